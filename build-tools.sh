@@ -0,0 +1,5 @@
+# Offline tools, not needed for running the vm. See the comments at the top of
+# each source file.
+
+g++ -pedantic -Wall -O2 -std=c++14 tools/opcodeStats.cpp -o opcode-stats
+g++ -pedantic -Wall -O2 -std=c++14 tools/prelink.cpp src/crc32.cpp -o prelink
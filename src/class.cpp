@@ -1,6 +1,11 @@
 #include "class.hpp"
+#include "memory.hpp"
 #include "methodTable.hpp"
 #include "object.hpp"
+#include "snapshot.hpp"
+#include "substitutionMethod.hpp"
+#include "vm.hpp"
+#include <algorithm>
 
 
 
@@ -8,24 +13,65 @@ namespace java {
 
 
 
+// Field resolution, see JVMS 5.4.3.2: the class itself, then its
+// superinterfaces, recursively, then its superclass, and so on.
+static Class::OptionStaticField* resolve_static(Class* clz,
+                                                Slice name,
+                                                jvm::symboltable::Symbol symbol)
+{
+    while (clz) {
+        if (auto field = clz->lookup_static(name, symbol)) {
+            return field;
+        }
+
+        if (auto interfaces = clz->interfaces()) {
+            auto vals = (network_u16*)((u8*)interfaces +
+                                       sizeof(ClassFile::HeaderSection2));
+            for (int i = 0; i < interfaces->interfaces_count_.get(); ++i) {
+                auto interface = jvm::load_class(clz, vals[i].get());
+                if (auto field = resolve_static(interface, name, symbol)) {
+                    return field;
+                }
+            }
+        }
+
+        clz = clz->super_;
+    }
+
+    return nullptr;
+}
+
+
+
 Class::OptionStaticField* Class::lookup_static(u16 index)
 {
     auto ref = (const ClassFile::ConstantRef*)constants_->load(index);
     auto nt = (const ClassFile::ConstantNameAndType*)constants_->load(
         ref->name_and_type_index_.get());
     auto name = constants_->load_string(nt->name_index_.get());
-    return lookup_static(name);
+    auto symbol = constants_->load_symbol(nt->name_index_.get());
+
+    // The field may be declared by another class entirely, or inherited from a
+    // superinterface or a superclass of the referenced class. E.g. javac
+    // refers to an interface's non-constant static field, used unqualified in
+    // a class that implements the interface, through the class.
+    return resolve_static(
+        jvm::load_class(this, ref->class_index_.get()), name, symbol);
 }
 
 
-const ClassFile::HeaderSection2* Class::interfaces() const
+const ClassFile::HeaderSection2* Class::header_section2() const
 {
-    if ((flags_ & Flag::implements_interfaces) == 0) {
-        return nullptr;
-    }
-
     auto src = (const ClassFile::HeaderSection1*)classfile_data_;
 
+#if JVM_PRELINKED_IMAGE
+    if (auto record = constants_->prelinked()) {
+        return (const ClassFile::HeaderSection2*)(classfile_data_ +
+                                                  record->interfaces_offset_
+                                                      .get());
+    }
+#endif
+
     const char* str = ((const char*)src) + sizeof(ClassFile::HeaderSection1);
 
     for (int i = 0; i < src->constant_count_.get() - 1; ++i) {
@@ -43,6 +89,35 @@ const ClassFile::HeaderSection2* Class::interfaces() const
 
 
 
+const ClassFile::HeaderSection3* Class::header_section3() const
+{
+#if JVM_PRELINKED_IMAGE
+    if (auto record = constants_->prelinked()) {
+        return (const ClassFile::HeaderSection3*)(classfile_data_ +
+                                                  record->fields_offset_.get());
+    }
+#endif
+
+    auto h2 = header_section2();
+
+    return (const ClassFile::HeaderSection3*)((const char*)(h2 + 1) +
+                                              sizeof(u16) *
+                                                  h2->interfaces_count_.get());
+}
+
+
+
+const ClassFile::HeaderSection2* Class::interfaces() const
+{
+    if ((flags_ & Flag::implements_interfaces) == 0) {
+        return nullptr;
+    }
+
+    return header_section2();
+}
+
+
+
 void Class::visit_methods(void (*visitor)(Class*,
                                           const ClassFile::MethodInfo*,
                                           void*),
@@ -78,8 +153,11 @@ void Class::visit_methods(void (*visitor)(Class*,
 
 
 
-const ClassFile::MethodInfo* Class::load_method(Slice method_name,
-                                                Slice type_signature)
+const ClassFile::MethodInfo*
+Class::load_method(Slice method_name,
+                   Slice type_signature,
+                   jvm::symboltable::Symbol method_name_symbol,
+                   jvm::symboltable::Symbol type_signature_symbol)
 {
     if (methods_ == nullptr) {
         return nullptr;
@@ -98,16 +176,13 @@ const ClassFile::MethodInfo* Class::load_method(Slice method_name,
         for (int i = 0; i < method_count; ++i) {
             auto method = (const ClassFile::MethodInfo*)str;
 
-            const auto method_name_str =
-                constants_->load_string(method->name_index_.get());
-
-            if (method_name_str == method_name) {
-                const auto method_type_str =
-                    constants_->load_string(method->descriptor_index_.get());
-
-                if (method_type_str == type_signature) {
-                    return method;
-                }
+            if (constants_->matches(method->name_index_.get(),
+                                    method_name,
+                                    method_name_symbol) and
+                constants_->matches(method->descriptor_index_.get(),
+                                    type_signature,
+                                    type_signature_symbol)) {
+                return method;
             }
 
             str += sizeof(ClassFile::MethodInfo);
@@ -119,7 +194,239 @@ const ClassFile::MethodInfo* Class::load_method(Slice method_name,
         }
     } else {
         auto method_table = (MethodTable*)methods_;
-        return method_table->load_method(this, method_name, type_signature);
+        return method_table->load_method(this,
+                                         method_name,
+                                         type_signature,
+                                         method_name_symbol,
+                                         type_signature_symbol);
+    }
+
+    return nullptr;
+}
+
+
+
+#if JVM_VTABLES
+static Slice method_name(Class* clz, const ClassFile::MethodInfo* method)
+{
+    return clz->constants_->load_string(method->name_index_.get());
+}
+
+
+
+// Whether two methods, of possibly different classes, have the same name and
+// descriptor.
+static bool same_signature(Class* lhs_class,
+                           const ClassFile::MethodInfo* lhs,
+                           Class* rhs_class,
+                           const ClassFile::MethodInfo* rhs)
+{
+    return same_string(*lhs_class->constants_,
+                       lhs->name_index_.get(),
+                       *rhs_class->constants_,
+                       rhs->name_index_.get()) and
+           same_string(*lhs_class->constants_,
+                       lhs->descriptor_index_.get(),
+                       *rhs_class->constants_,
+                       rhs->descriptor_index_.get());
+}
+
+
+
+static bool is_virtual(Class* clz, const ClassFile::MethodInfo* method)
+{
+    // Static methods, private methods, and constructors are never dispatched
+    // through a vtable.
+    if (method->access_flags_.get() & (0x0008 | 0x0002)) {
+        return false;
+    }
+
+    return method_name(clz, method).ptr_[0] not_eq '<';
+}
+
+
+
+// The index of the superclass method that a method overrides, or -1.
+static int overridden_index(Class* clz, const ClassFile::MethodInfo* method)
+{
+    if (clz->super_ == nullptr) {
+        return -1;
+    }
+
+    for (int i = 0; i < clz->super_->vtable_size_; ++i) {
+        auto& entry = clz->super_->vtable_[i];
+        if (same_signature(entry.class_, entry.method_, clz, method)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+
+bool Class::link_vtable()
+{
+    if (flags_ & Flag::has_vtable) {
+        return true;
+    }
+
+    if (methods_ == nullptr or (super_ and not super_->link_vtable())) {
+        return false;
+    }
+
+    struct Context {
+        u16 size_;
+        u16 overrides_;
+    } context = {super_ ? super_->vtable_size_ : (u16)0, 0};
+
+    visit_methods(
+        [](Class* clz, const ClassFile::MethodInfo* method, void* arg) {
+            auto context = (Context*)arg;
+            if (is_virtual(clz, method)) {
+                if (overridden_index(clz, method) < 0) {
+                    context->size_++;
+                } else {
+                    context->overrides_++;
+                }
+            }
+        },
+        &context);
+
+    if (context.size_ == 0) {
+        // Nothing to dispatch.
+    } else if (super_ and context.size_ == super_->vtable_size_ and
+               context.overrides_ == 0) {
+        // Inherits everything, and changes nothing, so we may as well share
+        // the superclass's vtable.
+        vtable_ = super_->vtable_;
+        vtable_size_ = super_->vtable_size_;
+    } else {
+        vtable_ = (VtableEntry*)jvm::classmemory::allocate(
+            sizeof(VtableEntry) * context.size_, alignof(VtableEntry));
+
+        if (vtable_ == nullptr) {
+            unhandled_error("failed to alloc vtable");
+        }
+
+        if (super_) {
+            std::copy(super_->vtable_,
+                      super_->vtable_ + super_->vtable_size_,
+                      vtable_);
+            vtable_size_ = super_->vtable_size_;
+        }
+
+        // Fill in overrides, and append new methods.
+        visit_methods(
+            [](Class* clz, const ClassFile::MethodInfo* method, void*) {
+                if (not is_virtual(clz, method)) {
+                    return;
+                }
+                const auto index = overridden_index(clz, method);
+                if (index < 0) {
+                    clz->vtable_[clz->vtable_size_++] = {method, clz};
+                } else {
+#if JVM_DEVIRTUALIZE
+                    jvm::invalidate_devirtualized_calls(
+                        clz->vtable_[index].method_);
+#endif
+                    clz->vtable_[index] = {method, clz};
+                }
+            },
+            nullptr);
+    }
+
+    flags_ |= Flag::has_vtable;
+
+    return true;
+}
+
+
+
+// Call tables are sorted by constant index.
+template <typename Call>
+static Call* lookup_call(Call* calls, u16 count, u16 constant_index)
+{
+    auto end = calls + count;
+
+    auto found = std::lower_bound(
+        calls, end, constant_index, [](const Call& call, u16 index) {
+            return call.constant_index_ < index;
+        });
+
+    if (found not_eq end and found->constant_index_ == constant_index) {
+        return found;
+    }
+
+    return nullptr;
+}
+
+
+
+Class::VirtualCall* Class::lookup_virtual_call(u16 constant_index)
+{
+    return lookup_call(virtual_calls_, virtual_call_count_, constant_index);
+}
+
+
+
+size_t Class::vtable_memory()
+{
+    size_t result = sizeof(VirtualCall) * virtual_call_count_;
+
+    if (not(super_ and vtable_ == super_->vtable_)) {
+        result += sizeof(VtableEntry) * vtable_size_;
+    }
+
+#if JVM_ITABLES
+    result += sizeof(InterfaceCall) * interface_call_count_;
+
+    if (not(super_ and itables_ == super_->itables_)) {
+        result += sizeof(Itable) * itable_count_;
+
+        for (int i = 0; i < itable_count_; ++i) {
+            if (itables_[i].methods_) {
+                result += sizeof(VtableEntry) *
+                          itables_[i].interface_->vtable_size_;
+            }
+        }
+    }
+#endif
+
+    return result;
+}
+#endif // JVM_VTABLES
+
+
+
+#if JVM_ITABLES
+Class::InterfaceCall* Class::lookup_interface_call(u16 constant_index)
+{
+    return lookup_call(interface_calls_, interface_call_count_, constant_index);
+}
+
+
+
+static bool is_abstract(const ClassFile::MethodInfo* method)
+{
+    return method->access_flags_.get() & 0x0400;
+}
+
+
+
+// The vtable entry with a method matching the name and descriptor of an
+// interface's method, or nullptr.
+static const Class::VtableEntry*
+find_method(Class* clz, const Class::VtableEntry& interface_method)
+{
+    for (int i = 0; i < clz->vtable_size_; ++i) {
+        auto& entry = clz->vtable_[i];
+        if (same_signature(entry.class_,
+                           entry.method_,
+                           interface_method.class_,
+                           interface_method.method_)) {
+            return &entry;
+        }
     }
 
     return nullptr;
@@ -127,23 +434,340 @@ const ClassFile::MethodInfo* Class::load_method(Slice method_name,
 
 
 
-size_t Class::instance_fields_size()
+bool Class::link_itables()
+{
+    if (flags_ & Flag::has_itables) {
+        return true;
+    }
+
+    if (not link_vtable() or (super_ and not super_->link_itables())) {
+        return false;
+    }
+
+    auto h2 = interfaces();
+
+    auto direct = [&](int i) {
+        auto indices =
+            (const network_u16*)((const u8*)h2 +
+                                 sizeof(ClassFile::HeaderSection2));
+        return jvm::load_class(this, indices[i].get());
+    };
+
+    const int direct_count = h2 ? h2->interfaces_count_.get() : 0;
+
+    // An upper bound, interfaces may be reachable by more than one path.
+    int capacity = super_ ? super_->itable_count_ : 0;
+
+    for (int i = 0; i < direct_count; ++i) {
+        auto interface = direct(i);
+        if (interface == nullptr or not interface->link_itables()) {
+            return false;
+        }
+        capacity += 1 + interface->itable_count_;
+    }
+
+    if (capacity == 0) {
+        flags_ |= Flag::has_itables;
+        return true;
+    }
+
+    if (super_ and direct_count == 0 and vtable_ == super_->vtable_) {
+        // Implements nothing new, and overrides nothing, so the superclass's
+        // itables apply as they are.
+        itables_ = super_->itables_;
+        itable_count_ = super_->itable_count_;
+        flags_ |= Flag::has_itables;
+        return true;
+    }
+
+    auto itables = (Itable*)jvm::classmemory::allocate(
+        sizeof(Itable) * capacity, alignof(Itable));
+
+    if (itables == nullptr) {
+        unhandled_error("failed to alloc itables");
+    }
+
+    int count = 0;
+
+    auto add = [&](Class* interface) {
+        for (int i = 0; i < count; ++i) {
+            if (itables[i].interface_ == interface) {
+                return;
+            }
+        }
+        itables[count++] = {interface, nullptr};
+    };
+
+    if (super_) {
+        for (int i = 0; i < super_->itable_count_; ++i) {
+            add(super_->itables_[i].interface_);
+        }
+    }
+
+    for (int i = 0; i < direct_count; ++i) {
+        auto interface = direct(i);
+        add(interface);
+        for (int j = 0; j < interface->itable_count_; ++j) {
+            add(interface->itables_[j].interface_);
+        }
+    }
+
+    const bool is_interface =
+        header_section2()->access_flags_.get() & 0x0200;
+
+    if (not is_interface) {
+        for (int i = 0; i < count; ++i) {
+            auto interface = itables[i].interface_;
+
+            auto methods = (VtableEntry*)jvm::classmemory::allocate(
+                sizeof(VtableEntry) * interface->vtable_size_,
+                alignof(VtableEntry));
+
+            if (methods == nullptr) {
+                unhandled_error("failed to alloc itables");
+            }
+
+            for (int j = 0; j < interface->vtable_size_; ++j) {
+                auto& declared = interface->vtable_[j];
+
+                if (auto found = find_method(this, declared)) {
+                    methods[j] = *found;
+                    continue;
+                }
+
+                // Not implemented by the class, maybe a default method. A
+                // default in a subinterface overrides one in the
+                // superinterface, whatever the order of the itables.
+                methods[j] = declared;
+
+                for (int k = 0; k < count; ++k) {
+                    auto candidate = itables[k].interface_;
+                    auto found = find_method(candidate, declared);
+                    if (found and not is_abstract(found->method_) and
+                        (is_abstract(methods[j].method_) or
+                         candidate->implements(methods[j].class_))) {
+                        methods[j] = *found;
+                    }
+                }
+            }
+
+            itables[i].methods_ = methods;
+        }
+    }
+
+    itables_ = itables;
+    itable_count_ = count;
+
+    flags_ |= Flag::has_itables;
+
+    return true;
+}
+#endif // JVM_ITABLES
+
+
+
+#if JVM_SUBTYPE_DISPLAY
+static u16 interface_count JVM_SNAPSHOT_STATE;
+
+
+
+bool Class::link_subtypes()
+{
+    if (flags_ & Flag::has_subtypes) {
+        return true;
+    }
+
+    if (not link_itables() or (super_ and not super_->link_subtypes())) {
+        return false;
+    }
+
+    for (int i = 0; i < itable_count_; ++i) {
+        if (not itables_[i].interface_->link_subtypes()) {
+            return false;
+        }
+    }
+
+    const bool is_interface =
+        header_section2()->access_flags_.get() & 0x0200;
+
+    if (is_interface) {
+        if (interface_count == 0xffff) {
+            unhandled_error("too many interfaces");
+        }
+        interface_id_ = ++interface_count;
+    }
+
+    depth_ = super_ ? super_->depth_ + 1 : 0;
+
+    display_ = (Class**)jvm::classmemory::allocate(
+        sizeof(Class*) * (depth_ + 1), alignof(Class*));
+
+    if (display_ == nullptr) {
+        unhandled_error("failed to alloc class display");
+    }
+
+    if (super_) {
+        std::copy(super_->display_, super_->display_ + depth_, display_);
+    }
+    display_[depth_] = this;
+
+    if (super_ and not is_interface and itables_ == super_->itables_) {
+        // Implements nothing new, see link_itables().
+        interface_bits_ = super_->interface_bits_;
+        interface_words_ = super_->interface_words_;
+    } else {
+        u16 highest = interface_id_;
+        for (int i = 0; i < itable_count_; ++i) {
+            highest = std::max(highest, itables_[i].interface_->interface_id_);
+        }
+
+        if (highest) {
+            const u16 words = highest / 32 + 1;
+
+            auto bits = (u32*)jvm::classmemory::allocate(sizeof(u32) * words,
+                                                         alignof(u32));
+
+            if (bits == nullptr) {
+                unhandled_error("failed to alloc interface bits");
+            }
+
+            std::fill(bits, bits + words, 0);
+
+            auto set = [bits](u16 id) { bits[id / 32] |= 1u << (id % 32); };
+
+            if (interface_id_) {
+                set(interface_id_);
+            }
+            for (int i = 0; i < itable_count_; ++i) {
+                set(itables_[i].interface_->interface_id_);
+            }
+
+            interface_bits_ = bits;
+            interface_words_ = words;
+        }
+    }
+
+    flags_ |= Flag::has_subtypes;
+
+    return true;
+}
+#endif // JVM_SUBTYPE_DISPLAY
+
+
+
+#if JVM_QUICKEN_BYTECODE
+static void insert_quickened_code(Class::OptionQuickenedCode** buckets,
+                                  u16 mask,
+                                  Class::OptionQuickenedCode* quick)
+{
+    auto& bucket = buckets[(uintptr_t)quick->method_ & mask];
+
+    quick->header_.option_.next_ = (Class::Option*)bucket;
+    bucket = quick;
+}
+
+
+
+void Class::bind_quickened_code(OptionQuickenedCode* quick)
 {
-    Class* current = this;
+    const u32 old_count = quickened_code_ ? quickened_code_mask_ + 1 : 0;
+
+    if (quickened_code_count_ >= old_count * 2 and old_count < 0x8000) {
+        // Doubles, starting small, as most classes quicken a handful of
+        // methods at most. The old buckets stay in class memory.
+        const u32 count = old_count ? old_count * 2 : 4;
+
+        auto buckets = (OptionQuickenedCode**)jvm::classmemory::allocate(
+            sizeof(OptionQuickenedCode*) * count,
+            alignof(OptionQuickenedCode*));
+
+        if (buckets == nullptr) {
+            unhandled_error("failed to alloc quickened code table");
+        }
+
+        std::fill(buckets, buckets + count, nullptr);
 
-    while (current) {
-        if (current->cpool_highest_field_ not_eq -1) {
-            auto sub = (SubstitutionField*)current->constants_->load(
-                current->cpool_highest_field_);
+        for (u32 i = 0; i < old_count; ++i) {
+            auto current = quickened_code_[i];
+            while (current) {
+                auto next = next_quickened_code(current);
+                insert_quickened_code(buckets, count - 1, current);
+                current = next;
+            }
+        }
+
+        quickened_code_ = buckets;
+        quickened_code_mask_ = count - 1;
+    }
+
+    insert_quickened_code(quickened_code_, quickened_code_mask_, quick);
+
+    if (quickened_code_count_ < 0xffff) {
+        ++quickened_code_count_;
+    }
+}
+#endif
 
-            return sub->offset_ + sub->real_size();
 
-        } else {
-            current = current->super_;
+
+void Class::replace_method(const ClassFile::MethodInfo* method,
+                           const ClassFile::MethodInfo* replacement)
+{
+#if JVM_VTABLES
+    for (int i = 0; i < vtable_size_; ++i) {
+        if (vtable_[i].method_ == method) {
+            vtable_[i].method_ = replacement;
+        }
+    }
+#endif
+
+#if JVM_INLINE_CACHES
+    visit_quickened_code([&](OptionQuickenedCode* quick) {
+        for (int i = 0; i < quick->inline_cache_count_; ++i) {
+            auto& cache = quick->inline_caches_[i];
+
+            if (cache.receivers_ == 0 or
+                cache.receivers_ == cache.megamorphic) {
+                continue;
+            }
+
+            if (cache.monomorphic_.method_ == method) {
+                cache.monomorphic_.method_ = replacement;
+            }
+
+            if (cache.receivers_ == cache.devirtualized) {
+                continue;
+            }
+
+            for (int j = 0; j < cache.receivers_ - 1; ++j) {
+                if (cache.polymorphic_[j].method_ == method) {
+                    cache.polymorphic_[j].method_ = replacement;
+                }
+            }
+        }
+    });
+#endif
+
+#if JVM_RESOLVED_METHODS
+    auto bound = constants_->method_bindings();
+
+    for (int i = 0; i < bound.second; ++i) {
+        if (auto sub = bound.first[i].method_) {
+            if (sub->method_ == method) {
+                sub->method_ = replacement;
+                sub->code_ = nullptr;
+#if JVM_QUICKEN_BYTECODE
+                sub->quick_ = nullptr;
+#endif
+            }
         }
     }
+#endif
 
-    return 0;
+#if not JVM_VTABLES and not JVM_INLINE_CACHES and not JVM_RESOLVED_METHODS
+    (void)method;
+    (void)replacement;
+#endif
 }
 
 
@@ -2,6 +2,7 @@
 
 #include "classfile.hpp"
 #include "constantPool.hpp"
+#include "defines.hpp"
 #include "slice.hpp"
 #include "substitutionField.hpp"
 
@@ -25,6 +26,7 @@ struct Class {
             null,
             bootstrap_methods,
             static_field,
+            quickened_code,
         } type_ = Type::null;
     };
 
@@ -44,14 +46,23 @@ struct Class {
         has_method_table      = (1 << 1),
         __reserved_1__        = (1 << 2),
         implements_interfaces = (1 << 3),
+        has_vtable            = (1 << 4),
+        has_itables           = (1 << 5),
+        has_subtypes          = (1 << 6),
         // clang-format on
     };
 
     u16 flags_ = 0;
 
-    // We keep track of the highest index of SubstitutionField in our class
-    // instance. In doing so, we know how large class instances need to be.
-    s16 cpool_highest_field_ = -1;
+    // The bytes that an instance's fields take, including inherited fields,
+    // from the class's field table, see instance_fields_size().
+    u16 instance_fields_size_ = 0;
+
+    u16 reference_field_count_ = 0;
+
+    // The offsets of the reference fields that the class itself declares,
+    // which the gc visits, along with those of each superclass.
+    const u16* reference_fields_ = nullptr;
 
 
     ConstantPool* constants_ = nullptr;
@@ -106,14 +117,39 @@ struct Class {
     const ClassFile::HeaderSection2* interfaces() const;
 
 
+    // The parts of the classfile after the constant pool. Walks the constant
+    // pool, unless the class was prelinked, see image.hpp.
+    const ClassFile::HeaderSection2* header_section2() const;
+    const ClassFile::HeaderSection3* header_section3() const;
+
+
+    // The text of the name and type must outlive the vm, as they may get
+    // interned, see symboltable::intern().
     const ClassFile::MethodInfo* load_method(Slice method_name,
-                                             Slice type_signature);
+                                             Slice type_signature)
+    {
+        return load_method(method_name,
+                           type_signature,
+                           jvm::symboltable::intern(method_name),
+                           jvm::symboltable::intern(type_signature));
+    }
+
+
+    // For callers that interned the name and type already.
+    const ClassFile::MethodInfo*
+    load_method(Slice method_name,
+                Slice type_signature,
+                jvm::symboltable::Symbol method_name_symbol,
+                jvm::symboltable::Symbol type_signature_symbol);
 
 
     // The extra memory required to hold all fields of an instance of this
     // class. A size of an instance of this class equals sizeof(Object) +
     // class->instance_fields_size().
-    size_t instance_fields_size();
+    size_t instance_fields_size()
+    {
+        return instance_fields_size_;
+    }
 
 
     size_t instance_size();
@@ -127,11 +163,16 @@ struct Class {
     struct OptionStaticField {
         OptionHeader<Option::Type::static_field> header_;
         const Slice name_;
+        const jvm::symboltable::Symbol symbol_;
         const u8 field_size_ : 7;
         const u8 is_object_ : 1;
 
-        OptionStaticField(Slice name, u8 field_size, bool is_object)
-            : name_(name), field_size_(field_size), is_object_(is_object)
+        OptionStaticField(Slice name,
+                          jvm::symboltable::Symbol symbol,
+                          u8 field_size,
+                          bool is_object)
+            : name_(name), symbol_(symbol), field_size_(field_size),
+              is_object_(is_object)
         {
         }
 
@@ -142,17 +183,24 @@ struct Class {
     };
 
 
+    // Resolve a Fieldref constant to a static field, in the referenced class,
+    // or in one of its superinterfaces or superclasses.
     OptionStaticField* lookup_static(u16 ref);
 
 
-    OptionStaticField* lookup_static(Slice field_name)
+    OptionStaticField* lookup_static(Slice field_name,
+                                     jvm::symboltable::Symbol symbol)
     {
         auto current = options_;
 
         while (current) {
             if (current->type_ == Option::Type::static_field) {
                 auto field = (OptionStaticField*)current;
-                if (field->name_ == field_name) {
+                if (symbol and field->symbol_) {
+                    if (field->symbol_ == symbol) {
+                        return field;
+                    }
+                } else if (field->name_ == field_name) {
                     return field;
                 }
             }
@@ -164,9 +212,285 @@ struct Class {
     }
 
 
+    // A copy of a method's bytecode, in class memory, which the interpreter is
+    // free to rewrite with quickened instructions. The classfile itself may
+    // live in read-only memory. See quicken_method() in vm.cpp.
+    struct OptionQuickenedCode {
+        OptionHeader<Option::Type::quickened_code> header_;
+        const ClassFile::MethodInfo* method_;
+
+        // Null, if the method contains nothing worth quickening, in which
+        // case, the interpreter runs the classfile's bytecode.
+        u8* code_ = nullptr;
+
+        // Resolved values, which do not fit into the operand bytes of a
+        // quickened instruction. Allocated up front, one slot per instruction
+        // that might need one (two, for ldc2_w).
+        union Slot {
+            OptionStaticField* static_field_;
+            const SubstitutionMethod* method_;
+            Class* class_;
+            s32 value_;
+        };
+
+        Slot* slots_ = nullptr;
+        u16 slot_count_ = 0;
+        u16 slot_capacity_ = 0;
+
+        u16 code_length_ = 0; // Of code_.
+
+#if JVM_INLINE_CACHES
+        // The receiver classes seen by an invokevirtual or invokeinterface
+        // instruction, and the methods that they resolved to. Allocated up
+        // front, one per instruction. A quickened invoke instruction carries
+        // the index of its cache. See vm.cpp.
+        struct InlineCache {
+            // A devirtualized cache calls its monomorphic method, whatever
+            // the receiver, see JVM_DEVIRTUALIZE.
+            enum : u8 { devirtualized = 0xfe, megamorphic = 0xff };
+
+            struct Entry {
+                Class* receiver_;
+                Class* class_; // Declares the method.
+                const ClassFile::MethodInfo* method_;
+            };
+
+            Entry monomorphic_;
+
+            // Room for JVM_INLINE_CACHE_SIZE - 1 more receivers, allocated
+            // once the call site sees a second receiver class.
+            Entry* polymorphic_;
+
+            u16 constant_index_;
+            u8 operand_count_; // Including self.
+            u8 receivers_;     // Entries in use, or one of the above.
+
+#if JVM_INLINE_CACHE_STATS
+            u32 hits_;
+            u32 misses_;
+#endif
+        };
+
+        InlineCache* inline_caches_ = nullptr;
+        u16 inline_cache_count_ = 0;
+        u16 inline_cache_capacity_ = 0;
+#endif
+
+        OptionQuickenedCode(const ClassFile::MethodInfo* method)
+            : method_(method)
+        {
+        }
+    };
+
+
+#if JVM_QUICKEN_BYTECODE
+    // The class's quickened code, hashed by method, so that a call finds its
+    // method's quickened code in constant time, however many methods and
+    // static fields the class has. Each bucket chains its quickened code
+    // through the option header, in place of the option list, and holds two
+    // on average, at most. See bind_quickened_code().
+    OptionQuickenedCode** quickened_code_ = nullptr;
+    u16 quickened_code_count_ = 0;
+    u16 quickened_code_mask_ = 0; // The bucket count, a power of two, less one.
+
+
+    static OptionQuickenedCode* next_quickened_code(OptionQuickenedCode* quick)
+    {
+        return (OptionQuickenedCode*)quick->header_.option_.next_;
+    }
+
+
+    OptionQuickenedCode* lookup_quickened_code(const ClassFile::MethodInfo* mtd)
+    {
+        if (quickened_code_ == nullptr) {
+            return nullptr;
+        }
+
+        // Methods sit at arbitrary offsets in the classfile, so the low bits
+        // of their addresses serve as a hash.
+        auto quick = quickened_code_[(uintptr_t)mtd & quickened_code_mask_];
+
+        for (; quick; quick = next_quickened_code(quick)) {
+            if (quick->method_ == mtd) {
+                return quick;
+            }
+        }
+
+        return nullptr;
+    }
+
+
+    void bind_quickened_code(OptionQuickenedCode* quick);
+
+
+    template <typename F> void visit_quickened_code(F visitor)
+    {
+        if (quickened_code_ == nullptr) {
+            return;
+        }
+
+        for (int i = 0; i <= quickened_code_mask_; ++i) {
+            auto quick = quickened_code_[i];
+            for (; quick; quick = next_quickened_code(quick)) {
+                visitor(quick);
+            }
+        }
+    }
+#endif
+
+
     // Required for debuggers
     const ClassFile::LineNumberTableAttribute*
     get_line_number_table(const ClassFile::MethodInfo* mtd);
+
+
+    // Swap out a method wherever the class may have cached it (the vtable,
+    // inline caches, bound Methodrefs), e.g. for a native method stub.
+    void replace_method(const ClassFile::MethodInfo* method,
+                        const ClassFile::MethodInfo* replacement);
+
+
+#if JVM_VTABLES
+    // Virtual methods, including inherited ones: a copy of the superclass's
+    // vtable, with overridden methods replaced, followed by the methods that
+    // the class introduces. A method keeps its index in every subclass.
+    struct VtableEntry {
+        const ClassFile::MethodInfo* method_;
+        Class* class_; // Declares the method.
+    };
+
+    VtableEntry* vtable_ = nullptr;
+    u16 vtable_size_ = 0;
+
+    // One entry per Methodref constant, in constant pool order, reserved when
+    // the classfile is parsed. Filled in the first time that an invokevirtual
+    // instruction calls through the Methodref. See vm.cpp.
+    struct VirtualCall {
+        enum : u16 { not_in_vtable = 0xffff };
+
+        u16 constant_index_;
+        u16 vtable_index_;
+        u16 operand_count_; // Including self. Zero until resolved.
+    };
+
+    VirtualCall* virtual_calls_ = nullptr;
+    u16 virtual_call_count_ = 0;
+
+
+    VirtualCall* lookup_virtual_call(u16 constant_index);
+
+
+    // Build the vtable, unless the class, or one of its superclasses, hasn't
+    // been parsed in full yet (classes may load other classes in the middle of
+    // being parsed). Returns false if the vtable isn't ready.
+    bool link_vtable();
+
+
+    // Class memory used by the vtable and the virtual call table (and the
+    // itables and the interface call table, if enabled).
+    size_t vtable_memory();
+#endif
+
+
+#if JVM_ITABLES
+    // One per interface that the class implements, whether directly, or
+    // through a superclass or a superinterface. The methods parallel the
+    // interface's vtable: the method at an index implements the interface's
+    // method at the same index. An interface's own list holds its
+    // superinterfaces, without methods.
+    struct Itable {
+        Class* interface_;
+        VtableEntry* methods_;
+    };
+
+    Itable* itables_ = nullptr;
+    u16 itable_count_ = 0;
+
+    // One entry per InterfaceMethodref constant, in constant pool order, like
+    // the virtual call table. Filled in the first time that an
+    // invokeinterface instruction calls through the InterfaceMethodref.
+    struct InterfaceCall {
+        Class* interface_; // Declares the method. Null until resolved.
+        u16 constant_index_;
+        u16 method_index_; // Into the interface's vtable.
+        u16 operand_count_; // Including self.
+    };
+
+    InterfaceCall* interface_calls_ = nullptr;
+    u16 interface_call_count_ = 0;
+
+
+    InterfaceCall* lookup_interface_call(u16 constant_index);
+
+
+    // Build the itables, loading the class's interfaces, if necessary. Returns
+    // false if the vtables of the class, or of one of the interfaces, aren't
+    // ready yet. See link_vtable().
+    bool link_itables();
+
+
+    // The class's implementation of an interface's method, or nullptr, if the
+    // class doesn't implement the interface.
+    const VtableEntry* lookup_itable(Class* interface, u16 method_index)
+    {
+        for (int i = 0; i < itable_count_; ++i) {
+            if (itables_[i].interface_ == interface) {
+                return itables_[i].methods_ + method_index;
+            }
+        }
+
+        return nullptr;
+    }
+
+
+    bool implements(Class* interface)
+    {
+        for (int i = 0; i < itable_count_; ++i) {
+            if (itables_[i].interface_ == interface) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+#endif
+
+
+#if JVM_SUBTYPE_DISPLAY
+    // The class's superclasses, indexed by depth in the class hierarchy
+    // (java/lang/Object has depth zero), ending with the class itself. A
+    // class extends the class at depth d, if and only if its display holds
+    // that class at index d.
+    Class** display_ = nullptr;
+    u16 depth_ = 0;
+
+    // Nonzero for interfaces. Numbered in the order that they're linked.
+    u16 interface_id_ = 0;
+
+    // One bit per interface id, set for each interface that the class
+    // implements. An interface's bits include its own.
+    u32* interface_bits_ = nullptr;
+    u16 interface_words_ = 0;
+
+
+    // Build the display and the interface bits. Returns false if the itables
+    // aren't ready yet, see link_itables().
+    bool link_subtypes();
+
+
+    // Whether instances of this class are instances of the other class, in
+    // constant time. Both classes must be linked.
+    bool is_subtype_of(const Class* other) const
+    {
+        if (other->interface_id_) {
+            const auto word = other->interface_id_ / 32;
+            return word < interface_words_ and
+                   (interface_bits_[word] >> (other->interface_id_ % 32)) & 1;
+        }
+
+        return other->depth_ <= depth_ and display_[other->depth_] == other;
+    }
+#endif
 };
 
 
@@ -58,160 +58,161 @@ std::pair<SubstitutionField::Size, bool> get_field_size(Slice field_type)
 
 
 
-// A quite complicated function call. It looks up a class, and determines the
-// byte offset of a field within an instance of that class.
-//
-// FIXME: this code does not look at access permissions on field access, we
-// could potentially have a shadowing bug, if there are private/public vars with
-// the same name.
-SubstitutionField link_field(Class* current, const ClassFile::ConstantRef& ref)
+// Calls the callback with each instance field that a class itself declares,
+// along with the field's layout, until the callback returns true. Fields are
+// laid out in an object according to the order in which they appear in the
+// fields section of the classfile, after the superclass's fields, tightly
+// packed.
+template <typename F>
+static void visit_instance_fields(Class* clz,
+                                  const ClassFile::HeaderSection3* h3,
+                                  F callback)
 {
-    auto src_nt =
-        (const ClassFile::ConstantNameAndType*)current->constants_->load(
-            ref.name_and_type_index_.get());
+    // The byte offset into the instance, where the field is stored.
+    // NOTE: The VM assumes that the parent class was loaded first. Otherwise
+    // none of this works!
+    u32 instance_offset = clz->super_ ? clz->super_->instance_fields_size() : 0;
 
-    auto local_field_type =
-        current->constants_->load_string(src_nt->descriptor_index_.get());
+    auto str = (const char*)(h3 + 1);
 
-    auto local_field_name =
-        current->constants_->load_string(src_nt->name_index_.get());
+    for (int i = 0; i < h3->fields_count_.get(); ++i) {
+        auto field = (const ClassFile::FieldInfo*)str;
+        str += sizeof(ClassFile::FieldInfo);
 
-    // std::cout << "linking field of name "
-    //           << std::string(local_field_name.ptr_, local_field_name.length_)
-    //           << ", type "
-    //           << std::string(local_field_type.ptr_, local_field_type.length_)
-    //           << std::endl;
+        for (int i = 0; i < field->attributes_count_.get(); ++i) {
+            auto attr = (ClassFile::AttributeInfo*)str;
+            str += sizeof(ClassFile::AttributeInfo) +
+                   attr->attribute_length_.get();
+        }
 
-    // Ok, so we're given a refrence to a field in an arbitrary class. To
-    // determine the byte offset of the field within an instance of said class,
-    // we begin by loading the class itself.
-    if (auto clz = jvm::load_class(current, ref.class_index_.get())) {
+        if (field->access_flags_.get() & 0x08) {
+            // Skip field, the static field does not contribute to the size of
+            // an instance.
+            continue;
+        }
 
-        // Storing a flag to indicate whether a fieldref in the constant pool
-        // belongs to the class defined in the classfile helps us later when
-        // we're running the gc.
-        const bool is_local = clz == current;
+        if (instance_offset > 2047) {
+            unhandled_error("field offset exceeds maximum");
+        }
 
-        // To make things even more complicated, we need to run this thing in a
-        // loop, to match inherited fields.
-        while (clz) {
+        auto field_type =
+            clz->constants_->load_string(field->descriptor_index_.get());
 
-            // The byte offset into the instance, where the field is stored.
-            u16 instance_offset = 0;
+        auto field_size = get_field_size(field_type);
 
-            if (clz->super_) {
-                // Ask the parent class how many bytes it requires for its own
-                // fields.
-                // NOTE: The VM assumes that the parent class was loaded
-                // first. Otherwise none of this works!
-                instance_offset = clz->super_->instance_fields_size();
-            }
+        SubstitutionField sub(
+            field_size.first, instance_offset, field_size.second);
 
-            // Now comes the tricky part. Fields are laid out in an object according
-            // to the order in which they appear in the fields section of the
-            // classfile. So we need to jump to the correct portion of the class
-            // file, and build up an offset while iterating over all of the fields.
+        if (callback(field, sub)) {
+            return;
+        }
 
-            auto classfile = clz->classfile_data_;
+        instance_offset += sub.real_size();
+    }
+}
 
-            // We cannot simply jump directly to the section of the classfile that
-            // lists all the field info, we need to iterate over some
-            // variable-length structures first.
 
-            auto h1 = (ClassFile::HeaderSection1*)classfile;
-            classfile += sizeof(ClassFile::HeaderSection1);
 
-            for (int i = 0; i < h1->constant_count_.get() - 1; ++i) {
-                auto c = (const ClassFile::ConstantHeader*)classfile;
-                if (c->tag_ == ClassFile::t_double or
-                    c->tag_ == ClassFile::t_long) {
-                    // Not sure who's bright idea this was... wish I could get
-                    // into a time machine and ask the people at Sun about
-                    // this...
-                    ++i;
+// Determine the byte offset of a field, by name and type, within an instance
+// of a class. Searches the superclasses too, for inherited fields.
+SubstitutionField find_field(Class* clz, Slice name, Slice type)
+{
+    const auto name_symbol = jvm::symboltable::intern(name);
+    const auto type_symbol = jvm::symboltable::intern(type);
+
+    // We need to run this thing in a loop, to match inherited fields.
+    while (clz) {
+        SubstitutionField found;
+
+        visit_instance_fields(
+            clz, clz->header_section3(), [&](auto field, auto sub) {
+                if (clz->constants_->matches(
+                        field->name_index_.get(), name, name_symbol) and
+                    clz->constants_->matches(
+                        field->descriptor_index_.get(), type, type_symbol)) {
+                    // NOTE: Do we ever need to check access protections here?
+                    // The java compiler will not allow a derived class to
+                    // access a base class' public field of the same name if
+                    // the derived class includes a private field that shadows
+                    // the public one. Methods, in addition, cannot be more
+                    // private than ones that they override. But, still, I'm
+                    // not entirely confident that I'm not missing
+                    // something... while the java compiler checks access
+                    // rules, what do other languages that target the java
+                    // platform do? i.e. will this jvm incorrectly handle
+                    // classfiles generated by Scale/Clojure/Kotlin, by
+                    // assuming access controls will be checked in advance by
+                    // a compiler? TODO: verify this.
+                    found = sub;
+                    return true;
                 }
-                classfile += ClassFile::constant_size(c);
-            }
+                return false;
+            });
 
-            // Ok, now we've skipped over the first part of the classfile (the
-            // constant pool). Next we need to jump across another section, along
-            // with the interfaces...
+        if (found.valid_) {
+            return found;
+        }
 
-            auto h2 = (ClassFile::HeaderSection2*)classfile;
-            classfile += sizeof(ClassFile::HeaderSection2);
+        clz = clz->super_;
+    }
 
-            if (h2->interfaces_count_.get()) {
-                for (int i = 0; i < h2->interfaces_count_.get(); ++i) {
-                    // Each interface is merely an index into the constant pool.
-                    classfile += sizeof(u16);
-                }
-            }
+    return {};
+}
 
-            auto h3 = (ClassFile::HeaderSection3*)classfile;
-            classfile += sizeof(ClassFile::HeaderSection3);
 
-            for (int i = 0; i < h3->fields_count_.get(); ++i) {
-                auto field = (const ClassFile::FieldInfo*)classfile;
-                classfile += sizeof(ClassFile::FieldInfo);
 
-                if (field->access_flags_.get() & 0x08) {
-                    // Skip field, the static field does not contribute to the
-                    // size of an instance.
-                    for (int i = 0; i < field->attributes_count_.get(); ++i) {
-                        auto attr = (ClassFile::AttributeInfo*)classfile;
-                        classfile += sizeof(ClassFile::AttributeInfo) +
-                                     attr->attribute_length_.get();
-                    }
+// A quite complicated function call. It looks up a class, and determines the
+// byte offset of a field within an instance of that class.
+//
+// FIXME: this code does not look at access permissions on field access, we
+// could potentially have a shadowing bug, if there are private/public vars with
+// the same name.
+static SubstitutionField link_field(Class* current,
+                                    const ClassFile::ConstantRef& ref)
+{
+    auto src_nt =
+        (const ClassFile::ConstantNameAndType*)current->constants_->load(
+            ref.name_and_type_index_.get());
 
-                    continue;
-                }
+    auto local_field_type =
+        current->constants_->load_string(src_nt->descriptor_index_.get());
 
-                auto field_type = clz->constants_->load_string(
-                    field->descriptor_index_.get());
+    auto local_field_name =
+        current->constants_->load_string(src_nt->name_index_.get());
 
-                auto field_name =
-                    clz->constants_->load_string(field->name_index_.get());
+    // Ok, so we're given a refrence to a field in an arbitrary class. To
+    // determine the byte offset of the field within an instance of said class,
+    // we begin by loading the class itself.
+    if (auto clz = jvm::load_class(current, ref.class_index_.get())) {
+        return find_field(clz, local_field_name, local_field_type);
+    }
 
-                auto field_size = get_field_size(field_type);
+    return {};
+}
 
-                SubstitutionField sub(
-                    field_size.first, instance_offset, field_size.second);
 
-                if (field_type == local_field_type and
-                    field_name == local_field_name) {
-                    // NOTE: Do we ever need to check access protections here?
-                    // The java compiler will not allow a derived class to
-                    // access a base class' public field of the same name if the
-                    // derived class includes a private field that shadows the
-                    // public one. Methods, in addition, cannot be more private
-                    // than ones that they override. But, still, I'm not
-                    // entirely confident that I'm not missing
-                    // something... while the java compiler checks access rules,
-                    // what do other languages that target the java platform do?
-                    // i.e. will this jvm incorrectly handle classfiles
-                    // generated by Scale/Clojure/Kotlin, by assuming access
-                    // controls will be checked in advance by a compiler? TODO:
-                    // verify this.
-
-                    sub.local_ = is_local;
-                    // std::cout << "found field at offset " << instance_offset << std::endl;
-                    return sub;
-                }
 
-                instance_offset += sub.real_size();
+SubstitutionField resolve_field(Class* clz, u16 index)
+{
+    if (auto field = clz->constants_->load_field(index)) {
+        return *field;
+    }
 
-                // Skip over attributes...
-                for (int i = 0; i < field->attributes_count_.get(); ++i) {
-                    auto attr = (ClassFile::AttributeInfo*)classfile;
-                    classfile += sizeof(ClassFile::AttributeInfo) +
-                                 attr->attribute_length_.get();
-                }
-            }
-            clz = clz->super_;
-        }
+    auto ref = (const ClassFile::ConstantRef*)clz->constants_->load(index);
+
+    auto field = link_field(clz, *ref);
+
+    // Linking may load the field's class, and run its static initializer,
+    // which may have bound the field already.
+    if (auto bound = clz->constants_->load_field(index)) {
+        return *bound;
     }
 
-    return {};
+    if (field.valid_) {
+        clz->constants_->bind_field(index, field);
+    }
+
+    return field;
 }
 
 
@@ -231,93 +232,122 @@ void make_static_variable(Class* clz, const ClassFile::FieldInfo* field)
         jvm::classmemory::allocate(sizeof(Class::OptionStaticField) + size,
                                    alignof(Class::OptionStaticField));
 
-    new (opt) Class::OptionStaticField(field_name, (u8)size, is_object);
+    new (opt) Class::OptionStaticField(
+        field_name,
+        clz->constants_->load_symbol(field->name_index_.get()),
+        (u8)size,
+        is_object);
 
     clz->append_option((Class::OptionStaticField*)opt);
 }
 
 
 
-const char* parse_classfile_fields(const char* str,
-                                   Class* clz,
-                                   const ClassFile::HeaderSection1& h1)
+#if JVM_VTABLES or JVM_ITABLES
+// Calls the callback with the index, and the header, of each constant with a
+// given tag.
+template <typename F>
+static void visit_constants(const Class* clz, u8 tag, F callback)
 {
-    int nfields = 0;
-    {
-        const char* str =
-            ((const char*)&h1) + sizeof(ClassFile::HeaderSection1);
+    auto& h1 = *(const ClassFile::HeaderSection1*)clz->classfile_data_;
+
+#if JVM_PRELINKED_IMAGE
+    if (auto record = clz->constants_->prelinked()) {
+        // We know where each constant is, no need to measure each one.
+        auto offsets = record->constant_offsets();
 
         for (int i = 0; i < h1.constant_count_.get() - 1; ++i) {
-            auto c = (const ClassFile::ConstantHeader*)str;
-            if (c->tag_ == ClassFile::t_field_ref) {
-                ++nfields;
-            } else if (c->tag_ == ClassFile::t_double or
-                       c->tag_ == ClassFile::t_long) {
-                ++i;
+            auto c = (const ClassFile::ConstantHeader*)(clz->classfile_data_ +
+                                                         offsets[i].get());
+            if (offsets[i].get() and c->tag_ == tag) {
+                callback(i + 1, c);
             }
-            str +=
-                ClassFile::constant_size((const ClassFile::ConstantHeader*)str);
         }
+        return;
     }
+#endif
 
-    // FIXME: This code reserves extra unused slots for static variables,
-    // because the code doesn't know at this point about the fields' access
-    // settings.
-    clz->constants_->reserve_fields(nfields);
+    const char* str = ((const char*)&h1) + sizeof(ClassFile::HeaderSection1);
 
-    {
-        // Substitute each field ref in this module with a specific byte offset
-        // into the class instance.
+    for (int i = 0; i < h1.constant_count_.get() - 1; ++i) {
+        auto c = (const ClassFile::ConstantHeader*)str;
+        if (c->tag_ == tag) {
+            callback(i + 1, c);
+        } else if (c->tag_ == ClassFile::t_double or
+                   c->tag_ == ClassFile::t_long) {
+            ++i;
+        }
+        str += ClassFile::constant_size(c);
+    }
+}
 
-        const char* str =
-            ((const char*)&h1) + sizeof(ClassFile::HeaderSection1);
 
-        for (int i = 0; i < h1.constant_count_.get() - 1; ++i) {
-            auto hdr = (const ClassFile::ConstantHeader*)str;
-            if (hdr->tag_ == ClassFile::t_field_ref) {
-                auto& ref = *(const ClassFile::ConstantRef*)hdr;
-
-                auto field = link_field(clz, ref);
-
-                if (field.valid_) {
-
-                    if (field.offset_ > 2047) {
-                        unhandled_error("field offset exceeds maximum");
-                    }
-
-                    clz->constants_->bind_field(i + 1, field);
-
-                    if (auto other_clz =
-                            jvm::load_class(clz, ref.class_index_.get())) {
-                        // If we're registering a field for the same class as we're
-                        // parsing...
-                        if (other_clz == clz) {
-                            if (clz->cpool_highest_field_ not_eq -1) {
-                                auto prev =
-                                    (SubstitutionField*)clz->constants_->load(
-                                        clz->cpool_highest_field_);
-                                if (field.offset_ > prev->offset_) {
-                                    clz->cpool_highest_field_ = i + 1;
-                                }
-                            } else {
-                                clz->cpool_highest_field_ = i + 1;
-                            }
-                        }
-                    }
-                }
-            } else if (hdr->tag_ == ClassFile::t_double or
-                       hdr->tag_ == ClassFile::t_long) {
-                ++i;
-            }
 
-            str +=
-                ClassFile::constant_size((const ClassFile::ConstantHeader*)str);
+// The number of constants with a given tag. Prelinked images count the
+// constants of each kind that we reserve memory for when loading a class.
+static u16 count_constants(const Class* clz, u8 tag)
+{
+#if JVM_PRELINKED_IMAGE
+    if (auto record = clz->constants_->prelinked()) {
+        switch (tag) {
+        case ClassFile::t_method_ref:
+            return record->method_ref_count_.get();
+
+        case ClassFile::t_interface_method_ref:
+            return record->interface_method_ref_count_.get();
         }
     }
+#endif
 
+    u16 count = 0;
+    visit_constants(clz, tag, [&](u16, auto) { ++count; });
 
-    // Skip over the rest of the file...
+    return count;
+}
+#endif
+
+
+
+const char* parse_classfile_fields(const char* str, Class* clz)
+{
+    // We lay out instances from the class's own field table. Fieldref
+    // constants get bound on first use, see resolve_field(), so that loading
+    // a class does not load every class whose fields it mentions.
     auto h3 = reinterpret_cast<const ClassFile::HeaderSection3*>(str);
+
+    u32 fields_size = clz->super_ ? clz->super_->instance_fields_size() : 0;
+    u16 reference_count = 0;
+
+    visit_instance_fields(clz, h3, [&](auto, SubstitutionField sub) {
+        fields_size = sub.offset_ + sub.real_size();
+        reference_count += sub.object_;
+        return false;
+    });
+
+    clz->instance_fields_size_ = fields_size;
+
+    if (reference_count) {
+        auto offsets = (u16*)jvm::classmemory::allocate(
+            sizeof(u16) * reference_count, alignof(u16));
+
+        if (offsets == nullptr) {
+            unhandled_error("failed to alloc classmemory");
+        }
+
+        u16 i = 0;
+        visit_instance_fields(clz, h3, [&](auto, SubstitutionField sub) {
+            if (sub.object_) {
+                offsets[i++] = sub.offset_;
+            }
+            return false;
+        });
+
+        clz->reference_fields_ = offsets;
+        clz->reference_field_count_ = reference_count;
+    }
+
+
+    // Skip over the rest of the file...
     str += sizeof(ClassFile::HeaderSection3);
 
     for (int i = 0; i < h3->fields_count_.get(); ++i) {
@@ -340,7 +370,68 @@ const char* parse_classfile_fields(const char* str,
 
 
 
-Class* parse_classfile(Slice classname, const char* str)
+#if JVM_VTABLES
+static void reserve_virtual_calls(Class* clz)
+{
+    const auto count = count_constants(clz, ClassFile::t_method_ref);
+
+    if (count == 0) {
+        return;
+    }
+
+    clz->virtual_calls_ = (Class::VirtualCall*)jvm::classmemory::allocate(
+        sizeof(Class::VirtualCall) * count, alignof(Class::VirtualCall));
+
+    if (clz->virtual_calls_ == nullptr) {
+        unhandled_error("failed to alloc classmemory");
+    }
+
+    visit_constants(clz, ClassFile::t_method_ref, [&](u16 index, auto) {
+        auto& call = clz->virtual_calls_[clz->virtual_call_count_++];
+        call.constant_index_ = index;
+        call.vtable_index_ = Class::VirtualCall::not_in_vtable;
+        call.operand_count_ = 0;
+    });
+}
+#endif
+
+
+
+#if JVM_ITABLES
+static void reserve_interface_calls(Class* clz)
+{
+    const auto count =
+        count_constants(clz, ClassFile::t_interface_method_ref);
+
+    if (count == 0) {
+        return;
+    }
+
+    clz->interface_calls_ = (Class::InterfaceCall*)jvm::classmemory::allocate(
+        sizeof(Class::InterfaceCall) * count, alignof(Class::InterfaceCall));
+
+    if (clz->interface_calls_ == nullptr) {
+        unhandled_error("failed to alloc classmemory");
+    }
+
+    visit_constants(clz,
+                    ClassFile::t_interface_method_ref,
+                    [&](u16 index, auto) {
+                        auto& call =
+                            clz->interface_calls_[clz->interface_call_count_++];
+                        call.interface_ = nullptr;
+                        call.constant_index_ = index;
+                        call.method_index_ = 0;
+                        call.operand_count_ = 0;
+                    });
+}
+#endif
+
+
+
+Class* parse_classfile(Slice classname,
+                       const char* str,
+                       const image::ClassRecord* record)
 {
     auto h1 = reinterpret_cast<const ClassFile::HeaderSection1*>(str);
 
@@ -361,9 +452,17 @@ Class* parse_classfile(Slice classname, const char* str)
     str += sizeof(ClassFile::HeaderSection1);
 
 
-    clz->constants_ = jvm::classmemory::allocate<ConstantPoolCompactImpl>();
+    clz->constants_ = make_constant_pool(*h1, record);
     str = clz->constants_->parse(*h1);
 
+#if JVM_VTABLES
+    reserve_virtual_calls(clz);
+#endif
+
+#if JVM_ITABLES
+    reserve_interface_calls(clz);
+#endif
+
     auto h2 = reinterpret_cast<const ClassFile::HeaderSection2*>(str);
     str += sizeof(ClassFile::HeaderSection2);
 
@@ -373,6 +472,19 @@ Class* parse_classfile(Slice classname, const char* str)
             clz->flags_ |= Class::Flag::implements_interfaces;
         }
     }
+
+#if JVM_SNAPSHOT
+    // Register the class under the name that its own classfile holds, where we
+    // can, as the caller's copy of the name might not outlive the vm, e.g. the
+    // launcher's argv, which a snapshot cannot point to.
+    auto this_class = (const ClassFile::ConstantClass*)clz->constants_->load(
+        h2->this_class_.get());
+    auto own_name = clz->constants_->load_string(this_class->name_index_.get());
+    if (own_name == classname) {
+        classname = own_name;
+    }
+#endif
+
     jvm::register_class(classname, clz);
 
 
@@ -381,7 +493,7 @@ Class* parse_classfile(Slice classname, const char* str)
     }
 
 
-    str = parse_classfile_fields(str, clz, *h1);
+    str = parse_classfile_fields(str, clz);
 
     auto h4 = reinterpret_cast<const ClassFile::HeaderSection4*>(str);
     str += sizeof(ClassFile::HeaderSection4);
@@ -391,6 +503,11 @@ Class* parse_classfile(Slice classname, const char* str)
                                // it has a method table, or whether it's running
                                // directly off of the classfile.
 
+#if JVM_PRELINKED_IMAGE
+    if (record) {
+        str = clz->classfile_data_ + record->attributes_offset_.get();
+    } else
+#endif
     if (h4->methods_count_.get()) {
 
         for (int i = 0; i < h4->methods_count_.get(); ++i) {
@@ -429,6 +546,12 @@ Class* parse_classfile(Slice classname, const char* str)
         }
     }
 
+#if JVM_VTABLES
+    // May fail, if a superclass is still being parsed, in which case the
+    // vtable will be built on first use.
+    clz->link_vtable();
+#endif
+
     return clz;
 }
 
@@ -3,6 +3,7 @@
 #include "endian.hpp"
 #include "java.hpp"
 #include "slice.hpp"
+#include "substitutionField.hpp"
 
 
 
@@ -309,7 +310,32 @@ struct Class;
 
 
 
-Class* parse_classfile(Slice classname, const char* str);
+namespace image {
+struct ClassRecord;
+}
+
+
+
+// Given the class's record in a prelinked image, see image.hpp, we skip the
+// walks over the classfile that the record makes unnecessary.
+Class* parse_classfile(Slice classname,
+                       const char* str,
+                       const image::ClassRecord* record = nullptr);
+
+
+
+// The layout of an instance field, by name and type, searching superclasses
+// too. Not valid_ if the class has no such field. The name and type get
+// interned, so they must outlive the vm, see symboltable::intern().
+SubstitutionField find_field(Class* clz, Slice name, Slice type);
+
+
+
+// The layout of the instance field that a Fieldref constant references, bound
+// into the constant pool the first time, see ConstantPool::bind_field(). May
+// load, and initialize, the field's class, and thereby run the gc. Not valid_
+// if the field does not exist.
+SubstitutionField resolve_field(Class* clz, u16 index);
 
 
 
@@ -2,6 +2,7 @@
 #include "crc32.hpp"
 #include "defines.hpp"
 #include "memory.hpp"
+#include "snapshot.hpp"
 
 
 
@@ -19,7 +20,7 @@ struct ClassTableEntry {
 
 
 
-static ClassTableEntry* class_table[CLASSTABLE_SIZE];
+static ClassTableEntry* class_table[CLASSTABLE_SIZE] JVM_SNAPSHOT_STATE;
 
 
 
@@ -1,6 +1,8 @@
 #include "constantPool.hpp"
 #include "memory.hpp"
+#include "snapshot.hpp"
 #include "vm.hpp"
+#include <algorithm>
 
 
 
@@ -14,6 +16,8 @@ const char* ConstantPoolArrayImpl::parse(const ClassFile::HeaderSection1& src)
         sizeof(ClassFile::ConstantHeader*) * src.constant_count_.get() - 1,
         alignof(ClassFile::ConstantHeader*));
 
+    count_ = src.constant_count_.get() - 1;
+
     const char* str = ((const char*)&src) + sizeof(ClassFile::HeaderSection1);
 
 
@@ -24,7 +28,7 @@ const char* ConstantPoolArrayImpl::parse(const ClassFile::HeaderSection1& src)
         str += ClassFile::constant_size((const ClassFile::ConstantHeader*)str);
 
         if (c->tag_ == ClassFile::t_double or c->tag_ == ClassFile::t_long) {
-            ++i;
+            array_[++i] = nullptr;
         }
     }
 
@@ -33,16 +37,23 @@ const char* ConstantPoolArrayImpl::parse(const ClassFile::HeaderSection1& src)
 
 
 
-void ConstantPoolArrayImpl::reserve_fields(int field_count)
+void ConstantPoolArrayImpl::bind_field(u16 index, SubstitutionField field)
 {
-    fields_ = (SubstitutionField*)jvm::classmemory::allocate(
-        sizeof(SubstitutionField) * field_count, alignof(SubstitutionField));
-}
+    if (fields_begin_ == nullptr) {
+        int field_count = 0;
+        for (int i = 0; i < count_; ++i) {
+            if (array_[i] and array_[i]->tag_ == ClassFile::t_field_ref) {
+                ++field_count;
+            }
+        }
 
+        fields_begin_ = (SubstitutionField*)jvm::classmemory::allocate(
+            sizeof(SubstitutionField) * field_count,
+            alignof(SubstitutionField));
 
+        fields_ = fields_begin_;
+    }
 
-void ConstantPoolArrayImpl::bind_field(u16 index, SubstitutionField field)
-{
     *fields_ = field;
     array_[index - 1] = (const ClassFile::ConstantHeader*)fields_;
     ++fields_;
@@ -50,30 +61,323 @@ void ConstantPoolArrayImpl::bind_field(u16 index, SubstitutionField field)
 
 
 
-void ConstantPoolCompactImpl::reserve_fields(int count)
+const SubstitutionField* ConstantPoolArrayImpl::load_field(u16 index)
 {
-    if (count == 0) {
-        return;
+    auto field = (const SubstitutionField*)array_[index - 1];
+
+    if (field >= fields_begin_ and field < fields_) {
+        return field;
     }
 
-    if (bindings_) {
-        unhandled_error("reserve fields called twice");
+    return nullptr;
+}
+
+
+
+u16 ConstantPoolCompactImpl::field_ref_count()
+{
+    const char* str = ((const char*)info_) + sizeof(ClassFile::HeaderSection1);
+
+    u16 count = 0;
+
+    for (int i = 0; i < info_->constant_count_.get() - 1; ++i) {
+        auto c = (const ClassFile::ConstantHeader*)str;
+        if (c->tag_ == ClassFile::t_field_ref) {
+            ++count;
+        } else if (c->tag_ == ClassFile::t_double or
+                   c->tag_ == ClassFile::t_long) {
+            ++i;
+        }
+        str += ClassFile::constant_size(c);
+    }
+
+    return count;
+}
+
+
+
+void ConstantPoolCompactImpl::reserve_fields()
+{
+    const auto count = field_ref_count();
+
+    if (count == 0) {
+        unhandled_error("no fieldref to bind");
     }
 
     bindings_ = (FieldBinding*)jvm::classmemory::allocate(
         sizeof(FieldBinding) * count, alignof(FieldBinding));
 
+    if (bindings_ == nullptr) {
+        unhandled_error("alloc failed");
+    }
+
     memset((void*)bindings_, 0, sizeof(FieldBinding) * count);
 
     for (int i = 0; i < count; ++i) {
         bindings_[i].field_.valid_ = 0;
     }
 
+    binding_count_ = count;
+}
+
+
+
+void ConstantPoolCompactImpl::bind_field(u16 index, SubstitutionField field)
+{
     if (bindings_ == nullptr) {
+        // Many classes never access an instance field, or only access fields
+        // of other classes through methods, so we reserve bindings when
+        // binding the first field.
+        reserve_fields();
+    }
+
+    for (int i = 0; i < binding_count_; ++i) {
+        if (not bindings_[i].field_.valid_) {
+            bindings_[i].index_ = index - 1;
+            bindings_[i].field_ = field;
+            return;
+        }
+    }
+}
+
+
+
+void ConstantPoolCompactImpl::reserve_methods()
+{
+    auto visit_method_refs = [&](auto callback) {
+        const char* str =
+            ((const char*)info_) + sizeof(ClassFile::HeaderSection1);
+
+        for (int i = 0; i < info_->constant_count_.get() - 1; ++i) {
+            auto c = (const ClassFile::ConstantHeader*)str;
+            if (c->tag_ == ClassFile::t_method_ref or
+                c->tag_ == ClassFile::t_interface_method_ref) {
+                callback(i + 1);
+            } else if (c->tag_ == ClassFile::t_double or
+                       c->tag_ == ClassFile::t_long) {
+                ++i;
+            }
+            str += ClassFile::constant_size(c);
+        }
+    };
+
+    u16 count = 0;
+    visit_method_refs([&](u16) { ++count; });
+
+    if (count == 0) {
+        return;
+    }
+
+    method_bindings_ = (MethodBinding*)jvm::classmemory::allocate(
+        sizeof(MethodBinding) * count, alignof(MethodBinding));
+
+    if (method_bindings_ == nullptr) {
         unhandled_error("alloc failed");
     }
 
-    binding_count_ = count;
+    visit_method_refs([&](u16 index) {
+        auto& binding = method_bindings_[method_binding_count_++];
+        binding.index_ = index;
+        binding.method_ = nullptr;
+    });
+}
+
+
+
+ConstantPool::MethodBinding*
+ConstantPoolCompactImpl::find_method_binding(u16 index)
+{
+    auto end = method_bindings_ + method_binding_count_;
+
+    auto found = std::lower_bound(
+        method_bindings_,
+        end,
+        index,
+        [](const MethodBinding& binding, u16 index) {
+            return binding.index_ < index;
+        });
+
+    if (found not_eq end and found->index_ == index) {
+        return found;
+    }
+
+    return nullptr;
+}
+
+
+
+jvm::symboltable::Symbol ConstantPoolCompactImpl::load_symbol(u16 index)
+{
+    using jvm::symboltable::Symbol;
+
+    // Marks constants that the symbol table had no room for, so that we don't
+    // hash them again on every lookup.
+    static const Symbol unavailable = jvm::symboltable::max_symbol + 1;
+
+    if (symbols_ == nullptr) {
+        const int count = info_->constant_count_.get() - 1;
+
+        symbols_ = (Symbol*)jvm::symboltable::allocate(sizeof(Symbol) * count,
+                                                      alignof(Symbol));
+
+        if (symbols_ == nullptr) {
+            // Out of budget, callers compare the text instead.
+            return 0;
+        }
+
+        memset(symbols_, 0, sizeof(Symbol) * count);
+    }
+
+    auto& symbol = symbols_[index - 1];
+
+    if (symbol == 0) {
+        symbol = ConstantPool::load_symbol(index);
+
+        if (symbol == 0) {
+            symbol = unavailable;
+        }
+    }
+
+    return symbol == unavailable ? 0 : symbol;
+}
+
+
+
+bool same_string(ConstantPool& lhs,
+                 u16 lhs_index,
+                 ConstantPool& rhs,
+                 u16 rhs_index)
+{
+    const auto lhs_symbol = lhs.load_symbol(lhs_index);
+    const auto rhs_symbol = rhs.load_symbol(rhs_index);
+
+    if (lhs_symbol and rhs_symbol) {
+        return lhs_symbol == rhs_symbol;
+    }
+
+    return lhs.load_string(lhs_index) == rhs.load_string(rhs_index);
+}
+
+
+
+const char* ConstantPoolIndexedImpl::parse(const ClassFile::HeaderSection1& src)
+{
+    auto str = ConstantPoolCompactImpl::parse(src);
+
+    if (JVM_CONSTANT_POOL_INDEX_THRESHOLD == 0) {
+        promote();
+    }
+
+    return str;
+}
+
+
+
+// Class memory consumed by constant pool indexes, see
+// JVM_CONSTANT_POOL_INDEX_BUDGET.
+static size_t constant_pool_index_bytes JVM_SNAPSHOT_STATE;
+
+
+
+bool ConstantPoolIndexedImpl::promote()
+{
+    const int count = info_->constant_count_.get() - 1;
+    const size_t cost = sizeof(u16) * count;
+
+    if (constant_pool_index_bytes + cost > JVM_CONSTANT_POOL_INDEX_BUDGET) {
+        return false;
+    }
+
+    // NOTE: We're called from load(), possibly while the caller holds object
+    // pointers that the gc does not know about, so we must not run the gc.
+    auto offsets =
+        (u16*)jvm::classmemory::try_allocate(cost, alignof(u16));
+
+    if (offsets == nullptr) {
+        return false;
+    }
+
+    constant_pool_index_bytes += cost;
+
+    const char* str = ((const char*)info_) + sizeof(ClassFile::HeaderSection1);
+
+    for (int i = 0; i < count; ++i) {
+        auto c = (const ClassFile::ConstantHeader*)str;
+
+        offsets[i] = str - (const char*)info_;
+        str += ClassFile::constant_size(c);
+
+        if (c->tag_ == ClassFile::t_double or c->tag_ == ClassFile::t_long) {
+            // The unusable second entry.
+            offsets[i + 1] = offsets[i];
+            ++i;
+        }
+    }
+
+    for (u16 i = 0; i < binding_count_; ++i) {
+        if (bindings_[i].field_.valid_) {
+            offsets[bindings_[i].index_] = i | bound_field;
+        }
+    }
+
+    offsets_ = offsets;
+
+    return true;
+}
+
+
+
+void ConstantPoolIndexedImpl::bind_field(u16 index, SubstitutionField field)
+{
+    ConstantPoolCompactImpl::bind_field(index, field);
+
+    if (offsets_) {
+        for (u16 i = 0; i < binding_count_; ++i) {
+            if (bindings_[i].index_ == index - 1 and
+                bindings_[i].field_.valid_) {
+                offsets_[index - 1] = i | bound_field;
+                return;
+            }
+        }
+    }
+}
+
+
+
+ConstantPool* make_constant_pool(const ClassFile::HeaderSection1& src,
+                                 const image::ClassRecord* record)
+{
+#if JVM_PRELINKED_IMAGE
+    if (record) {
+        return jvm::classmemory::allocate<ConstantPoolPrelinkedImpl>(*record);
+    }
+#else
+    (void)record;
+#endif
+
+    const int count = src.constant_count_.get() - 1;
+
+    if (count >= JVM_CONSTANT_POOL_INDEX_MIN_SIZE and
+        JVM_CONSTANT_POOL_INDEX_BUDGET > 0) {
+
+        // Offsets must leave the bound_field bit clear.
+        const char* str =
+            ((const char*)&src) + sizeof(ClassFile::HeaderSection1);
+        for (int i = 0; i < count; ++i) {
+            auto c = (const ClassFile::ConstantHeader*)str;
+            str += ClassFile::constant_size(c);
+            if (c->tag_ == ClassFile::t_double or
+                c->tag_ == ClassFile::t_long) {
+                ++i;
+            }
+        }
+
+        if (str - (const char*)&src <= ConstantPoolIndexedImpl::bound_field) {
+            return jvm::classmemory::allocate<ConstantPoolIndexedImpl>();
+        }
+    }
+
+    return jvm::classmemory::allocate<ConstantPoolCompactImpl>();
 }
 
 
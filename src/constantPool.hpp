@@ -1,8 +1,11 @@
 #pragma once
 
 #include "classfile.hpp"
+#include "defines.hpp"
+#include "image.hpp"
 #include "slice.hpp"
 #include "substitutionField.hpp"
+#include "symbolTable.hpp"
 
 
 // NOTE: Creating a constant pool in memory for every class takes up a lot of
@@ -15,6 +18,10 @@ namespace java {
 
 
 
+struct SubstitutionMethod;
+
+
+
 class ConstantPool {
 public:
     virtual ~ConstantPool()
@@ -28,22 +35,47 @@ public:
     };
 
 
+    struct MethodBinding {
+        u16 index_;
+        SubstitutionMethod* method_; // nullptr until bound
+    };
+
+
     virtual const char* parse(const ClassFile::HeaderSection1& src) = 0;
 
 
     virtual const ClassFile::ConstantHeader* load(u16 index) = 0;
 
 
-    virtual void reserve_fields(int count) = 0;
+    // Fieldref constants get bound to the layout of the field that they
+    // reference, the first time that the vm runs code that accesses the field,
+    // see resolve_field(). Once bound, load() returns the SubstitutionField, in
+    // place of the constant. Bindings get reserved with the first one.
+    virtual void bind_field(u16 index, SubstitutionField field) = 0;
 
 
-    virtual void bind_field(u16 index, SubstitutionField field) = 0;
+    // The field bound to a Fieldref constant, or nullptr, if not bound yet.
+    virtual const SubstitutionField* load_field(u16 index) = 0;
 
 
-    virtual std::pair<const FieldBinding*, u16> bindings()
+    // Optional: a constant pool without method bindings never binds a method,
+    // and calls keep resolving their targets by name. Returns false if the
+    // method was not bound.
+    virtual bool bind_method(u16, SubstitutionMethod*)
     {
-        while (true)
-            ;
+        return false;
+    }
+
+
+    virtual const SubstitutionMethod* load_method(u16)
+    {
+        return nullptr;
+    }
+
+
+    virtual std::pair<MethodBinding*, u16> method_bindings()
+    {
+        return {nullptr, 0};
     }
 
 
@@ -60,10 +92,51 @@ public:
                 ;
         }
     }
+
+
+    // The interned symbol of a utf8 constant, or zero, if the symbol table is
+    // full, see symboltable::intern().
+    virtual jvm::symboltable::Symbol load_symbol(u16 index)
+    {
+        return jvm::symboltable::intern(load_string(index));
+    }
+
+
+    // Whether the utf8 constant holds text, whose symbol is given (zero if it
+    // has none). Compares symbols, and only falls back to comparing bytes for
+    // text that missed out on a symbol.
+    bool matches(u16 index, Slice text, jvm::symboltable::Symbol symbol)
+    {
+        if (symbol) {
+            if (auto constant_symbol = load_symbol(index)) {
+                return constant_symbol == symbol;
+            }
+        }
+        return load_string(index) == text;
+    }
+
+
+#if JVM_PRELINKED_IMAGE
+    // The class's record in a prelinked image, or nullptr, if the class has
+    // none, see ConstantPoolPrelinkedImpl.
+    virtual const image::ClassRecord* prelinked()
+    {
+        return nullptr;
+    }
+#endif
 };
 
 
 
+// Whether two utf8 constants, of possibly different constant pools, hold the
+// same text.
+bool same_string(ConstantPool& lhs,
+                 u16 lhs_index,
+                 ConstantPool& rhs,
+                 u16 rhs_index);
+
+
+
 // The fastest constant pool implementation. All lookups are O(1), as the class
 // stores an array of pointers into the classfile.
 //
@@ -89,15 +162,17 @@ public:
     }
 
 
-    void reserve_fields(int field_count) override;
+    void bind_field(u16 index, SubstitutionField field) override;
 
 
-    void bind_field(u16 index, SubstitutionField field) override;
+    const SubstitutionField* load_field(u16 index) override;
 
 
 private:
     const ClassFile::ConstantHeader** array_ = nullptr;
+    SubstitutionField* fields_begin_ = nullptr;
     SubstitutionField* fields_ = nullptr;
+    u16 count_ = 0;
 };
 
 
@@ -108,14 +183,12 @@ public:
     // Runs in O(n), where n is the number of constants in the constant pool.
     const ClassFile::ConstantHeader* load(u16 index) override
     {
-        index -= 1;
-
-        for (int i = 0; i < binding_count_; ++i) {
-            if (bindings_[i].index_ == index and bindings_[i].field_.valid_) {
-                return (const ClassFile::ConstantHeader*)&bindings_[i].field_;
-            }
+        if (auto field = ConstantPoolCompactImpl::load_field(index)) {
+            return (const ClassFile::ConstantHeader*)field;
         }
 
+        index -= 1;
+
         auto str = (const char*)info_ + sizeof(ClassFile::HeaderSection1);
 
         int i = 0;
@@ -155,35 +228,216 @@ public:
     }
 
 
-    void reserve_fields(int count) override;
+    void bind_field(u16 index, SubstitutionField field) override;
 
 
-    void bind_field(u16 index, SubstitutionField field) override
+    // Runs in O(n), where n is the number of Fieldref constants.
+    const SubstitutionField* load_field(u16 index) override
     {
-        for (int i = 0;; ++i) {
-            if (not bindings_[i].field_.valid_) {
-                bindings_[i].index_ = index - 1;
-                bindings_[i].field_ = field;
-                return;
+        for (int i = 0; i < binding_count_; ++i) {
+            if (bindings_[i].index_ == index - 1 and
+                bindings_[i].field_.valid_) {
+                return &bindings_[i].field_;
             }
         }
+        return nullptr;
     }
 
 
-    std::pair<const FieldBinding*, u16> bindings() override
+    bool bind_method(u16 index, SubstitutionMethod* method) override
     {
-        return {bindings_, binding_count_};
+        if (method_bindings_ == nullptr) {
+            // Many classes never make a direct call, so we reserve bindings
+            // when binding the first method.
+            reserve_methods();
+        }
+
+        if (auto binding = find_method_binding(index)) {
+            binding->method_ = method;
+            return true;
+        }
+        return false;
     }
 
 
-private:
+    // Runs in O(log n), where n is the number of method constants.
+    const SubstitutionMethod* load_method(u16 index) override
+    {
+        if (auto binding = find_method_binding(index)) {
+            return binding->method_;
+        }
+        return nullptr;
+    }
+
+
+    std::pair<MethodBinding*, u16> method_bindings() override
+    {
+        return {method_bindings_, method_binding_count_};
+    }
+
+
+    // O(1), once the constant has been interned, as the constant pool keeps a
+    // map from constant index to symbol.
+    jvm::symboltable::Symbol load_symbol(u16 index) override;
+
+
+protected:
+    // The number of Fieldref constants, which we reserve bindings for.
+    virtual u16 field_ref_count();
+
     FieldBinding* bindings_ = nullptr;
     const ClassFile::HeaderSection1* info_;
     u16 binding_count_ = 0;
+
+private:
+    // One binding per Fieldref constant.
+    void reserve_fields();
+
+    // One binding per Methodref and InterfaceMethodref constant.
+    void reserve_methods();
+
+    MethodBinding* find_method_binding(u16 index);
+
+    // Sorted by constant index.
+    MethodBinding* method_bindings_ = nullptr;
+    u16 method_binding_count_ = 0;
+
+    // Zero for constants not interned yet. Allocated by the first call to
+    // load_symbol(), as some classes never resolve anything by name.
+    jvm::symboltable::Symbol* symbols_ = nullptr;
 };
 
 
 
+// Starts out as a compact constant pool, but counts lookups, and once a class
+// has made JVM_CONSTANT_POOL_INDEX_THRESHOLD of them, promotes itself by
+// building an index: the byte offset of each constant from the start of the
+// constant pool, so lookups run in O(1), for a u16 per constant. A bound
+// field's entry holds the field's slot in the bindings array instead, tagged
+// with bound_field. So the constant pool may not exceed bound_field bytes, see
+// make_constant_pool().
+class ConstantPoolIndexedImpl : public ConstantPoolCompactImpl {
+public:
+    enum : u16 { bound_field = 0x8000 };
+
+
+    const ClassFile::ConstantHeader* load(u16 index) override
+    {
+        if (offsets_ == nullptr) {
+            if (++loads_ not_eq JVM_CONSTANT_POOL_INDEX_THRESHOLD or
+                not promote()) {
+                return ConstantPoolCompactImpl::load(index);
+            }
+        }
+
+        const u16 offset = offsets_[index - 1];
+
+        if (offset & bound_field) {
+            auto& binding = bindings_[offset & ~bound_field];
+            return (const ClassFile::ConstantHeader*)&binding.field_;
+        }
+
+        return (const ClassFile::ConstantHeader*)((const char*)info_ +
+                                                  offset);
+    }
+
+
+    const char* parse(const ClassFile::HeaderSection1& src) override;
+
+
+    void bind_field(u16 index, SubstitutionField field) override;
+
+
+    const SubstitutionField* load_field(u16 index) override
+    {
+        if (offsets_ == nullptr) {
+            return ConstantPoolCompactImpl::load_field(index);
+        }
+
+        const u16 offset = offsets_[index - 1];
+
+        if (offset & bound_field) {
+            return &bindings_[offset & ~bound_field].field_;
+        }
+
+        return nullptr;
+    }
+
+
+private:
+    // Builds the index, if JVM_CONSTANT_POOL_INDEX_BUDGET allows. Returns
+    // false if it does not.
+    bool promote();
+
+    u16* offsets_ = nullptr;
+    u16 loads_ = 0;
+};
+
+
+
+#if JVM_PRELINKED_IMAGE
+// Runs off of the class's record in a prelinked image, see image.hpp, which
+// holds the offset of each constant. So lookups run in O(1), like in an indexed
+// constant pool, but the index stays in the image, rather than taking class
+// memory, and parse() need not walk the constant pool at all.
+class ConstantPoolPrelinkedImpl : public ConstantPoolCompactImpl {
+public:
+    explicit ConstantPoolPrelinkedImpl(const image::ClassRecord& record)
+        : record_(record)
+    {
+    }
+
+
+    const ClassFile::ConstantHeader* load(u16 index) override
+    {
+        auto c = (const ClassFile::ConstantHeader*)(
+            (const char*)info_ + record_.constant_offsets()[index - 1].get());
+
+        if (c->tag_ == ClassFile::t_field_ref) {
+            if (auto field = load_field(index)) {
+                return (const ClassFile::ConstantHeader*)field;
+            }
+        }
+
+        return c;
+    }
+
+
+    const char* parse(const ClassFile::HeaderSection1& src) override
+    {
+        info_ = &src;
+        return (const char*)&src + record_.interfaces_offset_.get();
+    }
+
+
+    const image::ClassRecord* prelinked() override
+    {
+        return &record_;
+    }
+
+
+protected:
+    u16 field_ref_count() override
+    {
+        return record_.field_ref_count_.get();
+    }
+
+
+private:
+    const image::ClassRecord& record_;
+};
+#endif
+
+
+
+// Allocates the constant pool implementation for a classfile: a prelinked one,
+// given the class's record in a prelinked image, or one that may be indexed, if
+// the constant pool is large enough to benefit, otherwise a compact one.
+ConstantPool* make_constant_pool(const ClassFile::HeaderSection1& src,
+                                 const image::ClassRecord* record = nullptr);
+
+
+
 // A balanced constant pool class. More compact than a large array
 // implementation, but caches some recent constant lookups in a local buffer.
 class ConstantPoolCompactCachingImpl : public ConstantPoolCompactImpl {
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <stdint.h>
 
+
+// Fill in stack traces for exceptions, by walking the vm's stack frames.
 #ifndef JVM_USE_CALLSTACK
 #define JVM_USE_CALLSTACK 1
 #endif
@@ -21,6 +24,13 @@
 #endif
 
 
+// Parsed method descriptors, remembered by address, so that a call doesn't
+// need to re-parse the descriptor to know how many slots its arguments take.
+#ifndef JVM_ARGUMENT_INFO_CACHE_SIZE
+#define JVM_ARGUMENT_INFO_CACHE_SIZE 32
+#endif
+
+
 #ifndef JVM_OPERAND_STACK_SIZE
 #define JVM_OPERAND_STACK_SIZE 512
 #endif
@@ -41,13 +51,331 @@
 #endif
 
 
+// Dispatch bytecode through a table of label addresses, rather than a switch
+// statement. Requires the labels-as-values extension.
+#ifndef JVM_THREADED_DISPATCH
+#ifdef __GNUC__
+#define JVM_THREADED_DISPATCH 1
+#else
+#define JVM_THREADED_DISPATCH 0
+#endif
+#endif
+
+
+// Copy each method's bytecode into class memory on first invocation, so that
+// the interpreter can rewrite field and constant pool instructions with
+// quickened versions, after resolving them once.
+#ifndef JVM_QUICKEN_BYTECODE
+#define JVM_QUICKEN_BYTECODE 1
+#endif
+
+
+// Quickened code also converts instruction operands to native byte order, and
+// resolves branch targets, when copying a method's bytecode.
+#ifndef JVM_PREDECODE_BYTECODE
+#define JVM_PREDECODE_BYTECODE JVM_QUICKEN_BYTECODE
+#endif
+
+
+// Class memory available for quickened copies of method bytecode. Once spent,
+// methods run directly from the classfile.
+#ifndef JVM_QUICKENED_CODE_BUDGET
+#define JVM_QUICKENED_CODE_BUDGET 32000
+#endif
+
+
+// Class memory available for constant pool indexes, which locate a constant in
+// O(1), at a u16 per constant, see ConstantPoolIndexedImpl. Once spent, and for
+// constant pools of fewer than JVM_CONSTANT_POOL_INDEX_MIN_SIZE entries, classes
+// search their constant pool from the start. Zero disables the indexes.
+#ifndef JVM_CONSTANT_POOL_INDEX_BUDGET
+#define JVM_CONSTANT_POOL_INDEX_BUDGET (JVM_HEAP_SIZE / 64)
+#endif
+
+
+#ifndef JVM_CONSTANT_POOL_INDEX_MIN_SIZE
+#define JVM_CONSTANT_POOL_INDEX_MIN_SIZE 8
+#endif
+
+
+// A class indexes its constant pool after this many constant lookups, so that
+// the budget goes to the classes that use their constant pools the most. Zero
+// indexes each constant pool when loading the class, in load order.
+#ifndef JVM_CONSTANT_POOL_INDEX_THRESHOLD
+#define JVM_CONSTANT_POOL_INDEX_THRESHOLD 128
+#endif
+
+
+// Index each jar's central directory when binding the jar, so that loading a
+// class hashes its path rather than walking the jar's files from the start. The
+// index takes class memory, of four bytes per classfile, plus some slack.
+#ifndef JVM_JAR_INDEX
+#define JVM_JAR_INDEX 1
+#endif
+
+
+// Load classes with the help of a prelinked image, if the host supplies one,
+// see image.hpp. A prelinked class finds its constants, and the sections of its
+// classfile, by offset, with no walk over the constant pool and no constant
+// pool index in class memory. Costs nothing for classes without a record.
+#ifndef JVM_PRELINKED_IMAGE
+#define JVM_PRELINKED_IMAGE 1
+#endif
+
+
+// Let the host save the vm's state just before main() runs, and restore it on
+// later runs, rather than loading and initializing classes again, see
+// snapshot.hpp. Places the vm's globals in a linker section of their own, so
+// we only enable it on linux hosts by default, where the linker provides the
+// section's bounds.
+#ifndef JVM_SNAPSHOT
+#if defined(__GNUC__) and defined(__linux__)
+#define JVM_SNAPSHOT 1
+#else
+#define JVM_SNAPSHOT 0
+#endif
+#endif
+
+
+// Buckets in the symbol table, which interns names and descriptors, so that
+// method and field resolution compares small integers, see symbolTable.hpp.
+#ifndef JVM_SYMBOL_TABLE_SIZE
+#define JVM_SYMBOL_TABLE_SIZE 64
+#endif
+
+
+// Class memory available for interned symbols, and for the tables that map each
+// class's utf8 constants to their symbols. Once spent, resolution compares
+// names byte by byte, as it does for everything when the budget is zero.
+#ifndef JVM_SYMBOL_TABLE_BUDGET
+#define JVM_SYMBOL_TABLE_BUDGET (JVM_HEAP_SIZE / 128)
+#endif
+
+
+// Fuse common instruction sequences in quickened code into superinstructions.
+// A debugger would no longer see the individual instructions of a fused
+// sequence, so we leave them alone when debugging.
+#ifndef JVM_SUPERINSTRUCTIONS
+#if JVM_QUICKEN_BYTECODE and not JVM_ENABLE_DEBUGGING
+#define JVM_SUPERINSTRUCTIONS 1
+#else
+#define JVM_SUPERINSTRUCTIONS 0
+#endif
+#endif
+
+
+// Don't tag operand stack slots and local variables with their types. Instead,
+// when the gc needs to find references in a stack frame, it works out the
+// types of the frame's slots at the current pc, by abstract interpretation of
+// the method's bytecode. The interpreter does a bit less work, and we save an
+// enum's worth of memory per slot, but each collection takes longer.
+#ifndef JVM_GC_REFERENCE_MAPS
+#define JVM_GC_REFERENCE_MAPS 0
+#endif
+
+
+// Scratch memory for computing a reference map. Methods with lots of branch
+// targets, or lots of locals, need more, which the vm allocates from class
+// memory when it loads their class.
+#ifndef JVM_GC_REFERENCE_MAP_SCRATCH
+#define JVM_GC_REFERENCE_MAP_SCRATCH 1024
+#endif
+
+
+// Give each class a table of its virtual methods, so that invokevirtual finds
+// the method to call by index, rather than by searching the receiver's class
+// hierarchy for a matching name and descriptor. Costs a pointer pair per
+// virtual method (shared, for classes that don't override anything), and six
+// bytes per Methodref constant.
+#ifndef JVM_VTABLES
+#define JVM_VTABLES 1
+#endif
+
+
+// Give each class an itable per interface that it implements, so that
+// invokeinterface finds the method to call by index, once it has found the
+// receiver's itable for the interface. The itables double as a cached list of
+// all of the class's interfaces, for instanceof and checkcast. Costs a pointer
+// pair per interface method, per implementing class, built the first time that
+// the class's interfaces are needed, plus twelve to sixteen bytes per
+// InterfaceMethodref constant.
+#ifndef JVM_ITABLES
+#define JVM_ITABLES JVM_VTABLES
+#endif
+
+
+// Give each class a display of its superclasses, and a bitset of the
+// interfaces that it implements, so that instanceof, checkcast, and catch
+// clauses test subtyping in constant time, rather than by walking the class
+// hierarchy. Costs a pointer per superclass, and a few bytes of interface bits,
+// per class. In quickened code, each checkcast and instanceof also remembers
+// the last class that passed, at a cost of two slots.
+#ifndef JVM_SUBTYPE_DISPLAY
+#define JVM_SUBTYPE_DISPLAY JVM_ITABLES
+#endif
+
+
+// Bind the method that an invokestatic or invokespecial resolves to to the
+// constant pool entry, see SubstitutionMethod. Costs a u16 index and a pointer
+// per Methodref constant, in classes that make direct calls, plus a
+// SubstitutionMethod per bound Methodref.
+#ifndef JVM_RESOLVED_METHODS
+#define JVM_RESOLVED_METHODS 1
+#endif
+
+
+// Remember, at each invokevirtual and invokeinterface in quickened code, the
+// receiver classes seen so far and the methods that they resolved to. A call
+// whose receiver matches a cached class skips method lookup altogether. A site
+// holds one receiver class inline, and up to JVM_INLINE_CACHE_SIZE in total,
+// after which it gives up on caching (megamorphic) and looks up each call.
+#ifndef JVM_INLINE_CACHES
+#define JVM_INLINE_CACHES JVM_QUICKEN_BYTECODE
+#endif
+
+
+#ifndef JVM_INLINE_CACHE_SIZE
+#define JVM_INLINE_CACHE_SIZE 4
+#endif
+
+
+// Class hierarchy analysis: bind an invokevirtual's inline cache to a method
+// outright, with no receiver check, if no loaded class overrides the method
+// below the class named by the Methodref, e.g. methods of final classes, like
+// String, and of classes without subclasses. Loading a class that overrides a
+// bound method unbinds the call sites. Costs nothing per class, but binding a
+// call site scans the class table.
+#ifndef JVM_DEVIRTUALIZE
+#define JVM_DEVIRTUALIZE (JVM_INLINE_CACHES and JVM_VTABLES)
+#endif
+
+
+// Count inline cache hits and misses per call site, see
+// print_inline_cache_stats().
+#ifndef JVM_INLINE_CACHE_STATS
+#define JVM_INLINE_CACHE_STATS 0
+#endif
+
+
+// Replace some small, frequently called java.lang methods, like String.charAt()
+// and String.length(), with C++ implementations, see intrinsics.cpp. Costs a
+// MethodStub per replaced method, in classes that have been loaded.
+#ifndef JVM_INTRINSICS
+#define JVM_INTRINSICS 1
+#endif
+
+
+// For testing: run each side-effect-free intrinsic alongside the bytecode method
+// that it replaces, and halt if their results differ.
+#ifndef JVM_INTRINSICS_CHECK
+#define JVM_INTRINSICS_CHECK 0
+#endif
+
+
+// Nesting limit for method calls, i.e. the number of stack frames. Every
+// bytecode method takes at least four local slots, so by default, deep
+// recursion runs out of locals and frames at about the same point.
+#ifndef JVM_MAX_CALL_DEPTH
+#define JVM_MAX_CALL_DEPTH (JVM_STACK_LOCALS_SIZE / 4)
+#endif
+
+
+// Frames held back from method calls (along with four local and four operand
+// slots apiece), so that the vm still has room to construct the
+// StackOverflowError for a call that does not fit.
+#ifndef JVM_STACK_RESERVE
+#define JVM_STACK_RESERVE 8
+#endif
+
+
+// Run a called method's bytecode in the caller's interpreter loop, rather than
+// recursing into a new one. Invoke and return instructions push and pop frames,
+// and an exception unwinds by searching each frame's exception table in turn.
+// Native methods still run on the C++ stack, as do callbacks from host code.
+#ifndef JVM_NONRECURSIVE_CALLS
+#define JVM_NONRECURSIVE_CALLS 1
+#endif
+
+
+// Store each long and double whole, in one of its two operand stack (or local
+// variable) slots, rather than splitting the value into 32 bit halves.
+// The second slot is padding, so slot numbering still matches the jvm spec.
+// Only possible when a slot (a void*) is 64 bits wide.
+#ifndef JVM_NATIVE_WIDE_SLOTS
+#if UINTPTR_MAX == UINT64_MAX
+#define JVM_NATIVE_WIDE_SLOTS 1
+#else
+#define JVM_NATIVE_WIDE_SLOTS 0
+#endif
+#endif
+
+
 #ifndef JVM_AVAILABLE_BREAKPOINTS
 #define JVM_AVAILABLE_BREAKPOINTS 4
 #endif
 
 
-#if JVM_ENABLE_DEBUGGING
-#if not JVM_USE_CALLSTACK
-#error "Debugging requires a callstack"
+#if JVM_PREDECODE_BYTECODE
+#if not JVM_QUICKEN_BYTECODE
+#error "Predecoding requires quickened code"
+#endif
+#endif
+
+
+#if JVM_SUPERINSTRUCTIONS
+#if not JVM_QUICKEN_BYTECODE
+#error "Superinstructions require quickened code"
+#endif
+#endif
+
+
+#if JVM_ITABLES
+#if not JVM_VTABLES
+#error "Itables require vtables"
+#endif
+#endif
+
+
+#if JVM_SUBTYPE_DISPLAY
+#if not JVM_ITABLES
+#error "Subtype displays require itables"
+#endif
+#endif
+
+
+#if JVM_INLINE_CACHES
+#if not JVM_QUICKEN_BYTECODE
+#error "Inline caches require quickened code"
+#endif
+#if JVM_INLINE_CACHE_SIZE < 1 or JVM_INLINE_CACHE_SIZE > 253
+#error "JVM_INLINE_CACHE_SIZE out of range"
+#endif
+#endif
+
+
+#if JVM_DEVIRTUALIZE
+#if not JVM_INLINE_CACHES or not JVM_VTABLES
+#error "Devirtualization requires inline caches and vtables"
+#endif
+#endif
+
+
+#if JVM_INTRINSICS_CHECK
+#if not JVM_INTRINSICS
+#error "Checking intrinsics requires intrinsics"
 #endif
 #endif
+
+
+#if JVM_CONSTANT_POOL_INDEX_THRESHOLD < 0 or \
+    JVM_CONSTANT_POOL_INDEX_THRESHOLD > 65535
+#error "JVM_CONSTANT_POOL_INDEX_THRESHOLD out of range"
+#endif
+
+
+#if JVM_NATIVE_WIDE_SLOTS
+#if UINTPTR_MAX != UINT64_MAX
+#error "Native wide slots require 64 bit pointers"
+#endif
+#endif
+
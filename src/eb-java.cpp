@@ -5,8 +5,26 @@
 
 #include <iostream>
 #include <string>
-#include <fstream>
-#include <streambuf>
+#include <string.h>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+
+#if JVM_SNAPSHOT
+#include "crc32.hpp"
+#include <link.h>
+
+// The bounds of the executable, and the end of its code, from the linker.
+extern "C" char __executable_start;
+extern "C" char __etext;
+extern "C" char _end;
+#endif
 
 
 
@@ -41,30 +59,270 @@ void uncaught_exception(Slice cname,
 
 
 
+// Maps a file into memory, read-only. The vm runs classes straight out of the
+// file's bytes, so we never copy them, and pages of a jar that hold classes
+// that the program never loads never get read from disk.
+static java::Slice map_file(const char* path, int advice)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return {};
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 or st.st_size == 0) {
+        close(fd);
+        return {};
+    }
+
+    auto mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mem == MAP_FAILED) {
+        return {};
+    }
+
+    madvise(mem, st.st_size, advice);
+
+    return {(const char*)mem, (size_t)st.st_size};
+}
+
+
+
+// Jars get read a class at a time, from wherever each class happens to be, so
+// readahead would mostly page in classes that we don't need.
+static java::Slice map_jar(const char* path)
+{
+    auto jar = map_file(path, MADV_RANDOM);
+    if (jar.length_ == 0) {
+        printf("failed to map %s\n", path);
+        exit(1);
+    }
+    return jar;
+}
+
+
+
+#if JVM_SNAPSHOT
+// The linker's build id of the executable, a hash of its contents, which tells
+// apart snapshots of different builds of the vm. Without one, e.g. when linked
+// with --build-id=none, we hash the code ourselves.
+static java::Slice build_id()
+{
+    static java::Slice id;
+
+    dl_iterate_phdr(
+        [](struct dl_phdr_info* info, size_t, void*) {
+            // The executable comes first, see dl_iterate_phdr(3).
+            for (int i = 0; i < info->dlpi_phnum; ++i) {
+                auto& phdr = info->dlpi_phdr[i];
+                if (phdr.p_type not_eq PT_NOTE) {
+                    continue;
+                }
+
+                auto str = (const char*)(info->dlpi_addr + phdr.p_vaddr);
+                const auto end = str + phdr.p_memsz;
+
+                auto align = [](size_t size) { return (size + 3) & ~3; };
+
+                while (str + sizeof(ElfW(Nhdr)) <= end) {
+                    auto note = (const ElfW(Nhdr)*)str;
+                    auto name = str + sizeof(ElfW(Nhdr));
+                    auto desc = name + align(note->n_namesz);
+
+                    if (note->n_type == NT_GNU_BUILD_ID and
+                        note->n_namesz == 4 and memcmp(name, "GNU", 4) == 0) {
+                        id = {desc, note->n_descsz};
+                    }
+
+                    str = desc + align(note->n_descsz);
+                }
+            }
+            return 1;
+        },
+        nullptr);
+
+    if (id.length_ == 0) {
+        static u32 code_crc32;
+        code_crc32 = java::crc32(&__executable_start,
+                                 &__etext - &__executable_start);
+        id = {(const char*)&code_crc32, sizeof code_crc32};
+    }
+
+    return id;
+}
+
+
+
+struct SnapshotFile {
+    std::string path_;
+    FILE* file_ = nullptr;
+    bool failed_ = false;
+};
+
+
+
+// We write the snapshot beside the old one, and then replace the old one, so
+// that a vm that exits early never leaves a partial snapshot behind.
+static void write_snapshot(const void* data, size_t size, void* arg)
+{
+    auto snapshot = (SnapshotFile*)arg;
+    const auto tmp_path = snapshot->path_ + ".tmp";
+
+    if (snapshot->failed_) {
+        return;
+    }
+
+    if (data == nullptr) {
+        if (snapshot->file_) {
+            const bool ok = not ferror(snapshot->file_);
+            if (fclose(snapshot->file_) == 0 and ok) {
+                rename(tmp_path.c_str(), snapshot->path_.c_str());
+            } else {
+                remove(tmp_path.c_str());
+            }
+            snapshot->file_ = nullptr;
+        }
+        return;
+    }
+
+    if (snapshot->file_ == nullptr) {
+        snapshot->file_ = fopen(tmp_path.c_str(), "wb");
+        if (snapshot->file_ == nullptr) {
+            printf("failed to write %s\n", tmp_path.c_str());
+            snapshot->failed_ = true;
+            return;
+        }
+    }
+
+    fwrite(data, 1, size, snapshot->file_);
+}
+#endif
+
+
+
+static int usage()
+{
+    puts("usage: eb-java <jar|classfile> <classpath> [-cp <jar>[:<jar>...]]"
+#if JVM_PRELINKED_IMAGE
+         " [-image <prelinked image>]"
+#endif
+#if JVM_SNAPSHOT
+         " [-snapshot <file>]"
+#endif
+    );
+    return 1;
+}
+
+
+
 int main(int argc, char** argv)
 {
     if (argc < 3) {
-        puts("usage: eb-java <jar|classfile> <classpath> [-XDebug=<port>]");
-        return 1;
+        return usage();
     }
 
     std::string fname(argv[1]);
 
-    std::ifstream t(fname);
-    std::string str((std::istreambuf_iterator<char>(t)),
-                    std::istreambuf_iterator<char>());
-
     const auto classpath = java::Slice::from_c_str(argv[2]);
 
+    // Further jars to load classes from, searched after the first one.
+    std::vector<std::string> extra_jars;
+
+    const char* snapshot_path = nullptr;
+
+    for (int i = 3; i < argc; ++i) {
+        if (strcmp(argv[i], "-cp") == 0 and i + 1 < argc) {
+            std::string list(argv[++i]);
+            size_t begin = 0;
+            while (begin <= list.length()) {
+                auto end = list.find(':', begin);
+                if (end == std::string::npos) {
+                    end = list.length();
+                }
+                if (end > begin) {
+                    extra_jars.push_back(list.substr(begin, end - begin));
+                }
+                begin = end + 1;
+            }
+        }
+#if JVM_PRELINKED_IMAGE
+        else if (strcmp(argv[i], "-image") == 0 and i + 1 < argc) {
+            // See tools/prelink.cpp. Each class looks up its own record.
+            auto image = map_file(argv[++i], MADV_RANDOM);
+            if (image.length_ == 0) {
+                printf("failed to map %s\n", argv[i]);
+                return 1;
+            }
+            if (not java::jvm::bind_image(image.ptr_, image.length_)) {
+                printf("warning: ignoring invalid image %s\n", argv[i]);
+            }
+        }
+#endif
+#if JVM_SNAPSHOT
+        else if (strcmp(argv[i], "-snapshot") == 0 and i + 1 < argc) {
+            // Restored from, if it exists and still matches, and written
+            // otherwise.
+            snapshot_path = argv[++i];
+        }
+#endif
+        else {
+            printf("invalid option %s\n", argv[i]);
+            return usage();
+        }
+    }
+
+    int status;
+
     if (fname.substr(fname.find_last_of(".") + 1) == "jar") {
-        auto status = java::jvm::start_from_jar(str.c_str(), classpath);
-        java::jvm::heap::print_stats([](const char* str) { printf("%s", str); });
-        return status;
+        std::vector<java::Slice> jars;
+        jars.push_back(map_jar(fname.c_str()));
+        for (auto& path : extra_jars) {
+            jars.push_back(map_jar(path.c_str()));
+        }
+
+#if JVM_SNAPSHOT
+        if (snapshot_path) {
+            java::jvm::snapshot::bind_program(
+                {&__executable_start, size_t(&_end - &__executable_start)},
+                build_id());
+
+            SnapshotFile file;
+            file.path_ = snapshot_path;
+
+            auto snapshot = map_file(snapshot_path, MADV_WILLNEED);
+
+            status = java::jvm::start_from_snapshot(snapshot,
+                                                    jars.data(),
+                                                    jars.size(),
+                                                    classpath,
+                                                    write_snapshot,
+                                                    &file);
+        } else
+#endif
+        status = java::jvm::start_from_jars(jars.data(), jars.size(), classpath);
     } else {
-        auto status = java::jvm::start_from_classfile(str.c_str(), classpath);
-        java::jvm::heap::print_stats([](const char* str) { printf("%s", str); });
-        return status;
+        // We parse the whole classfile right away.
+        auto classfile = map_file(fname.c_str(), MADV_WILLNEED);
+        if (classfile.length_ == 0) {
+            printf("failed to map %s\n", fname.c_str());
+            return 1;
+        }
+
+        if (snapshot_path) {
+            puts("-snapshot requires a jar");
+            return 1;
+        } else if (extra_jars.empty()) {
+            status = java::jvm::start_from_classfile(classfile.ptr_, classpath);
+        } else {
+            puts("-cp requires a jar");
+            return 1;
+        }
     }
 
-    return 0;
+    java::jvm::heap::print_stats([](const char* str) { printf("%s", str); });
+    java::jvm::print_class_stats([](const char* str) { printf("%s", str); });
+    java::jvm::print_inline_cache_stats([](const char* str) { printf("%s", str); });
+
+    return status;
 }
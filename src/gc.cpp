@@ -79,41 +79,20 @@ void visit_object_fields(Object* object, void (*callback)(Object**))
         return;
     }
 
-    // We are repurposing the SubstitutionField design to determine the
-    // layout of our own fields, and which of those fields are objects. For
-    // efficiency, the implementation inserts descriptors, called
-    // SubstitutionFields, into the constant pool, which describe the size
-    // and the offset of a field within an instance of a class. This speeds
-    // up field lookup significantly, but we can also use the same
-    // architecture to determine which fields in a class are objects, by
-    // asking the constant pool for previously bound substitution fields,
-    // and inspecting each field that's declared as local to the class
-    // definition (local, as opposed to non-local fields, which are
-    // referenced by a classfile, but which do not belong to the class
-    // itself).
-
+    // Each class records the offsets of the reference fields that it
+    // declares, see parse_classfile_fields(), and inherits the rest.
     auto current_clz = object->class_;
 
     while (current_clz) {
-        auto bindings = current_clz->constants_->bindings();
-
-        for (int i = 0; i < bindings.second; ++i) {
-            auto binding = bindings.first[i];
-
-            if (binding.field_.valid_ and binding.field_.local_ and
-                binding.field_.object_) {
+        for (int i = 0; i < current_clz->reference_field_count_; ++i) {
+            const auto offset = current_clz->reference_fields_[i];
 
-                Object* field;
-                memcpy(&field,
-                       object->data() + binding.field_.offset_,
-                       sizeof field);
+            Object* field;
+            memcpy(&field, object->data() + offset, sizeof field);
 
-                callback(&field);
+            callback(&field);
 
-                memcpy(object->data() + binding.field_.offset_,
-                       &field,
-                       sizeof field);
-            }
+            memcpy(object->data() + offset, &field, sizeof field);
         }
         current_clz = current_clz->super_;
     }
@@ -153,17 +132,7 @@ static inline void mark_object(Object* object)
 
 void mark()
 {
-    for (u32 i = 0; i < operand_stack().size(); ++i) {
-        if (operand_types()[i] == OperandTypeCategory::object) {
-            mark_object((Object*)operand_stack()[i]);
-        }
-    }
-
-    for (u32 i = 0; i < locals().size(); ++i) {
-        if (local_types()[i] == OperandTypeCategory::object) {
-            mark_object((Object*)locals()[i]);
-        }
-    }
+    visit_stack_roots([](Object** obj) { mark_object(*obj); });
 
     classtable::visit(
         [](Slice, Class* clz, void*) {
@@ -228,20 +197,9 @@ void resolve_forwarding_pointers()
     // First, fix pointers to objects in local variables, static variables, and
     // operand stack slots.
 
-    // Resolve addresses in operand stack
-    for (u32 i = 0; i < operand_stack().size(); ++i) {
-        if (operand_types()[i] == OperandTypeCategory::object) {
-            operand_stack()[i] =
-                resolve_forwarding_address((Object*)operand_stack()[i]);
-        }
-    }
-
-    // Resolve addresses in local variables
-    for (u32 i = 0; i < locals().size(); ++i) {
-        if (local_types()[i] == OperandTypeCategory::object) {
-            locals()[i] = resolve_forwarding_address((Object*)locals()[i]);
-        }
-    }
+    // Resolve addresses in operand stack slots and local variables
+    visit_stack_roots(
+        [](Object** obj) { *obj = resolve_forwarding_address(*obj); });
 
     // Resolve addresses in static variables
     classtable::visit(
@@ -368,6 +326,58 @@ u32 collect()
 
 
 
+#if JVM_SNAPSHOT
+static intptr_t rebase_offset;
+
+
+
+static void rebase_reference(Object** obj)
+{
+    if (*obj) {
+        *obj = (Object*)((u8*)*obj + rebase_offset);
+    }
+}
+
+
+
+void rebase_objects(intptr_t offset)
+{
+    if (heap::begin() == heap::end()) {
+        return;
+    }
+
+    rebase_offset = offset;
+
+    auto current = (Object*)heap::begin();
+
+    while (current) {
+        // We need the object's class to know its size.
+        current->class_ = (Class*)((u8*)current->class_ + offset);
+
+        const auto size = aligned_instance_size(current);
+
+        if (current->class_ == &reference_array_class) {
+            auto array = (Array*)current;
+            for (int i = 0; i < array->size_; ++i) {
+                Object* obj;
+                memcpy(&obj, array->data() + i * sizeof(Object*), sizeof obj);
+                rebase_reference(&obj);
+                memcpy(array->data() + i * sizeof(Object*), &obj, sizeof obj);
+            }
+        } else if (current->class_ == &return_address_class or
+                   current->class_ == &primitive_array_class) {
+            // Nothing to do
+        } else {
+            visit_object_fields(current, rebase_reference);
+        }
+
+        current = heap_next(current, size);
+    }
+}
+#endif
+
+
+
 } // namespace gc
 } // namespace jvm
 } // namespace java
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "defines.hpp"
 #include "int.h"
 
 
@@ -14,6 +15,16 @@ u32 collect();
 
 
 
+#if JVM_SNAPSHOT
+// Moves each address that the heap's objects hold, i.e. each object's class,
+// and each reference, by offset bytes, for a heap restored from a snapshot
+// taken at a different address, see snapshot.hpp. The classes themselves must
+// have been rebased already.
+void rebase_objects(intptr_t offset);
+#endif
+
+
+
 }
 } // namespace jvm
 } // namespace java
@@ -0,0 +1,105 @@
+#include "image.hpp"
+#include "crc32.hpp"
+
+
+
+namespace java {
+namespace image {
+
+
+
+// Whether a record starts, and ends, within the image.
+static bool record_fits(const char* image, size_t image_size, u32 offset)
+{
+    if (offset > image_size or image_size - offset < sizeof(ClassRecord)) {
+        return false;
+    }
+
+    auto record = (const ClassRecord*)(image + offset);
+
+    return record->constant_count_.get() > 0 and
+           record->size() <= image_size - offset;
+}
+
+
+
+bool check(const char* image, size_t image_size)
+{
+    auto header = (const Header*)image;
+
+    if (image_size < sizeof(Header) or header->magic_.get() not_eq magic or
+        header->version_.get() not_eq version or
+        header->capacity_.get() == 0) {
+        return false;
+    }
+
+    const auto capacity = header->capacity_.get();
+    const auto slots = (const host_u32*)(header + 1);
+
+    if (sizeof(Header) + sizeof(host_u32) * capacity > image_size) {
+        return false;
+    }
+
+    for (int slot = 0; slot < capacity; ++slot) {
+        if (slots[slot].get() and
+            not record_fits(image, image_size, slots[slot].get())) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+const ClassRecord* find(const char* image,
+                        size_t image_size,
+                        Slice class_name,
+                        u32 classfile_size,
+                        u32 classfile_crc32)
+{
+    auto header = (const Header*)image;
+
+    const auto capacity = header->capacity_.get();
+    const auto slots = (const host_u32*)(header + 1);
+
+    const auto hash = crc32(class_name.ptr_, class_name.length_);
+
+    // A full table has no empty slot to stop the search, so we visit each slot
+    // at most once.
+    auto slot = hash % capacity;
+    for (int i = 0; i < capacity and slots[slot].get();
+         ++i, slot = (slot + 1) % capacity) {
+
+        if (not record_fits(image, image_size, slots[slot].get())) {
+            return nullptr;
+        }
+
+        auto record = (const ClassRecord*)(image + slots[slot].get());
+
+        if (record->name() == class_name) {
+            if (record->classfile_size_.get() == classfile_size and
+                record->classfile_crc32_.get() == classfile_crc32) {
+                return record;
+            }
+            return nullptr;
+        }
+    }
+
+    return nullptr;
+}
+
+
+
+u32 table_crc32(const char* image)
+{
+    auto header = (const Header*)image;
+
+    return crc32(image,
+                 sizeof(Header) + sizeof(host_u32) * header->capacity_.get());
+}
+
+
+
+} // namespace image
+} // namespace java
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "endian.hpp"
+#include "int.h"
+#include "slice.hpp"
+
+
+// A prelinked image holds, for each class in a set of jars, what the vm would
+// otherwise work out by walking the class's classfile when loading it: where
+// each constant sits in the constant pool, where the sections after the
+// constant pool begin, and how many references of each kind the constant pool
+// holds. tools/prelink.cpp writes an image ahead of time. Like a jar, the vm
+// reads the image in place, so it may sit in flash, and the image holds
+// offsets, rather than pointers, so it may be mapped anywhere.
+
+// NOTE: A record describes one exact classfile. The vm checks each record
+// against the crc32 that the jar stores for the classfile, and loads classes
+// that changed since we wrote the image the usual way.
+
+
+namespace java {
+namespace image {
+
+
+
+enum : u32 { magic = 0x4d494245 }; // "EBIM"
+
+
+
+enum : u16 { version = 1 };
+
+
+
+struct Header {
+    host_u32 magic_;
+    host_u16 version_;
+
+    // The number of slots in the table of records that follows the header.
+    host_u16 capacity_;
+
+    // host_u32 slots[capacity_];
+    //
+    // The offset, from the start of the image, of the record for the class
+    // whose name hashes to the slot, or the next free slot. Empty slots hold
+    // zero.
+};
+
+
+
+struct ClassRecord {
+    host_u32 classfile_size_;
+    host_u32 classfile_crc32_;
+
+    // From the start of the classfile.
+    host_u32 interfaces_offset_; // ClassFile::HeaderSection2
+    host_u32 fields_offset_;     // ClassFile::HeaderSection3
+    host_u32 attributes_offset_; // ClassFile::HeaderSection5
+
+    host_u16 field_ref_count_;
+    host_u16 method_ref_count_;
+    host_u16 interface_method_ref_count_;
+
+    // As in the classfile, i.e. one more than the number of constants.
+    host_u16 constant_count_;
+
+    host_u16 name_length_;
+
+    // u8 name[name_length_];
+    // host_u16 constant_offsets[constant_count_ - 1];
+    //
+    // The offset of each constant from the start of the classfile. Zero for the
+    // unusable slot after each long and double constant.
+
+    Slice name() const
+    {
+        return {(const char*)(this + 1), name_length_.get()};
+    }
+
+    size_t size() const
+    {
+        return sizeof(ClassRecord) + name_length_.get() +
+               sizeof(host_u16) * (constant_count_.get() - 1);
+    }
+
+    const host_u16* constant_offsets() const
+    {
+        return (const host_u16*)((const char*)(this + 1) + name_length_.get());
+    }
+};
+
+
+
+// Whether the image is one that we can read: a header of the right version,
+// with a table of records, and records, that fit within the image's size. The
+// image comes from a file, which may be truncated or corrupt, so the vm checks
+// it once, before using it.
+bool check(const char* image, size_t image_size);
+
+
+
+// Returns the record for a class, or nullptr, if the image has no record of the
+// class, or if the classfile no longer matches the record.
+const ClassRecord* find(const char* image,
+                        size_t image_size,
+                        Slice class_name,
+                        u32 classfile_size,
+                        u32 classfile_crc32);
+
+
+
+// The checksum of the image's header and table of records, which tells apart
+// images of the same size, without reading every record.
+u32 table_crc32(const char* image);
+
+
+
+} // namespace image
+} // namespace java
@@ -0,0 +1,342 @@
+#include "intrinsics.hpp"
+#include "array.hpp"
+#include "classfile.hpp"
+#include "jni.hpp"
+#include "object.hpp"
+#include "snapshot.hpp"
+#include <string.h>
+
+
+
+#if JVM_INTRINSICS
+
+
+namespace java {
+namespace jvm {
+namespace intrinsics {
+
+
+
+// Intrinsics read fields by offset, looked up when the class is bound.
+static SubstitutionField string_value JVM_SNAPSHOT_STATE;
+static SubstitutionField builder_data JVM_SNAPSHOT_STATE;
+static SubstitutionField builder_count JVM_SNAPSHOT_STATE;
+
+
+
+static const struct {
+    const char* class_name_;
+    const char* field_name_;
+    const char* type_;
+    SubstitutionField* field_;
+} fields[] = {
+    {"java/lang/String", "value", "[C", &string_value},
+    {"java/lang/StringBuilder", "data", "[C", &builder_data},
+    {"java/lang/StringBuilder", "count", "I", &builder_count},
+};
+
+
+
+template <typename T> static T load_field(Object* obj, SubstitutionField field)
+{
+    T result;
+    memcpy(&result, obj->data() + field.offset_, sizeof result);
+    return result;
+}
+
+
+
+template <typename T>
+static void store_field(Object* obj, SubstitutionField field, T value)
+{
+    memcpy(obj->data() + field.offset_, &value, sizeof value);
+}
+
+
+
+// Leaves the call to the method's bytecode, see jni::Declinable.
+template <typename R> static jni::Declinable<R> decline()
+{
+    return {R(), true};
+}
+
+
+
+static void object_init(Object*)
+{
+}
+
+
+
+static jni::Declinable<s32> string_length(Object* self)
+{
+    auto value = load_field<Array*>(self, string_value);
+    if (value == nullptr) {
+        return decline<s32>();
+    }
+
+    return {(s32)value->size_, false};
+}
+
+
+
+static jni::Declinable<s32> string_char_at(Object* self, s32 index)
+{
+    auto value = load_field<Array*>(self, string_value);
+    if (value == nullptr or not value->check_bounds(index)) {
+        // The bytecode throws a StringIndexOutOfBoundsException.
+        return decline<s32>();
+    }
+
+    return {*value->address(index), false};
+}
+
+
+
+static jni::Declinable<s32> string_equals(Object* self, Object* other)
+{
+    if (self == other) {
+        return {true, false};
+    }
+
+    // String is final, so other is a String only if its class matches.
+    if (other == nullptr or other->class_ not_eq self->class_) {
+        return {false, false};
+    }
+
+    auto lhs = load_field<Array*>(self, string_value);
+    auto rhs = load_field<Array*>(other, string_value);
+
+    if (lhs == nullptr or rhs == nullptr) {
+        return decline<s32>();
+    }
+
+    return {lhs->size_ == rhs->size_ and
+                memcmp(lhs->data(),
+                       rhs->data(),
+                       lhs->size_ * lhs->element_size()) == 0,
+            false};
+}
+
+
+
+static jni::Declinable<Object*> builder_append_char(Object* self, s32 c)
+{
+    auto data = load_field<Array*>(self, builder_data);
+    auto count = load_field<s32>(self, builder_count);
+
+    if (data == nullptr or not data->check_bounds(count)) {
+        // The bytecode grows the buffer, which allocates.
+        return decline<Object*>();
+    }
+
+    *data->address(count) = c;
+    store_field(self, builder_count, count + 1);
+
+    return {self, false};
+}
+
+
+
+static s32 int_string_size(s32 x)
+{
+    s64 limit = 9;
+    for (s32 i = 1; i < 10; ++i) {
+        if (x <= limit) {
+            return i;
+        }
+        limit = limit * 10 + 9;
+    }
+    return 10;
+}
+
+
+
+static s32 long_string_size(s64 x)
+{
+    s64 limit = 10;
+    for (s32 i = 1; i < 19; ++i) {
+        if (x < limit) {
+            return i;
+        }
+        if (i < 18) {
+            limit *= 10;
+        }
+    }
+    return 19;
+}
+
+
+
+// Writes the decimal digits of a number into buf, ending just before index.
+// Declines, before writing anything, if the digits do not fit, so that the
+// bytecode throws.
+static jni::Declinable<void>
+write_decimal(u64 magnitude, bool negative, s32 index, Object* buf)
+{
+    auto array = (Array*)buf;
+
+    s32 length = negative;
+    u64 rest = magnitude;
+    do {
+        ++length;
+        rest /= 10;
+    } while (rest);
+
+    if (array == nullptr or index > (s32)array->size_ or index < length) {
+        return {true};
+    }
+
+    do {
+        *array->address(--index) = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+
+    if (negative) {
+        *array->address(--index) = '-';
+    }
+
+    return {false};
+}
+
+
+
+static jni::Declinable<void> int_get_chars(s32 i, s32 index, Object* buf)
+{
+    if (i == INT32_MIN) {
+        // The bytecode can't negate it, leave it to the bytecode.
+        return {true};
+    }
+
+    return write_decimal(i < 0 ? -(s64)i : i, i < 0, index, buf);
+}
+
+
+
+static jni::Declinable<void> long_get_chars(s64 i, s32 index, Object* buf)
+{
+    if (i == INT64_MIN) {
+        return {true};
+    }
+
+    return write_decimal(i < 0 ? -(u64)i : i, i < 0, index, buf);
+}
+
+
+
+struct Intrinsic {
+    const char* class_name_;
+    const char* method_name_;
+    const char* type_signature_;
+    void (*implementation_)();
+    bool (*invoke_)(void (*)());
+    const char* native_descriptor_;
+
+    // Free of side effects, so JVM_INTRINSICS_CHECK may run both the intrinsic
+    // and the bytecode.
+    bool pure_;
+};
+
+
+
+template <typename R, typename... Args>
+static Intrinsic intrinsic(const char* class_name,
+                           const char* method_name,
+                           const char* type_signature,
+                           R (*implementation)(Args...),
+                           bool pure)
+{
+    return {class_name,
+            method_name,
+            type_signature,
+            reinterpret_cast<void (*)()>(implementation),
+            &jni::NativeCall<R, Args...>::invoke,
+            jni::NativeCall<R, Args...>::descriptor(),
+            pure};
+}
+
+
+
+static const Intrinsic intrinsics[] = {
+    intrinsic("java/lang/Object", "<init>", "()V", object_init, true),
+    intrinsic("java/lang/String", "length", "()I", string_length, true),
+    intrinsic("java/lang/String", "charAt", "(I)C", string_char_at, true),
+    intrinsic("java/lang/String",
+              "equals",
+              "(Ljava/lang/Object;)Z",
+              string_equals,
+              true),
+    intrinsic("java/lang/StringBuilder",
+              "append",
+              "(C)Ljava/lang/StringBuilder;",
+              builder_append_char,
+              false),
+    intrinsic("java/lang/IntegerStringConverter",
+              "stringSize",
+              "(I)I",
+              int_string_size,
+              true),
+    intrinsic("java/lang/IntegerStringConverter",
+              "stringSize",
+              "(J)I",
+              long_string_size,
+              true),
+    intrinsic("java/lang/IntegerStringConverter",
+              "getChars",
+              "(II[C)V",
+              int_get_chars,
+              false),
+    intrinsic("java/lang/IntegerStringConverter",
+              "getChars",
+              "(JI[C)V",
+              long_get_chars,
+              false),
+};
+
+
+
+void bind(Class* clz, Slice class_name)
+{
+    for (auto& field : fields) {
+        if (class_name == Slice::from_c_str(field.class_name_)) {
+            *field.field_ = find_field(clz,
+                                       Slice::from_c_str(field.field_name_),
+                                       Slice::from_c_str(field.type_));
+            if (not field.field_->valid_) {
+                // Not the class that we expected, leave its methods alone.
+                return;
+            }
+        }
+    }
+
+    for (auto& entry : intrinsics) {
+        if (not(class_name == Slice::from_c_str(entry.class_name_))) {
+            continue;
+        }
+
+        auto stub =
+            jni::bind_native_method(clz,
+                                    Slice::from_c_str(entry.method_name_),
+                                    Slice::from_c_str(entry.type_signature_),
+                                    entry.implementation_,
+                                    entry.invoke_,
+                                    entry.native_descriptor_);
+
+#if JVM_INTRINSICS_CHECK
+        if (stub) {
+            stub->checked_ = entry.pure_;
+        }
+#else
+        (void)stub;
+#endif
+    }
+}
+
+
+
+} // namespace intrinsics
+} // namespace jvm
+} // namespace java
+
+
+#endif // JVM_INTRINSICS
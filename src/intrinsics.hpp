@@ -0,0 +1,23 @@
+#pragma once
+
+#include "class.hpp"
+#include "slice.hpp"
+
+
+
+namespace java {
+namespace jvm {
+namespace intrinsics {
+
+
+
+// Replace each of the class' methods that has a C++ implementation, see
+// intrinsics.cpp. Called when the vm imports a class, before running its
+// static initializer, so that no caller ever resolves the bytecode version.
+void bind(Class* clz, Slice class_name);
+
+
+
+} // namespace intrinsics
+} // namespace jvm
+} // namespace java
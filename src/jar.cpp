@@ -1,5 +1,6 @@
 #include "jar.hpp"
 #include "classfile.hpp"
+#include "crc32.hpp"
 #include "endian.hpp"
 #include <string.h>
 
@@ -29,51 +30,417 @@ struct LocalFileHeader {
 };
 
 
+struct CentralDirectoryFileHeader {
+    host_u32 signature_;
+    host_u16 version_made_by_;
+    host_u16 minimum_version_;
+    host_u16 gp_bit_flag_;
+    host_u16 compression_method_;
+    host_u16 last_modification_time_;
+    host_u16 last_modification_date_;
+    host_u32 uncompressed_data_crc32_;
+    host_u32 compressed_size_;
+    host_u32 uncompressed_size_;
+    host_u16 file_name_length_;
+    host_u16 extra_field_length_;
+    host_u16 file_comment_length_;
+    host_u16 disk_number_start_;
+    host_u16 internal_file_attributes_;
+    host_u32 external_file_attributes_;
+    host_u32 local_header_offset_;
+    // u8 file_name[file_name_length_];
+    // u8 extra_field[extra_field_length_];
+    // u8 file_comment[file_comment_length_];
+};
+
+
+struct EndOfCentralDirectory {
+    host_u32 signature_;
+    host_u16 disk_number_;
+    host_u16 central_directory_disk_number_;
+    host_u16 disk_entries_;
+    host_u16 total_entries_;
+    host_u32 central_directory_size_;
+    host_u32 central_directory_offset_;
+    host_u16 comment_length_;
+    // u8 comment[comment_length_];
+};
+
+
+enum Signature : u32 {
+    local_file_header = 0x04034b50,
+    central_directory_file_header = 0x02014b50,
+    end_of_central_directory = 0x06054b50,
+};
+
+
 } // namespace zip
 
 
 
-Slice load_file_data(const char* jar_file_bytes, Slice path)
+// Reads the local file header at the start of a jar entry. Returns the file's
+// name, and sets data to the file's contents, or returns an empty name if the
+// entry is not a file that we are able to load.
+static Slice parse_local_file(const char* entry,
+                              Slice& data,
+                              u32* file_crc32 = nullptr)
 {
+    auto hdr = (const zip::LocalFileHeader*)entry;
 
+    if (hdr->signature_.get() not_eq zip::local_file_header) {
+        // Invalid file header
+        return {nullptr, 0};
+    }
 
-    while (true) {
-        auto hdr = (const zip::LocalFileHeader*)jar_file_bytes;
+    if (hdr->compression_method_.get() not_eq 0) {
+        // We cannot support compressed files within jars. Doing so would
+        // greatly limit our ability to run larger java programs.
+        return {nullptr, 0};
+    }
 
-        if (hdr->signature_.get() not_eq 0x04034b50) {
-            // Invalid file header
-            return {nullptr, 0};
+    if (hdr->compressed_size_.get() not_eq hdr->uncompressed_size_.get()) {
+        // We should never really reach this point, unless the file is
+        // corrupt.
+        return {nullptr, 0};
+    }
+
+    if (hdr->gp_bit_flag_.get() & (1 << 3)) {
+        // We do not support data descriptors in zip files.
+        // TODO: maybe we'll support this someday?
+        return {nullptr, 0};
+    }
+
+    entry += sizeof(zip::LocalFileHeader);
+
+    const Slice file_name{entry, hdr->file_name_length_.get()};
+
+    entry += hdr->file_name_length_.get();
+    entry += hdr->extra_field_length_.get();
+
+    data = {entry, hdr->compressed_size_.get()};
+
+    if (file_crc32) {
+        *file_crc32 = hdr->uncompressed_data_crc32_.get();
+    }
+
+    return file_name;
+}
+
+
+
+#if JVM_JAR_INDEX or JVM_SNAPSHOT
+// The end of central directory record closes the jar, followed only by a
+// comment of up to 64K.
+static const zip::EndOfCentralDirectory*
+end_of_central_directory(const char* jar_file_bytes, size_t jar_size)
+{
+    const auto record_size = sizeof(zip::EndOfCentralDirectory);
+
+    if (jar_size < record_size) {
+        return nullptr;
+    }
+
+    for (size_t comment = 0;
+         comment <= 0xffff and comment <= jar_size - record_size;
+         ++comment) {
+
+        auto record =
+            (const zip::EndOfCentralDirectory*)(jar_file_bytes + jar_size -
+                                                 record_size - comment);
+
+        if (record->signature_.get() == zip::end_of_central_directory and
+            record->comment_length_.get() == comment) {
+            return record;
         }
+    }
 
-        if (hdr->compression_method_.get() not_eq 0) {
-            // We cannot support compressed files within jars. Doing so would
-            // greatly limit our ability to run larger java programs.
-            return {nullptr, 0};
+    return nullptr;
+}
+#endif
+
+
+
+#if JVM_SNAPSHOT
+u32 directory_crc32(const char* jar_file_bytes, size_t jar_size)
+{
+    auto end = end_of_central_directory(jar_file_bytes, jar_size);
+    if (not end) {
+        return 0;
+    }
+
+    const auto offset = end->central_directory_offset_.get();
+    const auto size = end->central_directory_size_.get();
+
+    if ((size_t)offset + size > jar_size) {
+        return 0;
+    }
+
+    return crc32(jar_file_bytes + offset, size);
+}
+#endif
+
+
+
+#if JVM_JAR_INDEX
+struct CentralDirectory {
+    const zip::CentralDirectoryFileHeader* begin_ = nullptr;
+
+    // Null, with entries_ at its maximum, if we don't know the jar's size.
+    const char* end_ = nullptr;
+    u32 entries_ = 0;
+
+    // Bounds the local file headers that the entries point to.
+    size_t jar_size_ = 0;
+
+    bool fits(const char* str, size_t size) const
+    {
+        return end_ == nullptr or (str <= end_ and size_t(end_ - str) >= size);
+    }
+};
+
+
+
+// The central directory follows the last file in the jar. Without the jar's
+// size, we cannot find the end of central directory record, so we skip over
+// the files, without looking at them. With the jar's size, a jar whose end of
+// central directory record is missing, or points outside of the jar, is
+// corrupt, and gets no index.
+static CentralDirectory central_directory(const char* jar_file_bytes,
+                                          size_t jar_size)
+{
+    CentralDirectory directory;
+
+    auto str = jar_file_bytes;
+
+    if (jar_size) {
+        auto end = end_of_central_directory(jar_file_bytes, jar_size);
+        if (not end) {
+            return {};
         }
 
-        if (hdr->compressed_size_.get() not_eq hdr->uncompressed_size_.get()) {
-            // We should never really reach this point, unless the file is
-            // corrupt.
-            return {nullptr, 0};
+        const auto offset = end->central_directory_offset_.get();
+        const auto size = end->central_directory_size_.get();
+
+        if ((size_t)offset + size > jar_size) {
+            return {};
         }
 
-        if (hdr->gp_bit_flag_.get() & (1 << 3)) {
-            // We do not support data descriptors in zip files.
-            // TODO: maybe we'll support this someday?
-            return {nullptr, 0};
+        str += offset;
+        directory.end_ = str + size;
+        directory.entries_ = end->total_entries_.get();
+        directory.jar_size_ = jar_size;
+    } else {
+        while (true) {
+            Slice data;
+            if (parse_local_file(str, data).length_ == 0) {
+                break;
+            }
+            str = data.ptr_ + data.length_;
+        }
+
+        directory.entries_ = ~0;
+    }
+
+    auto hdr = (const zip::CentralDirectoryFileHeader*)str;
+
+    if (not directory.fits(str, sizeof(zip::CentralDirectoryFileHeader)) or
+        hdr->signature_.get() not_eq zip::central_directory_file_header) {
+        return {};
+    }
+
+    directory.begin_ = hdr;
+
+    return directory;
+}
+
+
+
+// Only classfiles go into the index, as the vm loads nothing else from jars,
+// while jars may hold any number of other files.
+static bool is_classfile(Slice path)
+{
+    static const Slice extension{".class", 6};
+
+    return path.length_ >= extension.length_ and
+           Slice{path.ptr_ + path.length_ - extension.length_,
+                 extension.length_} == extension;
+}
+
+
+
+// Visits at most the number of entries, and the bytes, that the end of central
+// directory record gives. Returns false, after visiting only some of the
+// entries, if the directory turns out to be corrupt: an entry doesn't fit, or
+// points outside of the jar.
+template <typename F>
+static bool visit_central_directory(const CentralDirectory& directory,
+                                    F callback)
+{
+    auto hdr = directory.begin_;
+
+    for (u32 i = 0; i < directory.entries_; ++i) {
+        auto str = (const char*)hdr;
+
+        if (not directory.fits(str, sizeof(zip::CentralDirectoryFileHeader)) or
+            hdr->signature_.get() not_eq zip::central_directory_file_header) {
+            // Without the jar's size, the directory ends at the first thing
+            // that isn't an entry.
+            return directory.end_ == nullptr;
+        }
+
+        str += sizeof(zip::CentralDirectoryFileHeader);
+
+        const Slice file_name{str, hdr->file_name_length_.get()};
+
+        const size_t variable_size = hdr->file_name_length_.get() +
+                                     hdr->extra_field_length_.get() +
+                                     hdr->file_comment_length_.get();
+
+        if (not directory.fits(str, variable_size)) {
+            return false;
+        }
+
+        str += variable_size;
+
+        const auto offset = hdr->local_header_offset_.get();
+
+        if (directory.jar_size_ and
+            offset + sizeof(zip::LocalFileHeader) > directory.jar_size_) {
+            return false;
+        }
+
+        if (is_classfile(file_name)) {
+            callback(file_name, offset);
+        }
+
+        hdr = (const zip::CentralDirectoryFileHeader*)str;
+    }
+
+    return true;
+}
+
+
+
+static u16 index_capacity(const char* jar_file_bytes, size_t jar_size)
+{
+    auto directory = central_directory(jar_file_bytes, jar_size);
+
+    if (directory.begin_ == nullptr) {
+        return 0;
+    }
+
+    // A corrupt jar gets no index, so that we fall back to searching it.
+    u32 count = 0;
+    if (not visit_central_directory(directory, [&](Slice, u32) { ++count; })) {
+        return 0;
+    }
+
+    // At most two thirds full, so that probes, for misses too, end quickly at
+    // an empty entry.
+    const u32 capacity = count + count / 2 + 1;
+
+    if (capacity > 0xffff) {
+        return 0;
+    }
+
+    return capacity;
+}
+
+
+
+size_t index_size(const char* jar_file_bytes, size_t jar_size)
+{
+    if (auto capacity = index_capacity(jar_file_bytes, jar_size)) {
+        return sizeof(Index) + sizeof(Index::Entry) * capacity;
+    }
+
+    return 0;
+}
+
+
+
+const Index*
+build_index(const char* jar_file_bytes, size_t jar_size, void* memory)
+{
+    auto index = (Index*)memory;
+
+    index->capacity_ = index_capacity(jar_file_bytes, jar_size);
+
+    auto entries = index->entries();
+
+    for (int i = 0; i < index->capacity_; ++i) {
+        entries[i] = ~0;
+    }
+
+    visit_central_directory(
+        central_directory(jar_file_bytes, jar_size),
+        [&](Slice name, u32 offset) {
+            const auto hash = crc32(name.ptr_, name.length_);
+
+            auto slot = hash % index->capacity_;
+            while (entries[slot] not_eq (u32)~0) {
+                slot = (slot + 1) % index->capacity_;
+            }
+
+            entries[slot] = offset;
+        });
+
+    return index;
+}
+
+
+
+static Slice load_indexed_file_data(const char* jar_file_bytes,
+                                    Slice path,
+                                    const Index* index,
+                                    u32* file_crc32)
+{
+    const auto hash = crc32(path.ptr_, path.length_);
+
+    auto entries = index->entries();
+
+    for (auto slot = hash % index->capacity_; entries[slot] not_eq (u32)~0;
+         slot = (slot + 1) % index->capacity_) {
+
+        Slice data;
+        auto entry = jar_file_bytes + entries[slot];
+        if (parse_local_file(entry, data, file_crc32) == path) {
+            return data;
         }
+    }
 
-        jar_file_bytes += sizeof(zip::LocalFileHeader);
+    return {nullptr, 0};
+}
+#endif // JVM_JAR_INDEX
+
+
+
+Slice load_file_data(const char* jar_file_bytes,
+                     Slice path,
+                     const Index* index,
+                     u32* file_crc32)
+{
+#if JVM_JAR_INDEX
+    if (index and is_classfile(path)) {
+        return load_indexed_file_data(
+            jar_file_bytes, path, index, file_crc32);
+    }
+#else
+    (void)index;
+#endif
 
-        const char* file_name_ptr = jar_file_bytes;
+    while (true) {
+        Slice data;
+        auto file_name = parse_local_file(jar_file_bytes, data, file_crc32);
 
-        jar_file_bytes += hdr->file_name_length_.get();
-        jar_file_bytes += hdr->extra_field_length_.get();
+        if (file_name.length_ == 0) {
+            return {nullptr, 0};
+        }
 
-        if (path == Slice{file_name_ptr, hdr->file_name_length_.get()}) {
-            return {jar_file_bytes, hdr->compressed_size_.get()};
+        if (path == file_name) {
+            return data;
         } else {
-            jar_file_bytes += hdr->compressed_size_.get();
+            jar_file_bytes = data.ptr_ + data.length_;
         }
     }
 
@@ -82,7 +449,10 @@ Slice load_file_data(const char* jar_file_bytes, Slice path)
 
 
 
-Slice load_classfile(const char* jar_file_bytes, Slice classpath)
+Slice load_classfile(const char* jar_file_bytes,
+                     Slice classpath,
+                     const Index* index,
+                     u32* file_crc32)
 {
     static const int max_classpath = 256;
 
@@ -95,7 +465,8 @@ Slice load_classfile(const char* jar_file_bytes, Slice classpath)
     memcpy(buffer, classpath.ptr_, classpath.length_);
     memcpy(buffer + classpath.length_, ".class", 6);
 
-    auto data = load_file_data(jar_file_bytes, {buffer, classpath.length_ + 6});
+    auto data = load_file_data(
+        jar_file_bytes, {buffer, classpath.length_ + 6}, index, file_crc32);
 
     if (data.length_ >= sizeof(ClassFile::HeaderSection1)) {
         if (((ClassFile::HeaderSection1*)data.ptr_)->magic_.get() not_eq
@@ -1,11 +1,14 @@
 #pragma once
 
+#include "defines.hpp"
+#include "int.h"
 #include "slice.hpp"
+#include <stddef.h>
 
 
-// NOTE: This jar library does not store anything in memory. It accepts a
-// pointer to a jar file, and returns a pointer to a class within the input
-// buffer.
+// NOTE: This jar library does not allocate anything. It accepts a pointer to a
+// jar file, and returns a pointer to a class within the input buffer. Callers
+// may supply memory for an index of the jar, see build_index().
 
 // NOTE: we want our jvm to run on small embedded systems, therefore, jars must
 // be uncompressed.
@@ -16,11 +19,72 @@ namespace jar {
 
 
 
-Slice load_file_data(const char* jar_file_bytes, Slice path);
+#if JVM_JAR_INDEX
+// A hash table over the classfiles in a jar, built from the jar's central
+// directory. Finds a classfile, or finds that the jar has no such classfile,
+// without walking the jar's local file headers.
+struct Index {
+    // The offset of a classfile's local file header, at the slot given by the
+    // hash of the classfile's path, or the next free slot. Empty slots hold ~0.
+    // We check the path in the local file header, which also settles hash
+    // collisions, so entries need not store the hash.
+    using Entry = u32;
 
+    u16 capacity_;
 
+    Entry* entries()
+    {
+        return (Entry*)(this + 1);
+    }
 
-Slice load_classfile(const char* jar_file_byts, Slice classpath);
+    const Entry* entries() const
+    {
+        return (const Entry*)(this + 1);
+    }
+};
+
+
+
+// The bytes of memory needed for an index of the jar, or zero if we cannot
+// index it. Pass the size of the jar, if known, so that we can find the
+// central directory from the end of the jar, rather than by skipping over the
+// jar's files, which touches every page of the jar. Zero if not known.
+size_t index_size(const char* jar_file_bytes, size_t jar_size);
+
+
+
+// Builds an index in memory of index_size() bytes, aligned for an Index.
+const Index*
+build_index(const char* jar_file_bytes, size_t jar_size, void* memory);
+#else
+struct Index;
+#endif
+
+
+
+// Without an index, walks the jar from the start. If given file_crc32, sets it
+// to the checksum that the jar records for the file.
+Slice load_file_data(const char* jar_file_bytes,
+                     Slice path,
+                     const Index* index = nullptr,
+                     u32* file_crc32 = nullptr);
+
+
+
+Slice load_classfile(const char* jar_file_byts,
+                     Slice classpath,
+                     const Index* index = nullptr,
+                     u32* file_crc32 = nullptr);
+
+
+
+#if JVM_SNAPSHOT
+// The checksum of the jar's central directory, which lists the checksum of each
+// file in the jar, so it tells apart jars of the same size with different
+// contents, without reading the whole jar. Zero if the jar has no central
+// directory.
+u32 directory_crc32(const char* jar_file_bytes, size_t jar_size);
+#endif
 
 
 
@@ -1,4 +1,5 @@
 #include "jni.hpp"
+#include "classtable.hpp"
 #include "memory.hpp"
 #include "methodTable.hpp"
 #include "vm.hpp"
@@ -9,13 +10,98 @@ namespace java {
 namespace jni {
 
 
-void bind_native_method(Class* clz,
-                        Slice method_name,
-                        Slice method_type_signature,
-                        void (*implementation)())
+// The descriptor character of a java type, as NativeType spells it.
+static char native_kind(char type)
 {
-    if (not clz->methods_) {
-        return;
+    switch (type) {
+    case 'Z':
+    case 'B':
+    case 'C':
+    case 'S':
+        return 'I';
+
+    case '[':
+        return 'L';
+
+    default:
+        return type;
+    }
+}
+
+
+
+// Whether a native's descriptor, see NativeCall::descriptor(), matches the
+// descriptor of the method that it implements. An instance method's native
+// takes self as its first parameter.
+static bool native_descriptor_matches(const char* native,
+                                      Slice descriptor,
+                                      bool is_static)
+{
+    if (*native++ not_eq '(') {
+        return false;
+    }
+
+    if (not is_static and *native++ not_eq 'L') {
+        return false;
+    }
+
+    auto str = descriptor.ptr_;
+    const auto end = descriptor.ptr_ + descriptor.length_;
+
+    if (str == end or *str++ not_eq '(') {
+        return false;
+    }
+
+    while (str not_eq end) {
+        const char type = *str;
+
+        if (*native++ not_eq native_kind(type)) {
+            return false;
+        }
+
+        if (type == ')') {
+            ++str;
+            return str not_eq end and *native == native_kind(*str) and
+                   native[1] == '\0';
+        }
+
+        while (str not_eq end and *str == '[') {
+            ++str;
+        }
+
+        if (str not_eq end and *str == 'L') {
+            while (str not_eq end and *str not_eq ';') {
+                ++str;
+            }
+        }
+
+        ++str;
+    }
+
+    return false;
+}
+
+
+
+MethodStub* bind_native_method(Class* clz,
+                               Slice method_name,
+                               Slice method_type_signature,
+                               void (*implementation)(),
+                               bool (*invoke)(void (*)()),
+                               const char* native_descriptor)
+{
+    // Look the method up before we allocate anything, so that a failed bind
+    // costs no class memory.
+    auto method = clz->load_method(method_name, method_type_signature, 0, 0);
+    if (method == nullptr) {
+        return nullptr;
+    }
+
+    if (native_descriptor and
+        not native_descriptor_matches(native_descriptor,
+                                      method_type_signature,
+                                      method->access_flags_.get() & 0x0008)) {
+        unhandled_error("native function does not match method descriptor");
     }
 
     // We need a way to bind a native method to this class. If we haven't
@@ -36,9 +122,41 @@ void bind_native_method(Class* clz,
                                                         alignof(MethodStub));
 
     stub->implementation_ = implementation;
+    stub->invoke_ = invoke;
+#if JVM_INTRINSICS_CHECK
+    stub->checked_ = false;
+#endif
+
+    auto replaced =
+        ((MethodTable*)clz->methods_)
+            ->bind_native_method(clz, method_name, method_type_signature, stub);
+
+    stub->fallback_ = replaced;
+
+#if JVM_VTABLES or JVM_INLINE_CACHES or JVM_RESOLVED_METHODS
+    if (replaced) {
+        // The method may already sit in the vtables of the class, and of any
+        // loaded subclasses, or in the inline caches or constant pool of any
+        // caller.
+        struct Context {
+            const ClassFile::MethodInfo* replaced_;
+            const ClassFile::MethodInfo* stub_;
+        } context = {replaced, (const ClassFile::MethodInfo*)stub};
+
+        jvm::classtable::visit(
+            [](Slice, Class* clz, void* arg) {
+                auto context = (Context*)arg;
+                clz->replace_method(context->replaced_, context->stub_);
+            },
+            &context);
+    }
+#endif
+
+    if (not replaced) {
+        return nullptr;
+    }
 
-    ((MethodTable*)clz->methods_)
-        ->bind_native_method(clz, method_name, method_type_signature, stub);
+    return stub;
 }
 
 
@@ -1,10 +1,18 @@
 #pragma once
 
 #include "class.hpp"
+#include <utility>
 
 
 
 namespace java {
+
+
+
+struct Object;
+
+
+
 namespace jni {
 
 
@@ -19,14 +27,272 @@ struct MethodStub {
 
     void (*implementation_)(); // Return the number of operand stack slots used
                                // by function result.
+
+    // For natives bound with bind_native_function(): takes the arguments off
+    // of the operand stack, calls implementation_, and pushes the result. The
+    // vm calls it without pushing a stack frame. Null for natives that read
+    // their arguments from local variables. Returns false, leaving the operand
+    // stack as it was, if the native declined the call, see Declinable.
+    bool (*invoke_)(void (*implementation)());
+
+    // The bytecode method that the native replaced, if any. Runs in place of
+    // a declined call.
+    const ClassFile::MethodInfo* fallback_;
+
+#if JVM_INTRINSICS_CHECK
+    // Compare the native's result against the fallback_ method's, see
+    // JVM_INTRINSICS_CHECK.
+    bool checked_;
+#endif
+};
+
+
+
+// Bind a native method, by name and descriptor. The implementation runs in a
+// stack frame of its own, and reads its arguments from the frame's local
+// variables. Needed by natives that throw, or that inspect the call stack.
+// Returns nullptr if the class has no such method. For typed natives, invoke
+// and native_descriptor come from NativeCall, see bind_native_function().
+MethodStub* bind_native_method(Class* clz,
+                               Slice method_name,
+                               Slice method_type_signature,
+                               void (*implementation)(),
+                               bool (*invoke)(void (*)()) = nullptr,
+                               const char* native_descriptor = nullptr);
+
+
+
+// Operand stack access for typed natives. Offsets count slots from the top of
+// the operand stack, as in the interpreter.
+s32 load_operand_i(int offset);
+float load_operand_f(int offset);
+s64 load_wide_operand_l(int offset);
+double load_wide_operand_d(int offset);
+Object* load_operand_a(int offset);
+
+void push_operand_i(s32 value);
+void push_operand_f(float value);
+void push_wide_operand_l(s64 value);
+void push_wide_operand_d(double value);
+void push_operand_a(Object* value);
+
+void pop_operands(int count);
+
+
+
+// How a java type maps to a native method's C++ parameter or return type.
+// Booleans, bytes, chars and shorts are passed as s32, like on the operand
+// stack. The kind is the descriptor character of the java types that map to
+// the C++ type, with I standing in for Z, B, C and S too, and L for arrays.
+template <typename T> struct NativeType;
+
+template <> struct NativeType<s32> {
+    enum { slots = 1, kind = 'I' };
+    static s32 load(int offset)
+    {
+        return load_operand_i(offset);
+    }
+    static void push(s32 value)
+    {
+        push_operand_i(value);
+    }
+};
+
+template <> struct NativeType<float> {
+    enum { slots = 1, kind = 'F' };
+    static float load(int offset)
+    {
+        return load_operand_f(offset);
+    }
+    static void push(float value)
+    {
+        push_operand_f(value);
+    }
+};
+
+template <> struct NativeType<s64> {
+    enum { slots = 2, kind = 'J' };
+    static s64 load(int offset)
+    {
+        return load_wide_operand_l(offset);
+    }
+    static void push(s64 value)
+    {
+        push_wide_operand_l(value);
+    }
+};
+
+template <> struct NativeType<double> {
+    enum { slots = 2, kind = 'D' };
+    static double load(int offset)
+    {
+        return load_wide_operand_d(offset);
+    }
+    static void push(double value)
+    {
+        push_wide_operand_d(value);
+    }
+};
+
+template <> struct NativeType<Object*> {
+    enum { slots = 1, kind = 'L' };
+    static Object* load(int offset)
+    {
+        return load_operand_a(offset);
+    }
+    static void push(Object* value)
+    {
+        push_operand_a(value);
+    }
+};
+
+
+
+// The operand stack slots taken by the arguments after the index'th one, i.e.
+// the offset of the index'th argument from the top of the stack.
+constexpr int slots_above(const int* slots, int count, int index)
+{
+    int result = 0;
+    for (int i = index + 1; i < count; ++i) {
+        result += slots[i];
+    }
+    return result;
+}
+
+
+
+// A native that replaces a bytecode method may return Declinable<R> in place
+// of R, and decline calls that it does not handle, e.g. ones that should throw.
+// The vm then runs the replaced method's bytecode instead, with the same
+// arguments. A native must not allocate before declining.
+template <typename R> struct Declinable {
+    R value_;
+    bool declined_;
+};
+
+template <> struct Declinable<void> {
+    bool declined_;
+};
+
+
+
+template <typename R> struct NativeResult {
+    enum { kind = NativeType<R>::kind };
+
+    template <typename F> static bool call(F f, int argument_slots)
+    {
+        const R result = f();
+        pop_operands(argument_slots);
+        NativeType<R>::push(result);
+        return true;
+    }
+};
+
+template <> struct NativeResult<void> {
+    enum { kind = 'V' };
+
+    template <typename F> static bool call(F f, int argument_slots)
+    {
+        f();
+        pop_operands(argument_slots);
+        return true;
+    }
+};
+
+template <typename R> struct NativeResult<Declinable<R>> {
+    enum { kind = NativeType<R>::kind };
+
+    template <typename F> static bool call(F f, int argument_slots)
+    {
+        const auto result = f();
+        if (result.declined_) {
+            return false;
+        }
+        pop_operands(argument_slots);
+        NativeType<R>::push(result.value_);
+        return true;
+    }
+};
+
+template <> struct NativeResult<Declinable<void>> {
+    enum { kind = 'V' };
+
+    template <typename F> static bool call(F f, int argument_slots)
+    {
+        if (f().declined_) {
+            return false;
+        }
+        pop_operands(argument_slots);
+        return true;
+    }
+};
+
+
+
+// Marshalling for a native with the signature R(Args...). The arguments stay
+// on the operand stack, where the gc can see them, until the native returns.
+// But a native that allocates may trigger the gc, which moves objects, so it
+// must not use its reference arguments after allocating.
+template <typename R, typename... Args> struct NativeCall {
+
+    template <std::size_t... I>
+    static R call(R (*implementation)(Args...), std::index_sequence<I...>)
+    {
+        constexpr int slots[] = {NativeType<Args>::slots..., 0};
+        (void)slots;
+
+        return implementation(NativeType<Args>::load(
+            slots_above(slots, sizeof...(Args), I))...);
+    }
+
+    static bool invoke(void (*implementation)())
+    {
+        auto fn = reinterpret_cast<R (*)(Args...)>(implementation);
+
+        constexpr int slots[] = {NativeType<Args>::slots..., 0};
+
+        int argument_slots = 0;
+        for (auto s : slots) {
+            argument_slots += s;
+        }
+
+        return NativeResult<R>::call(
+            [fn] { return call(fn, std::index_sequence_for<Args...>{}); },
+            argument_slots);
+    }
+
+    // A method descriptor made of the kinds of the C++ types, see NativeType,
+    // e.g. (LI)I for s32 (*)(Object*, s32). Binding checks it against the
+    // method's own descriptor.
+    static const char* descriptor()
+    {
+        static const char result[] = {
+            '(', NativeType<Args>::kind..., ')', NativeResult<R>::kind, '\0'};
+
+        return result;
+    }
 };
 
 
 
-void bind_native_method(Class* clz,
-                        Slice method_name,
-                        Slice method_type_signature,
-                        void (*implementation)());
+// Bind a native method to a C++ function, whose signature gives the types of
+// the java method's parameters (including self, for instance methods) and
+// result, e.g. s32 (*)(Object* self, s32 index) for an int method(int). The
+// vm calls the function straight from the operand stack, without a stack
+// frame, so binding this way is the cheapest way to call into C++.
+template <typename R, typename... Args>
+MethodStub* bind_native_function(Class* clz,
+                                 Slice method_name,
+                                 Slice method_type_signature,
+                                 R (*implementation)(Args...))
+{
+    return bind_native_method(clz,
+                              method_name,
+                              method_type_signature,
+                              reinterpret_cast<void (*)()>(implementation),
+                              &NativeCall<R, Args...>::invoke,
+                              NativeCall<R, Args...>::descriptor());
+}
 
 
 
@@ -1,6 +1,7 @@
 #include "memory.hpp"
 #include "defines.hpp"
 #include "gc.hpp"
+#include "symbolTable.hpp"
 #include "vm.hpp"
 #include <stdlib.h>
 #include <cstdio>
@@ -129,6 +130,14 @@ void print_stats(void (*print_str_callback)(const char*))
              heap_end - (u8*)heap_alloc);
 
     print_str_callback(buffer);
+
+    snprintf(buffer,
+             sizeof buffer,
+             "symbols %d, %zu bytes of class info\n",
+             symboltable::size(),
+             symboltable::footprint());
+
+    print_str_callback(buffer);
 }
 
 
@@ -175,7 +184,21 @@ namespace classmemory {
 
 
 
-void* allocate(size_t size, size_t alignment)
+u8* begin()
+{
+    return heap::heap_end;
+}
+
+
+
+void __overwrite_begin(u8* new_begin)
+{
+    heap::heap_end = new_begin;
+}
+
+
+
+void* try_allocate(size_t size, size_t alignment)
 {
     if (size == 0) {
         return heap::heap_end;
@@ -191,26 +214,28 @@ void* allocate(size_t size, size_t alignment)
     }
 
     if (alloc_ptr < heap::heap_alloc) {
-        gc::collect();
-    } else {
-        heap::heap_end = alloc_ptr;
-        return alloc_ptr;
+        return nullptr;
     }
 
+    heap::heap_end = alloc_ptr;
+    return alloc_ptr;
+}
 
-    alloc_ptr = (u8*)heap::heap_end - size;
 
-    while (((size_t)alloc_ptr) % alignment not_eq 0) {
-        --alloc_ptr;
+
+void* allocate(size_t size, size_t alignment)
+{
+    if (auto mem = try_allocate(size, alignment)) {
+        return mem;
     }
 
+    gc::collect();
 
-    if (alloc_ptr < heap::heap_alloc) {
-        unhandled_error("oom!");
+    if (auto mem = try_allocate(size, alignment)) {
+        return mem;
     }
 
-    heap::heap_end = alloc_ptr;
-    return alloc_ptr;
+    unhandled_error("oom!");
 }
 
 
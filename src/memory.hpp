@@ -66,6 +66,23 @@ void* allocate(size_t size, size_t align);
 
 
 
+// Like allocate(), but returns nullptr when the heap is full, rather than
+// running the gc, which moves objects. For callers that may hold object
+// pointers that the gc cannot see.
+void* try_allocate(size_t size, size_t align);
+
+
+
+// Class memory runs from here to the end of the heap.
+u8* begin();
+
+
+
+// Only intended to be called when restoring a snapshot, see snapshot.hpp.
+void __overwrite_begin(u8* new_begin);
+
+
+
 template <typename T, typename... Args> T* allocate(Args&&... args)
 {
     if (auto mem = (T*)allocate(sizeof(T), alignof(T))) {
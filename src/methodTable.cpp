@@ -44,21 +44,28 @@ MethodTableImpl::MethodTableImpl(const ClassFile::HeaderSection4* h4)
 
 
 const ClassFile::MethodInfo*
-MethodTableImpl::load_method(Class* clz, Slice lhs_name, Slice lhs_type)
+MethodTableImpl::load_method(Class* clz,
+                             Slice lhs_name,
+                             Slice lhs_type,
+                             jvm::symboltable::Symbol lhs_name_symbol,
+                             jvm::symboltable::Symbol lhs_type_symbol)
 {
     // TODO: This stuff should really be refactored. A method cache loses some
     // of its effectiveness if it does not cache methods from the
     // superclasses...
-    auto index = crc32(lhs_name.ptr_, lhs_name.length_) % JVM_METHOD_CACHE_SIZE;
+    auto index = (lhs_name_symbol ? lhs_name_symbol
+                                  : crc32(lhs_name.ptr_, lhs_name.length_)) %
+                 JVM_METHOD_CACHE_SIZE;
 
-    if (auto mtd = method_cache_[index]) {
-        u16 name_index = mtd->name_index_.get();
-        u16 type_index = mtd->descriptor_index_.get();
-
-        auto rhs_name = clz->constants_->load_string(name_index);
-        auto rhs_type = clz->constants_->load_string(type_index);
+    auto matches = [&](const ClassFile::MethodInfo* mtd) {
+        return clz->constants_->matches(
+                   mtd->name_index_.get(), lhs_name, lhs_name_symbol) and
+               clz->constants_->matches(
+                   mtd->descriptor_index_.get(), lhs_type, lhs_type_symbol);
+    };
 
-        if (rhs_name == lhs_name and rhs_type == lhs_type) {
+    if (auto mtd = method_cache_[index]) {
+        if (matches(mtd)) {
             return mtd;
         }
     }
@@ -66,13 +73,7 @@ MethodTableImpl::load_method(Class* clz, Slice lhs_name, Slice lhs_type)
 
     if (methods_) {
         for (int i = 0; i < method_count_; ++i) {
-            u16 name_index = methods_[i]->name_index_.get();
-            u16 type_index = methods_[i]->descriptor_index_.get();
-
-            auto rhs_name = clz->constants_->load_string(name_index);
-            auto rhs_type = clz->constants_->load_string(type_index);
-
-            if (lhs_type == rhs_type and lhs_name == rhs_name) {
+            if (matches(methods_[i])) {
                 method_cache_[index] = methods_[i];
                 return methods_[i];
             }
@@ -83,19 +84,21 @@ MethodTableImpl::load_method(Class* clz, Slice lhs_name, Slice lhs_type)
 
 
 
-void MethodTableImpl::bind_native_method(Class* clz,
-                                         Slice method_name,
-                                         Slice type_signature,
-                                         jni::MethodStub* stub)
+const ClassFile::MethodInfo*
+MethodTableImpl::bind_native_method(Class* clz,
+                                    Slice method_name,
+                                    Slice type_signature,
+                                    jni::MethodStub* stub)
 {
     for (int i = 0; i < method_count_; ++i) {
         const auto method_name_str =
             clz->constants_->load_string(methods_[i]->name_index_.get());
 
-        // FIXME: check method type signature too, to avoid issues with
-        // overloaded methods.
+        const auto method_type_str =
+            clz->constants_->load_string(methods_[i]->descriptor_index_.get());
 
-        if (method_name_str == method_name) {
+        if (method_name_str == method_name and
+            method_type_str == type_signature) {
 
             auto old_method = methods_[i];
 
@@ -112,9 +115,18 @@ void MethodTableImpl::bind_native_method(Class* clz,
             stub->attribute_info_.attribute_length_.set(jni::magic);
 
             methods_[i] = (ClassFile::MethodInfo*)stub;
-            return;
+
+            for (auto& mtd : method_cache_) {
+                if (mtd == old_method) {
+                    mtd = methods_[i];
+                }
+            }
+
+            return old_method;
         }
     }
+
+    return nullptr;
 }
 
 
@@ -4,6 +4,7 @@
 #include "classfile.hpp"
 #include "defines.hpp"
 #include "jni.hpp"
+#include "symbolTable.hpp"
 
 
 
@@ -21,13 +22,20 @@ public:
     {
     }
 
+    // The symbols may be zero, see Class::load_method().
     virtual const ClassFile::MethodInfo*
-    load_method(Class* clz, Slice method_name, Slice type_signature) = 0;
+    load_method(Class* clz,
+                Slice method_name,
+                Slice type_signature,
+                jvm::symboltable::Symbol method_name_symbol,
+                jvm::symboltable::Symbol type_signature_symbol) = 0;
 
-    virtual void bind_native_method(Class* clz,
-                                    Slice method_name,
-                                    Slice type_signature,
-                                    jni::MethodStub* stub) = 0;
+    // Returns the method that the stub replaced, if any.
+    virtual const ClassFile::MethodInfo*
+    bind_native_method(Class* clz,
+                       Slice method_name,
+                       Slice type_signature,
+                       jni::MethodStub* stub) = 0;
 
 
     virtual void
@@ -44,13 +52,18 @@ public:
 
 
     const ClassFile::MethodInfo*
-    load_method(Class* clz, Slice method_name, Slice type_signature) override;
+    load_method(Class* clz,
+                Slice method_name,
+                Slice type_signature,
+                jvm::symboltable::Symbol method_name_symbol,
+                jvm::symboltable::Symbol type_signature_symbol) override;
 
 
-    void bind_native_method(Class* clz,
-                            Slice method_name,
-                            Slice type_signature,
-                            jni::MethodStub* stub) override;
+    const ClassFile::MethodInfo*
+    bind_native_method(Class* clz,
+                       Slice method_name,
+                       Slice type_signature,
+                       jni::MethodStub* stub) override;
 
 
     void
@@ -0,0 +1,460 @@
+#include "snapshot.hpp"
+#include "class.hpp"
+#include "classtable.hpp"
+#include "crc32.hpp"
+#include "gc.hpp"
+#include "memory.hpp"
+#include <string.h>
+
+
+
+#if JVM_SNAPSHOT
+
+
+// The bounds of the section that holds the JVM_SNAPSHOT_STATE globals, which
+// the linker provides.
+extern "C" char __start_jvm_state[];
+extern "C" char __stop_jvm_state[];
+
+
+
+namespace java {
+namespace jvm {
+namespace snapshot {
+
+
+
+enum : u32 { magic = 0x50534245 }; // "EBSP"
+
+
+
+enum : u16 { version = 2 };
+
+
+
+#define JVM_SNAPSHOT_STR_(X) #X
+#define JVM_SNAPSHOT_STR(X) JVM_SNAPSHOT_STR_(X)
+#define JVM_SNAPSHOT_SETTING(NAME) #NAME "=" JVM_SNAPSHOT_STR(NAME) ";"
+
+
+
+// The settings in defines.hpp, many of which change the layout of the vm's
+// state, while leaving the program's size and layout as they were.
+static const char configuration[] =
+    JVM_SNAPSHOT_SETTING(JVM_ARGUMENT_INFO_CACHE_SIZE)
+    JVM_SNAPSHOT_SETTING(JVM_AVAILABLE_BREAKPOINTS)
+    JVM_SNAPSHOT_SETTING(JVM_CONSTANT_POOL_INDEX_BUDGET)
+    JVM_SNAPSHOT_SETTING(JVM_CONSTANT_POOL_INDEX_MIN_SIZE)
+    JVM_SNAPSHOT_SETTING(JVM_CONSTANT_POOL_INDEX_THRESHOLD)
+    JVM_SNAPSHOT_SETTING(JVM_DEVIRTUALIZE)
+    JVM_SNAPSHOT_SETTING(JVM_ENABLE_DEBUGGING)
+    JVM_SNAPSHOT_SETTING(JVM_GC_REFERENCE_MAPS)
+    JVM_SNAPSHOT_SETTING(JVM_GC_REFERENCE_MAP_SCRATCH)
+    JVM_SNAPSHOT_SETTING(JVM_HEAP_SIZE)
+    JVM_SNAPSHOT_SETTING(JVM_INLINE_CACHES)
+    JVM_SNAPSHOT_SETTING(JVM_INLINE_CACHE_SIZE)
+    JVM_SNAPSHOT_SETTING(JVM_INLINE_CACHE_STATS)
+    JVM_SNAPSHOT_SETTING(JVM_INTRINSICS)
+    JVM_SNAPSHOT_SETTING(JVM_INTRINSICS_CHECK)
+    JVM_SNAPSHOT_SETTING(JVM_ITABLES)
+    JVM_SNAPSHOT_SETTING(JVM_JAR_INDEX)
+    JVM_SNAPSHOT_SETTING(JVM_MAX_CALL_DEPTH)
+    JVM_SNAPSHOT_SETTING(JVM_METHOD_CACHE_SIZE)
+    JVM_SNAPSHOT_SETTING(JVM_NATIVE_WIDE_SLOTS)
+    JVM_SNAPSHOT_SETTING(JVM_NONRECURSIVE_CALLS)
+    JVM_SNAPSHOT_SETTING(JVM_OPERAND_STACK_SIZE)
+    JVM_SNAPSHOT_SETTING(JVM_PREDECODE_BYTECODE)
+    JVM_SNAPSHOT_SETTING(JVM_PRELINKED_IMAGE)
+    JVM_SNAPSHOT_SETTING(JVM_QUICKENED_CODE_BUDGET)
+    JVM_SNAPSHOT_SETTING(JVM_QUICKEN_BYTECODE)
+    JVM_SNAPSHOT_SETTING(JVM_RESOLVED_METHODS)
+    JVM_SNAPSHOT_SETTING(JVM_STACK_LOCALS_SIZE)
+    JVM_SNAPSHOT_SETTING(JVM_STACK_OVERFLOW_CHECK)
+    JVM_SNAPSHOT_SETTING(JVM_STACK_RESERVE)
+    JVM_SNAPSHOT_SETTING(JVM_SUBTYPE_DISPLAY)
+    JVM_SNAPSHOT_SETTING(JVM_SUPERINSTRUCTIONS)
+    JVM_SNAPSHOT_SETTING(JVM_SYMBOL_TABLE_BUDGET)
+    JVM_SNAPSHOT_SETTING(JVM_SYMBOL_TABLE_SIZE)
+    JVM_SNAPSHOT_SETTING(JVM_THREADED_DISPATCH)
+    JVM_SNAPSHOT_SETTING(JVM_USE_CALLSTACK)
+    JVM_SNAPSHOT_SETTING(JVM_VTABLES);
+
+
+
+struct Header {
+    u32 magic_;
+    u16 version_;
+    u8 pointer_size_;
+    u8 region_count_; // Not counting the program.
+    u32 heap_size_;
+    u32 state_size_;
+    u32 objects_size_;
+    u32 class_memory_size_;
+
+    // Where the program was, and where the heap and our own code were within
+    // it. Any other build of the vm would lay these out differently.
+    uintptr_t program_base_;
+    uintptr_t program_size_;
+    uintptr_t heap_offset_;
+    uintptr_t code_offset_;
+
+    // Tell apart builds that happen to lay out the program alike.
+    u32 configuration_crc32_;
+    u8 build_id_size_;
+    u8 build_id_[max_build_id];
+
+    // RegionRecord regions[region_count_];
+    // u8 state[state_size_];
+    // u8 objects[objects_size_];
+    // u8 class_memory[class_memory_size_];
+    // u8 bitmap[];
+    //
+    // With one bit per pointer aligned word of the state, followed by one bit
+    // per pointer aligned word of class memory, set for words that held an
+    // address in the program or in one of the regions, other than words of
+    // the java program's data, see holds_program_data().
+};
+
+
+
+struct RegionRecord {
+    uintptr_t base_;
+    uintptr_t size_;
+    u32 fingerprint_;
+};
+
+
+
+static Slice program;
+static Slice build_id;
+
+
+
+void bind_program(Slice memory, Slice id)
+{
+    program = memory;
+    build_id = id;
+}
+
+
+
+static u8* state_begin()
+{
+    return (u8*)__start_jvm_state;
+}
+
+
+
+static size_t state_size()
+{
+    return __stop_jvm_state - __start_jvm_state;
+}
+
+
+
+static u8* heap_limit()
+{
+    return heap::begin() + heap::total();
+}
+
+
+
+// Calls the visitor with each pointer aligned word of the state, and then of
+// class memory, along with the word's bit in the bitmap.
+template <typename F> static u32 visit_words(F visitor)
+{
+    u32 bit = 0;
+
+    auto visit = [&](u8* begin, u8* end) {
+        auto word = begin;
+        while ((uintptr_t)word % sizeof(void*) not_eq 0) {
+            ++word;
+        }
+
+        for (; word + sizeof(void*) <= end; word += sizeof(void*)) {
+            visitor(word, bit++);
+        }
+    };
+
+    visit(state_begin(), state_begin() + state_size());
+    visit(classmemory::begin(), heap_limit());
+
+    return bit;
+}
+
+
+
+// The index of the region that holds an address, zero being the program, or -1
+// if no region does. Includes the end of each region, as a pointer may point
+// just past the end of something.
+static int
+find_region(uintptr_t address, const RegionRecord* regions, int region_count)
+{
+    for (int i = 0; i < region_count; ++i) {
+        if (address >= regions[i].base_ and
+            address - regions[i].base_ <= regions[i].size_) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+
+// Whether a word overlaps data that the java program chose: the value of a
+// primitive static field, or the bytecode of a quickened method. Such a word
+// holds no address, whatever its value, see snapshot.hpp.
+static bool holds_program_data(const u8* word)
+{
+    struct Context {
+        const u8* word_;
+        bool found_;
+    } context = {word, false};
+
+    classtable::visit(
+        [](Slice, Class* clz, void* arg) {
+            auto context = (Context*)arg;
+
+            auto overlaps = [context](const u8* data, size_t size) {
+                return context->word_ < data + size and
+                       data < context->word_ + sizeof(void*);
+            };
+
+            for (auto opt = clz->options_; opt; opt = opt->next_) {
+                if (opt->type_ == Class::Option::Type::static_field) {
+                    auto field = (Class::OptionStaticField*)opt;
+                    if (not field->is_object_ and
+                        overlaps(field->data(), field->field_size_)) {
+                        context->found_ = true;
+                    }
+                }
+            }
+
+#if JVM_QUICKEN_BYTECODE
+            clz->visit_quickened_code([&](Class::OptionQuickenedCode* quick) {
+                if (quick->code_ and
+                    overlaps(quick->code_, quick->code_length_)) {
+                    context->found_ = true;
+                }
+            });
+#endif
+        },
+        &context);
+
+    return context.found_;
+}
+
+
+
+static uintptr_t load_word(const u8* word)
+{
+    uintptr_t value;
+    memcpy(&value, word, sizeof value);
+    return value;
+}
+
+
+
+static Header make_header(int region_count)
+{
+    Header header;
+    memset(&header, 0, sizeof header);
+
+    header.magic_ = magic;
+    header.version_ = version;
+    header.pointer_size_ = sizeof(void*);
+    header.region_count_ = region_count;
+    header.heap_size_ = heap::total();
+    header.state_size_ = state_size();
+    header.program_base_ = (uintptr_t)program.ptr_;
+    header.program_size_ = program.length_;
+    header.heap_offset_ = (uintptr_t)heap::begin() - (uintptr_t)program.ptr_;
+    header.code_offset_ = (uintptr_t)&restore - (uintptr_t)program.ptr_;
+    header.configuration_crc32_ =
+        crc32(configuration, sizeof configuration - 1);
+    header.build_id_size_ = build_id.length_ < max_build_id ? build_id.length_
+                                                            : max_build_id;
+    if (header.build_id_size_) {
+        memcpy(header.build_id_, build_id.ptr_, header.build_id_size_);
+    }
+
+    return header;
+}
+
+
+
+bool save(const Region* regions, int region_count, Writer write, void* arg)
+{
+    if (program.length_ == 0 or region_count > max_regions) {
+        return false;
+    }
+
+    RegionRecord records[max_regions + 1];
+
+    records[0] = {(uintptr_t)program.ptr_, program.length_, 0};
+
+    for (int i = 0; i < region_count; ++i) {
+        if (regions[i].memory_.length_ == 0) {
+            return false;
+        }
+
+        records[i + 1] = {(uintptr_t)regions[i].memory_.ptr_,
+                          regions[i].memory_.length_,
+                          regions[i].fingerprint_};
+    }
+
+    // So that the snapshot holds live objects only.
+    gc::collect();
+
+    auto header = make_header(region_count);
+    header.objects_size_ = heap::end() - heap::begin();
+    header.class_memory_size_ = heap_limit() - classmemory::begin();
+
+    write(&header, sizeof header, arg);
+    write(records + 1, sizeof(RegionRecord) * region_count, arg);
+    write(state_begin(), header.state_size_, arg);
+    write(heap::begin(), header.objects_size_, arg);
+    write(classmemory::begin(), header.class_memory_size_, arg);
+
+    // We need no memory for the bitmap, writing a bit of it at a time.
+    u8 buffer[64];
+    memset(buffer, 0, sizeof buffer);
+
+    const auto bits = visit_words([&](u8* word, u32 bit) {
+        auto& byte = buffer[(bit / 8) % sizeof buffer];
+
+        if (find_region(load_word(word), records, region_count + 1) >= 0 and
+            (word < classmemory::begin() or not holds_program_data(word))) {
+            byte |= 1 << (bit % 8);
+        }
+
+        if (bit % (sizeof buffer * 8) == sizeof buffer * 8 - 1) {
+            write(buffer, sizeof buffer, arg);
+            memset(buffer, 0, sizeof buffer);
+        }
+    });
+
+    if (auto remainder = bits % (sizeof buffer * 8)) {
+        write(buffer, (remainder + 7) / 8, arg);
+    }
+
+    write(nullptr, 0, arg);
+
+    return true;
+}
+
+
+
+bool restore(Slice snapshot, const Region* regions, int region_count)
+{
+    if (program.length_ == 0 or region_count > max_regions or
+        snapshot.length_ < sizeof(Header)) {
+        return false;
+    }
+
+    Header header;
+    memcpy(&header, snapshot.ptr_, sizeof header);
+
+    const auto expected = make_header(region_count);
+
+    if (header.magic_ not_eq expected.magic_ or
+        header.version_ not_eq expected.version_ or
+        header.pointer_size_ not_eq expected.pointer_size_ or
+        header.region_count_ not_eq expected.region_count_ or
+        header.heap_size_ not_eq expected.heap_size_ or
+        header.state_size_ not_eq expected.state_size_ or
+        header.program_size_ not_eq expected.program_size_ or
+        header.heap_offset_ not_eq expected.heap_offset_ or
+        header.code_offset_ not_eq expected.code_offset_ or
+        header.configuration_crc32_ not_eq expected.configuration_crc32_ or
+        header.build_id_size_ not_eq expected.build_id_size_ or
+        memcmp(header.build_id_, expected.build_id_, header.build_id_size_) or
+        header.objects_size_ + header.class_memory_size_ > heap::total()) {
+        return false;
+    }
+
+    auto str = snapshot.ptr_ + sizeof header;
+
+    // Where each region was, and how far it moved since.
+    RegionRecord records[max_regions + 1];
+    intptr_t offsets[max_regions + 1];
+
+    records[0].base_ = header.program_base_;
+    records[0].size_ = header.program_size_;
+    offsets[0] = (uintptr_t)program.ptr_ - header.program_base_;
+
+    for (int i = 0; i < region_count; ++i) {
+        auto& record = records[i + 1];
+        memcpy(&record, str + sizeof(RegionRecord) * i, sizeof record);
+
+        if (record.size_ not_eq regions[i].memory_.length_ or
+            record.fingerprint_ not_eq regions[i].fingerprint_) {
+            return false;
+        }
+
+        offsets[i + 1] = (uintptr_t)regions[i].memory_.ptr_ - record.base_;
+    }
+
+    str += sizeof(RegionRecord) * region_count;
+
+    const size_t words = (header.state_size_ + header.class_memory_size_) /
+                         sizeof(void*);
+
+    const size_t total = sizeof header + sizeof(RegionRecord) * region_count +
+                         header.state_size_ + header.objects_size_ +
+                         header.class_memory_size_ + (words + 7) / 8;
+
+    if (snapshot.length_ < total) {
+        return false;
+    }
+
+    auto class_memory = heap_limit() - header.class_memory_size_;
+
+    memcpy(state_begin(), str, header.state_size_);
+    str += header.state_size_;
+
+    memcpy(heap::begin(), str, header.objects_size_);
+    str += header.objects_size_;
+
+    memcpy(class_memory, str, header.class_memory_size_);
+    str += header.class_memory_size_;
+
+    heap::__overwrite_end(heap::begin() + header.objects_size_);
+    classmemory::__overwrite_begin(class_memory);
+
+    bool moved = false;
+    for (int i = 0; i < region_count + 1; ++i) {
+        moved |= offsets[i] not_eq 0;
+    }
+
+    if (not moved) {
+        return true;
+    }
+
+    auto bitmap = (const u8*)str;
+
+    visit_words([&](u8* word, u32 bit) {
+        if (bitmap[bit / 8] & (1 << (bit % 8))) {
+            auto value = load_word(word);
+            const auto region = find_region(value, records, region_count + 1);
+            if (region >= 0) {
+                value += offsets[region];
+                memcpy(word, &value, sizeof value);
+            }
+        }
+    });
+
+    // Objects and classes live in the heap, which sits in the program.
+    gc::rebase_objects(offsets[0]);
+
+    return true;
+}
+
+
+
+} // namespace snapshot
+} // namespace jvm
+} // namespace java
+
+
+#endif // JVM_SNAPSHOT
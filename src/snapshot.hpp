@@ -0,0 +1,104 @@
+#pragma once
+
+#include "defines.hpp"
+#include "int.h"
+#include "slice.hpp"
+#include <stddef.h>
+
+
+// A snapshot holds the vm's state just before it calls main(): the heap, class
+// memory, and the globals marked JVM_SNAPSHOT_STATE. Restoring one, on a later
+// run, skips bootstrapping, class loading, and static initializers. The state
+// points into the program (the vm's own globals, code, and Lang.jar), and into
+// the jars and prelinked image that the host mapped, which may all sit at
+// different addresses on the next run, so the snapshot records where each of
+// these regions was, and a bitmap of the words that held addresses. Restoring
+// moves each such address by the distance that its region moved.
+
+// NOTE: We spot addresses in class memory and globals by value, as class
+// memory holds no type information. But we leave out the data that the java
+// program chose, i.e. the values of primitive static fields and the bytecode of
+// quickened methods, which could hold any bit pattern, so that a long static
+// field never gets moved, whatever its value. The rest is the vm's own data:
+// addresses, and counts, offsets, flags and hashes, which, even packed together
+// into a word, fall far below or above where the regions sit. Objects get
+// rebased exactly, by walking the heap, as their fields need not be aligned.
+
+// NOTE: A snapshot only fits the build of the vm that took it. The snapshot
+// records the vm's configuration, i.e. the JVM_* settings, and the build id
+// that the host passes to bind_program(), and a different build rejects it.
+
+// NOTE: The vm's state may only point into the program, the heap, and the
+// regions. Names of classes, for example, get registered from the classfile
+// rather than from the caller's copy.
+
+
+namespace java {
+namespace jvm {
+namespace snapshot {
+
+
+
+#if JVM_SNAPSHOT
+
+
+
+#define JVM_SNAPSHOT_STATE __attribute__((section("jvm_state")))
+
+
+
+// Memory, other than the program, that the vm's state may point into: a jar or
+// a prelinked image. The fingerprint tells apart different contents of the
+// same size, see jar::directory_crc32().
+struct Region {
+    Slice memory_;
+    u32 fingerprint_;
+};
+
+
+
+// Not counting the program.
+enum { max_regions = 31 };
+
+
+
+// The memory that the program occupies, including its code, constants and
+// globals, and an id that tells apart different builds of the program, e.g. the
+// linker's build id. Only the first max_build_id bytes of the id count. Call
+// before save() or restore().
+void bind_program(Slice program, Slice build_id);
+
+
+
+enum { max_build_id = 32 };
+
+
+
+// Called with successive pieces of a snapshot, and then once with nullptr,
+// once the snapshot is complete.
+using Writer = void (*)(const void* data, size_t size, void* arg);
+
+
+
+// Runs the gc, then writes a snapshot. Returns false, having written nothing,
+// if a region's size is not known.
+bool save(const Region* regions, int region_count, Writer write, void* arg);
+
+
+
+// Returns false, leaving the vm untouched, if the snapshot was taken by a
+// different build or configuration of the vm, or with different regions. Call
+// in place of bootstrapping the vm, before loading anything.
+bool restore(Slice snapshot, const Region* regions, int region_count);
+
+
+
+#else
+#define JVM_SNAPSHOT_STATE
+#endif
+
+
+
+} // namespace snapshot
+} // namespace jvm
+} // namespace java
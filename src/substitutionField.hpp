@@ -22,7 +22,7 @@ struct SubstitutionField {
     };
 
     Size size_ : 2;
-    u16 local_ : 1;
+    u16 __reserved_0__ : 1;
     u16 object_ : 1;
     u16 valid_ : 1;
 
@@ -39,7 +39,7 @@ struct SubstitutionField {
 
 
     SubstitutionField(Size size, u16 offset, bool is_object)
-        : size_(size), local_(false), object_(is_object), valid_(1),
+        : size_(size), __reserved_0__(0), object_(is_object), valid_(1),
           offset_(offset)
     {
     }
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "class.hpp"
+#include "int.h"
+
+
+namespace java {
+
+
+
+// A Methodref only names its target, so calling through one means loading the
+// class by name, and searching the class hierarchy for the method. Once an
+// invokestatic or invokespecial instruction has resolved a Methodref, we bind
+// the result to the constant pool entry, much like SubstitutionField does for
+// fields, and later calls skip the lookup entirely. Only direct calls bind
+// their target. A virtual call resolves by receiver, see vtables.
+struct SubstitutionMethod {
+    Class* class_; // Declares the method.
+    const ClassFile::MethodInfo* method_;
+
+    // nullptr for native methods, or if not known.
+    const ClassFile::AttributeCode* code_;
+
+#if JVM_QUICKEN_BYTECODE
+    // The method's quickened code, so that a bound call need not look it up.
+    // nullptr whenever code_ is.
+    Class::OptionQuickenedCode* quick_;
+#endif
+
+    // Including self, for invokespecial.
+    u16 operand_count_;
+};
+
+
+
+} // namespace java
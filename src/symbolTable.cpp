@@ -0,0 +1,123 @@
+#include "symbolTable.hpp"
+#include "crc32.hpp"
+#include "defines.hpp"
+#include "memory.hpp"
+#include "snapshot.hpp"
+#include <string.h>
+
+
+
+namespace java {
+namespace jvm {
+namespace symboltable {
+
+
+
+struct SymbolTableEntry {
+    SymbolTableEntry* next_;
+    const char* text_;
+    u32 hash_;
+    u16 length_;
+    Symbol symbol_;
+};
+
+
+
+static SymbolTableEntry*
+    symbol_table[JVM_SYMBOL_TABLE_SIZE] JVM_SNAPSHOT_STATE;
+
+static Symbol symbol_count JVM_SNAPSHOT_STATE;
+
+// Class memory charged to JVM_SYMBOL_TABLE_BUDGET.
+static size_t symbol_table_bytes JVM_SNAPSHOT_STATE;
+
+
+
+void* allocate(size_t size, size_t align)
+{
+    if (symbol_table_bytes + size > JVM_SYMBOL_TABLE_BUDGET) {
+        return nullptr;
+    }
+
+    // NOTE: Symbols are interned during method and field resolution, while the
+    // caller may hold object pointers that the gc does not know about.
+    auto mem = classmemory::try_allocate(size, align);
+
+    if (mem) {
+        symbol_table_bytes += size;
+    }
+
+    return mem;
+}
+
+
+
+static SymbolTableEntry* search(Slice text, u32 hash)
+{
+    auto entry = symbol_table[hash % JVM_SYMBOL_TABLE_SIZE];
+
+    while (entry) {
+        if (entry->hash_ == hash and entry->length_ == text.length_ and
+            memcmp(entry->text_, text.ptr_, text.length_) == 0) {
+            return entry;
+        }
+
+        entry = entry->next_;
+    }
+
+    return nullptr;
+}
+
+
+
+Symbol intern(Slice text)
+{
+    const auto hash = crc32(text.ptr_, text.length_);
+
+    if (auto entry = search(text, hash)) {
+        return entry->symbol_;
+    }
+
+    if (symbol_count == max_symbol) {
+        return 0;
+    }
+
+    auto entry = (SymbolTableEntry*)allocate(sizeof(SymbolTableEntry),
+                                             alignof(SymbolTableEntry));
+
+    if (entry == nullptr) {
+        return 0;
+    }
+
+    auto& bucket = symbol_table[hash % JVM_SYMBOL_TABLE_SIZE];
+
+    entry->next_ = bucket;
+    entry->text_ = text.ptr_;
+    entry->hash_ = hash;
+    entry->length_ = text.length_;
+    entry->symbol_ = ++symbol_count;
+
+    bucket = entry;
+
+    return entry->symbol_;
+}
+
+
+
+int size()
+{
+    return symbol_count;
+}
+
+
+
+size_t footprint()
+{
+    return symbol_table_bytes;
+}
+
+
+
+} // namespace symboltable
+} // namespace jvm
+} // namespace java
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "int.h"
+#include "slice.hpp"
+#include <stddef.h>
+
+
+
+namespace java {
+namespace jvm {
+namespace symboltable {
+
+
+
+// Every distinct name and descriptor that the vm compares gets interned once,
+// as a small integer id, so that method and field resolution compare ids
+// rather than bytes. Zero means no symbol: the table ran out of
+// JVM_SYMBOL_TABLE_BUDGET, in which case callers fall back to comparing the
+// text.
+using Symbol = u16;
+
+
+
+// The most symbols that the table hands out, leaving the values above it free
+// for users to mark symbols as unavailable.
+enum : Symbol { max_symbol = 0xfffe };
+
+
+
+// Returns the text's symbol, adding it to the table if need be. The text must
+// outlive the vm, i.e. point into a classfile. Never runs the gc.
+Symbol intern(Slice text);
+
+
+
+// Class memory for tables that map constants to symbols, charged to the
+// JVM_SYMBOL_TABLE_BUDGET, see ConstantPool::load_symbol(). Returns nullptr
+// once the budget is spent. Never runs the gc.
+void* allocate(size_t size, size_t align);
+
+
+
+int size();
+
+
+
+// Class memory used by the symbol table and constant pool symbol maps.
+size_t footprint();
+
+
+
+} // namespace symboltable
+} // namespace jvm
+} // namespace java
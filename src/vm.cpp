@@ -4,11 +4,15 @@
 #include "classtable.hpp"
 #include "endian.hpp"
 #include "gc.hpp"
+#include "image.hpp"
+#include "intrinsics.hpp"
 #include "jar.hpp"
 #include "jni.hpp"
 #include "object.hpp"
 #include "returnAddress.hpp"
 #include "stringBuffer.hpp"
+#include "substitutionMethod.hpp"
+#include "symbolTable.hpp"
 #include <string.h>
 #define INCBIN_PREFIX
 #define INCBIN_STYLE INCBIN_STYLE_SNAKE
@@ -16,7 +20,9 @@
 #include "incbin.h"
 #include "jdwp.hpp"
 #include "memory.hpp"
+#include <algorithm>
 #include <math.h>
+#include <stdio.h>
 // #include <cstdio>
 
 
@@ -29,30 +35,64 @@ namespace jvm {
 struct AvailableJar {
     const char* jar_file_data_;
     AvailableJar* next_;
+    const jar::Index* index_;
+    size_t size_; // Zero if not known.
 };
 
 
 
-static AvailableJar* jars;
+static AvailableJar* jars JVM_SNAPSHOT_STATE;
 
 
 
-static void bind_jar(const char* jar_file_data)
+// The jar's size may be zero, if not known.
+static void bind_jar(const char* jar_file_data, size_t jar_size)
 {
     auto info = classmemory::allocate<AvailableJar>();
 
     info->jar_file_data_ = jar_file_data;
     info->next_ = jars;
+    info->index_ = nullptr;
+    info->size_ = jar_size;
     jars = info;
+
+#if JVM_JAR_INDEX
+    if (auto size = jar::index_size(jar_file_data, jar_size)) {
+        if (auto mem = classmemory::allocate(size, alignof(jar::Index))) {
+            info->index_ = jar::build_index(jar_file_data, jar_size, mem);
+        }
+    }
+#else
+    (void)jar_size;
+#endif
+}
+
+
+
+#if JVM_PRELINKED_IMAGE
+static Slice prelinked_image JVM_SNAPSHOT_STATE;
+
+
+
+bool bind_image(const char* image_bytes, size_t image_size)
+{
+    if (not image::check(image_bytes, image_size)) {
+        prelinked_image = {};
+        return false;
+    }
+
+    prelinked_image = {image_bytes, image_size};
+    return true;
 }
+#endif
 
 
 
 // Our implementation includes three classes of pseudo-objects, which need to be
 // handled separately from all other java objects.
-Class primitive_array_class;
-Class reference_array_class;
-Class return_address_class;
+Class primitive_array_class JVM_SNAPSHOT_STATE;
+Class reference_array_class JVM_SNAPSHOT_STATE;
+Class return_address_class JVM_SNAPSHOT_STATE;
 
 
 
@@ -70,10 +110,13 @@ static ReturnAddress* make_return_address(u32 pc)
 
 
 static OperandStack __operand_stack;
-// We need to keep track of operand types, for garbage collection purposes, as
-// well as for putfield (which needs to know whether a stack operand is
-// long/double).
+
+
+#if not JVM_GC_REFERENCE_MAPS
+// We need to keep track of operand types, for garbage collection purposes.
+using OperandTypes = Buffer<OperandTypeCategory, JVM_OPERAND_STACK_SIZE>;
 static OperandTypes __operand_types;
+#endif
 
 
 
@@ -84,57 +127,203 @@ OperandStack& operand_stack()
 
 
 
-OperandTypes& operand_types()
-{
-    return __operand_types;
-}
+// Local variable slots, for all active methods. Each method's frame holds a
+// pointer to its first local variable, see Frame below.
+static void* __locals[JVM_STACK_LOCALS_SIZE];
+static void** __locals_top = __locals;
 
 
+#if not JVM_GC_REFERENCE_MAPS
+static OperandTypeCategory __local_types[JVM_STACK_LOCALS_SIZE];
+#endif
 
-static Locals __locals;
-static LocalTypes __local_types;
 
 
+// An activation record, one for each method invocation.
+struct Frame {
+    Class* clz_;
 
-#if JVM_USE_CALLSTACK
-using CallstackInfo = std::pair<Class*, const ClassFile::MethodInfo*>;
-static Buffer<CallstackInfo, 64> callstack;
+    // nullptr for host frames, see HostFrame below.
+    const ClassFile::MethodInfo* method_;
+
+    // The frame pointer. Local variable n lives at locals_[n].
+    void** locals_;
+
+    // Points to the interpreter's pc variable, nullptr for native methods, or
+    // until the method starts running. For a calling method, the pc of the
+    // invoke instruction, i.e. where the method will resume after the call.
+    const u32* pc_;
+
+    // The method's operand stack begins here. Below, the slots belong to the
+    // caller.
+    u32 operand_base_;
+
+#if JVM_NONRECURSIVE_CALLS
+    // Interpreter state of a calling method, saved while the callee runs in the
+    // same execute_bytecode() activation. pc_ points to call_pc_, the pc of the
+    // invoke instruction.
+    const u8* bytecode_;
+    const ClassFile::ExceptionTable* exception_table_;
+    Class::OptionQuickenedCode* quick_;
+    u32 call_pc_;
+#endif
+
+#if JVM_GC_REFERENCE_MAPS
+    // Without type tags, the gc needs to know where each method's operand
+    // stack begins, in order to work out which slots hold references. See
+    // visit_stack_roots().
+
+    // nullptr for native methods.
+    const ClassFile::AttributeCode* code_;
+
+    // For native methods, the descriptor used by the caller (native methods
+    // are bound with placeholder descriptors).
+    Slice signature_;
+
+    // Set while searching for an exception handler, when the method's operand
+    // stack holds only the exception object.
+    bool unwinding_;
 #endif
+};
+
+
+static Buffer<Frame, JVM_MAX_CALL_DEPTH> frames;
+
+
+// Locals of the innermost frame.
+static void** __fp;
+
+
 
+// Set while the vm constructs a StackOverflowError, which may use the frames
+// and slots that push_frame() otherwise holds back. See stack_overflow().
+static bool stack_reserve_open;
 
 
-Locals& locals()
+
+// Returns false, pushing nothing, if the frame's locals, or max_stack operands
+// on top of the current operand stack, would not fit. Calls leave room for
+// JVM_STACK_RESERVE more frames, host frames (method == nullptr) take no slots
+// and may use the reserve.
+static bool push_frame(Class* clz,
+                       const ClassFile::MethodInfo* method,
+                       int local_count,
+                       int max_stack)
 {
-    return __locals;
+    const int reserve =
+        (stack_reserve_open or method == nullptr) ? 0 : JVM_STACK_RESERVE;
+
+    if (frames.size() + reserve >= frames.capacity() or
+        local_count + reserve * 4 >
+            (__locals + JVM_STACK_LOCALS_SIZE) - __locals_top or
+        max_stack + reserve * 4 >
+            (int)(__operand_stack.capacity() - __operand_stack.size())) {
+        return false;
+    }
+
+    Frame frame;
+    frame.clz_ = clz;
+    frame.method_ = method;
+    frame.locals_ = __locals_top;
+    frame.pc_ = nullptr;
+    frame.operand_base_ = __operand_stack.size();
+
+#if JVM_GC_REFERENCE_MAPS
+    frame.code_ = nullptr;
+    frame.signature_ = Slice(nullptr, 0);
+    frame.unwinding_ = false;
+#else
+    // An earlier frame may have left object tags behind, the gc would then
+    // mistake whatever happens to be in the slots for references.
+    std::fill(__local_types + (__locals_top - __locals),
+              __local_types + (__locals_top - __locals) + local_count,
+              OperandTypeCategory::primitive);
+#endif
+
+    frames.push_back(frame);
+
+    __fp = __locals_top;
+    __locals_top += local_count;
+
+    return true;
 }
 
 
 
-LocalTypes& local_types()
+static void pop_frame()
 {
-    return __local_types;
+    __locals_top = frames.back().locals_;
+    frames.pop_back();
+    __fp = frames.empty() ? nullptr : frames.back().locals_;
 }
 
 
 
+// Host code that keeps references on the operand stack while calling back into
+// the vm (e.g. make_string()), should put a HostFrame on the C++ stack first.
+// Everything that the host pushes above the frame will be treated as a
+// reference by the gc. Without type tags, the gc would otherwise interpret the
+// slots according to the calling method's reference map, which knows nothing
+// about the host's temporaries.
+struct HostFrame {
+    HostFrame()
+    {
+#if JVM_GC_REFERENCE_MAPS
+        if (not push_frame(nullptr, nullptr, 0, 0)) {
+            unhandled_error("call depth exceeded");
+        }
+#endif
+    }
+
+    ~HostFrame()
+    {
+#if JVM_GC_REFERENCE_MAPS
+        pop_frame();
+#endif
+    }
+};
+
+
+
 static void store_local(int index, void* value, OperandTypeCategory tp)
 {
-    __locals[(__locals.size() - 1) - index] = value;
-    __local_types[(__local_types.size() - 1) - index] = tp;
+    __fp[index] = value;
+#if JVM_GC_REFERENCE_MAPS
+    (void)tp;
+#else
+    __local_types[(__fp - __locals) + index] = tp;
+#endif
 }
 
 
 
 static void* load_local(int index)
 {
-    return __locals[(__locals.size() - 1) - index];
+    return __fp[index];
 }
 
 
 
 static void store_wide_local(int index, void* value)
 {
-    s32* words = (s32*)value;
+#if JVM_NATIVE_WIDE_SLOTS
+    // As on the operand stack, the value lives in the second slot. The first
+    // slot is never read, but with type tags, we still need to tell the gc
+    // that it isn't a reference.
+    memcpy(&__fp[index + 1], value, sizeof(s64));
+
+#if not JVM_GC_REFERENCE_MAPS
+    __local_types[(__fp - __locals) + index] =
+        OperandTypeCategory::primitive_wide;
+    __local_types[(__fp - __locals) + index + 1] =
+        OperandTypeCategory::primitive_wide;
+#endif
+
+#else
+    // NOTE: memcpy, rather than casting to s32*, which would violate strict
+    // aliasing rules (and does, in practice, break long arithmetic at -O2).
+    s32 words[2];
+    memcpy(words, value, sizeof words);
 
     store_local(
         index, (void*)(intptr_t)words[0], OperandTypeCategory::primitive_wide);
@@ -142,36 +331,23 @@ static void store_wide_local(int index, void* value)
     store_local(index + 1,
                 (void*)(intptr_t)words[1],
                 OperandTypeCategory::primitive_wide);
+#endif
 }
 
 
 
 static void load_wide_local(int index, void* result)
 {
-    s32* words = (s32*)result;
+#if JVM_NATIVE_WIDE_SLOTS
+    memcpy(result, &__fp[index + 1], sizeof(s64));
+#else
+    s32 words[2];
 
     words[0] = (s32)(intptr_t)load_local(index);
     words[1] = (s32)(intptr_t)load_local(index + 1);
-}
-
-
-
-static void alloc_locals(int count)
-{
-    for (int i = 0; i < count; ++i) {
-        __locals.push_back(nullptr);
-        __local_types.push_back(OperandTypeCategory::primitive);
-    }
-}
 
-
-
-static void free_locals(int count)
-{
-    for (int i = 0; i < count; ++i) {
-        __locals.pop_back();
-        __local_types.pop_back();
-    }
+    memcpy(result, words, sizeof words);
+#endif
 }
 
 
@@ -185,7 +361,11 @@ static void __push_operand_impl(void* value, OperandTypeCategory tp)
 #endif
 
     __operand_stack.push_back(value);
+#if JVM_GC_REFERENCE_MAPS
+    (void)tp;
+#else
     __operand_types.push_back(tp);
+#endif
 }
 
 
@@ -215,8 +395,9 @@ static void push_operand_i(s32 value)
 
 static void __push_operand_f_impl(float* value)
 {
-    __push_operand_impl((void*)(intptr_t) * (int*)value,
-                        OperandTypeCategory::primitive);
+    s32 bits;
+    memcpy(&bits, value, sizeof bits);
+    __push_operand_impl((void*)(intptr_t)bits, OperandTypeCategory::primitive);
 }
 
 
@@ -235,16 +416,11 @@ static void* load_operand(int offset)
 
 
 
-static OperandTypeCategory operand_type_category(int offset)
-{
-    return __operand_types[(__operand_types.size() - 1) - offset];
-}
-
-
-
 static float __load_operand_f_impl(void** val)
 {
-    return *(float*)val;
+    float result;
+    memcpy(&result, val, sizeof result);
+    return result;
 }
 
 
@@ -266,13 +442,23 @@ static s32 load_operand_i(int offset)
 
 static void push_wide_operand(void* value)
 {
-    s32* words = (s32*)value;
+#if JVM_NATIVE_WIDE_SLOTS
+    // The value lives in the top slot, the slot beneath it is padding.
+    void* slot;
+    memcpy(&slot, value, sizeof slot);
+
+    __push_operand_impl(nullptr, OperandTypeCategory::primitive_wide);
+    __push_operand_impl(slot, OperandTypeCategory::primitive_wide);
+#else
+    s32 words[2];
+    memcpy(words, value, sizeof words);
 
     __push_operand_impl((void*)(intptr_t)words[0],
                         OperandTypeCategory::primitive_wide);
 
     __push_operand_impl((void*)(intptr_t)words[1],
                         OperandTypeCategory::primitive_wide);
+#endif
 }
 
 
@@ -294,17 +480,63 @@ static void push_wide_operand_d(double value)
 static s64 load_wide_operand_l(int offset)
 {
     s64 result;
-    s32* words = (s32*)&result;
+
+#if JVM_NATIVE_WIDE_SLOTS
+    memcpy(&result,
+           &__operand_stack[(__operand_stack.size() - 1) - offset],
+           sizeof result);
+#else
+    s32 words[2];
     words[1] = load_operand_i(offset);
     words[0] = load_operand_i(offset + 1);
+
+    memcpy(&result, words, sizeof result);
+#endif
+
     return result;
 }
 
 
 
+// Overwrite a long or double already on the operand stack. Saves popping and
+// re-pushing two slots, when an instruction replaces one wide value with
+// another, e.g. ladd, after popping its right hand operand.
+static void store_wide_operand(int offset, void* value)
+{
+    auto slot = &__operand_stack[(__operand_stack.size() - 1) - offset];
+
+#if JVM_NATIVE_WIDE_SLOTS
+    memcpy(slot, value, sizeof(s64));
+#else
+    s32 words[2];
+    memcpy(words, value, sizeof words);
+
+    slot[0] = (void*)(intptr_t)words[1];
+    slot[-1] = (void*)(intptr_t)words[0];
+#endif
+}
+
+
+
+static void store_wide_operand_l(int offset, s64 value)
+{
+    store_wide_operand(offset, (void*)&value);
+}
+
+
+
+static void store_wide_operand_d(int offset, double value)
+{
+    store_wide_operand(offset, (void*)&value);
+}
+
+
+
 static double __load_wide_operand_d_impl(void* ptr)
 {
-    return *(double*)ptr;
+    double result;
+    memcpy(&result, ptr, sizeof result);
+    return result;
 }
 
 
@@ -325,8 +557,10 @@ static void dup(int offset)
     __operand_stack.push_back(
         __operand_stack[(__operand_stack.size() - 1) - offset]);
 
+#if not JVM_GC_REFERENCE_MAPS
     __operand_types.push_back(
         __operand_types[(__operand_types.size() - 1) - offset]);
+#endif
 }
 
 
@@ -336,8 +570,10 @@ static void dup_x1()
     auto v1 = __operand_stack.back();
     __operand_stack.insert(__operand_stack.end() - 2, v1);
 
+#if not JVM_GC_REFERENCE_MAPS
     auto tp = __operand_types.back();
     __operand_types.insert(__operand_types.end() - 2, tp);
+#endif
 }
 
 
@@ -349,8 +585,10 @@ static void dup_x2()
     auto v1 = __operand_stack.back();
     __operand_stack.insert(__operand_stack.end() - 3, v1);
 
+#if not JVM_GC_REFERENCE_MAPS
     auto tp = __operand_types.back();
     __operand_types.insert(__operand_types.end() - 3, tp);
+#endif
 }
 
 
@@ -376,6 +614,7 @@ static void dup2_x1()
         __operand_stack.insert(__operand_stack.end() - 3, v1);
     }
 
+#if not JVM_GC_REFERENCE_MAPS
     {
         auto v1 = *(__operand_types.end() - 2);
         __operand_types.insert(__operand_types.end() - 3, v1);
@@ -385,6 +624,7 @@ static void dup2_x1()
         auto v1 = *(__operand_types.end() - 1);
         __operand_types.insert(__operand_types.end() - 3, v1);
     }
+#endif
 }
 
 
@@ -449,6 +689,7 @@ static void dup2_x2()
         __operand_stack.insert(__operand_stack.end() - 4, v1);
     }
 
+#if not JVM_GC_REFERENCE_MAPS
     {
         auto v1 = *(__operand_types.end() - 2);
         __operand_types.insert(__operand_types.end() - 4, v1);
@@ -458,6 +699,7 @@ static void dup2_x2()
         auto v1 = *(__operand_types.end() - 1);
         __operand_types.insert(__operand_types.end() - 4, v1);
     }
+#endif
 }
 
 
@@ -514,8 +756,10 @@ static void swap()
     std::swap(__operand_stack[__operand_stack.size() - 1],
               __operand_stack[__operand_stack.size() - 2]);
 
+#if not JVM_GC_REFERENCE_MAPS
     std::swap(__operand_types[__operand_types.size() - 1],
               __operand_types[__operand_types.size() - 2]);
+#endif
 }
 
 
@@ -523,7 +767,18 @@ static void swap()
 static void pop_operand()
 {
     __operand_stack.pop_back();
+#if not JVM_GC_REFERENCE_MAPS
     __operand_types.pop_back();
+#endif
+}
+
+
+
+static void pop_operands(int count)
+{
+    for (int i = 0; i < count; ++i) {
+        pop_operand();
+    }
 }
 
 
@@ -731,6 +986,53 @@ struct Bytecode {
         jsr_w           = 0xc9,
         monitorenter    = 0xc2,
         monitorexit     = 0xc3,
+        wide            = 0xc4,
+
+        // Private opcodes, which never appear in classfiles. The interpreter
+        // writes them over instructions in a method's quickened code, after
+        // resolving the instruction's constant pool reference. See
+        // quicken_method().
+        getfield_quick   = 0xcb, // operand: SubstitutionField
+        getfield_quick_i = 0xcc, // operand: u16 field offset (native endian)
+        getfield_quick_a = 0xcd, // ...
+        getfield_quick_w = 0xce,
+        putfield_quick   = 0xcf, // operand: SubstitutionField
+        putfield_quick_i = 0xd0, // operand: u16 field offset (native endian)
+        putfield_quick_a = 0xd1, // ...
+        putfield_quick_w = 0xd2,
+        getstatic_quick  = 0xd3, // operand: u16 slot (native endian)
+        putstatic_quick  = 0xd4, // ...
+        ldc_quick        = 0xd5, // operand: u8 slot
+        ldc_w_quick      = 0xd6, // operand: u16 slot (native endian)
+        ldc2_w_quick     = 0xd7, // operand: u16 slot, value spans two slots
+
+        // Superinstructions, which replace the first opcode of a common
+        // instruction sequence. See fuse_superinstructions().
+        aload_0_getfield = 0xd8, // aload_0, getfield
+        iinc_goto        = 0xd9, // iinc, goto
+        iload_iload      = 0xda, // iload, iload, (iadd, istore)|if_icmp<cond>
+        iload_0_iload    = 0xdb, // ...
+        iload_1_iload    = 0xdc,
+        iload_2_iload    = 0xdd,
+        iload_3_iload    = 0xde,
+        aload_iload      = 0xdf, // aload, iload, iaload
+        aload_0_iload    = 0xe0, // ...
+        aload_1_iload    = 0xe1,
+        aload_2_iload    = 0xe2,
+        aload_3_iload    = 0xe3,
+
+        // Calls through an inline cache. See quicken_invoke().
+        invokevirtual_quick   = 0xe4, // operand: u16 inline cache (native endian)
+        invokeinterface_quick = 0xe5, // ..., followed by the count and zero bytes
+
+        // Calls through a bound Methodref. See quicken_direct_call().
+        invokestatic_quick    = 0xe6, // operand: u16 slot (native endian)
+        invokespecial_quick   = 0xe7, // ...
+
+        // Type checks against a resolved class, which remember the last class
+        // that passed. See quicken_type_check().
+        checkcast_quick       = 0xe8, // operand: u16 slot (native endian)
+        instanceof_quick      = 0xe9, // ...
     };
 };
 // clang-format on
@@ -741,9 +1043,36 @@ static void invoke_static_block(Class* clz);
 
 
 
-static Class* import_class(Slice classpath, const char* classfile_data)
+#if JVM_GC_REFERENCE_MAPS
+static void reserve_reference_map_scratch(Class* clz);
+#endif
+
+
+
+static Class*
+import_class(Slice classpath, Slice classfile, u32 classfile_crc32)
 {
-    if (auto clz = parse_classfile(classpath, classfile_data)) {
+    const image::ClassRecord* record = nullptr;
+
+#if JVM_PRELINKED_IMAGE
+    if (prelinked_image.ptr_) {
+        record = image::find(prelinked_image.ptr_,
+                             prelinked_image.length_,
+                             classpath,
+                             classfile.length_,
+                             classfile_crc32);
+    }
+#else
+    (void)classfile_crc32;
+#endif
+
+    if (auto clz = parse_classfile(classpath, classfile.ptr_, record)) {
+#if JVM_GC_REFERENCE_MAPS
+        reserve_reference_map_scratch(clz);
+#endif
+#if JVM_INTRINSICS
+        intrinsics::bind(clz, classpath);
+#endif
         invoke_static_block(clz);
         return clz;
     }
@@ -760,9 +1089,11 @@ Class* import(Slice classpath)
 
     auto current = jars;
     while (current) {
-        auto data = jar::load_classfile(current->jar_file_data_, classpath);
+        u32 crc32 = 0;
+        auto data = jar::load_classfile(
+            current->jar_file_data_, classpath, current->index_, &crc32);
         if (data.length_) {
-            return import_class(classpath, data.ptr_);
+            return import_class(classpath, data, crc32);
         }
         current = current->next_;
     }
@@ -783,213 +1114,2489 @@ using Exception = Object;
 
 
 
-static Exception*
-execute_bytecode(Class* clz,
-                 const u8* bytecode,
-                 const ClassFile::ExceptionTable* exception_table);
-
+// The interpreter reads instruction operands through one of the following
+// encodings. Classfile bytecode stores operands in big endian byte order, with
+// branch targets relative to the branch instruction. Predecoded code (see
+// predecode()) stores native endian operands, with absolute branch targets.
+struct ClassfileOperands {
+    static const bool predecoded = false;
 
+    static u16 u16_at(const u8* p)
+    {
+        return ((network_u16*)p)->get();
+    }
 
-static void pop_arguments(const ArgumentInfo& argc)
-{
-    for (int i = 0; i < argc.operand_count_; ++i) {
-        pop_operand();
+    static s16 s16_at(const u8* p)
+    {
+        return ((network_s16*)p)->get();
     }
-}
 
+    static s32 s32_at(const u8* p)
+    {
+        return ((network_s32*)p)->get();
+    }
 
+    // Target of a branch instruction at pc, with a two byte operand.
+    static u32 branch(const u8* bytecode, u32 pc)
+    {
+        return pc + s16_at(bytecode + pc + 1);
+    }
 
-// Move arguments from the operand stack into local variable slots in the stack
-// frame.
-static void
-bind_arguments(Object* self, const ArgumentInfo& argc, Slice type_signature)
-{
-    int local_param_index = 0;
-    int stack_load_index = argc.operand_count_ - 1;
-    if (self) {
-        store_local(local_param_index++, self, OperandTypeCategory::object);
-        stack_load_index--;
+    // Target of a branch instruction at pc, with a four byte operand.
+    static u32 branch_w(const u8* bytecode, u32 pc)
+    {
+        return pc + s32_at(bytecode + pc + 1);
     }
 
-    const char* str = type_signature.ptr_;
-    if (str) {
-        int i = 1;
-        while (true) {
-            switch (str[i]) {
-            default:
-                store_local(local_param_index,
-                            load_operand(stack_load_index--),
-                            OperandTypeCategory::primitive);
-                ++local_param_index;
-                ++i;
-                break;
+    // Target of a tableswitch/lookupswitch entry p, for a switch at pc.
+    static u32 switch_target(u32 pc, const u8* p)
+    {
+        return pc + s32_at(p);
+    }
+};
 
-            case 'J': {
-                auto l = load_wide_operand_l(stack_load_index - 1);
-                store_wide_local(local_param_index, &l);
-                local_param_index += 2;
-                stack_load_index -= 2;
-                ++i;
-                break;
-            }
 
-            case 'D': {
-                auto d = load_wide_operand_d(stack_load_index - 1);
-                store_wide_local(local_param_index, &d);
-                local_param_index += 2;
-                stack_load_index -= 2;
-                ++i;
-                break;
-            }
 
-            case '[':
-                ++i;
-                while (str[i] == '[') {
-                    ++i;
-                }
-                if (str[i] not_eq 'L') {
-                    // We're a primitive array. Only one character follows the
-                    // first one.
-                    ++i;
-                    store_local(local_param_index,
-                                load_operand(stack_load_index--),
-                                OperandTypeCategory::object);
-                    ++local_param_index;
-                    break;
-                }
-                goto OBJECT; // Intentional fallthrough. We started parsing an
-                             // array, only to find that it's an array of
-                             // objects. Continue parsing in the next case for
-                             // 'L'.
+struct PredecodedOperands {
+    static const bool predecoded = true;
 
+    template <typename T> static T native_at(const u8* p)
+    {
+        T result;
+        memcpy(&result, p, sizeof result);
+        return result;
+    }
 
-            OBJECT:
-            case 'L':
-                store_local(local_param_index,
-                            load_operand(stack_load_index--),
-                            OperandTypeCategory::object);
-                ++local_param_index;
-                while (str[i] not_eq ';') {
-                    ++i;
-                }
-                ++i;
-                break;
+    static u16 u16_at(const u8* p)
+    {
+        return native_at<u16>(p);
+    }
 
-            case ')':
-                // We've moved all of the arguments from the operand stack to
-                // the stack frame, now we can pop the arguments off of the
-                // operand stack.
-                pop_arguments(argc);
-                return;
-            }
-        }
+    static s16 s16_at(const u8* p)
+    {
+        return native_at<s16>(p);
     }
-}
 
+    static s32 s32_at(const u8* p)
+    {
+        return native_at<s32>(p);
+    }
 
+    static u32 branch(const u8* bytecode, u32 pc)
+    {
+        return native_at<u16>(bytecode + pc + 1);
+    }
 
-static Exception* make_exception(const char* classpath, const char* error);
-Exception* TODO_throw_proper_exception();
+    static u32 branch_w(const u8* bytecode, u32 pc)
+    {
+        return native_at<u32>(bytecode + pc + 1);
+    }
 
+    static u32 switch_target(u32, const u8* p)
+    {
+        return native_at<u32>(p);
+    }
+};
 
 
-static Exception* invoke_method(Class* clz,
-                                Object* self,
-                                const ClassFile::MethodInfo* method,
-                                const ArgumentInfo& argc = ArgumentInfo{},
-                                Slice type_signature = Slice(nullptr, 0))
-{
-    for (int i = 0; i < method->attributes_count_.get(); ++i) {
-        auto attr = (ClassFile::AttributeInfo*)((const char*)method +
-                                                sizeof(ClassFile::MethodInfo));
 
+template <typename Operands>
+static Exception*
+execute_bytecode(Class* clz,
+                 const u8* bytecode,
+                 const ClassFile::ExceptionTable* exception_table,
+                 Class::OptionQuickenedCode* quick);
 
-        if (attr->attribute_name_index_.get() == jni::magic and
-            attr->attribute_length_.get() == jni::magic) {
 
-            alloc_locals(argc.operand_count_);
 
-#if JVM_USE_CALLSTACK
-            callstack.push_back({clz, method});
-#endif
+// Move arguments (including self) from the operand stack into the first local
+// variable slots of the innermost frame. Locals use the same slot layout as
+// the operand stack, longs and doubles included, so we copy the slots as they
+// are. With type tags, the tags come along too: the operand stack already
+// knows which slots hold references.
+static void bind_arguments(const ArgumentInfo& argc)
+{
+    const auto count = argc.operand_count_;
 
-            bind_arguments(self, argc, type_signature);
-            ((jni::MethodStub*)method)->implementation_();
+    std::copy(__operand_stack.end() - count, __operand_stack.end(), __fp);
 
-#if JVM_USE_CALLSTACK
-            callstack.pop_back();
+#if not JVM_GC_REFERENCE_MAPS
+    std::copy(__operand_types.end() - count,
+              __operand_types.end(),
+              __local_types + (__fp - __locals));
 #endif
 
-            free_locals(argc.operand_count_);
+    pop_operands(count);
+}
 
-            return nullptr;
 
-        } else if (clz->constants_->load_string(
-                       attr->attribute_name_index_.get()) ==
-                   Slice::from_c_str("Code")) {
 
-            auto bytecode =
-                ((const u8*)attr) + sizeof(ClassFile::AttributeCode);
+static Exception* make_exception(const char* classpath, const char* error);
+Exception* TODO_throw_proper_exception();
 
-            auto exception_table =
-                (const ClassFile::ExceptionTable*)(bytecode +
-                                                   ((ClassFile::AttributeCode*)
-                                                        attr)
-                                                       ->code_length_.get());
 
-            const auto local_count =
-                std::max(((ClassFile::AttributeCode*)attr)->max_locals_.get(),
-                         (u16)4); // Why a min of four? istore_0-3, so there
-                                  // must be at least four slots.
 
-            alloc_locals(local_count);
+#if JVM_QUICKEN_BYTECODE or JVM_GC_REFERENCE_MAPS
+// The length of the instruction at pc, including operands.
+static u32 instruction_length(const u8* bytecode, u32 pc)
+{
+    switch (bytecode[pc]) {
+    case Bytecode::tableswitch: {
+        u32 i = pc + 1;
+        if (i % 4 not_eq 0) {
+            i += 4 - i % 4;
+        }
+        const auto low = ((network_s32*)(bytecode + i + 4))->get();
+        const auto high = ((network_s32*)(bytecode + i + 8))->get();
+        return (i - pc) + 12 + 4 * (high - low + 1);
+    }
 
-#if JVM_USE_CALLSTACK
-            callstack.push_back({clz, method});
-#endif
+    case Bytecode::lookupswitch: {
+        u32 i = pc + 1;
+        if (i % 4 not_eq 0) {
+            i += 4 - i % 4;
+        }
+        const auto npairs = ((network_s32*)(bytecode + i + 4))->get();
+        return (i - pc) + 8 + 8 * npairs;
+    }
 
-            bind_arguments(self, argc, type_signature);
-            auto exn = execute_bytecode(clz, bytecode, exception_table);
+    case Bytecode::wide:
+        return bytecode[pc + 1] == Bytecode::iinc ? 6 : 4;
+
+    case Bytecode::bipush:
+    case Bytecode::ldc:
+    case Bytecode::ldc_quick:
+    case Bytecode::newarray:
+    case Bytecode::ret:
+    case Bytecode::iload:
+    case Bytecode::lload:
+    case Bytecode::fload:
+    case Bytecode::dload:
+    case Bytecode::aload:
+    case Bytecode::istore:
+    case Bytecode::lstore:
+    case Bytecode::fstore:
+    case Bytecode::dstore:
+    case Bytecode::astore:
+    case Bytecode::iload_iload:
+    case Bytecode::aload_iload:
+        return 2;
+
+    case Bytecode::sipush:
+    case Bytecode::ldc_w:
+    case Bytecode::ldc2_w:
+    case Bytecode::ldc_w_quick:
+    case Bytecode::ldc2_w_quick:
+    case Bytecode::iinc:
+    case Bytecode::iinc_goto:
+    case Bytecode::getstatic:
+    case Bytecode::putstatic:
+    case Bytecode::getstatic_quick:
+    case Bytecode::putstatic_quick:
+    case Bytecode::getfield:
+    case Bytecode::putfield:
+    case Bytecode::getfield_quick:
+    case Bytecode::getfield_quick_i:
+    case Bytecode::getfield_quick_a:
+    case Bytecode::getfield_quick_w:
+    case Bytecode::putfield_quick:
+    case Bytecode::putfield_quick_i:
+    case Bytecode::putfield_quick_a:
+    case Bytecode::putfield_quick_w:
+    case Bytecode::invokevirtual:
+    case Bytecode::invokespecial:
+    case Bytecode::invokestatic:
+    case Bytecode::invokevirtual_quick:
+    case Bytecode::invokestatic_quick:
+    case Bytecode::invokespecial_quick:
+    case Bytecode::new_inst:
+    case Bytecode::anewarray:
+    case Bytecode::checkcast:
+    case Bytecode::instanceof:
+    case Bytecode::checkcast_quick:
+    case Bytecode::instanceof_quick:
+    case Bytecode::if_acmpeq:
+    case Bytecode::if_acmpne:
+    case Bytecode::if_icmpeq:
+    case Bytecode::if_icmpne:
+    case Bytecode::if_icmplt:
+    case Bytecode::if_icmpge:
+    case Bytecode::if_icmpgt:
+    case Bytecode::if_icmple:
+    case Bytecode::if_eq:
+    case Bytecode::if_ne:
+    case Bytecode::if_lt:
+    case Bytecode::if_ge:
+    case Bytecode::if_gt:
+    case Bytecode::if_le:
+    case Bytecode::if_null:
+    case Bytecode::if_nonnull:
+    case Bytecode::__goto:
+    case Bytecode::jsr:
+        return 3;
+
+    case Bytecode::multianewarray:
+        return 4;
+
+    case Bytecode::invokeinterface:
+    case Bytecode::invokeinterface_quick:
+    case Bytecode::invokedynamic:
+    case Bytecode::__goto_w:
+    case Bytecode::jsr_w:
+        return 5;
 
-#if JVM_USE_CALLSTACK
-            callstack.pop_back();
+    default:
+        return 1;
+    }
+}
 #endif
 
-            free_locals(local_count);
 
-            return exn;
-        }
-    }
 
-    return make_exception("java/lang/RuntimeException",
-                          "failed to invoke method");
-}
+#if JVM_QUICKEN_BYTECODE
+// Class memory consumed by quickened code, see JVM_QUICKENED_CODE_BUDGET.
+static u32 quickened_code_bytes JVM_SNAPSHOT_STATE = 0;
+#endif
 
 
 
-Class* load_class_by_name(Slice class_name)
+#if JVM_PREDECODE_BYTECODE
+template <typename T> static void store_native(u8* p, T value)
 {
-    if (auto entry = classtable::load(class_name)) {
-        return entry;
-    }
-
-    if (auto clz = import(class_name)) {
-        return clz;
-    } else {
-        StringBuffer<80> buffer = "missing class: ";
-        for (u32 i = 0; i < class_name.length_; ++i) {
-            buffer.push_back(class_name.ptr_[i]);
-        }
-        unhandled_error(buffer.c_str());
-    }
+    memcpy(p, &value, sizeof value);
 }
 
 
 
-static Slice classname(Class* current_module, u16 class_index)
+// Rewrite the operands in a copy of a method's bytecode into the encoding
+// expected by PredecodedOperands: native byte order, with absolute branch
+// targets. Instructions keep their offsets and lengths, so pcs in predecoded
+// code are also valid bytecode pcs, and exception tables, line number tables,
+// and debugger locations all apply unchanged. The copy must be allocated with
+// four byte alignment, like the original code, for the switch tables to stay
+// aligned.
+static void predecode(u8* code, const u8* bytecode, u32 code_length)
 {
-    auto c_clz =
-        (const ClassFile::ConstantClass*)current_module->constants_->load(
+    for (u32 pc = 0; pc < code_length;
+         pc += instruction_length(bytecode, pc)) {
+
+        switch (bytecode[pc]) {
+        case Bytecode::sipush:
+            store_native(code + pc + 1,
+                         ClassfileOperands::s16_at(bytecode + pc + 1));
+            break;
+
+        case Bytecode::ldc_w:
+        case Bytecode::ldc2_w:
+        case Bytecode::getstatic:
+        case Bytecode::putstatic:
+        case Bytecode::getfield:
+        case Bytecode::putfield:
+        case Bytecode::invokevirtual:
+        case Bytecode::invokespecial:
+        case Bytecode::invokestatic:
+        case Bytecode::invokeinterface:
+        case Bytecode::invokedynamic:
+        case Bytecode::new_inst:
+        case Bytecode::anewarray:
+        case Bytecode::multianewarray:
+        case Bytecode::checkcast:
+        case Bytecode::instanceof:
+            store_native(code + pc + 1,
+                         ClassfileOperands::u16_at(bytecode + pc + 1));
+            break;
+
+        case Bytecode::if_acmpeq:
+        case Bytecode::if_acmpne:
+        case Bytecode::if_icmpeq:
+        case Bytecode::if_icmpne:
+        case Bytecode::if_icmplt:
+        case Bytecode::if_icmpge:
+        case Bytecode::if_icmpgt:
+        case Bytecode::if_icmple:
+        case Bytecode::if_eq:
+        case Bytecode::if_ne:
+        case Bytecode::if_lt:
+        case Bytecode::if_ge:
+        case Bytecode::if_gt:
+        case Bytecode::if_le:
+        case Bytecode::if_null:
+        case Bytecode::if_nonnull:
+        case Bytecode::__goto:
+        case Bytecode::jsr:
+            // The code attribute is limited to 65535 bytes, so an absolute
+            // target fits in the two operand bytes.
+            store_native(code + pc + 1,
+                         (u16)ClassfileOperands::branch(bytecode, pc));
+            break;
+
+        case Bytecode::__goto_w:
+        case Bytecode::jsr_w:
+            store_native(code + pc + 1,
+                         ClassfileOperands::branch_w(bytecode, pc));
+            break;
+
+        case Bytecode::tableswitch:
+        case Bytecode::lookupswitch: {
+            u32 i = pc + 1;
+            if (i % 4 not_eq 0) {
+                i += 4 - i % 4;
+            }
+
+            auto target = [&](u32 offset) {
+                store_native(
+                    code + offset,
+                    ClassfileOperands::switch_target(pc, bytecode + offset));
+            };
+
+            auto value = [&](u32 offset) {
+                store_native(code + offset,
+                             ClassfileOperands::s32_at(bytecode + offset));
+            };
+
+            target(i);
+
+            if (bytecode[pc] == Bytecode::tableswitch) {
+                const auto low = ClassfileOperands::s32_at(bytecode + i + 4);
+                const auto high = ClassfileOperands::s32_at(bytecode + i + 8);
+                value(i + 4);
+                value(i + 8);
+                for (s32 j = 0; j < high - low + 1; ++j) {
+                    target(i + 12 + j * 4);
+                }
+            } else {
+                const auto npairs =
+                    ClassfileOperands::s32_at(bytecode + i + 4);
+                value(i + 4);
+                for (s32 j = 0; j < npairs; ++j) {
+                    value(i + 8 + j * 8);
+                    target(i + 8 + j * 8 + 4);
+                }
+            }
+            break;
+        }
+        }
+    }
+}
+#endif // JVM_PREDECODE_BYTECODE
+
+
+
+// The local variable index of the access at p, e.g. iload <n> or iload_0-3.
+// Advances p to the next instruction.
+static u8 local_index(const u8* bytecode, u32& p, u8 op, u8 op_0)
+{
+    if (bytecode[p] == op) {
+        p += 2;
+        return bytecode[p - 1];
+    }
+    return bytecode[p++] - op_0;
+}
+
+
+
+#if JVM_SUPERINSTRUCTIONS
+// Whether the instruction at p is one of the forms of a local variable
+// access, e.g. iload <n> or iload_0-3.
+static bool is_local_access(const u8* bytecode, u32 p, u8 op, u8 op_0)
+{
+    return bytecode[p] == op or
+           (bytecode[p] >= op_0 and bytecode[p] <= op_0 + 3);
+}
+
+
+
+// The superinstruction for the sequence starting at pc, if any.
+static u8 superinstruction(const u8* bytecode, u32 code_length, u32 pc)
+{
+    const u8 op = bytecode[pc];
+    const u32 second = pc + instruction_length(bytecode, pc);
+
+    if (second >= code_length) {
+        return Bytecode::nop;
+    }
+
+    if (op == Bytecode::aload_0 and bytecode[second] == Bytecode::getfield) {
+        return Bytecode::aload_0_getfield;
+    }
+
+    if (op == Bytecode::iinc and bytecode[second] == Bytecode::__goto) {
+        return Bytecode::iinc_goto;
+    }
+
+    if (not is_local_access(
+            bytecode, second, Bytecode::iload, Bytecode::iload_0)) {
+        return Bytecode::nop;
+    }
+
+    const u32 third = second + instruction_length(bytecode, second);
+
+    if (third >= code_length) {
+        return Bytecode::nop;
+    }
+
+    // NOTE: the superinstructions for the short forms of aload and iload are
+    // numbered in the same order as aload_0-3 and iload_0-3.
+
+    if (is_local_access(bytecode, pc, Bytecode::aload, Bytecode::aload_0) and
+        bytecode[third] == Bytecode::iaload) {
+        if (op == Bytecode::aload) {
+            return Bytecode::aload_iload;
+        }
+        return Bytecode::aload_0_iload + (op - Bytecode::aload_0);
+    }
+
+    if (is_local_access(bytecode, pc, Bytecode::iload, Bytecode::iload_0)) {
+        switch (bytecode[third]) {
+        case Bytecode::iadd:
+            if (third + 1 >= code_length or
+                not is_local_access(bytecode,
+                                    third + 1,
+                                    Bytecode::istore,
+                                    Bytecode::istore_0)) {
+                return Bytecode::nop;
+            }
+            break;
+
+        case Bytecode::if_icmpeq:
+        case Bytecode::if_icmpne:
+        case Bytecode::if_icmplt:
+        case Bytecode::if_icmpge:
+        case Bytecode::if_icmpgt:
+        case Bytecode::if_icmple:
+            break;
+
+        default:
+            return Bytecode::nop;
+        }
+
+        if (op == Bytecode::iload) {
+            return Bytecode::iload_iload;
+        }
+        return Bytecode::iload_0_iload + (op - Bytecode::iload_0);
+    }
+
+    return Bytecode::nop;
+}
+
+
+
+// javac emits a handful of instruction sequences over and over again, e.g.
+// aload_0, getfield for reading a field of this, or iload, iload, if_icmpge
+// in a for loop (tools/opcodeStats.cpp counts them). For each such sequence in
+// a method's quickened code, we replace the sequence's first opcode with a
+// superinstruction, whose handler runs the whole sequence with a single
+// dispatch, without moving values through the operand stack. Only the first
+// opcode changes. The rest of the sequence stays in place, and the handler
+// reads the operands from there, so branching into the middle of a sequence
+// still works.
+static void fuse_superinstructions(u8* code, const u8* bytecode, u32 length)
+{
+    for (u32 pc = 0; pc < length; pc += instruction_length(bytecode, pc)) {
+        const u8 fused = superinstruction(bytecode, length, pc);
+        if (fused not_eq Bytecode::nop) {
+            code[pc] = fused;
+        }
+    }
+}
+#endif // JVM_SUPERINSTRUCTIONS
+
+
+
+#if JVM_QUICKEN_BYTECODE
+// Quickening: the first time that the interpreter executes a field access or
+// a constant pool load in a method's quickened code, it resolves the
+// instruction, and overwrites it with a private quick opcode that carries the
+// resolved result (a field offset, or an index into the method's slot
+// table). Subsequent executions skip the constant pool entirely. The quick
+// instructions have the same lengths as the originals, so branch offsets and
+// exception tables remain valid. Virtual and interface calls get an inline
+// cache, see quicken_invoke().
+static Class::OptionQuickenedCode*
+quicken_method(Class* clz,
+               const ClassFile::MethodInfo* method,
+               const ClassFile::AttributeCode* code)
+{
+    if (auto existing = clz->lookup_quickened_code(method)) {
+        return existing;
+    }
+
+    auto bytecode = ((const u8*)code) + sizeof(ClassFile::AttributeCode);
+    const auto code_length = code->code_length_.get();
+
+    bool quickenable = false;
+    u32 slot_capacity = 0;
+#if JVM_INLINE_CACHES
+    u32 inline_cache_capacity = 0;
+#endif
+
+    for (u32 pc = 0; pc < code_length;
+         pc += instruction_length(bytecode, pc)) {
+        switch (bytecode[pc]) {
+        case Bytecode::getfield:
+        case Bytecode::putfield:
+            quickenable = true;
+            break;
+
+        case Bytecode::ldc2_w:
+            quickenable = true;
+            slot_capacity += 2;
+            break;
+
+        case Bytecode::ldc:
+        case Bytecode::ldc_w:
+        case Bytecode::getstatic:
+        case Bytecode::putstatic:
+            quickenable = true;
+            slot_capacity += 1;
+            break;
+
+#if JVM_INLINE_CACHES
+        case Bytecode::invokevirtual:
+        case Bytecode::invokeinterface:
+            quickenable = true;
+            inline_cache_capacity += 1;
+            break;
+#endif
+
+#if JVM_RESOLVED_METHODS
+        case Bytecode::invokestatic:
+        case Bytecode::invokespecial:
+            quickenable = true;
+            slot_capacity += 1;
+            break;
+#endif
+
+#if JVM_SUBTYPE_DISPLAY
+        case Bytecode::checkcast:
+        case Bytecode::instanceof:
+            quickenable = true;
+            slot_capacity += 2;
+            break;
+#endif
+        }
+
+#if JVM_SUPERINSTRUCTIONS
+        if (superinstruction(bytecode, code_length, pc) not_eq Bytecode::nop) {
+            quickenable = true;
+        }
+#endif
+    }
+
+#if JVM_PREDECODE_BYTECODE
+    // Predecoded code benefits every method, not just ones with instructions
+    // to quicken.
+    quickenable = true;
+#endif
+
+    // Slot indices need to fit in a u16 operand. Instructions without a slot
+    // simply stay unquickened.
+    slot_capacity = std::min(slot_capacity, (u32)0xffff);
+
+    u32 cost =
+        code_length + sizeof(Class::OptionQuickenedCode::Slot) * slot_capacity;
+
+#if JVM_INLINE_CACHES
+    inline_cache_capacity = std::min(inline_cache_capacity, (u32)0xffff);
+
+    cost += sizeof(Class::OptionQuickenedCode::InlineCache) *
+            inline_cache_capacity;
+#endif
+
+    if (quickened_code_bytes + cost > JVM_QUICKENED_CODE_BUDGET) {
+        // Over budget. The method will run from the classfile's bytecode.
+        quickenable = false;
+    }
+
+    auto quick =
+        classmemory::allocate<Class::OptionQuickenedCode>(method);
+
+    if (quickenable) {
+        quickened_code_bytes += cost;
+
+        quick->code_ = (u8*)classmemory::allocate(code_length, 4);
+        quick->code_length_ = code_length;
+        memcpy(quick->code_, bytecode, code_length);
+
+#if JVM_PREDECODE_BYTECODE
+        predecode(quick->code_, bytecode, code_length);
+#endif
+
+#if JVM_SUPERINSTRUCTIONS
+        fuse_superinstructions(quick->code_, bytecode, code_length);
+#endif
+
+        if (slot_capacity) {
+            quick->slots_ = (Class::OptionQuickenedCode::Slot*)
+                classmemory::allocate(
+                    sizeof(Class::OptionQuickenedCode::Slot) * slot_capacity,
+                    alignof(Class::OptionQuickenedCode::Slot));
+            quick->slot_capacity_ = slot_capacity;
+        }
+
+#if JVM_INLINE_CACHES
+        if (inline_cache_capacity) {
+            quick->inline_caches_ = (Class::OptionQuickenedCode::InlineCache*)
+                classmemory::allocate(
+                    sizeof(Class::OptionQuickenedCode::InlineCache) *
+                        inline_cache_capacity,
+                    alignof(Class::OptionQuickenedCode::InlineCache));
+            quick->inline_cache_capacity_ = inline_cache_capacity;
+        }
+#endif
+    }
+
+    clz->bind_quickened_code(quick);
+
+    return quick;
+}
+#endif // JVM_QUICKEN_BYTECODE
+
+
+
+static void load_static(Class::OptionStaticField* field)
+{
+    if (field->is_object_) {
+        Object* obj;
+        memcpy(&obj, field->data(), sizeof(Object*));
+        push_operand_a(*obj);
+        return;
+    }
+
+    switch (field->field_size_) {
+    case 1: {
+        u8 val = *field->data();
+        push_operand_i(val);
+        break;
+    }
+    case 2: {
+        s16 val;
+        memcpy(&val, field->data(), 2);
+        push_operand_i(val);
+        break;
+    }
+    case 4: {
+        s32 val;
+        memcpy(&val, field->data(), 4);
+        push_operand_i(val);
+        break;
+    }
+    case 8: {
+        s64 val;
+        memcpy(&val, field->data(), 8);
+        push_wide_operand_l(val);
+        break;
+    }
+    }
+}
+
+
+
+static void store_static(Class::OptionStaticField* field)
+{
+    if (field->is_object_) {
+        auto val = load_operand(0);
+        pop_operand();
+        memcpy(field->data(), &val, sizeof val);
+        return;
+    }
+
+    switch (field->field_size_) {
+    case 1: {
+        *field->data() = (u8)load_operand_i(0);
+        pop_operand();
+        break;
+    }
+    case 2: {
+        s16 val = load_operand_i(0);
+        pop_operand();
+        memcpy(field->data(), &val, 2);
+        break;
+    }
+    case 4: {
+        s32 val = load_operand_i(0);
+        pop_operand();
+        memcpy(field->data(), &val, 4);
+        break;
+    }
+    case 8: {
+        s64 val = load_wide_operand_l(0);
+        pop_operand();
+        pop_operand();
+        memcpy(field->data(), &val, 8);
+        break;
+    }
+    }
+}
+
+
+
+static void write_quick_operand(u8* code, u32 pc, u16 value)
+{
+    memcpy(code + pc + 1, &value, sizeof value);
+}
+
+
+
+static u16 read_quick_operand(const u8* code, u32 pc)
+{
+    u16 value;
+    memcpy(&value, code + pc + 1, sizeof value);
+    return value;
+}
+
+
+
+// Links a Fieldref constant the first time that it runs. Loading the field's
+// class may run the gc, so call before taking objects off of the operand stack.
+static SubstitutionField resolve_instance_field(Class* clz, u16 index)
+{
+    const auto sub = resolve_field(clz, index);
+
+    if (not sub.valid_) {
+        unhandled_error("missing field");
+    }
+
+    return sub;
+}
+
+
+
+static void quicken_field_access(Class* clz, u8* code, u32 pc, u16 index)
+{
+    const auto sub = resolve_instance_field(clz, index);
+
+    const bool get = code[pc] == Bytecode::getfield;
+
+    if (sub.object_) {
+        code[pc] =
+            get ? Bytecode::getfield_quick_a : Bytecode::putfield_quick_a;
+        write_quick_operand(code, pc, sub.offset_);
+    } else if (sub.size_ == SubstitutionField::b4) {
+        code[pc] =
+            get ? Bytecode::getfield_quick_i : Bytecode::putfield_quick_i;
+        write_quick_operand(code, pc, sub.offset_);
+    } else if (sub.size_ == SubstitutionField::b8) {
+        code[pc] =
+            get ? Bytecode::getfield_quick_w : Bytecode::putfield_quick_w;
+        write_quick_operand(code, pc, sub.offset_);
+    } else {
+        code[pc] = get ? Bytecode::getfield_quick : Bytecode::putfield_quick;
+        memcpy(code + pc + 1, &sub, sizeof sub);
+    }
+}
+
+
+
+static bool quicken_static_access(Class* clz,
+                                  Class::OptionQuickenedCode* quick,
+                                  u32 pc,
+                                  u16 index)
+{
+    if (quick->slot_count_ == quick->slot_capacity_) {
+        return false;
+    }
+
+    auto code = quick->code_;
+
+    auto field = clz->lookup_static(index);
+    if (field == nullptr) {
+        return false;
+    }
+
+    const u16 slot = quick->slot_count_++;
+    quick->slots_[slot].static_field_ = field;
+
+    code[pc] = code[pc] == Bytecode::getstatic ? Bytecode::getstatic_quick
+                                               : Bytecode::putstatic_quick;
+    write_quick_operand(code, pc, slot);
+
+    return true;
+}
+
+
+
+static bool
+quicken_ldc(Class* clz, Class::OptionQuickenedCode* quick, u32 pc, u16 index)
+{
+    auto code = quick->code_;
+
+    const bool wide_index = code[pc] not_eq Bytecode::ldc;
+
+    auto c = clz->constants_->load(index);
+
+    switch (c->tag_) {
+    case ClassFile::ConstantType::t_float:
+    case ClassFile::ConstantType::t_integer: {
+        if (quick->slot_count_ == quick->slot_capacity_) {
+            return false;
+        }
+
+        const u16 slot = quick->slot_count_;
+
+        if (not wide_index and slot > 255) {
+            return false;
+        }
+
+        ++quick->slot_count_;
+
+        // Floats and ints both occupy a single operand stack slot, and carry
+        // their raw bits, so we don't need to distinguish between the two.
+        const u32 bits = ((ClassFile::ConstantInteger*)c)->value_.get();
+        memcpy(&quick->slots_[slot].value_, &bits, sizeof bits);
+
+        if (wide_index) {
+            code[pc] = Bytecode::ldc_w_quick;
+            write_quick_operand(code, pc, slot);
+        } else {
+            code[pc] = Bytecode::ldc_quick;
+            code[pc + 1] = slot;
+        }
+        return true;
+    }
+
+    case ClassFile::ConstantType::t_double:
+    case ClassFile::ConstantType::t_long: {
+        if (quick->slot_capacity_ - quick->slot_count_ < 2) {
+            return false;
+        }
+
+        const u16 slot = quick->slot_count_;
+        quick->slot_count_ += 2;
+
+        const u64 bits = ((ClassFile::ConstantLong*)c)->value_.get();
+        s32 words[2];
+        memcpy(words, &bits, sizeof words);
+        quick->slots_[slot].value_ = words[0];
+        quick->slots_[slot + 1].value_ = words[1];
+
+        code[pc] = Bytecode::ldc2_w_quick;
+        write_quick_operand(code, pc, slot);
+        return true;
+    }
+
+    default:
+        // Strings create a new instance on each ldc, and remain unquickened.
+        return false;
+    }
+}
+
+
+
+#if JVM_RESOLVED_METHODS
+// After an invokestatic or invokespecial has bound its Methodref, put the
+// SubstitutionMethod in a slot, so that the call skips the constant pool
+// altogether.
+static void quicken_direct_call(Class* clz,
+                                Class::OptionQuickenedCode* quick,
+                                u32 pc,
+                                u16 method_index)
+{
+    if (quick->slot_count_ == quick->slot_capacity_) {
+        return;
+    }
+
+    auto sub = clz->constants_->load_method(method_index);
+    if (sub == nullptr) {
+        return;
+    }
+
+    const u16 slot = quick->slot_count_++;
+    quick->slots_[slot].method_ = sub;
+
+    auto code = quick->code_;
+
+    code[pc] = code[pc] == Bytecode::invokestatic
+                   ? Bytecode::invokestatic_quick
+                   : Bytecode::invokespecial_quick;
+
+    write_quick_operand(code, pc, slot);
+}
+#endif
+
+
+
+#if JVM_SUBTYPE_DISPLAY
+// Once a checkcast or instanceof has loaded the class that it tests against,
+// put the class in a slot, followed by a slot for the last class that passed
+// the test. Casts in collection code, for instance, tend to see the same class
+// over and over.
+static void quicken_type_check(Class::OptionQuickenedCode* quick,
+                               u32 pc,
+                               Slice class_name)
+{
+    if (quick->slot_capacity_ - quick->slot_count_ < 2) {
+        return;
+    }
+
+    if (class_name.length_ == 0 or class_name.ptr_[0] == '[') {
+        // Array types have no class to test against, see checkcast().
+        return;
+    }
+
+    auto target = load_class_by_name(class_name);
+    if (target == nullptr or not target->link_subtypes()) {
+        return;
+    }
+
+    const u16 slot = quick->slot_count_;
+    quick->slot_count_ += 2;
+
+    quick->slots_[slot].class_ = target;
+    quick->slots_[slot + 1].class_ = nullptr;
+
+    auto code = quick->code_;
+
+    code[pc] = code[pc] == Bytecode::checkcast ? Bytecode::checkcast_quick
+                                               : Bytecode::instanceof_quick;
+
+    write_quick_operand(code, pc, slot);
+}
+#endif
+
+
+
+#if JVM_GC_REFERENCE_MAPS
+
+
+
+// Without type tags on the operand stack and in local variables, the gc works
+// out which slots in a stack frame hold references by abstract interpretation
+// of the frame's bytecode, up to the frame's current pc. We only care about
+// whether a slot holds a reference, so this is much simpler than what a
+// bytecode verifier does.
+//
+// Merging the types that flow into a branch target is a bitwise or. A slot that
+// holds a reference along one path, and a primitive along another, must be
+// dead, as verified bytecode could not read from it, so the gc ignores it.
+enum SlotType : u8 {
+    slot_unset = 0,
+    slot_primitive = 1,
+    slot_reference = 2,
+    slot_conflict = 3,
+};
+
+
+
+alignas(u16) static u8
+    reference_map_default_scratch[JVM_GC_REFERENCE_MAP_SCRATCH];
+
+
+// Grows when we load a class with a method that needs more, see
+// reserve_reference_map_scratch(). The gc must not allocate.
+static u8* reference_map_scratch JVM_SNAPSHOT_STATE =
+    reference_map_default_scratch;
+static u32 reference_map_scratch_size JVM_SNAPSHOT_STATE =
+    JVM_GC_REFERENCE_MAP_SCRATCH;
+
+
+
+// NOTE: Results live in a shared scratch buffer, so only one ReferenceMap may
+// exist at a time. The gc is not reentrant, so that's fine.
+class ReferenceMap {
+public:
+    ReferenceMap(Class* clz,
+                 const ClassFile::MethodInfo* method,
+                 const ClassFile::AttributeCode* code,
+                 u32 pc)
+        : clz_(clz), method_(method),
+          code_((const u8*)code + sizeof(ClassFile::AttributeCode)),
+          code_length_(code->code_length_.get()),
+          exception_table_(
+              (const ClassFile::ExceptionTable*)(code_ + code_length_)),
+          local_count_(code->max_locals_.get()),
+          width_(2 + local_count_ + code->max_stack_.get())
+    {
+        find_leaders();
+
+        entry_state(state(0));
+
+        do {
+            changed_ = false;
+            run(code_length_);
+        } while (changed_);
+
+        if (not run(pc)) {
+            unhandled_error("reference map: unreachable pc");
+        }
+    }
+
+
+    u16 local_count() const
+    {
+        return local_count_;
+    }
+
+
+    u16 depth() const
+    {
+        return depth(current_);
+    }
+
+
+    bool local_is_reference(int index) const
+    {
+        return current_[2 + index] == slot_reference;
+    }
+
+
+    bool operand_is_reference(int index) const
+    {
+        return current_[2 + local_count_ + index] == slot_reference;
+    }
+
+
+    // The most scratch memory that a reference map for the code may need: a
+    // leader and a state for each basic block (counting each branch target
+    // once per branch), plus the current state. See find_leaders().
+    static u32 scratch_size(const ClassFile::AttributeCode* code)
+    {
+        auto bytecode = (const u8*)code + sizeof(ClassFile::AttributeCode);
+        const u32 code_length = code->code_length_.get();
+        auto exception_table =
+            (const ClassFile::ExceptionTable*)(bytecode + code_length);
+
+        u32 leaders = 1 + exception_table->exception_table_length_.get();
+
+        for (u32 pc = 0; pc < code_length;
+             pc += instruction_length(bytecode, pc)) {
+            visit_branch_targets(bytecode, pc, [&](u32) { ++leaders; });
+        }
+
+        const u32 width =
+            2 + code->max_locals_.get() + code->max_stack_.get();
+
+        return leaders * sizeof(u16) + (leaders + 1) * width;
+    }
+
+
+private:
+    static const u16 unreached = 0xffff;
+
+
+    static u16 depth(const u8* state)
+    {
+        u16 result;
+        memcpy(&result, state, sizeof result);
+        return result;
+    }
+
+
+    static void set_depth(u8* state, u16 depth)
+    {
+        memcpy(state, &depth, sizeof depth);
+    }
+
+
+    u8* state(int leader)
+    {
+        return states_ + leader * width_;
+    }
+
+
+    u8* locals(u8* state)
+    {
+        return state + 2;
+    }
+
+
+    u8* operands(u8* state)
+    {
+        return state + 2 + local_count_;
+    }
+
+
+    void push(u8 type)
+    {
+        const auto d = depth(current_);
+        if (d == width_ - (2 + local_count_)) {
+            unhandled_error("reference map: stack overflow");
+        }
+        operands(current_)[d] = type;
+        set_depth(current_, d + 1);
+    }
+
+
+    u8 pop()
+    {
+        const auto d = depth(current_);
+        if (d == 0) {
+            unhandled_error("reference map: stack underflow");
+        }
+        set_depth(current_, d - 1);
+        return operands(current_)[d - 1];
+    }
+
+
+    void pop(int count)
+    {
+        while (count--) {
+            pop();
+        }
+    }
+
+
+    void store(u32 index, u8 type)
+    {
+        if (index >= local_count_) {
+            unhandled_error("reference map: bad local index");
+        }
+        locals(current_)[index] = type;
+    }
+
+
+    // Push a value of the type named by the first character of a descriptor.
+    void push_descriptor(char c)
+    {
+        switch (c) {
+        case 'V':
+            break;
+
+        case 'J':
+        case 'D':
+            push(slot_primitive);
+            push(slot_primitive);
+            break;
+
+        case 'L':
+        case '[':
+            push(slot_reference);
+            break;
+
+        default:
+            push(slot_primitive);
+            break;
+        }
+    }
+
+
+    Slice descriptor(u16 name_and_type_index)
+    {
+        auto nt = (const ClassFile::ConstantNameAndType*)clz_->constants_->load(
+            name_and_type_index);
+
+        return clz_->constants_->load_string(nt->descriptor_index_.get());
+    }
+
+
+    Slice ref_descriptor(u16 index)
+    {
+        auto ref = (const ClassFile::ConstantRef*)clz_->constants_->load(index);
+        return descriptor(ref->name_and_type_index_.get());
+    }
+
+
+    // The type of an instance field, as the first character of a descriptor.
+    // Code that ran already may have bound the field, see resolve_field(),
+    // while we need not link fields that never ran.
+    char field_descriptor(u16 index)
+    {
+        if (auto sub = clz_->constants_->load_field(index)) {
+            if (sub->object_) {
+                return 'L';
+            }
+            return sub->size_ == SubstitutionField::b8 ? 'J' : 'I';
+        }
+        return ref_descriptor(index).ptr_[0];
+    }
+
+
+    void invoke(Slice type, bool has_self)
+    {
+        pop(parse_arguments(type).operand_count_ + (has_self ? 1 : 0));
+
+        for (u32 i = 0; i < type.length_; ++i) {
+            if (type.ptr_[i] == ')') {
+                push_descriptor(type.ptr_[i + 1]);
+                break;
+            }
+        }
+    }
+
+
+    // The types of the method's arguments, before the first instruction.
+    void entry_state(u8* state)
+    {
+        memset(state, slot_unset, width_);
+        set_depth(state, 0);
+
+        u32 index = 0;
+
+        if (not(method_->access_flags_.get() & 0x0008)) {
+            locals(state)[index++] = slot_reference;
+        }
+
+        auto type = clz_->constants_->load_string(
+            method_->descriptor_index_.get());
+
+        for (u32 i = 1; type.ptr_[i] not_eq ')'; ++i) {
+            if (index >= local_count_) {
+                unhandled_error("reference map: bad descriptor");
+            }
+
+            switch (type.ptr_[i]) {
+            case 'J':
+            case 'D':
+                locals(state)[index++] = slot_primitive;
+                locals(state)[index++] = slot_primitive;
+                break;
+
+            case '[':
+                while (type.ptr_[i] == '[') {
+                    ++i;
+                }
+                if (type.ptr_[i] not_eq 'L') {
+                    locals(state)[index++] = slot_reference;
+                    break;
+                }
+                // Intentional fallthrough (array of objects)
+
+            case 'L':
+                while (type.ptr_[i] not_eq ';') {
+                    ++i;
+                }
+                locals(state)[index++] = slot_reference;
+                break;
+
+            default:
+                locals(state)[index++] = slot_primitive;
+                break;
+            }
+        }
+    }
+
+
+    void add_leader(u32 pc)
+    {
+        if ((leader_count_ + 1) * sizeof(u16) > reference_map_scratch_size) {
+            unhandled_error("reference map: out of scratch memory");
+        }
+        leaders_[leader_count_++] = pc;
+    }
+
+
+    // Branch targets and exception handlers begin basic blocks. We store the
+    // state of the frame's slots only at the beginning of each basic block.
+    void find_leaders()
+    {
+        leaders_ = (u16*)reference_map_scratch;
+        leader_count_ = 0;
+
+        add_leader(0);
+
+        for (u32 pc = 0; pc < code_length_;
+             pc += instruction_length(code_, pc)) {
+
+            visit_branch_targets(code_, pc, [this](u32 target) {
+                add_leader(target);
+            });
+        }
+
+        for (int i = 0; i < exception_table_->exception_table_length_.get();
+             ++i) {
+            add_leader(exception_table_->entries()[i].handler_pc_.get());
+        }
+
+        // Sort, and remove duplicates.
+        std::sort(leaders_, leaders_ + leader_count_);
+        leader_count_ = std::unique(leaders_, leaders_ + leader_count_) -
+                        leaders_;
+
+        states_ = reference_map_scratch + leader_count_ * sizeof(u16);
+        current_ = states_ + leader_count_ * width_;
+
+        if (current_ + width_ >
+            reference_map_scratch + reference_map_scratch_size) {
+            unhandled_error("reference map: out of scratch memory");
+        }
+
+        for (int i = 0; i < leader_count_; ++i) {
+            set_depth(state(i), unreached);
+        }
+    }
+
+
+    template <typename F>
+    static void visit_branch_targets(const u8* code, u32 pc, F&& callback)
+    {
+        auto offset16 = [&] {
+            return ((const network_s16*)(code + pc + 1))->get();
+        };
+
+        auto offset32 = [&] {
+            return ((const network_s32*)(code + pc + 1))->get();
+        };
+
+        switch (code[pc]) {
+        case Bytecode::if_eq:
+        case Bytecode::if_ne:
+        case Bytecode::if_lt:
+        case Bytecode::if_ge:
+        case Bytecode::if_gt:
+        case Bytecode::if_le:
+        case Bytecode::if_icmpeq:
+        case Bytecode::if_icmpne:
+        case Bytecode::if_icmplt:
+        case Bytecode::if_icmpge:
+        case Bytecode::if_icmpgt:
+        case Bytecode::if_icmple:
+        case Bytecode::if_acmpeq:
+        case Bytecode::if_acmpne:
+        case Bytecode::if_null:
+        case Bytecode::if_nonnull:
+        case Bytecode::__goto:
+        case Bytecode::jsr:
+            callback(pc + offset16());
+            break;
+
+        case Bytecode::__goto_w:
+        case Bytecode::jsr_w:
+            callback(pc + offset32());
+            break;
+
+        case Bytecode::tableswitch:
+        case Bytecode::lookupswitch: {
+            u32 i = pc + 1;
+            if (i % 4 not_eq 0) {
+                i += 4 - i % 4;
+            }
+            auto word = [&](u32 index) {
+                return ((const network_s32*)(code + i + index * 4))->get();
+            };
+
+            callback(pc + word(0));
+
+            if (code[pc] == Bytecode::tableswitch) {
+                for (s32 j = 0; j < word(2) - word(1) + 1; ++j) {
+                    callback(pc + word(3 + j));
+                }
+            } else {
+                for (s32 j = 0; j < word(1); ++j) {
+                    callback(pc + word(3 + j * 2));
+                }
+            }
+            break;
+        }
+        }
+    }
+
+
+    int find_leader(u32 pc)
+    {
+        auto found = std::lower_bound(leaders_, leaders_ + leader_count_, pc);
+        if (found == leaders_ + leader_count_ or *found not_eq pc) {
+            unhandled_error("reference map: bad branch target");
+        }
+        return found - leaders_;
+    }
+
+
+    void merge(u8* leader, const u8* from)
+    {
+        const auto d = depth(from);
+
+        if (depth(leader) == unreached) {
+            memcpy(leader, from, width_);
+            changed_ = true;
+            return;
+        }
+
+        if (depth(leader) not_eq d) {
+            unhandled_error("reference map: inconsistent stack depth");
+        }
+
+        for (u32 i = 2; i < 2u + local_count_ + d; ++i) {
+            const u8 merged = leader[i] | from[i];
+            if (merged not_eq leader[i]) {
+                leader[i] = merged;
+                changed_ = true;
+            }
+        }
+    }
+
+
+    void merge_handler(u8* handler)
+    {
+        // The handler starts with the current locals, and the exception alone
+        // on the operand stack.
+        const auto saved = depth(current_);
+        const auto top = operands(current_)[0];
+
+        set_depth(current_, 0);
+        push(slot_reference);
+        merge(handler, current_);
+
+        operands(current_)[0] = top;
+        set_depth(current_, saved);
+    }
+
+
+    // Interpret the method's code, from start to finish, in a single pass.
+    // Returns true, with the state before the instruction at stop_pc in
+    // current_, if the pass reaches stop_pc.
+    bool run(u32 stop_pc)
+    {
+        bool live = false;
+        int next_leader = 0;
+
+        for (u32 pc = 0; pc < code_length_;
+             pc += instruction_length(code_, pc)) {
+
+            if (next_leader < leader_count_ and leaders_[next_leader] == pc) {
+                auto leader = state(next_leader++);
+
+                if (live) {
+                    merge(leader, current_);
+                }
+
+                live = depth(leader) not_eq unreached;
+
+                if (live) {
+                    memcpy(current_, leader, width_);
+                }
+            }
+
+            if (not live) {
+                // Dead code, or code that we have not reached yet.
+                continue;
+            }
+
+            if (pc == stop_pc) {
+                return true;
+            }
+
+            for (int i = 0; i < exception_table_->exception_table_length_.get();
+                 ++i) {
+                auto& entry = exception_table_->entries()[i];
+                if (pc >= entry.start_pc_.get() and pc < entry.end_pc_.get()) {
+                    merge_handler(state(find_leader(entry.handler_pc_.get())));
+                }
+            }
+
+            live = step(pc);
+        }
+
+        return false;
+    }
+
+
+    // Apply the effect of the instruction at pc to current_. Returns false if
+    // the instruction does not fall through to the next one.
+    bool step(u32 pc)
+    {
+        const u8 op = code_[pc];
+
+        auto u16_operand = [&] {
+            return ((const network_u16*)(code_ + pc + 1))->get();
+        };
+
+        switch (op) {
+        case Bytecode::nop:
+        case Bytecode::checkcast:
+            break;
+
+        case Bytecode::aconst_null:
+        case Bytecode::new_inst:
+        case Bytecode::aload_0:
+        case Bytecode::aload_1:
+        case Bytecode::aload_2:
+        case Bytecode::aload_3:
+        case Bytecode::aload:
+            push(slot_reference);
+            break;
+
+        case Bytecode::iconst_m1:
+        case Bytecode::iconst_0:
+        case Bytecode::iconst_1:
+        case Bytecode::iconst_2:
+        case Bytecode::iconst_3:
+        case Bytecode::iconst_4:
+        case Bytecode::iconst_5:
+        case Bytecode::fconst_0:
+        case Bytecode::fconst_1:
+        case Bytecode::fconst_2:
+        case Bytecode::bipush:
+        case Bytecode::sipush:
+        case Bytecode::iload:
+        case Bytecode::fload:
+        case Bytecode::iload_0:
+        case Bytecode::iload_1:
+        case Bytecode::iload_2:
+        case Bytecode::iload_3:
+        case Bytecode::fload_0:
+        case Bytecode::fload_1:
+        case Bytecode::fload_2:
+        case Bytecode::fload_3:
+            push(slot_primitive);
+            break;
+
+        case Bytecode::lconst_0:
+        case Bytecode::lconst_1:
+        case Bytecode::dconst_0:
+        case Bytecode::dconst_1:
+        case Bytecode::ldc2_w:
+        case Bytecode::lload:
+        case Bytecode::dload:
+        case Bytecode::lload_0:
+        case Bytecode::lload_1:
+        case Bytecode::lload_2:
+        case Bytecode::lload_3:
+        case Bytecode::dload_0:
+        case Bytecode::dload_1:
+        case Bytecode::dload_2:
+        case Bytecode::dload_3:
+            push(slot_primitive);
+            push(slot_primitive);
+            break;
+
+        case Bytecode::ldc:
+        case Bytecode::ldc_w: {
+            auto c = clz_->constants_->load(op == Bytecode::ldc
+                                                ? code_[pc + 1]
+                                                : u16_operand());
+            if (c->tag_ == ClassFile::t_integer or
+                c->tag_ == ClassFile::t_float) {
+                push(slot_primitive);
+            } else {
+                push(slot_reference);
+            }
+            break;
+        }
+
+        case Bytecode::iaload:
+        case Bytecode::faload:
+        case Bytecode::baload:
+        case Bytecode::caload:
+        case Bytecode::saload:
+            pop(2);
+            push(slot_primitive);
+            break;
+
+        case Bytecode::laload:
+        case Bytecode::daload:
+            pop(2);
+            push(slot_primitive);
+            push(slot_primitive);
+            break;
+
+        case Bytecode::aaload:
+            pop(2);
+            push(slot_reference);
+            break;
+
+        case Bytecode::istore:
+        case Bytecode::fstore:
+            pop();
+            store(code_[pc + 1], slot_primitive);
+            break;
+
+        case Bytecode::istore_0:
+        case Bytecode::istore_1:
+        case Bytecode::istore_2:
+        case Bytecode::istore_3:
+            pop();
+            store(op - Bytecode::istore_0, slot_primitive);
+            break;
+
+        case Bytecode::fstore_0:
+        case Bytecode::fstore_1:
+        case Bytecode::fstore_2:
+        case Bytecode::fstore_3:
+            pop();
+            store(op - Bytecode::fstore_0, slot_primitive);
+            break;
+
+        case Bytecode::lstore:
+        case Bytecode::dstore:
+            pop(2);
+            store(code_[pc + 1], slot_primitive);
+            store(code_[pc + 1] + 1, slot_primitive);
+            break;
+
+        case Bytecode::lstore_0:
+        case Bytecode::lstore_1:
+        case Bytecode::lstore_2:
+        case Bytecode::lstore_3:
+            pop(2);
+            store(op - Bytecode::lstore_0, slot_primitive);
+            store(op - Bytecode::lstore_0 + 1, slot_primitive);
+            break;
+
+        case Bytecode::dstore_0:
+        case Bytecode::dstore_1:
+        case Bytecode::dstore_2:
+        case Bytecode::dstore_3:
+            pop(2);
+            store(op - Bytecode::dstore_0, slot_primitive);
+            store(op - Bytecode::dstore_0 + 1, slot_primitive);
+            break;
+
+        case Bytecode::astore:
+            store(code_[pc + 1], pop());
+            break;
+
+        case Bytecode::astore_0:
+        case Bytecode::astore_1:
+        case Bytecode::astore_2:
+        case Bytecode::astore_3:
+            store(op - Bytecode::astore_0, pop());
+            break;
+
+        case Bytecode::iastore:
+        case Bytecode::fastore:
+        case Bytecode::aastore:
+        case Bytecode::bastore:
+        case Bytecode::castore:
+        case Bytecode::sastore:
+            pop(3);
+            break;
+
+        case Bytecode::lastore:
+        case Bytecode::dastore:
+            pop(4);
+            break;
+
+        case Bytecode::pop:
+        case Bytecode::monitorenter:
+        case Bytecode::monitorexit:
+            pop();
+            break;
+
+        case Bytecode::pop2:
+            pop(2);
+            break;
+
+        case Bytecode::dup: {
+            auto a = pop();
+            push(a);
+            push(a);
+            break;
+        }
+
+        case Bytecode::dup_x1: {
+            auto a = pop();
+            auto b = pop();
+            push(a);
+            push(b);
+            push(a);
+            break;
+        }
+
+        case Bytecode::dup_x2: {
+            auto a = pop();
+            auto b = pop();
+            auto c = pop();
+            push(a);
+            push(c);
+            push(b);
+            push(a);
+            break;
+        }
+
+        case Bytecode::dup2: {
+            auto a = pop();
+            auto b = pop();
+            push(b);
+            push(a);
+            push(b);
+            push(a);
+            break;
+        }
+
+        case Bytecode::dup2_x1: {
+            auto a = pop();
+            auto b = pop();
+            auto c = pop();
+            push(b);
+            push(a);
+            push(c);
+            push(b);
+            push(a);
+            break;
+        }
+
+        case Bytecode::dup2_x2: {
+            auto a = pop();
+            auto b = pop();
+            auto c = pop();
+            auto d = pop();
+            push(b);
+            push(a);
+            push(d);
+            push(c);
+            push(b);
+            push(a);
+            break;
+        }
+
+        case Bytecode::swap: {
+            auto a = pop();
+            auto b = pop();
+            push(a);
+            push(b);
+            break;
+        }
+
+        case Bytecode::iadd:
+        case Bytecode::isub:
+        case Bytecode::imul:
+        case Bytecode::idiv:
+        case Bytecode::irem:
+        case Bytecode::ishl:
+        case Bytecode::ishr:
+        case Bytecode::iushr:
+        case Bytecode::iand:
+        case Bytecode::ior:
+        case Bytecode::ixor:
+        case Bytecode::fadd:
+        case Bytecode::fsub:
+        case Bytecode::fmul:
+        case Bytecode::fdiv:
+        case Bytecode::frem:
+        case Bytecode::fcmpl:
+        case Bytecode::fcmpg:
+            pop(2);
+            push(slot_primitive);
+            break;
+
+        case Bytecode::ladd:
+        case Bytecode::lsub:
+        case Bytecode::lmul:
+        case Bytecode::ldiv:
+        case Bytecode::lrem:
+        case Bytecode::land:
+        case Bytecode::lor:
+        case Bytecode::lxor:
+        case Bytecode::dadd:
+        case Bytecode::dsub:
+        case Bytecode::dmul:
+        case Bytecode::ddiv:
+        case Bytecode::drem:
+            pop(4);
+            push(slot_primitive);
+            push(slot_primitive);
+            break;
+
+        case Bytecode::lshl:
+        case Bytecode::lshr:
+        case Bytecode::lushr:
+            pop(3);
+            push(slot_primitive);
+            push(slot_primitive);
+            break;
+
+        case Bytecode::lcmp:
+        case Bytecode::dcmpl:
+        case Bytecode::dcmpg:
+            pop(4);
+            push(slot_primitive);
+            break;
+
+        case Bytecode::ineg:
+        case Bytecode::fneg:
+        case Bytecode::i2f:
+        case Bytecode::f2i:
+        case 0x91: // i2b
+        case Bytecode::i2c:
+        case Bytecode::i2s:
+        case Bytecode::arraylength:
+        case Bytecode::instanceof:
+            pop();
+            push(slot_primitive);
+            break;
+
+        case Bytecode::lneg:
+        case Bytecode::dneg:
+        case Bytecode::l2d:
+        case Bytecode::d2l:
+            pop(2);
+            push(slot_primitive);
+            push(slot_primitive);
+            break;
+
+        case Bytecode::i2l:
+        case Bytecode::i2d:
+        case Bytecode::f2l:
+        case Bytecode::f2d:
+            pop();
+            push(slot_primitive);
+            push(slot_primitive);
+            break;
+
+        case Bytecode::l2i:
+        case Bytecode::l2f:
+        case Bytecode::d2i:
+        case Bytecode::d2f:
+            pop(2);
+            push(slot_primitive);
+            break;
+
+        case Bytecode::iinc:
+            store(code_[pc + 1], slot_primitive);
+            break;
+
+        case Bytecode::if_eq:
+        case Bytecode::if_ne:
+        case Bytecode::if_lt:
+        case Bytecode::if_ge:
+        case Bytecode::if_gt:
+        case Bytecode::if_le:
+        case Bytecode::if_null:
+        case Bytecode::if_nonnull:
+            pop();
+            branch(pc);
+            break;
+
+        case Bytecode::if_icmpeq:
+        case Bytecode::if_icmpne:
+        case Bytecode::if_icmplt:
+        case Bytecode::if_icmpge:
+        case Bytecode::if_icmpgt:
+        case Bytecode::if_icmple:
+        case Bytecode::if_acmpeq:
+        case Bytecode::if_acmpne:
+            pop(2);
+            branch(pc);
+            break;
+
+        case Bytecode::__goto:
+        case Bytecode::__goto_w:
+            branch(pc);
+            return false;
+
+        case Bytecode::jsr:
+        case Bytecode::jsr_w:
+            // NOTE: We pretend that the subroutine returns with the frame's
+            // slots unchanged. Compilers haven't emitted jsr in a long time,
+            // and this is good enough for the usual finally blocks.
+            push(slot_reference);
+            branch(pc);
+            pop();
+            break;
+
+        case Bytecode::tableswitch:
+        case Bytecode::lookupswitch:
+            pop();
+            branch(pc);
+            return false;
+
+        case Bytecode::ret:
+        case Bytecode::ireturn:
+        case Bytecode::lreturn:
+        case Bytecode::freturn:
+        case Bytecode::dreturn:
+        case Bytecode::areturn:
+        case Bytecode::vreturn:
+        case Bytecode::athrow:
+            return false;
+
+        case Bytecode::getstatic:
+            push_descriptor(ref_descriptor(u16_operand()).ptr_[0]);
+            break;
+
+        case Bytecode::putstatic: {
+            const char c = ref_descriptor(u16_operand()).ptr_[0];
+            pop(c == 'J' or c == 'D' ? 2 : 1);
+            break;
+        }
+
+        case Bytecode::getfield:
+            pop();
+            push_descriptor(field_descriptor(u16_operand()));
+            break;
+
+        case Bytecode::putfield: {
+            const char c = field_descriptor(u16_operand());
+            pop((c == 'J' or c == 'D' ? 2 : 1) + 1);
+            break;
+        }
+
+        case Bytecode::invokevirtual:
+        case Bytecode::invokespecial:
+        case Bytecode::invokeinterface:
+            invoke(ref_descriptor(u16_operand()), true);
+            break;
+
+        case Bytecode::invokestatic:
+            invoke(ref_descriptor(u16_operand()), false);
+            break;
+
+        case Bytecode::invokedynamic: {
+            auto info = (const ClassFile::ConstantInvokeDynamic*)
+                            clz_->constants_->load(u16_operand());
+            invoke(descriptor(info->name_and_type_index_.get()), false);
+            break;
+        }
+
+        case Bytecode::newarray:
+        case Bytecode::anewarray:
+            pop();
+            push(slot_reference);
+            break;
+
+        case Bytecode::multianewarray:
+            pop(code_[pc + 3]);
+            push(slot_reference);
+            break;
+
+        case Bytecode::wide: {
+            const u32 index = ((const network_u16*)(code_ + pc + 2))->get();
+
+            switch (code_[pc + 1]) {
+            case Bytecode::iload:
+            case Bytecode::fload:
+                push(slot_primitive);
+                break;
+
+            case Bytecode::aload:
+                push(slot_reference);
+                break;
+
+            case Bytecode::lload:
+            case Bytecode::dload:
+                push(slot_primitive);
+                push(slot_primitive);
+                break;
+
+            case Bytecode::istore:
+            case Bytecode::fstore:
+                pop();
+                store(index, slot_primitive);
+                break;
+
+            case Bytecode::astore:
+                store(index, pop());
+                break;
+
+            case Bytecode::lstore:
+            case Bytecode::dstore:
+                pop(2);
+                store(index, slot_primitive);
+                store(index + 1, slot_primitive);
+                break;
+
+            case Bytecode::iinc:
+                store(index, slot_primitive);
+                break;
+
+            case Bytecode::ret:
+                return false;
+            }
+            break;
+        }
+
+        default:
+            unhandled_error("reference map: unexpected opcode");
+        }
+
+        return true;
+    }
+
+
+    // Merge current_ into the state at each of the instruction's branch
+    // targets.
+    void branch(u32 pc)
+    {
+        visit_branch_targets(code_, pc, [this](u32 target) {
+            merge(state(find_leader(target)), current_);
+        });
+    }
+
+
+    Class* clz_;
+    const ClassFile::MethodInfo* method_;
+    const u8* code_;
+    u32 code_length_;
+    const ClassFile::ExceptionTable* exception_table_;
+    u16 local_count_;
+    u32 width_;
+
+    u16* leaders_ = nullptr;
+    int leader_count_ = 0;
+    u8* states_ = nullptr;
+    u8* current_ = nullptr;
+    bool changed_ = false;
+};
+
+
+
+// Native methods are bound with placeholder descriptors, so we type their
+// arguments according to the descriptor used by the caller.
+static void visit_native_locals(const Frame& frame,
+                                void** locals_end,
+                                void (*visitor)(Object**))
+{
+    const int count = locals_end - frame.locals_;
+    auto local = [&](int index) { return (Object**)&frame.locals_[index]; };
+
+    int index = 0;
+
+    auto type = frame.signature_;
+    if (type.ptr_ == nullptr) {
+        return;
+    }
+
+    if (parse_arguments(type).operand_count_ < count) {
+        visitor(local(index++));
+    }
+
+    for (u32 i = 1; type.ptr_[i] not_eq ')'; ++i) {
+        switch (type.ptr_[i]) {
+        case 'J':
+        case 'D':
+            index += 2;
+            break;
+
+        case '[':
+            while (type.ptr_[i] == '[') {
+                ++i;
+            }
+            if (type.ptr_[i] not_eq 'L') {
+                visitor(local(index++));
+                break;
+            }
+            // Intentional fallthrough (array of objects)
+
+        case 'L':
+            while (type.ptr_[i] not_eq ';') {
+                ++i;
+            }
+            visitor(local(index++));
+            break;
+
+        default:
+            ++index;
+            break;
+        }
+    }
+}
+
+
+
+#endif // JVM_GC_REFERENCE_MAPS
+
+
+
+void visit_stack_roots(void (*visitor)(Object**))
+{
+#if not JVM_GC_REFERENCE_MAPS
+    for (u32 i = 0; i < __operand_stack.size(); ++i) {
+        if (__operand_types[i] == OperandTypeCategory::object) {
+            visitor((Object**)&__operand_stack[i]);
+        }
+    }
+
+    for (u32 i = 0; i < (u32)(__locals_top - __locals); ++i) {
+        if (__local_types[i] == OperandTypeCategory::object) {
+            visitor((Object**)&__locals[i]);
+        }
+    }
+#else
+    // Anything on the operand stack below the first frame was pushed by the
+    // host, e.g. start().
+    const u32 host_end =
+        frames.empty() ? __operand_stack.size() : frames[0].operand_base_;
+
+    for (u32 i = 0; i < host_end; ++i) {
+        visitor((Object**)&__operand_stack[i]);
+    }
+
+    for (u32 f = 0; f < frames.size(); ++f) {
+        auto& frame = frames[f];
+
+        const bool top = f + 1 == frames.size();
+
+        const u32 operands_end =
+            top ? __operand_stack.size() : frames[f + 1].operand_base_;
+
+        void** locals_end = top ? __locals_top : frames[f + 1].locals_;
+
+        u32 i = frame.operand_base_;
+
+        if (frame.code_) {
+            ReferenceMap map(frame.clz_,
+                             frame.method_,
+                             frame.code_,
+                             frame.pc_ ? *frame.pc_ : 0);
+
+            for (u32 j = 0; j < map.local_count() and
+                            j < (u32)(locals_end - frame.locals_);
+                 ++j) {
+                if (map.local_is_reference(j)) {
+                    visitor((Object**)&frame.locals_[j]);
+                }
+            }
+
+            if (not frame.unwinding_) {
+                for (; i < operands_end and i - frame.operand_base_ < map.depth();
+                     ++i) {
+                    if (map.operand_is_reference(i - frame.operand_base_)) {
+                        visitor((Object**)&__operand_stack[i]);
+                    }
+                }
+            }
+
+        } else if (frame.method_) {
+            visit_native_locals(frame, locals_end, visitor);
+        }
+
+        // Anything else on the frame's operand stack must be a reference: an
+        // exception being thrown, something that the host pushed (see
+        // HostFrame), or a temporary from an instruction that allocates more
+        // than once (multianewarray).
+        for (; i < operands_end; ++i) {
+            visitor((Object**)&__operand_stack[i]);
+        }
+    }
+#endif
+}
+
+
+
+static const ClassFile::AttributeInfo*
+first_attribute(const ClassFile::MethodInfo* method)
+{
+    return (const ClassFile::AttributeInfo*)((const char*)method +
+                                             sizeof(ClassFile::MethodInfo));
+}
+
+
+
+static bool is_native(const ClassFile::MethodInfo* method)
+{
+    if (method->attributes_count_.get() == 0) {
+        return false;
+    }
+
+    auto attr = first_attribute(method);
+
+    return attr->attribute_name_index_.get() == jni::magic and
+           attr->attribute_length_.get() == jni::magic;
+}
+
+
+
+// nullptr for native methods.
+static const ClassFile::AttributeCode*
+code_attribute(Class* clz, const ClassFile::MethodInfo* method)
+{
+    if (method->attributes_count_.get() == 0 or is_native(method)) {
+        return nullptr;
+    }
+
+    auto attr = first_attribute(method);
+
+    if (clz->constants_->load_string(attr->attribute_name_index_.get()) ==
+        Slice::from_c_str("Code")) {
+        return (const ClassFile::AttributeCode*)attr;
+    }
+
+    return nullptr;
+}
+
+
+
+#if JVM_GC_REFERENCE_MAPS
+// Grow the reference map scratch memory, if need be, so that the gc can work
+// out reference maps for the class's methods. The gc itself cannot allocate
+// scratch memory, as it runs when the heap is full.
+static void reserve_reference_map_scratch(Class* clz)
+{
+    u32 required = 0;
+
+    clz->visit_methods(
+        [](Class* clz, const ClassFile::MethodInfo* method, void* arg) {
+            if (auto code = code_attribute(clz, method)) {
+                auto& required = *(u32*)arg;
+                required =
+                    std::max(required, ReferenceMap::scratch_size(code));
+            }
+        },
+        &required);
+
+    if (required <= reference_map_scratch_size) {
+        return;
+    }
+
+    // The old scratch memory, if in class memory, goes to waste. Only the
+    // largest methods get here, as the default scratch fits most.
+    auto scratch = (u8*)classmemory::allocate(required, alignof(u16));
+    if (scratch == nullptr) {
+        unhandled_error("failed to alloc reference map scratch");
+    }
+
+    reference_map_scratch = scratch;
+    reference_map_scratch_size = required;
+}
+#endif
+
+
+
+// A method's code, as the interpreter will run it. See enter_method().
+struct MethodCode {
+    const u8* bytecode_;
+    const ClassFile::ExceptionTable* exception_table_;
+
+    // nullptr, unless the method runs quickened code.
+    Class::OptionQuickenedCode* quick_;
+};
+
+
+
+// Push a frame for a method with bytecode, and bind the method's arguments.
+// Whoever runs the code (see run_method()) pops the frame afterwards. Pass the
+// method's quickened code, if already known. If the frame does not fit, returns
+// a null bytecode_ and leaves the arguments on the operand stack, see
+// stack_overflow().
+static MethodCode enter_method(Class* clz,
+                               const ClassFile::MethodInfo* method,
+                               const ClassFile::AttributeCode* code,
+                               const ArgumentInfo& argc,
+                               Slice type_signature,
+                               Class::OptionQuickenedCode* quick = nullptr)
+{
+    MethodCode result;
+
+    result.bytecode_ = ((const u8*)code) + sizeof(ClassFile::AttributeCode);
+
+    result.exception_table_ =
+        (const ClassFile::ExceptionTable*)(result.bytecode_ +
+                                           code->code_length_.get());
+
+    result.quick_ = nullptr;
+
+    const auto local_count =
+        std::max(code->max_locals_.get(),
+                 (u16)4); // Why a min of four? istore_0-3, so there
+                          // must be at least four slots.
+
+    if (not push_frame(clz, method, local_count, code->max_stack_.get())) {
+        result.bytecode_ = nullptr;
+        return result;
+    }
+
+    bind_arguments(argc);
+
+    frames.back().operand_base_ = __operand_stack.size();
+
+#if JVM_GC_REFERENCE_MAPS
+    frames.back().code_ = code;
+    frames.back().signature_ = type_signature;
+#endif
+
+#if JVM_QUICKEN_BYTECODE
+    // NOTE: We quicken only after binding arguments, as class memory
+    // allocation may trigger the gc, which needs to find the arguments in the
+    // callee's frame.
+    if (quick == nullptr) {
+        quick = quicken_method(clz, method, code);
+    }
+    if (quick->code_) {
+        result.bytecode_ = quick->code_;
+        result.quick_ = quick;
+    }
+#else
+    (void)quick;
+#endif
+
+    return result;
+}
+
+
+
+static Exception* run_method(Class* clz, const MethodCode& code)
+{
+#if JVM_PREDECODE_BYTECODE
+    if (code.quick_) {
+        return execute_bytecode<PredecodedOperands>(
+            clz, code.bytecode_, code.exception_table_, code.quick_);
+    }
+#endif
+
+    return execute_bytecode<ClassfileOperands>(
+        clz, code.bytecode_, code.exception_table_, code.quick_);
+}
+
+
+
+#if JVM_INTRINSICS_CHECK
+static Exception* check_intrinsic(Class* clz,
+                                  const jni::MethodStub* stub,
+                                  const ArgumentInfo& argc,
+                                  Slice type_signature);
+#endif
+
+
+
+// For a call that does not fit on the stack (see push_frame()): drops the
+// call's arguments, and returns a StackOverflowError for the caller to throw.
+static Exception* stack_overflow(const ArgumentInfo& argc)
+{
+    if (stack_reserve_open) {
+        unhandled_error("stack overflow while constructing StackOverflowError");
+    }
+
+    for (int i = 0; i < argc.operand_count_; ++i) {
+        pop_operand();
+    }
+
+    stack_reserve_open = true;
+    auto exn = make_exception("java/lang/StackOverflowError", "");
+    stack_reserve_open = false;
+
+    return exn;
+}
+
+
+
+// The method's arguments (including self) must be on top of the operand stack.
+static Exception* invoke_method(Class* clz,
+                                const ClassFile::MethodInfo* method,
+                                const ArgumentInfo& argc = ArgumentInfo{},
+                                Slice type_signature = Slice(nullptr, 0))
+{
+    if (is_native(method)) {
+
+        auto stub = (jni::MethodStub*)method;
+
+        if (stub->invoke_) {
+#if JVM_INTRINSICS_CHECK
+            if (stub->checked_) {
+                return check_intrinsic(clz, stub, argc, type_signature);
+            }
+#endif
+            // A typed native takes its arguments from the operand stack, and
+            // needs no frame.
+            if (stub->invoke_(stub->implementation_)) {
+                return nullptr;
+            }
+
+            // The native declined the call, run the method that it replaced.
+            return invoke_method(clz, stub->fallback_, argc, type_signature);
+        }
+
+        // Room for a wide result, or a reference to an object that the
+        // native creates.
+        if (not push_frame(clz, method, argc.operand_count_, 2)) {
+            return stack_overflow(argc);
+        }
+
+        bind_arguments(argc);
+
+        frames.back().operand_base_ = __operand_stack.size();
+
+#if JVM_GC_REFERENCE_MAPS
+        frames.back().signature_ = type_signature;
+#endif
+
+        stub->implementation_();
+
+        pop_frame();
+
+        return nullptr;
+
+    } else if (auto code = code_attribute(clz, method)) {
+
+        auto callee = enter_method(clz, method, code, argc, type_signature);
+        if (callee.bytecode_ == nullptr) {
+            return stack_overflow(argc);
+        }
+
+        auto exn = run_method(clz, callee);
+
+        pop_frame();
+
+        return exn;
+    }
+
+    return make_exception("java/lang/RuntimeException",
+                          "failed to invoke method");
+}
+
+
+
+#if JVM_INTRINSICS_CHECK
+// Runs the intrinsic on a copy of the arguments, then the method that it
+// replaced, which produces the call's actual result, and halts if the two
+// results differ. The intrinsic must not allocate, or the gc would miss the
+// copies.
+static Exception* check_intrinsic(Class* clz,
+                                  const jni::MethodStub* stub,
+                                  const ArgumentInfo& argc,
+                                  Slice type_signature)
+{
+    const int count = argc.operand_count_;
+    const auto base = __operand_stack.size() - count;
+
+    for (int i = 0; i < count; ++i) {
+#if JVM_GC_REFERENCE_MAPS
+        push_operand_p(__operand_stack[base + i]);
+#else
+        __push_operand_impl(__operand_stack[base + i],
+                            __operand_types[base + i]);
+#endif
+    }
+
+    if (not stub->invoke_(stub->implementation_)) {
+        pop_operands(count);
+        return invoke_method(clz, stub->fallback_, argc, type_signature);
+    }
+
+    void* expected[2];
+    const int expected_count = __operand_stack.size() - (base + count);
+    for (int i = 0; i < expected_count; ++i) {
+        expected[i] = load_operand(expected_count - 1 - i);
+    }
+    pop_operands(expected_count);
+
+    auto exn = invoke_method(clz, stub->fallback_, argc, type_signature);
+
+    const int result_count = __operand_stack.size() - base;
+
+    bool match = exn == nullptr and result_count == expected_count;
+    for (int i = 0; match and i < result_count; ++i) {
+        match = load_operand(result_count - 1 - i) == expected[i];
+    }
+
+    if (not match) {
+        StringBuffer<80> buffer = "intrinsic mismatch: ";
+        auto name = clz->constants_->load_string(
+            stub->method_info_.name_index_.get());
+        for (u32 i = 0; i < name.length_; ++i) {
+            buffer.push_back(name.ptr_[i]);
+        }
+        unhandled_error(buffer.c_str());
+    }
+
+    return exn;
+}
+#endif
+
+
+
+Class* load_class_by_name(Slice class_name)
+{
+    if (auto entry = classtable::load(class_name)) {
+        return entry;
+    }
+
+    if (auto clz = import(class_name)) {
+        return clz;
+    } else {
+        StringBuffer<80> buffer = "missing class: ";
+        for (u32 i = 0; i < class_name.length_; ++i) {
+            buffer.push_back(class_name.ptr_[i]);
+        }
+        unhandled_error(buffer.c_str());
+    }
+}
+
+
+
+static Slice classname(Class* current_module, u16 class_index)
+{
+    auto c_clz =
+        (const ClassFile::ConstantClass*)current_module->constants_->load(
             class_index);
 
     auto cname =
@@ -1007,32 +3614,142 @@ Class* load_class(Class* current_module, u16 class_index)
 
 
 
-static std::pair<const ClassFile::MethodInfo*, Class*>
-lookup_method(Class* clz, Slice lhs_name, Slice lhs_type)
-{
-    if (auto mtd = clz->load_method(lhs_name, lhs_type)) {
-        return {mtd, clz};
-    }
+static bool is_subtype(Class* clz, Class* other);
+
+
+
+// Searches an interface, and then its superinterfaces, for a default method.
+// A default in a subinterface overrides one in the superinterface, so of the
+// defaults found, we keep the one from the most specific interface.
+static void
+lookup_default_method(Class* interface,
+                      Slice lhs_name,
+                      Slice lhs_type,
+                      symboltable::Symbol lhs_name_symbol,
+                      symboltable::Symbol lhs_type_symbol,
+                      std::pair<const ClassFile::MethodInfo*, Class*>& found)
+{
+    if (auto mtd = interface->load_method(
+            lhs_name, lhs_type, lhs_name_symbol, lhs_type_symbol)) {
+        // Abstract, static, and private methods aren't defaults. An abstract
+        // redeclaration hides the superinterfaces' defaults.
+        if ((mtd->access_flags_.get() & (0x0400 | 0x0008 | 0x0002)) == 0 and
+            (found.first == nullptr or is_subtype(interface, found.second))) {
+            found = {mtd, interface};
+        }
+        return;
+    }
+
+    if (auto interfaces = interface->interfaces()) {
+        auto vals = (network_u16*)((u8*)interfaces +
+                                   sizeof(ClassFile::HeaderSection2));
+        for (int i = 0; i < interfaces->interfaces_count_.get(); ++i) {
+            lookup_default_method(load_class(interface, vals[i].get()),
+                                  lhs_name,
+                                  lhs_type,
+                                  lhs_name_symbol,
+                                  lhs_type_symbol,
+                                  found);
+        }
+    }
+}
+
+
+
+static std::pair<const ClassFile::MethodInfo*, Class*>
+lookup_method(Class* clz,
+              Slice lhs_name,
+              Slice lhs_type,
+              symboltable::Symbol lhs_name_symbol,
+              symboltable::Symbol lhs_type_symbol)
+{
+    for (auto current = clz; current; current = current->super_) {
+        if (auto mtd = current->load_method(
+                lhs_name, lhs_type, lhs_name_symbol, lhs_type_symbol)) {
+            return {mtd, current};
+        }
+    }
+
+    // No class in the hierarchy implements the method, maybe one of the
+    // interfaces has a default.
+    std::pair<const ClassFile::MethodInfo*, Class*> found = {nullptr, clz};
+
+    for (auto current = clz; current; current = current->super_) {
+        if (auto interfaces = current->interfaces()) {
+            auto vals = (network_u16*)((u8*)interfaces +
+                                       sizeof(ClassFile::HeaderSection2));
+            for (int i = 0; i < interfaces->interfaces_count_.get(); ++i) {
+                lookup_default_method(load_class(current, vals[i].get()),
+                                      lhs_name,
+                                      lhs_type,
+                                      lhs_name_symbol,
+                                      lhs_type_symbol,
+                                      found);
+            }
+        }
+    }
+
+    return found;
+}
+
+
+
+// Descriptors live in classfile memory (or are string literals), which stays
+// put, so a descriptor's address identifies it.
+static struct {
+    const char* descriptor_;
+    ArgumentInfo info_;
+} argument_info_cache[JVM_ARGUMENT_INFO_CACHE_SIZE];
+
+
+
+static ArgumentInfo argument_info(Slice method_type)
+{
+    auto& entry = argument_info_cache[(uintptr_t)method_type.ptr_ %
+                                      JVM_ARGUMENT_INFO_CACHE_SIZE];
+
+    if (entry.descriptor_ not_eq method_type.ptr_) {
+        entry.descriptor_ = method_type.ptr_;
+        entry.info_ = parse_arguments(method_type);
+    }
+
+    return entry.info_;
+}
+
+
+
+// A method call, with the method looked up. See resolve_method().
+struct Invocation {
+    Class* clz_;
+    const ClassFile::MethodInfo* method_;
 
-    if (clz->super_ == nullptr) {
-        return {nullptr, clz};
-    } else {
-        return lookup_method(clz->super_, lhs_name, lhs_type);
-    }
-}
+    // Includes self.
+    ArgumentInfo argc_;
 
+    Slice type_signature_;
 
+    // nullptr if not known, see code_attribute().
+    const ClassFile::AttributeCode* code_;
 
-static Exception* dispatch_method(Class* clz,
-                                  Slice method_name,
-                                  Slice method_type,
-                                  bool direct_dispatch,
-                                  bool special,
-                                  const ClassFile::ConstantRef* ref)
+    // nullptr if not known, see quicken_method().
+    Class::OptionQuickenedCode* quick_;
+};
+
+
+
+static Exception* resolve_method(Class* clz,
+                                 Slice method_name,
+                                 Slice method_type,
+                                 symboltable::Symbol method_name_symbol,
+                                 symboltable::Symbol method_type_symbol,
+                                 bool direct_dispatch,
+                                 bool special,
+                                 const ClassFile::ConstantRef* ref,
+                                 Invocation& call)
 {
     // std::cout << "call " << std::string(method_name.ptr_, method_name.length_)
     //           << std::endl;
-    auto argc = parse_arguments(method_type);
+    auto argc = argument_info(method_type);
 
     Object* self = nullptr;
     if ((not direct_dispatch) or special) {
@@ -1056,7 +3773,11 @@ static Exception* dispatch_method(Class* clz,
 
     auto mtd = [&] {
         if (not direct_dispatch) {
-            return lookup_method(self->class_, method_name, method_type);
+            return lookup_method(self->class_,
+                                 method_name,
+                                 method_type,
+                                 method_name_symbol,
+                                 method_type_symbol);
         } else {
             // If we do not have a self pointer we're looking up a static
             // method, if direct_dispatch, we're processing an invoke_special
@@ -1065,7 +3786,11 @@ static Exception* dispatch_method(Class* clz,
             if (t_clz == nullptr) {
                 unhandled_error("failed to load class, TODO: raise error");
             }
-            return lookup_method(t_clz, method_name, method_type);
+            return lookup_method(t_clz,
+                                 method_name,
+                                 method_type,
+                                 method_name_symbol,
+                                 method_type_symbol);
         }
     }();
 
@@ -1073,43 +3798,640 @@ static Exception* dispatch_method(Class* clz,
         if (self) {
             argc.operand_count_ += 1;
         }
-        return invoke_method(mtd.second, self, mtd.first, argc, method_type);
+        call.clz_ = mtd.second;
+        call.method_ = mtd.first;
+        call.argc_ = argc;
+        call.type_signature_ = method_type;
+        call.code_ = nullptr;
+        call.quick_ = nullptr;
+        return nullptr;
     } else {
         StringBuffer<80> buffer = "method lookup failed for ";
         for (u32 i = 0; i < method_name.length_; ++i) {
             buffer.push_back(method_name.ptr_[i]);
         }
 
-        return make_exception("java/lang/RuntimeException", buffer.c_str());
+        return make_exception("java/lang/RuntimeException", buffer.c_str());
+    }
+}
+
+
+
+#if JVM_INLINE_CACHES or (JVM_VTABLES and JVM_GC_REFERENCE_MAPS)
+static Slice method_descriptor(Class* clz, u16 method_index)
+{
+    auto ref =
+        (const ClassFile::ConstantRef*)clz->constants_->load(method_index);
+
+    auto nt = (const ClassFile::ConstantNameAndType*)clz->constants_->load(
+        ref->name_and_type_index_.get());
+
+    return clz->constants_->load_string(nt->descriptor_index_.get());
+}
+#endif
+
+
+
+static Exception* resolve_method(Class* clz,
+                                 u16 method_index,
+                                 bool direct_dispatch,
+                                 bool special,
+                                 Invocation& call)
+{
+
+    auto ref =
+        (const ClassFile::ConstantRef*)clz->constants_->load(method_index);
+
+    auto nt = (const ClassFile::ConstantNameAndType*)clz->constants_->load(
+        ref->name_and_type_index_.get());
+
+    auto lhs_name = clz->constants_->load_string(nt->name_index_.get());
+    auto lhs_type = clz->constants_->load_string(nt->descriptor_index_.get());
+
+    return resolve_method(clz,
+                          lhs_name,
+                          lhs_type,
+                          clz->constants_->load_symbol(nt->name_index_.get()),
+                          clz->constants_->load_symbol(
+                              nt->descriptor_index_.get()),
+                          direct_dispatch,
+                          special,
+                          ref,
+                          call);
+}
+
+
+
+#if JVM_RESOLVED_METHODS
+static Exception* bound_invocation(const SubstitutionMethod* sub,
+                                   bool special,
+                                   Invocation& call)
+{
+    if (special and load_operand(sub->operand_count_ - 1) == nullptr) {
+        pop_operands(sub->operand_count_);
+        return make_exception("java/lang/NullPointerException", "");
+    }
+
+    call.clz_ = sub->class_;
+    call.method_ = sub->method_;
+    call.argc_.operand_count_ = sub->operand_count_;
+    call.type_signature_ = Slice();
+    call.code_ = sub->code_;
+#if JVM_QUICKEN_BYTECODE
+    call.quick_ = sub->quick_;
+#else
+    call.quick_ = nullptr;
+#endif
+
+    return nullptr;
+}
+
+
+
+// For invokestatic and invokespecial, which call the same method every time.
+// The first call through a Methodref looks up the method by name, and binds
+// the result to the constant pool entry. See SubstitutionMethod.
+static Exception*
+resolve_direct(Class* clz, u16 method_index, bool special, Invocation& call)
+{
+    if (auto sub = clz->constants_->load_method(method_index)) {
+        return bound_invocation(sub, special, call);
+    }
+
+    if (auto exn = resolve_method(clz, method_index, true, special, call)) {
+        return exn;
+    }
+
+#if JVM_GC_REFERENCE_MAPS
+    if (is_native(call.method_)) {
+        // The gc types a native method's locals by the caller's descriptor,
+        // which the binding doesn't keep.
+        return nullptr;
+    }
+#endif
+
+    call.code_ = code_attribute(call.clz_, call.method_);
+
+    // NOTE: Allocating class memory may run the gc, which finds the call's
+    // arguments still on the operand stack.
+
+#if JVM_QUICKEN_BYTECODE
+    // Quickened now, rather than on entry, so that the binding can carry the
+    // quickened code.
+    if (call.code_) {
+        call.quick_ = quicken_method(call.clz_, call.method_, call.code_);
+    }
+#endif
+
+    auto sub = classmemory::allocate<SubstitutionMethod>();
+    sub->class_ = call.clz_;
+    sub->method_ = call.method_;
+    sub->code_ = call.code_;
+#if JVM_QUICKEN_BYTECODE
+    sub->quick_ = call.quick_;
+#endif
+    sub->operand_count_ = call.argc_.operand_count_;
+
+    clz->constants_->bind_method(method_index, sub);
+
+    return nullptr;
+}
+#endif
+
+
+
+#if JVM_VTABLES
+// For invokevirtual. The first call through a Methodref looks up the method by
+// name, and records its vtable index, which holds for any receiver, as
+// subclasses keep the indices of inherited methods. Later calls index the
+// receiver's vtable.
+static Exception* resolve_virtual(Class* clz, u16 method_index, Invocation& call)
+{
+    auto site = clz->lookup_virtual_call(method_index);
+
+    if (site and site->operand_count_) {
+        auto self = (Object*)load_operand(site->operand_count_ - 1);
+
+        if (self == nullptr) {
+            pop_operands(site->operand_count_);
+            return make_exception("java/lang/NullPointerException", "");
+        }
+
+        if (site->vtable_index_ not_eq Class::VirtualCall::not_in_vtable and
+            self->class_->link_vtable()) {
+
+            auto& entry = self->class_->vtable_[site->vtable_index_];
+
+            call.clz_ = entry.class_;
+            call.method_ = entry.method_;
+            call.argc_.operand_count_ = site->operand_count_;
+            call.type_signature_ = Slice();
+            call.code_ = nullptr;
+            call.quick_ = nullptr;
+
+#if JVM_GC_REFERENCE_MAPS
+            if (is_native(entry.method_)) {
+                // The gc types a native method's locals by the caller's
+                // descriptor.
+                call.type_signature_ = method_descriptor(clz, method_index);
+            }
+#endif
+
+            return nullptr;
+        }
+    }
+
+    if (auto exn = resolve_method(clz, method_index, false, false, call)) {
+        return exn;
+    }
+
+    auto receiver = ((Object*)load_operand(call.argc_.operand_count_ - 1))
+                        ->class_;
+
+    if (site and site->operand_count_ == 0 and receiver->link_vtable()) {
+        // Private methods aren't in the vtable, those calls will always
+        // take the slow path.
+        for (int i = 0; i < receiver->vtable_size_; ++i) {
+            if (receiver->vtable_[i].method_ == call.method_) {
+                site->vtable_index_ = i;
+                break;
+            }
+        }
+        site->operand_count_ = call.argc_.operand_count_;
+    }
+
+    return nullptr;
+}
+#endif
+
+
+
+#if JVM_ITABLES
+// The index in a class's vtable of the method named by a referencing class's
+// NameAndType constant, or -1.
+static int vtable_index(Class* clz,
+                        Class* referencing_class,
+                        const ClassFile::ConstantNameAndType* nt)
+{
+    for (int i = 0; i < clz->vtable_size_; ++i) {
+        auto& entry = clz->vtable_[i];
+        auto c = entry.class_->constants_;
+        if (same_string(*c,
+                        entry.method_->name_index_.get(),
+                        *referencing_class->constants_,
+                        nt->name_index_.get()) and
+            same_string(*c,
+                        entry.method_->descriptor_index_.get(),
+                        *referencing_class->constants_,
+                        nt->descriptor_index_.get())) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+
+// For invokeinterface. The first call through an InterfaceMethodref looks up
+// the method by name, and records the interface that declares it, along with
+// the method's index in the interface's vtable. Later calls look up the
+// receiver's itable for the interface, and take the method at that index.
+static Exception*
+resolve_interface(Class* clz, u16 method_index, Invocation& call)
+{
+    auto site = clz->lookup_interface_call(method_index);
+
+    if (site and site->interface_) {
+        auto self = (Object*)load_operand(site->operand_count_ - 1);
+
+        if (self == nullptr) {
+            pop_operands(site->operand_count_);
+            return make_exception("java/lang/NullPointerException", "");
+        }
+
+        if (self->class_->link_itables()) {
+            if (auto entry = self->class_->lookup_itable(
+                    site->interface_, site->method_index_)) {
+
+                call.clz_ = entry->class_;
+                call.method_ = entry->method_;
+                call.argc_.operand_count_ = site->operand_count_;
+                call.type_signature_ = Slice();
+                call.code_ = nullptr;
+                call.quick_ = nullptr;
+
+#if JVM_GC_REFERENCE_MAPS
+                if (is_native(entry->method_)) {
+                    call.type_signature_ =
+                        method_descriptor(clz, method_index);
+                }
+#endif
+
+                return nullptr;
+            }
+        }
+    }
+
+    if (auto exn = resolve_method(clz, method_index, false, false, call)) {
+        return exn;
+    }
+
+    if (site and site->interface_ == nullptr) {
+        auto ref =
+            (const ClassFile::ConstantRef*)clz->constants_->load(method_index);
+        auto nt = (const ClassFile::ConstantNameAndType*)clz->constants_->load(
+            ref->name_and_type_index_.get());
+
+        auto interface = load_class(clz, ref->class_index_.get());
+
+        if (interface and interface->link_itables()) {
+            // The method may be declared by a superinterface.
+            auto declaring = interface;
+            int index = vtable_index(interface, clz, nt);
+
+            for (int i = 0; index < 0 and i < interface->itable_count_; ++i) {
+                declaring = interface->itables_[i].interface_;
+                index = vtable_index(declaring, clz, nt);
+            }
+
+            if (index >= 0) {
+                site->interface_ = declaring;
+                site->method_index_ = index;
+                site->operand_count_ = call.argc_.operand_count_;
+            }
+        }
+    }
+
+    return nullptr;
+}
+#endif
+
+
+
+#if JVM_INLINE_CACHES
+using InlineCache = Class::OptionQuickenedCode::InlineCache;
+
+
+
+// Give an invokevirtual or invokeinterface instruction in quickened code an
+// inline cache, and rewrite the instruction to call through the cache. The
+// cache starts out empty, the first call fills it in.
+static bool quicken_invoke(Class* clz,
+                           Class::OptionQuickenedCode* quick,
+                           u32 pc,
+                           u16 method_index)
+{
+    if (quick->inline_cache_count_ == quick->inline_cache_capacity_) {
+        return false;
+    }
+
+    const u16 index = quick->inline_cache_count_++;
+
+    auto& cache = quick->inline_caches_[index];
+    cache = InlineCache{};
+    cache.constant_index_ = method_index;
+    cache.operand_count_ =
+        argument_info(method_descriptor(clz, method_index)).operand_count_ +
+        1; // +1 for self
+
+    auto code = quick->code_;
+
+    code[pc] = code[pc] == Bytecode::invokevirtual
+                   ? Bytecode::invokevirtual_quick
+                   : Bytecode::invokeinterface_quick;
+
+    write_quick_operand(code, pc, index);
+
+    return true;
+}
+
+
+
+// Remember the method that a call resolved to, for the receiver's class. A
+// call site that has seen more receiver classes than the cache holds, or that
+// would need more class memory than the quickened code budget has left, stops
+// caching for good.
+static void cache_receiver(InlineCache& cache,
+                           Class* receiver,
+                           const Invocation& call)
+{
+    const InlineCache::Entry entry = {receiver, call.clz_, call.method_};
+
+    if (cache.receivers_ == 0) {
+        cache.monomorphic_ = entry;
+        cache.receivers_ = 1;
+        return;
+    }
+
+    if (cache.receivers_ == JVM_INLINE_CACHE_SIZE) {
+        cache.receivers_ = InlineCache::megamorphic;
+        return;
+    }
+
+    if (cache.polymorphic_ == nullptr) {
+        const u32 cost =
+            sizeof(InlineCache::Entry) * (JVM_INLINE_CACHE_SIZE - 1);
+
+        if (quickened_code_bytes + cost > JVM_QUICKENED_CODE_BUDGET) {
+            cache.receivers_ = InlineCache::megamorphic;
+            return;
+        }
+
+        quickened_code_bytes += cost;
+
+        cache.polymorphic_ = (InlineCache::Entry*)classmemory::allocate(
+            cost, alignof(InlineCache::Entry));
+    }
+
+    cache.polymorphic_[cache.receivers_ - 1] = entry;
+    ++cache.receivers_;
+}
+
+
+
+#if JVM_DEVIRTUALIZE
+// Class hierarchy analysis. Whether every loaded subclass of a class inherits
+// the method at a vtable index, rather than overriding it. A subclass that
+// hasn't built its vtable yet might override it, for all we know.
+static bool is_leaf_method(Class* clz, u16 vtable_index)
+{
+    struct Context {
+        Class* clz_;
+        const ClassFile::MethodInfo* method_;
+        u16 index_;
+        bool leaf_;
+    } context = {clz, clz->vtable_[vtable_index].method_, vtable_index, true};
+
+    classtable::visit(
+        [](Slice, Class* other, void* arg) {
+            auto context = (Context*)arg;
+
+            for (auto current = other->super_; current;
+                 current = current->super_) {
+                if (current == context->clz_) {
+                    if (not(other->flags_ & Class::Flag::has_vtable) or
+                        other->vtable_[context->index_].method_ not_eq
+                            context->method_) {
+                        context->leaf_ = false;
+                    }
+                    break;
+                }
+            }
+        },
+        &context);
+
+    return context.leaf_;
+}
+
+
+
+// Bind an invokevirtual's empty inline cache to the method that the call
+// resolved to, if the method is final, or if no loaded class overrides it.
+// The Methodref's class must implement the method itself, else receivers of
+// that class would call a different method.
+static bool
+devirtualize(Class* clz, InlineCache& cache, const Invocation& call)
+{
+    auto ref =
+        (const ClassFile::ConstantRef*)clz->constants_->load(
+            cache.constant_index_);
+
+    if (classname(clz, ref->class_index_.get()).ptr_[0] == '[') {
+        // Arrays, e.g. clone(), have no class of their own.
+        return false;
+    }
+
+    auto target = load_class(clz, ref->class_index_.get());
+
+    if (target == nullptr or not target->link_vtable()) {
+        return false;
+    }
+
+    int index = -1;
+    for (int i = 0; i < target->vtable_size_; ++i) {
+        if (target->vtable_[i].method_ == call.method_) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index < 0) {
+        // Not the target's own method, or not in the vtable at all (private
+        // methods).
+        return false;
+    }
+
+    const bool is_final = call.method_->access_flags_.get() & 0x0010;
+
+    if (not is_final and not is_leaf_method(target, index)) {
+        return false;
+    }
+
+    cache.monomorphic_ = {nullptr, call.clz_, call.method_};
+    cache.receivers_ = InlineCache::devirtualized;
+
+    return true;
+}
+
+
+
+void invalidate_devirtualized_calls(const ClassFile::MethodInfo* method)
+{
+    classtable::visit(
+        [](Slice, Class* clz, void* arg) {
+            clz->visit_quickened_code([arg](Class::OptionQuickenedCode* quick) {
+                for (int i = 0; i < quick->inline_cache_count_; ++i) {
+                    auto& cache = quick->inline_caches_[i];
+
+                    if (cache.receivers_ == InlineCache::devirtualized and
+                        cache.monomorphic_.method_ == arg) {
+                        // Starts over as an empty inline cache.
+                        cache.receivers_ = 0;
+                    }
+                }
+            });
+        },
+        (void*)method);
+}
+#endif // JVM_DEVIRTUALIZE
+
+
+
+// For invokevirtual_quick and invokeinterface_quick. A call whose receiver
+// class is in the inline cache takes the cached method, anything else resolves
+// the call as the original instruction would have, and updates the cache.
+static Exception*
+resolve_cached(Class* clz, InlineCache& cache, bool interface, Invocation& call)
+{
+    auto self = (Object*)load_operand(cache.operand_count_ - 1);
+
+    if (self == nullptr) {
+        pop_operands(cache.operand_count_);
+        return make_exception("java/lang/NullPointerException", "");
+    }
+
+    auto receiver = self->class_;
+
+    const InlineCache::Entry* hit = nullptr;
+
+    if (cache.receivers_ == InlineCache::devirtualized) {
+        hit = &cache.monomorphic_;
+    } else if (cache.receivers_ not_eq InlineCache::megamorphic) {
+        if (cache.receivers_ and cache.monomorphic_.receiver_ == receiver) {
+            hit = &cache.monomorphic_;
+        } else {
+            for (int i = 0; i < cache.receivers_ - 1; ++i) {
+                if (cache.polymorphic_[i].receiver_ == receiver) {
+                    hit = &cache.polymorphic_[i];
+                    break;
+                }
+            }
+        }
+    }
+
+    if (hit) {
+#if JVM_INLINE_CACHE_STATS
+        ++cache.hits_;
+#endif
+        call.clz_ = hit->class_;
+        call.method_ = hit->method_;
+        call.argc_.operand_count_ = cache.operand_count_;
+        call.type_signature_ = Slice();
+        call.code_ = nullptr;
+        call.quick_ = nullptr;
+
+#if JVM_GC_REFERENCE_MAPS
+        if (is_native(hit->method_)) {
+            call.type_signature_ =
+                method_descriptor(clz, cache.constant_index_);
+        }
+#endif
+
+        return nullptr;
+    }
+
+#if JVM_INLINE_CACHE_STATS
+    ++cache.misses_;
+#endif
+
+#if JVM_ITABLES
+    auto exn = interface ? resolve_interface(clz, cache.constant_index_, call)
+                         : resolve_virtual(clz, cache.constant_index_, call);
+#elif JVM_VTABLES
+    auto exn =
+        interface
+            ? resolve_method(clz, cache.constant_index_, false, false, call)
+            : resolve_virtual(clz, cache.constant_index_, call);
+#else
+    (void)interface;
+    auto exn = resolve_method(clz, cache.constant_index_, false, false, call);
+#endif
+
+    if (exn) {
+        return exn;
+    }
+
+#if JVM_DEVIRTUALIZE
+    if (cache.receivers_ == 0 and not interface and
+        devirtualize(clz, cache, call)) {
+        return nullptr;
     }
+#endif
+
+    if (cache.receivers_ not_eq InlineCache::megamorphic) {
+        cache_receiver(cache, receiver, call);
+    }
+
+    return nullptr;
 }
+#endif // JVM_INLINE_CACHES
 
 
 
-static Exception* dispatch_method(Class* clz,
-                                  u16 method_index,
-                                  bool direct_dispatch,
-                                  bool special)
+static Exception* invoke_method(const Invocation& call)
 {
+    return invoke_method(
+        call.clz_, call.method_, call.argc_, call.type_signature_);
+}
 
-    auto ref =
-        (const ClassFile::ConstantRef*)clz->constants_->load(method_index);
-
-    auto nt = (const ClassFile::ConstantNameAndType*)clz->constants_->load(
-        ref->name_and_type_index_.get());
 
-    auto lhs_name = clz->constants_->load_string(nt->name_index_.get());
-    auto lhs_type = clz->constants_->load_string(nt->descriptor_index_.get());
 
-    return dispatch_method(
-        clz, lhs_name, lhs_type, direct_dispatch, special, ref);
+static Exception* dispatch_method(Class* clz,
+                                  Slice method_name,
+                                  Slice method_type,
+                                  bool direct_dispatch,
+                                  bool special,
+                                  const ClassFile::ConstantRef* ref)
+{
+    Invocation call;
+    if (auto exn = resolve_method(clz,
+                                  method_name,
+                                  method_type,
+                                  symboltable::intern(method_name),
+                                  symboltable::intern(method_type),
+                                  direct_dispatch,
+                                  special,
+                                  ref,
+                                  call)) {
+        return exn;
+    }
+    return invoke_method(call);
 }
 
 
 
-static Exception* invoke_special(Class* clz, u16 method_index)
+static Exception* dispatch_method(Class* clz,
+                                  u16 method_index,
+                                  bool direct_dispatch,
+                                  bool special)
 {
-    return dispatch_method(clz, method_index, true, true);
+    Invocation call;
+    if (auto exn = resolve_method(
+            clz, method_index, direct_dispatch, special, call)) {
+        return exn;
+    }
+    return invoke_method(call);
 }
 
 
@@ -1122,6 +4444,10 @@ static Object* make_instance_impl(Class* clz)
     if (mem == nullptr) {
         unhandled_error("oom");
     }
+    // Fields must start out zeroed. The heap is not cleared after a gc
+    // compaction, so memory freshly handed out by the allocator may contain
+    // stale data from previously collected objects.
+    memset((void*)mem, 0, instance_size);
     new (mem) Object(clz);
     return mem;
 }
@@ -1187,6 +4513,8 @@ static Object* make_string(Slice data)
     // constructor with the array. In this way, the entire string class can
     // be written in java.
 
+    HostFrame frame;
+
     {
         auto array = Array::create(data.length_, 1, Array::Type::t_char);
 
@@ -1221,8 +4549,7 @@ static Object* make_string(Slice data)
         ArgumentInfo argc;
         argc.argument_count_ = 2;
         argc.operand_count_ = 2;
-        auto exn = invoke_method(
-            string_class, (Object*)load_operand(1), mtd, argc, ctor_typeinfo);
+        auto exn = invoke_method(string_class, mtd, argc, ctor_typeinfo);
         if (exn) {
             unhandled_error("exception from String(char[])");
         }
@@ -1240,6 +4567,8 @@ static Object* make_string(Slice data)
 
 static Exception* make_exception(const char* classpath, const char* error)
 {
+    HostFrame frame;
+
     push_operand_a(*(Object*)make_string(Slice::from_c_str(error)));
     push_operand_a(
         *make_instance_impl(load_class_by_name(Slice::from_c_str(classpath))));
@@ -1253,8 +4582,7 @@ static Exception* make_exception(const char* classpath, const char* error)
         ArgumentInfo argc;
         argc.argument_count_ = 2;
         argc.operand_count_ = 2;
-        auto exn = invoke_method(
-            clz, (Object*)load_operand(1), mtd, argc, ctor_typeinfo);
+        auto exn = invoke_method(clz, mtd, argc, ctor_typeinfo);
         if (exn) {
             unhandled_error("exception while constructing exception!?");
         }
@@ -1306,7 +4634,7 @@ static void ldc1(Class* clz, u16 index)
 
 static void __push_double_from_aligned_bytevector(void* d)
 {
-    push_wide_operand_d(*(double*)d);
+    push_wide_operand_d(__load_wide_operand_d_impl(d));
 }
 
 
@@ -1336,8 +4664,23 @@ static void ldc2(Class* clz, u16 index)
 
 
 
+// Whether every array is an instance of the class: java/lang/Object, and the
+// interfaces that arrays implement.
+static bool is_array_supertype(Slice class_name)
+{
+    return class_name == Slice::from_c_str("java/lang/Object") or
+           class_name == Slice::from_c_str("java/lang/Cloneable") or
+           class_name == Slice::from_c_str("java/io/Serializable");
+}
+
+
+
 static bool primitive_array_type_compare(Array* array, Slice typedescriptor)
 {
+    if (is_array_supertype(typedescriptor)) {
+        return true;
+    }
+
     if (typedescriptor.length_ == 2) {
         if (typedescriptor.ptr_[0] not_eq '[') {
             return false;
@@ -1372,57 +4715,65 @@ static bool primitive_array_type_compare(Array* array, Slice typedescriptor)
 
 static bool reference_array_type_compare(Array* array, Slice typedescriptor)
 {
-    [[maybe_unused]] auto c = array->metadata_.class_type_;
+    if (is_array_supertype(typedescriptor)) {
+        return true;
+    }
 
-    if (typedescriptor.length_ > 2) {
-        // NOTE: The ref array class type desc begins with "[L"
-        typedescriptor.ptr_ += 2;
-        typedescriptor.length_ -= 2;
+    // NOTE: Read the element class before loading anything, which may run the
+    // gc, and relocate the array.
+    auto c = array->metadata_.class_type_;
+
+    if (typedescriptor.length_ < 2 or typedescriptor.ptr_[0] not_eq '[') {
+        return false;
+    }
 
-        // TODO...
+    // NOTE: Arrays of arrays don't record their elements' type beyond being
+    // arrays (see multianewarray), so we accept any array of arrays.
+    const bool nested =
+        c == nullptr or c == &reference_array_class or c == &primitive_array_class;
 
-        return true;
-    } else {
+    if (typedescriptor.ptr_[1] == '[') {
+        return nested;
+    }
+
+    // NOTE: The ref array class type desc begins with "[L", and ends with ';'.
+    if (typedescriptor.length_ < 4 or typedescriptor.ptr_[1] not_eq 'L') {
         return false;
     }
-}
 
+    typedescriptor.ptr_ += 2;
+    typedescriptor.length_ -= 3;
 
+    if (typedescriptor == Slice::from_c_str("java/lang/Object")) {
+        return true;
+    }
 
-bool checkcast(Object* obj, Slice class_name)
-{
+    if (nested) {
+        return false;
+    }
 
-    if (obj->class_ == &primitive_array_class) {
-        return primitive_array_type_compare((Array*)obj, class_name);
-    } else if (obj->class_ == &reference_array_class) {
-        return reference_array_type_compare((Array*)obj, class_name);
+    if (auto other = load_class_by_name(typedescriptor)) {
+        return is_subtype(c, other);
     }
 
-    {
-        auto other = load_class_by_name(class_name);
+    return false;
+}
 
-        // First pass: direct inheritance
-        auto current = obj->class_;
-        while (current) {
-            if (current == other) {
-                return true;
-            }
-            current = current->super_;
-        }
 
-        // Second pass: check interfaces (slower)
-        current = obj->class_;
-        while (current) {
-            if (auto interfaces = current->interfaces()) {
-                auto vals = (network_u16*)((u8*)interfaces +
-                                           sizeof(ClassFile::HeaderSection2));
-                for (int i = 0; i < interfaces->interfaces_count_.get(); ++i) {
-                    if (class_name == classname(current, vals[i].get())) {
-                        return true;
-                    }
-                }
+
+// Whether other is among the interfaces that clz declares, or among their
+// superinterfaces.
+static bool implements_interface(Class* clz, Class* other)
+{
+    if (auto interfaces = clz->interfaces()) {
+        auto vals = (network_u16*)((u8*)interfaces +
+                                   sizeof(ClassFile::HeaderSection2));
+        for (int i = 0; i < interfaces->interfaces_count_.get(); ++i) {
+            auto interface = load_class_by_name(classname(clz, vals[i].get()));
+            if (interface == other or
+                (interface and implements_interface(interface, other))) {
+                return true;
             }
-            current = current->super_;
         }
     }
 
@@ -1431,27 +4782,36 @@ bool checkcast(Object* obj, Slice class_name)
 
 
 
-bool instanceof (Object * obj, Class* clz)
+// Whether instances of clz are instances of other: other is clz, a superclass,
+// or an interface that clz implements.
+static bool is_subtype(Class* clz, Class* other)
 {
-    auto current = obj->class_;
+#if JVM_SUBTYPE_DISPLAY
+    if (clz->link_subtypes() and other->link_subtypes()) {
+        return clz->is_subtype_of(other);
+    }
+#endif
+
+    // First pass: direct inheritance
+    auto current = clz;
     while (current) {
-        if (current == clz) {
+        if (current == other) {
             return true;
         }
         current = current->super_;
     }
 
-    current = obj->class_;
+#if JVM_ITABLES
+    if (clz->link_itables()) {
+        return clz->implements(other);
+    }
+#endif
+
+    // Second pass: check interfaces (slower)
+    current = clz;
     while (current) {
-        if (auto interfaces = current->interfaces()) {
-            auto vals = (network_u16*)((u8*)interfaces +
-                                       sizeof(ClassFile::HeaderSection2));
-            for (int i = 0; i < interfaces->interfaces_count_.get(); ++i) {
-                if (clz ==
-                    load_class_by_name(classname(current, vals[i].get()))) {
-                    return true;
-                }
-            }
+        if (implements_interface(current, other)) {
+            return true;
         }
         current = current->super_;
     }
@@ -1461,9 +4821,66 @@ bool instanceof (Object * obj, Class* clz)
 
 
 
+bool checkcast(Object* obj, Slice class_name)
+{
+
+    if (obj->class_ == &primitive_array_class) {
+        return primitive_array_type_compare((Array*)obj, class_name);
+    } else if (obj->class_ == &reference_array_class) {
+        return reference_array_type_compare((Array*)obj, class_name);
+    }
+
+    // NOTE: Read the object's class before loading anything, which may run the
+    // gc, and relocate the object.
+    auto clz = obj->class_;
+
+    if (auto other = load_class_by_name(class_name)) {
+        return is_subtype(clz, other);
+    }
+
+    return false;
+}
+
+
+
+bool instanceof (Object * obj, Class* clz)
+{
+    return is_subtype(obj->class_, clz);
+}
+
+
+
+#if JVM_SUBTYPE_DISPLAY
+// The type check at a checkcast_quick or instanceof_quick, see
+// quicken_type_check().
+static bool quick_type_check(Object* obj, Class::OptionQuickenedCode::Slot* site)
+{
+    auto clz = obj->class_;
+
+    if (clz == site[1].class_) {
+        return true;
+    }
+
+    if (clz == &primitive_array_class or clz == &reference_array_class) {
+        // Rare enough, e.g. an array cast to java/lang/Object, that we don't
+        // mind looking up the class's name.
+        return checkcast(obj, classtable::name(site[0].class_));
+    }
+
+    if (is_subtype(clz, site[0].class_)) {
+        site[1].class_ = clz;
+        return true;
+    }
+
+    return false;
+}
+#endif
+
+
+
+// NOTE: Expects the exception on top of the operand stack.
 static const ClassFile::ExceptionTableEntry*
 find_exception_handler(Class* clz,
-                       Object* exception,
                        u32 pc,
                        const ClassFile::ExceptionTable* exception_table)
 {
@@ -1476,7 +4893,10 @@ find_exception_handler(Class* clz,
 
         if (pc >= entry.start_pc_.get() and pc < entry.end_pc_.get()) {
             auto catch_clz = load_class(clz, entry.catch_type_.get());
-            if (instanceof (exception, catch_clz)) {
+
+            // Loading the class may have run the gc, which would relocate the
+            // exception, so we need to read it from the stack afterwards.
+            if (instanceof ((Object*)load_operand(0), catch_clz)) {
                 return &entry;
             }
         }
@@ -1487,20 +4907,33 @@ find_exception_handler(Class* clz,
 
 
 
+// Search for a handler for the exception on top of the operand stack. The
+// method's other operands are discarded either way, leaving the exception
+// alone on the stack, which is what the handler's bytecode expects.
 static bool handle_exception(Class* clz,
-                             Exception* exn,
                              u32& pc,
-                             const ClassFile::ExceptionTable* exception_table)
+                             const ClassFile::ExceptionTable* exception_table,
+                             u32 operand_base)
 {
-    auto handler = find_exception_handler(clz, exn, pc, exception_table);
+    auto exn = (Object*)load_operand(0);
+    while (__operand_stack.size() > operand_base) {
+        pop_operand();
+    }
+    push_operand_a(*exn);
+
+#if JVM_GC_REFERENCE_MAPS
+    frames.back().unwinding_ = true;
+#endif
+
+    auto handler = find_exception_handler(clz, pc, exception_table);
+
+#if JVM_GC_REFERENCE_MAPS
+    frames.back().unwinding_ = false;
+#endif
+
     if (handler) {
-        // Subsequent bytecode will expect to be able to load the
-        // exception object into a local variable, so push it onto
-        // the stack.
-        push_operand_a(*(Object*)exn);
         pc = handler->handler_pc_.get();
         return true;
-
     } else {
         return false;
     }
@@ -1590,10 +5023,66 @@ static void array_index_exn_msg(int index, char buffer[80])
 
 
 
+#if JVM_ENABLE_DEBUGGING
+#define JVM_DEBUGGER_UPDATE() debugger::update(clz, frames.back().method_, pc)
+#else
+#define JVM_DEBUGGER_UPDATE()
+#endif
+
+
+// With threaded dispatch, each opcode handler jumps directly to the handler
+// for the next instruction through a table of label addresses, rather than
+// looping back around to the switch statement. Every handler ends up with its
+// own indirect branch, which the host's branch predictor handles much better
+// than the single shared jump of a switch. Labels-as-values is a gcc/clang
+// extension, so we keep the switch around as a fallback, and each handler is
+// written so that it works either way: JVM_OPCODE() declares the case label
+// (plus a jump target), and JVM_DISPATCH() ends the handler.
+#if JVM_THREADED_DISPATCH
+#define JVM_OPCODE(OP)                                                         \
+    case Bytecode::OP:                                                         \
+    op_##OP
+#define JVM_DISPATCH()                                                         \
+    do {                                                                       \
+        JVM_DEBUGGER_UPDATE();                                                 \
+        goto* dispatch_table[bytecode[pc]];                                    \
+    } while (false)
+#else
+#define JVM_OPCODE(OP) case Bytecode::OP
+#define JVM_DISPATCH() break
+#endif
+
+// Run the instruction at pc again, without notifying the debugger a second
+// time. Used after quickening an instruction in place.
+#define JVM_REDISPATCH() goto REDISPATCH
+
+
+
+#if JVM_THREADED_DISPATCH
+// Taking the address of a label is non-standard, and -pedantic would warn about
+// every entry in the dispatch table.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+
+
+static u32 invoke_length(u8 opcode)
+{
+    return opcode == Bytecode::invokeinterface or
+                   opcode == Bytecode::invokeinterface_quick
+               ? 5
+               : 3;
+}
+
+
+
+template <typename Operands>
 static Exception*
 execute_bytecode(Class* clz,
                  const u8* bytecode,
-                 const ClassFile::ExceptionTable* exception_table)
+                 const ClassFile::ExceptionTable* exception_table,
+                 Class::OptionQuickenedCode* quick)
 {
 #define JVM_THROW_EXN(CPATH, MSG)                                              \
     push_operand_a(*make_exception(CPATH, MSG));                               \
@@ -1606,62 +5095,207 @@ execute_bytecode(Class* clz,
         JVM_THROW_EXN("java/lang/ArrayIndexOutOfBoundsException", buffer);     \
     }
 
+#if JVM_THREADED_DISPATCH
+    // Indexed by opcode. Unimplemented opcodes land in the default case.
+    // clang-format off
+    static const void* const dispatch_table[256] = {
+        /* 0x00 */ &&op_nop, &&op_aconst_null, &&op_iconst_m1, &&op_iconst_0,
+        /* 0x04 */ &&op_iconst_1, &&op_iconst_2, &&op_iconst_3, &&op_iconst_4,
+        /* 0x08 */ &&op_iconst_5, &&op_lconst_0, &&op_lconst_1, &&op_fconst_0,
+        /* 0x0c */ &&op_fconst_1, &&op_fconst_2, &&op_dconst_0, &&op_dconst_1,
+        /* 0x10 */ &&op_bipush, &&op_sipush, &&op_ldc, &&op_ldc_w,
+        /* 0x14 */ &&op_ldc2_w, &&op_iload, &&op_lload, &&op_fload,
+        /* 0x18 */ &&op_dload, &&op_aload, &&op_iload_0, &&op_iload_1,
+        /* 0x1c */ &&op_iload_2, &&op_iload_3, &&op_lload_0, &&op_lload_1,
+        /* 0x20 */ &&op_lload_2, &&op_lload_3, &&op_fload_0, &&op_fload_1,
+        /* 0x24 */ &&op_fload_2, &&op_fload_3, &&op_dload_0, &&op_dload_1,
+        /* 0x28 */ &&op_dload_2, &&op_dload_3, &&op_aload_0, &&op_aload_1,
+        /* 0x2c */ &&op_aload_2, &&op_aload_3, &&op_iaload, &&op_laload,
+        /* 0x30 */ &&op_faload, &&op_daload, &&op_aaload, &&op_baload,
+        /* 0x34 */ &&op_caload, &&op_saload, &&op_istore, &&op_lstore,
+        /* 0x38 */ &&op_fstore, &&op_dstore, &&op_astore, &&op_istore_0,
+        /* 0x3c */ &&op_istore_1, &&op_istore_2, &&op_istore_3, &&op_lstore_0,
+        /* 0x40 */ &&op_lstore_1, &&op_lstore_2, &&op_lstore_3, &&op_fstore_0,
+        /* 0x44 */ &&op_fstore_1, &&op_fstore_2, &&op_fstore_3, &&op_dstore_0,
+        /* 0x48 */ &&op_dstore_1, &&op_dstore_2, &&op_dstore_3, &&op_astore_0,
+        /* 0x4c */ &&op_astore_1, &&op_astore_2, &&op_astore_3, &&op_iastore,
+        /* 0x50 */ &&op_lastore, &&op_fastore, &&op_dastore, &&op_aastore,
+        /* 0x54 */ &&op_bastore, &&op_castore, &&op_sastore, &&op_pop,
+        /* 0x58 */ &&op_pop2, &&op_dup, &&op_dup_x1, &&op_dup_x2,
+        /* 0x5c */ &&op_dup2, &&op_dup2_x1, &&op_dup2_x2, &&op_swap,
+        /* 0x60 */ &&op_iadd, &&op_ladd, &&op_fadd, &&op_dadd,
+        /* 0x64 */ &&op_isub, &&op_lsub, &&op_fsub, &&op_dsub,
+        /* 0x68 */ &&op_imul, &&op_lmul, &&op_fmul, &&op_dmul,
+        /* 0x6c */ &&op_idiv, &&op_ldiv, &&op_fdiv, &&op_ddiv,
+        /* 0x70 */ &&op_irem, &&op_lrem, &&op_frem, &&op_drem,
+        /* 0x74 */ &&op_ineg, &&op_lneg, &&op_fneg, &&op_dneg,
+        /* 0x78 */ &&op_ishl, &&op_lshl, &&op_ishr, &&op_lshr,
+        /* 0x7c */ &&op_iushr, &&op_lushr, &&op_iand, &&op_land,
+        /* 0x80 */ &&op_ior, &&op_lor, &&op_ixor, &&op_lxor,
+        /* 0x84 */ &&op_iinc, &&op_i2l, &&op_i2f, &&op_i2d,
+        /* 0x88 */ &&op_l2i, &&op_l2f, &&op_l2d, &&op_f2i,
+        /* 0x8c */ &&op_f2l, &&op_f2d, &&op_d2i, &&op_d2l,
+        /* 0x90 */ &&op_d2f, &&op_invalid, &&op_i2c, &&op_i2s,
+        /* 0x94 */ &&op_lcmp, &&op_fcmpl, &&op_fcmpg, &&op_dcmpl,
+        /* 0x98 */ &&op_dcmpg, &&op_if_eq, &&op_if_ne, &&op_if_lt,
+        /* 0x9c */ &&op_if_ge, &&op_if_gt, &&op_if_le, &&op_if_icmpeq,
+        /* 0xa0 */ &&op_if_icmpne, &&op_if_icmplt, &&op_if_icmpge, &&op_if_icmpgt,
+        /* 0xa4 */ &&op_if_icmple, &&op_if_acmpeq, &&op_if_acmpne, &&op___goto,
+        /* 0xa8 */ &&op_jsr, &&op_ret, &&op_tableswitch, &&op_lookupswitch,
+        /* 0xac */ &&op_ireturn, &&op_lreturn, &&op_freturn, &&op_dreturn,
+        /* 0xb0 */ &&op_areturn, &&op_vreturn, &&op_getstatic, &&op_putstatic,
+        /* 0xb4 */ &&op_getfield, &&op_putfield, &&op_invokevirtual, &&op_invokespecial,
+        /* 0xb8 */ &&op_invokestatic, &&op_invokeinterface, &&op_invokedynamic, &&op_new_inst,
+        /* 0xbc */ &&op_newarray, &&op_anewarray, &&op_arraylength, &&op_athrow,
+        /* 0xc0 */ &&op_checkcast, &&op_instanceof, &&op_monitorenter, &&op_monitorexit,
+        /* 0xc4 */ &&op_invalid, &&op_multianewarray, &&op_if_null, &&op_if_nonnull,
+        /* 0xc8 */ &&op___goto_w, &&op_jsr_w, &&op_invalid, &&op_getfield_quick,
+        /* 0xcc */ &&op_getfield_quick_i, &&op_getfield_quick_a, &&op_getfield_quick_w, &&op_putfield_quick,
+        /* 0xd0 */ &&op_putfield_quick_i, &&op_putfield_quick_a, &&op_putfield_quick_w, &&op_getstatic_quick,
+        /* 0xd4 */ &&op_putstatic_quick, &&op_ldc_quick, &&op_ldc_w_quick, &&op_ldc2_w_quick,
+        /* 0xd8 */ &&op_aload_0_getfield, &&op_iinc_goto, &&op_iload_iload, &&op_iload_0_iload,
+        /* 0xdc */ &&op_iload_1_iload, &&op_iload_2_iload, &&op_iload_3_iload, &&op_aload_iload,
+        /* 0xe0 */ &&op_aload_0_iload, &&op_aload_1_iload, &&op_aload_2_iload, &&op_aload_3_iload,
+        /* 0xe4 */ &&op_invokevirtual_quick, &&op_invokeinterface_quick, &&op_invokestatic_quick, &&op_invokespecial_quick,
+        /* 0xe8 */ &&op_checkcast_quick, &&op_instanceof_quick, &&op_invalid, &&op_invalid,
+        /* 0xec */ &&op_invalid, &&op_invalid, &&op_invalid, &&op_invalid,
+        /* 0xf0 */ &&op_invalid, &&op_invalid, &&op_invalid, &&op_invalid,
+        /* 0xf4 */ &&op_invalid, &&op_invalid, &&op_invalid, &&op_invalid,
+        /* 0xf8 */ &&op_invalid, &&op_invalid, &&op_invalid, &&op_invalid,
+        /* 0xfc */ &&op_invalid, &&op_invalid, &&op_invalid, &&op_invalid,
+    };
+    // clang-format on
+#endif
+
     u32 pc = 0;
 
+    // The operand stack belongs to the caller below this point.
+    u32 operand_base = __operand_stack.size();
+
+    frames.back().pc_ = &pc;
+
+#if JVM_NONRECURSIVE_CALLS
+    // Frames above this one belong to methods that we called without leaving
+    // the interpreter loop. See INVOKE.
+    const u32 entry_depth = frames.size();
+
+    // Switch back to the method in the innermost frame, after its callee
+    // returned or threw. The method resumes at the invoke instruction.
+    auto resume = [&] {
+        auto& frame = frames.back();
+        clz = frame.clz_;
+        bytecode = frame.bytecode_;
+        exception_table = frame.exception_table_;
+        quick = frame.quick_;
+        operand_base = frame.operand_base_;
+        pc = frame.call_pc_;
+        frame.pc_ = &pc;
+    };
+#endif
+
+    Invocation call;
+
+    // Superinstruction handlers for the one and two byte forms of a local
+    // access share their code. The variant stores the local's index, and the
+    // pc of the sequence's second instruction, then jumps to the shared part.
+    u8 fused_local = 0;
+    u32 fused_pc = 0;
+
     while (true) {
 
-#if JVM_ENABLE_DEBUGGING
-        debugger::update(clz, callstack.back().second, pc);
+        JVM_DEBUGGER_UPDATE();
+
+    REDISPATCH:
+#if JVM_THREADED_DISPATCH
+        // Enter the threaded code. Handlers never return to the top of the
+        // loop, they jump directly to one another.
+        goto* dispatch_table[bytecode[pc]];
 #endif
 
         switch (bytecode[pc]) {
-        case Bytecode::nop:
+        JVM_OPCODE(nop):
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::pop:
+        JVM_OPCODE(pop):
             pop_operand();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::pop2:
+        JVM_OPCODE(pop2):
             pop_operand();
             pop_operand();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::swap:
+        JVM_OPCODE(swap):
             swap();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::ldc:
+        JVM_OPCODE(ldc):
+            if (quick and quicken_ldc(clz, quick, pc, bytecode[pc + 1])) {
+                JVM_REDISPATCH();
+            }
             ldc1(clz, bytecode[pc + 1]);
             pc += 2;
-            break;
+            JVM_DISPATCH();
+
+        JVM_OPCODE(ldc_w):
+            if (quick and quicken_ldc(clz,
+                                      quick,
+                                      pc,
+                                      Operands::u16_at(bytecode + pc + 1))) {
+                JVM_REDISPATCH();
+            }
+            ldc1(clz, Operands::u16_at(bytecode + pc + 1));
+            pc += 3;
+            JVM_DISPATCH();
+
+        JVM_OPCODE(ldc2_w):
+            if (quick and quicken_ldc(clz,
+                                      quick,
+                                      pc,
+                                      Operands::u16_at(bytecode + pc + 1))) {
+                JVM_REDISPATCH();
+            }
+            ldc2(clz, Operands::u16_at(bytecode + pc + 1));
+            pc += 3;
+            JVM_DISPATCH();
 
-        case Bytecode::ldc_w:
-            ldc1(clz, ((network_u16*)&bytecode[pc + 1])->get());
+        JVM_OPCODE(ldc_quick):
+            push_operand_i(quick->slots_[bytecode[pc + 1]].value_);
+            pc += 2;
+            JVM_DISPATCH();
+
+        JVM_OPCODE(ldc_w_quick):
+            push_operand_i(
+                quick->slots_[read_quick_operand(bytecode, pc)].value_);
             pc += 3;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::ldc2_w:
-            ldc2(clz, ((network_u16*)&bytecode[pc + 1])->get());
+        JVM_OPCODE(ldc2_w_quick): {
+            auto slots = quick->slots_ + read_quick_operand(bytecode, pc);
+            const s32 words[2] = {slots[0].value_, slots[1].value_};
+            s64 value;
+            memcpy(&value, words, sizeof value);
+            push_wide_operand_l(value);
             pc += 3;
-            break;
+            JVM_DISPATCH();
+        }
 
-        case Bytecode::new_inst:
+        JVM_OPCODE(new_inst):
             push_operand_a(
-                *make_instance(clz, ((network_u16*)&bytecode[pc + 1])->get()));
+                *make_instance(clz, Operands::u16_at(bytecode + pc + 1)));
             pc += 3;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::bipush:
-            push_operand_i((s32)bytecode[pc + 1]);
+        JVM_OPCODE(bipush):
+            push_operand_i((s8)bytecode[pc + 1]);
             pc += 2;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::anewarray: {
+        JVM_OPCODE(anewarray): {
             auto len = load_operand_i(0);
             pop_operand();
 
@@ -1670,7 +5304,7 @@ execute_bytecode(Class* clz,
                               "cannot instantiate array with negative size");
             }
 
-            auto c = load_class(clz, ((network_u16*)&bytecode[pc + 1])->get());
+            auto c = load_class(clz, Operands::u16_at(bytecode + pc + 1));
 
             auto array = Array::create(len, c);
 
@@ -1680,11 +5314,11 @@ execute_bytecode(Class* clz,
 
             push_operand_a(*(Object*)array);
             pc += 3;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::multianewarray: {
-            // auto c = load_class(clz, ((network_u16*)&bytecode[pc + 1])->get());
+        JVM_OPCODE(multianewarray): {
+            // auto c = load_class(clz, Operands::u16_at(bytecode + pc + 1));
             const u8 dimensions = bytecode[pc + 3];
 
             if (dimensions == 1) {
@@ -1715,7 +5349,7 @@ execute_bytecode(Class* clz,
                             outer_array(), i, dim, dimensions, [&](int dim) {
                                 auto cname = multi_nested_typename(classname(
                                     clz,
-                                    ((network_u16*)&bytecode[pc + 1])->get()));
+                                    Operands::u16_at(bytecode + pc + 1)));
                                 if (cname.length_ == 1) {
                                     Array::Type type;
                                     u8 size;
@@ -1800,10 +5434,10 @@ execute_bytecode(Class* clz,
             }
 
             pc += 4;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::newarray: {
+        JVM_OPCODE(newarray): {
             const int element_count = load_operand_i(0);
             pop_operand();
 
@@ -1842,10 +5476,10 @@ execute_bytecode(Class* clz,
 
             push_operand_a(*(Object*)array);
             pc += 2;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::arraylength: {
+        JVM_OPCODE(arraylength): {
             auto array = (Array*)load_operand(0);
             pop_operand();
 
@@ -1855,10 +5489,10 @@ execute_bytecode(Class* clz,
 
             push_operand_i(array->size_);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::aaload: {
+        JVM_OPCODE(aaload): {
             auto array = (Array*)load_operand(1);
             s32 index = load_operand_i(0);
 
@@ -1881,10 +5515,10 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::aastore: {
+        JVM_OPCODE(aastore): {
             auto array = (Array*)load_operand(2);
             auto value = (Object*)load_operand(0);
             s32 index = load_operand_i(1);
@@ -1907,151 +5541,212 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::aconst_null:
+        JVM_OPCODE(aconst_null):
             push_operand_p((void*)nullptr);
             pc += 1;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::athrow: {
+        JVM_OPCODE(athrow): {
         THROW:
-            auto exn = (Object*)load_operand(0);
-            pop_operand();
-
-            if (not handle_exception(clz, exn, pc, exception_table)) {
+            if (not handle_exception(clz, pc, exception_table, operand_base)) {
+#if JVM_NONRECURSIVE_CALLS
+                if (frames.size() > entry_depth) {
+                    // Unwind into the caller, and search its exception table.
+                    // The exception stays on top of the operand stack.
+                    pop_frame();
+                    resume();
+                    goto THROW;
+                }
+#endif
+                auto exn = (Object*)load_operand(0);
+                pop_operand();
                 return exn;
             }
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::checkcast: {
+        JVM_OPCODE(checkcast): {
             auto obj = (Object*)load_operand(0);
 
             if (obj == nullptr) {
                 // According to the JVM specification, checkcast for null is a
                 // no-op.
                 pc += 3;
-                break;
+                JVM_DISPATCH();
             }
 
-            pop_operand();
-
             auto cname =
-                classname(clz, ((network_u16*)&bytecode[pc + 1])->get());
+                classname(clz, Operands::u16_at(bytecode + pc + 1));
 
-            if (checkcast(obj, cname)) {
-                push_operand_a(*obj);
-                pc += 3;
-            } else {
+            if (not checkcast(obj, cname)) {
+                pop_operand();
                 JVM_THROW_EXN("java/lang/ClassCastException", "Bad cast");
             }
-            break;
+
+#if JVM_SUBTYPE_DISPLAY
+            if (quick) {
+                quicken_type_check(quick, pc, cname);
+            }
+#endif
+
+            pc += 3;
+            JVM_DISPATCH();
         }
 
-        case Bytecode:: instanceof: {
+        JVM_OPCODE(instanceof): {
             auto obj = (Object*)load_operand(0);
-            pop_operand();
 
             if (obj == nullptr) {
+                pop_operand();
                 push_operand_i(0);
                 pc += 3;
-                break;
+                JVM_DISPATCH();
             }
 
             auto cname =
-                classname(clz, ((network_u16*)&bytecode[pc + 1])->get());
-
-            if (obj->class_ == &primitive_array_class) {
-                push_operand_i(
-                    primitive_array_type_compare((Array*)obj, cname));
-            } else if (obj->class_ == &reference_array_class) {
-                push_operand_i(
-                    reference_array_type_compare((Array*)obj, cname));
-            } else {
-                auto other = load_class_by_name(cname);
-                push_operand_i(instanceof (obj, other));
+                classname(clz, Operands::u16_at(bytecode + pc + 1));
+
+            // NOTE: checkcast() may load the class, so we leave the object on
+            // the operand stack until afterwards, where the gc can find it.
+            const bool result = checkcast(obj, cname);
+
+            pop_operand();
+            push_operand_i(result);
+
+#if JVM_SUBTYPE_DISPLAY
+            if (quick) {
+                quicken_type_check(quick, pc, cname);
             }
+#endif
 
             pc += 3;
+            JVM_DISPATCH();
+        }
 
-            break;
+        JVM_OPCODE(checkcast_quick): {
+#if JVM_SUBTYPE_DISPLAY
+            auto obj = (Object*)load_operand(0);
+
+            if (obj and
+                not quick_type_check(
+                    obj, quick->slots_ + read_quick_operand(bytecode, pc))) {
+                pop_operand();
+                JVM_THROW_EXN("java/lang/ClassCastException", "Bad cast");
+            }
+
+            pc += 3;
+            JVM_DISPATCH();
+#else
+            invalid_bytecode_instruction(bytecode[pc], pc);
+#endif
+        }
+
+        JVM_OPCODE(instanceof_quick): {
+#if JVM_SUBTYPE_DISPLAY
+            auto obj = (Object*)load_operand(0);
+
+            const bool result =
+                obj and quick_type_check(
+                            obj,
+                            quick->slots_ + read_quick_operand(bytecode, pc));
+
+            pop_operand();
+            push_operand_i(result);
+
+            pc += 3;
+            JVM_DISPATCH();
+#else
+            invalid_bytecode_instruction(bytecode[pc], pc);
+#endif
         }
 
-        case Bytecode::dup:
+        JVM_OPCODE(dup):
             dup(0);
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::dup_x1:
+        JVM_OPCODE(dup_x1):
             dup_x1();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::dup_x2:
+        JVM_OPCODE(dup_x2):
             dup_x2();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::dup2_x1:
+        JVM_OPCODE(dup2_x1):
             dup2_x1();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::dup2_x2:
+        JVM_OPCODE(dup2_x2):
             dup2_x2();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::dup2:
+        JVM_OPCODE(dup2):
             // FiXME: loses info about whether operands are objects.
             dup(1);
             dup(1);
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::iconst_m1:
+        JVM_OPCODE(iconst_m1):
             push_operand_i(-1);
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::iconst_0:
+        JVM_OPCODE(iconst_0):
             push_operand_i(0);
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::iconst_1:
+        JVM_OPCODE(iconst_1):
             push_operand_i(1);
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::iconst_2:
+        JVM_OPCODE(iconst_2):
             push_operand_i(2);
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::iconst_3:
+        JVM_OPCODE(iconst_3):
             push_operand_i(3);
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::iconst_4:
+        JVM_OPCODE(iconst_4):
             push_operand_i(4);
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::iconst_5:
+        JVM_OPCODE(iconst_5):
             push_operand_i(5);
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::getfield: {
+        JVM_OPCODE(getfield): {
             // FIXME: getfield and putfield need to be refactored so that they
             // check the size of the field before trying to read/write it, so
             // that we know how many operand stack slots that we need to
             // read. The code currently works for most datatypes, but breaks for
             // long/double datatypes.
 
+            if (quick) {
+                quicken_field_access(
+                    clz, quick->code_, pc, Operands::u16_at(bytecode + pc + 1));
+                JVM_REDISPATCH();
+            }
+
+            const auto field = resolve_instance_field(
+                clz, Operands::u16_at(bytecode + pc + 1));
+
+            const auto sub = &field;
+
             auto arg = (Object*)load_operand(0);
             pop_operand();
 
@@ -2060,11 +5755,6 @@ execute_bytecode(Class* clz,
                               "Access to field in null object");
             }
 
-            auto c =
-                clz->constants_->load(((network_u16*)&bytecode[pc + 1])->get());
-
-            auto sub = (SubstitutionField*)c;
-
             u8* obj_ram = arg->data();
 
             if (sub->object_) {
@@ -2099,12 +5789,26 @@ execute_bytecode(Class* clz,
                 }
             }
             pc += 3;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::putfield: {
-            if (operand_type_category(0) ==
-                OperandTypeCategory::primitive_wide) {
+        JVM_OPCODE(putfield): {
+            if (quick) {
+                quicken_field_access(
+                    clz, quick->code_, pc, Operands::u16_at(bytecode + pc + 1));
+                JVM_REDISPATCH();
+            }
+
+            const auto field = resolve_instance_field(
+                clz, Operands::u16_at(bytecode + pc + 1));
+
+            const auto sub = &field;
+
+            // NOTE: The field's size tells us whether the operand is a
+            // long/double, we do not want to rely on operand type tags, which
+            // do not exist with JVM_GC_REFERENCE_MAPS.
+            if (not sub->object_ and
+                sub->size_ == SubstitutionField::Size::b8) {
 
                 // NOTE: I haven't tested this code for writing long/double,
                 // hopefully it actually works. TODO: unit tests...
@@ -2121,17 +5825,8 @@ execute_bytecode(Class* clz,
                                   "Access to field in null object");
                 }
 
-                auto c = clz->constants_->load(
-                    ((network_u16*)&bytecode[pc + 1])->get());
-
-                auto sub = (SubstitutionField*)c;
-
                 u8* obj_ram = obj->data();
 
-                if (sub->size_ not_eq SubstitutionField::Size::b8) {
-                    unhandled_error("VM logic error");
-                }
-
                 memcpy(obj_ram + sub->offset_, &value, sizeof(value));
 
             } else {
@@ -2142,14 +5837,10 @@ execute_bytecode(Class* clz,
                 pop_operand();
 
                 if (obj == nullptr) {
-                    return make_exception("java/lang/NullPointerException", "");
+                    JVM_THROW_EXN("java/lang/NullPointerException",
+                                  "Access to field in null object");
                 }
 
-                auto c = clz->constants_->load(
-                    ((network_u16*)&bytecode[pc + 1])->get());
-
-                auto sub = (SubstitutionField*)c;
-
                 u8* obj_ram = obj->data();
 
                 if (sub->object_) {
@@ -2180,138 +5871,406 @@ execute_bytecode(Class* clz,
                 }
             }
             pc += 3;
-            break;
+            JVM_DISPATCH();
+        }
+
+        JVM_OPCODE(getfield_quick): {
+            auto obj = (Object*)load_operand(0);
+            pop_operand();
+
+            if (obj == nullptr) {
+                JVM_THROW_EXN("java/lang/NullPointerException",
+                              "Access to field in null object");
+            }
+
+            SubstitutionField sub;
+            memcpy(&sub, bytecode + pc + 1, sizeof sub);
+
+            if (sub.size_ == SubstitutionField::b1) {
+                push_operand_i(obj->data()[sub.offset_]);
+            } else {
+                s16 val;
+                memcpy(&val, obj->data() + sub.offset_, sizeof val);
+                push_operand_i(val);
+            }
+            pc += 3;
+            JVM_DISPATCH();
+        }
+
+        JVM_OPCODE(getfield_quick_i): {
+            auto obj = (Object*)load_operand(0);
+            pop_operand();
+
+            if (obj == nullptr) {
+                JVM_THROW_EXN("java/lang/NullPointerException",
+                              "Access to field in null object");
+            }
+
+            s32 val;
+            memcpy(&val,
+                   obj->data() + read_quick_operand(bytecode, pc),
+                   sizeof val);
+            push_operand_i(val);
+            pc += 3;
+            JVM_DISPATCH();
+        }
+
+        JVM_OPCODE(getfield_quick_a): {
+            auto obj = (Object*)load_operand(0);
+            pop_operand();
+
+            if (obj == nullptr) {
+                JVM_THROW_EXN("java/lang/NullPointerException",
+                              "Access to field in null object");
+            }
+
+            Object* val;
+            memcpy(&val,
+                   obj->data() + read_quick_operand(bytecode, pc),
+                   sizeof val);
+            push_operand_a(*val);
+            pc += 3;
+            JVM_DISPATCH();
+        }
+
+        JVM_OPCODE(getfield_quick_w): {
+            auto obj = (Object*)load_operand(0);
+            pop_operand();
+
+            if (obj == nullptr) {
+                JVM_THROW_EXN("java/lang/NullPointerException",
+                              "Access to field in null object");
+            }
+
+            s64 val;
+            memcpy(&val,
+                   obj->data() + read_quick_operand(bytecode, pc),
+                   sizeof val);
+            push_wide_operand_l(val);
+            pc += 3;
+            JVM_DISPATCH();
+        }
+
+        JVM_OPCODE(putfield_quick): {
+            auto obj = (Object*)load_operand(1);
+            auto value = load_operand_i(0);
+
+            pop_operand();
+            pop_operand();
+
+            if (obj == nullptr) {
+                JVM_THROW_EXN("java/lang/NullPointerException",
+                              "Access to field in null object");
+            }
+
+            SubstitutionField sub;
+            memcpy(&sub, bytecode + pc + 1, sizeof sub);
+
+            if (sub.size_ == SubstitutionField::b1) {
+                obj->data()[sub.offset_] = (u8)value;
+            } else {
+                s16 val = value;
+                memcpy(obj->data() + sub.offset_, &val, sizeof val);
+            }
+            pc += 3;
+            JVM_DISPATCH();
+        }
+
+        JVM_OPCODE(putfield_quick_i): {
+            auto obj = (Object*)load_operand(1);
+            s32 value = load_operand_i(0);
+
+            pop_operand();
+            pop_operand();
+
+            if (obj == nullptr) {
+                JVM_THROW_EXN("java/lang/NullPointerException",
+                              "Access to field in null object");
+            }
+
+            memcpy(obj->data() + read_quick_operand(bytecode, pc),
+                   &value,
+                   sizeof value);
+            pc += 3;
+            JVM_DISPATCH();
+        }
+
+        JVM_OPCODE(putfield_quick_a): {
+            auto obj = (Object*)load_operand(1);
+            auto value = (Object*)load_operand(0);
+
+            pop_operand();
+            pop_operand();
+
+            if (obj == nullptr) {
+                JVM_THROW_EXN("java/lang/NullPointerException",
+                              "Access to field in null object");
+            }
+
+            memcpy(obj->data() + read_quick_operand(bytecode, pc),
+                   &value,
+                   sizeof value);
+            pc += 3;
+            JVM_DISPATCH();
+        }
+
+        JVM_OPCODE(putfield_quick_w): {
+            auto obj = (Object*)load_operand(2);
+            auto value = load_wide_operand_l(0);
+
+            pop_operand();
+            pop_operand();
+            pop_operand();
+
+            if (obj == nullptr) {
+                JVM_THROW_EXN("java/lang/NullPointerException",
+                              "Access to field in null object");
+            }
+
+            memcpy(obj->data() + read_quick_operand(bytecode, pc),
+                   &value,
+                   sizeof value);
+            pc += 3;
+            JVM_DISPATCH();
+        }
+
+        JVM_OPCODE(aload_0_getfield): {
+            auto obj = (Object*)load_local(0);
+            const u8 get = bytecode[pc + 1];
+
+            if (get not_eq Bytecode::getfield_quick_i and
+                get not_eq Bytecode::getfield_quick_a) {
+                // The getfield hasn't run yet, so it still needs quickening
+                // (or it's for a field size that we don't bother fusing).
+                // Just do the aload_0.
+                push_operand_a(*obj);
+                ++pc;
+                JVM_DISPATCH();
+            }
+
+            ++pc;
+
+            if (obj == nullptr) {
+                JVM_THROW_EXN("java/lang/NullPointerException",
+                              "Access to field in null object");
+            }
+
+            auto field = obj->data() + read_quick_operand(bytecode, pc);
+
+            if (get == Bytecode::getfield_quick_i) {
+                s32 val;
+                memcpy(&val, field, sizeof val);
+                push_operand_i(val);
+            } else {
+                Object* val;
+                memcpy(&val, field, sizeof val);
+                push_operand_a(*val);
+            }
+            pc += 3;
+            JVM_DISPATCH();
+        }
+
+        JVM_OPCODE(iinc_goto):
+            store_local(bytecode[pc + 1],
+                        (void*)(intptr_t)(
+                            (int)(intptr_t)(load_local(bytecode[pc + 1])) +
+                            (s8)bytecode[pc + 2]),
+                        OperandTypeCategory::primitive);
+            pc = Operands::branch(bytecode, pc + 3);
+            JVM_DISPATCH();
+
+        JVM_OPCODE(iload_iload):
+            fused_local = bytecode[pc + 1];
+            fused_pc = pc + 2;
+            goto ILOAD_ILOAD;
+
+        JVM_OPCODE(iload_0_iload):
+        JVM_OPCODE(iload_1_iload):
+        JVM_OPCODE(iload_2_iload):
+        JVM_OPCODE(iload_3_iload):
+            fused_local = bytecode[pc] - Bytecode::iload_0_iload;
+            fused_pc = pc + 1;
+            goto ILOAD_ILOAD;
+
+        ILOAD_ILOAD: {
+            const s32 lhs = (s32)(intptr_t)load_local(fused_local);
+            const s32 rhs = (s32)(intptr_t)load_local(local_index(
+                bytecode, fused_pc, Bytecode::iload, Bytecode::iload_0));
+
+            if (bytecode[fused_pc] == Bytecode::iadd) {
+                ++fused_pc;
+                store_local(local_index(bytecode,
+                                        fused_pc,
+                                        Bytecode::istore,
+                                        Bytecode::istore_0),
+                            (void*)(intptr_t)(lhs + rhs),
+                            OperandTypeCategory::primitive);
+                pc = fused_pc;
+                JVM_DISPATCH();
+            }
+
+            bool taken;
+
+            switch (bytecode[fused_pc]) {
+            case Bytecode::if_icmpeq:
+                taken = lhs == rhs;
+                break;
+
+            case Bytecode::if_icmpne:
+                taken = lhs not_eq rhs;
+                break;
+
+            case Bytecode::if_icmplt:
+                taken = lhs < rhs;
+                break;
+
+            case Bytecode::if_icmpge:
+                taken = lhs >= rhs;
+                break;
+
+            case Bytecode::if_icmpgt:
+                taken = lhs > rhs;
+                break;
+
+            default: // if_icmple
+                taken = lhs <= rhs;
+                break;
+            }
+
+            if (taken) {
+                pc = Operands::branch(bytecode, fused_pc);
+            } else {
+                pc = fused_pc + 3;
+            }
+            JVM_DISPATCH();
+        }
+
+        JVM_OPCODE(aload_iload):
+            fused_local = bytecode[pc + 1];
+            fused_pc = pc + 2;
+            goto ALOAD_ILOAD;
+
+        JVM_OPCODE(aload_0_iload):
+        JVM_OPCODE(aload_1_iload):
+        JVM_OPCODE(aload_2_iload):
+        JVM_OPCODE(aload_3_iload):
+            fused_local = bytecode[pc] - Bytecode::aload_0_iload;
+            fused_pc = pc + 1;
+            goto ALOAD_ILOAD;
+
+        ALOAD_ILOAD: {
+            auto array = (Array*)load_local(fused_local);
+            const s32 index = (s32)(intptr_t)load_local(local_index(
+                bytecode, fused_pc, Bytecode::iload, Bytecode::iload_0));
+
+            // The iaload.
+            pc = fused_pc;
+
+            if (array == nullptr) {
+                unhandled_error("nullptr exception");
+            }
+
+            if (array->check_bounds(index)) {
+                s32 result;
+                memcpy(&result, array->address(index), sizeof result);
+                push_operand_i(result);
+            } else {
+                JVM_ARRAY_INDEX_EXCEPTION(index);
+            }
+            ++pc;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::getstatic: {
-            auto index = ((network_u16*)&bytecode[pc + 1])->get();
+        JVM_OPCODE(getstatic): {
+            if (quick and
+                quicken_static_access(
+                    clz, quick, pc, Operands::u16_at(bytecode + pc + 1))) {
+                JVM_REDISPATCH();
+            }
+            auto index = Operands::u16_at(bytecode + pc + 1);
             if (auto opt = clz->lookup_static(index)) {
-                if (opt->is_object_) {
-                    Object* obj;
-                    memcpy(&obj, opt->data(), sizeof(Object*));
-                    push_operand_a(*obj);
-                } else {
-                    switch (opt->field_size_) {
-                    case 1: {
-                        u8 val = *opt->data();
-                        push_operand_i(val);
-                        break;
-                    }
-                    case 2: {
-                        s16 val;
-                        memcpy(&val, opt->data(), 2);
-                        push_operand_i(val);
-                        break;
-                    }
-                    case 4: {
-                        s32 val;
-                        memcpy(&val, opt->data(), 4);
-                        push_operand_i(val);
-                        break;
-                    }
-                    case 8: {
-                        s64 val;
-                        memcpy(&val, opt->data(), 8);
-                        push_wide_operand_l(val);
-                        break;
-                    }
-                    }
-                }
+                load_static(opt);
             } else {
                 unhandled_error("critical error in getstatic");
             }
             pc += 3;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::putstatic: {
-            auto index = ((network_u16*)&bytecode[pc + 1])->get();
+        JVM_OPCODE(putstatic): {
+            if (quick and
+                quicken_static_access(
+                    clz, quick, pc, Operands::u16_at(bytecode + pc + 1))) {
+                JVM_REDISPATCH();
+            }
+            auto index = Operands::u16_at(bytecode + pc + 1);
             if (auto opt = clz->lookup_static(index)) {
-                if (opt->is_object_) {
-                    auto val = load_operand(0);
-                    pop_operand();
-                    memcpy(opt->data(), &val, sizeof val);
-                } else {
-                    switch (opt->field_size_) {
-                    case 1: {
-                        *opt->data() = (u8)load_operand_i(0);
-                        pop_operand();
-                        break;
-                    }
-                    case 2: {
-                        s16 val = load_operand_i(0);
-                        pop_operand();
-                        memcpy(opt->data(), &val, 2);
-                        break;
-                    }
-                    case 4: {
-                        s32 val = load_operand_i(0);
-                        pop_operand();
-                        memcpy(opt->data(), &val, 4);
-                        break;
-                    }
-                    case 8: {
-                        s64 val = load_wide_operand_l(0);
-                        pop_operand();
-                        pop_operand();
-                        memcpy(opt->data(), &val, 8);
-                        break;
-                    }
-                    }
-                }
+                store_static(opt);
             } else {
                 unhandled_error("critical error in putstatic");
             }
             pc += 3;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::isub: {
+        JVM_OPCODE(getstatic_quick):
+            load_static(
+                quick->slots_[read_quick_operand(bytecode, pc)].static_field_);
+            pc += 3;
+            JVM_DISPATCH();
+
+        JVM_OPCODE(putstatic_quick):
+            store_static(
+                quick->slots_[read_quick_operand(bytecode, pc)].static_field_);
+            pc += 3;
+            JVM_DISPATCH();
+
+        JVM_OPCODE(isub): {
             const s32 result = load_operand_i(1) - load_operand_i(0);
             pop_operand();
             pop_operand();
             push_operand_i(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::iand: {
+        JVM_OPCODE(iand): {
             const s32 result = load_operand_i(0) & load_operand_i(1);
             pop_operand();
             pop_operand();
             push_operand_i(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::ior: {
+        JVM_OPCODE(ior): {
             const s32 result = load_operand_i(0) | load_operand_i(1);
             pop_operand();
             pop_operand();
             push_operand_i(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::ixor: {
+        JVM_OPCODE(ixor): {
             const s32 result = load_operand_i(0) ^ load_operand_i(1);
             pop_operand();
             pop_operand();
             push_operand_i(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::iadd: {
+        JVM_OPCODE(iadd): {
             const s32 result = load_operand_i(0) + load_operand_i(1);
             pop_operand();
             pop_operand();
             push_operand_i(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::idiv: {
+        JVM_OPCODE(idiv): {
             auto value = load_operand_i(1);
             auto divisor = load_operand_i(0);
 
@@ -2326,19 +6285,19 @@ execute_bytecode(Class* clz,
 
             push_operand_i(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::irem: {
+        JVM_OPCODE(irem): {
             const s32 result = load_operand_i(1) % load_operand_i(0);
             pop_operand();
             pop_operand();
             push_operand_i(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::iushr: {
+        JVM_OPCODE(iushr): {
             const s32 result =
                 (u32)load_operand_i(1) >> ((u32)load_operand_i(0) & 0x1f);
 
@@ -2346,240 +6305,240 @@ execute_bytecode(Class* clz,
             pop_operand();
             push_operand_i(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
         // FIXME: ishl and ishr may not be implemented correctly (sign extension
         // and negative numbers).
-        case Bytecode::ishl: {
+        JVM_OPCODE(ishl): {
             const s32 result = load_operand_i(1) << (load_operand_i(0) & 0x1f);
             pop_operand();
             pop_operand();
             push_operand_i(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::ishr: {
+        JVM_OPCODE(ishr): {
             const s32 result = arithmetic_right_shift_32(
                 load_operand_i(1), load_operand_i(0) & 0x1f);
             pop_operand();
             pop_operand();
             push_operand_i(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::imul: {
+        JVM_OPCODE(imul): {
             const s32 result = load_operand_i(1) * load_operand_i(0);
             pop_operand();
             pop_operand();
             push_operand_i(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::ineg: {
+        JVM_OPCODE(ineg): {
             const s32 result = -load_operand_i(0);
             pop_operand();
             push_operand_i(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::i2c: {
+        JVM_OPCODE(i2c): {
             u8 val = load_operand_i(0);
             pop_operand();
             push_operand_i(val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::i2f: {
+        JVM_OPCODE(i2f): {
             float val = load_operand_i(0);
             pop_operand();
             push_operand_f(val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::i2s: {
+        JVM_OPCODE(i2s): {
             s16 val = load_operand_i(0);
             pop_operand();
             push_operand_i(val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::i2l: {
+        JVM_OPCODE(i2l): {
             s64 val = load_operand_i(0);
             pop_operand();
             push_wide_operand_l(val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::i2d: {
+        JVM_OPCODE(i2d): {
             double val = load_operand_i(0);
             pop_operand();
             push_wide_operand_d(val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::if_acmpeq:
+        JVM_OPCODE(if_acmpeq):
             if (load_operand(0) == load_operand(1)) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_acmpne:
+        JVM_OPCODE(if_acmpne):
             if (load_operand(0) not_eq load_operand(1)) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_icmpeq:
+        JVM_OPCODE(if_icmpeq):
             if (load_operand_i(0) == load_operand_i(1)) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_icmpne:
+        JVM_OPCODE(if_icmpne):
             if (load_operand_i(0) not_eq load_operand_i(1)) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_icmplt:
+        JVM_OPCODE(if_icmplt):
             if (load_operand_i(0) > load_operand_i(1)) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_icmpgt:
+        JVM_OPCODE(if_icmpgt):
             if (load_operand_i(0) < load_operand_i(1)) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_icmpge:
+        JVM_OPCODE(if_icmpge):
             if (load_operand_i(0) <= load_operand_i(1)) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_icmple:
+        JVM_OPCODE(if_icmple):
             if (load_operand_i(0) >= load_operand_i(1)) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_eq:
+        JVM_OPCODE(if_eq):
             if (load_operand_i(0) == 0) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_ne:
+        JVM_OPCODE(if_ne):
             if (load_operand_i(0) not_eq 0) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_lt:
+        JVM_OPCODE(if_lt):
             if (load_operand_i(0) < 0) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_ge:
+        JVM_OPCODE(if_ge):
             if (load_operand_i(0) >= 0) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_gt:
+        JVM_OPCODE(if_gt):
             if (load_operand_i(0) > 0) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_le:
-            if (load_operand_i(0) < 0) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+        JVM_OPCODE(if_le):
+            if (load_operand_i(0) <= 0) {
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_nonnull:
+        JVM_OPCODE(if_nonnull):
             if (load_operand(0) not_eq nullptr) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::if_null:
+        JVM_OPCODE(if_null):
             if (load_operand(0) == nullptr) {
-                pc += ((network_s16*)(bytecode + pc + 1))->get();
+                pc = Operands::branch(bytecode, pc);
             } else {
                 pc += 3;
             }
             pop_operand();
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::lookupswitch: {
+        JVM_OPCODE(lookupswitch): {
             auto key = load_operand_i(0);
             pop_operand();
 
@@ -2590,33 +6549,29 @@ execute_bytecode(Class* clz,
                 i += 4 - i % 4;
             }
 
-            auto default_br = ((network_s32*)(bytecode + i))->get();
-            i += sizeof(network_s32);
-            auto npairs = ((network_s32*)(bytecode + i))->get();
-            i += sizeof(network_s32);
+            auto default_br = bytecode + i;
+            i += sizeof(s32);
+            auto npairs = Operands::s32_at(bytecode + i);
+            i += sizeof(s32);
 
-            struct MatchPair {
-                network_s32 case_;
-                network_s32 branch_;
-            };
-
-            auto pairs = (const MatchPair*)(bytecode + i);
+            // Each pair: s32 match, followed by s32 branch.
+            auto pairs = bytecode + i;
 
             for (int i = 0; i < npairs; ++i) {
-                auto& pair = pairs[i];
-                if (pair.case_.get() == key) {
-                    pc += pair.branch_.get();
+                auto pair = pairs + i * 2 * sizeof(s32);
+                if (Operands::s32_at(pair) == key) {
+                    pc = Operands::switch_target(pc, pair + sizeof(s32));
                     goto DONE;
                 }
             }
 
-            pc += default_br;
+            pc = Operands::switch_target(pc, default_br);
 
         DONE:
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::tableswitch: {
+        JVM_OPCODE(tableswitch): {
             auto index = load_operand_i(0);
             pop_operand();
 
@@ -2627,96 +6582,97 @@ execute_bytecode(Class* clz,
                 i += 4 - i % 4;
             }
 
-            auto default_br = ((network_s32*)(bytecode + i))->get();
-            i += sizeof(network_s32);
-            auto low = ((network_s32*)(bytecode + i))->get();
-            i += sizeof(network_s32);
-            auto high = ((network_s32*)(bytecode + i))->get();
+            auto default_br = bytecode + i;
+            i += sizeof(s32);
+            auto low = Operands::s32_at(bytecode + i);
+            i += sizeof(s32);
+            auto high = Operands::s32_at(bytecode + i);
 
             if (index < low or index > high) {
-                pc += default_br;
+                pc = Operands::switch_target(pc, default_br);
             } else {
                 auto table_offset = index - low;
-                i += sizeof(network_s32);
-                auto jump_table = (network_s32*)(bytecode + i);
-                pc += jump_table[table_offset].get();
+                i += sizeof(s32);
+                auto jump_table = bytecode + i;
+                pc = Operands::switch_target(
+                    pc, jump_table + table_offset * sizeof(s32));
             }
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::fconst_0: {
+        JVM_OPCODE(fconst_0): {
             static_assert(sizeof(float) == sizeof(s32) and
                               sizeof(void*) >= sizeof(float),
                           "undefined behavior");
             auto f = 0.f;
             push_operand_f(f);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::fconst_1: {
+        JVM_OPCODE(fconst_1): {
             static_assert(sizeof(float) == sizeof(s32) and
                               sizeof(void*) >= sizeof(float),
                           "undefined behavior");
             auto f = 1.f;
             push_operand_f(f);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::fconst_2: {
+        JVM_OPCODE(fconst_2): {
             static_assert(sizeof(float) == sizeof(s32) and
                               sizeof(void*) >= sizeof(float),
                           "undefined behavior");
             auto f = 2.f;
             push_operand_f(f);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::f2d: {
+        JVM_OPCODE(f2d): {
             float value = load_operand_f(0);
             pop_operand();
             push_wide_operand_d(value);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::f2i: {
+        JVM_OPCODE(f2i): {
             float value = load_operand_f(0);
             pop_operand();
             push_operand_i(value);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::f2l: {
+        JVM_OPCODE(f2l): {
             float value = load_operand_f(0);
             pop_operand();
             push_wide_operand_l(value);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::fneg: {
+        JVM_OPCODE(fneg): {
             float value = load_operand_f(0);
             pop_operand();
             push_operand_f(-value);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::frem: {
+        JVM_OPCODE(frem): {
             float lhs = load_operand_f(1);
             float rhs = load_operand_f(0);
             pop_operand();
             pop_operand();
             push_operand_f(fmod(lhs, rhs));
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::fsub: {
+        JVM_OPCODE(fsub): {
             float lhs = load_operand_f(1);
             float rhs = load_operand_f(0);
             pop_operand();
@@ -2724,10 +6680,10 @@ execute_bytecode(Class* clz,
             auto result = lhs - rhs;
             push_operand_f(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::fadd: {
+        JVM_OPCODE(fadd): {
             float lhs = load_operand_f(0);
             float rhs = load_operand_f(1);
             pop_operand();
@@ -2735,10 +6691,10 @@ execute_bytecode(Class* clz,
             auto result = lhs + rhs;
             push_operand_f(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::fdiv: {
+        JVM_OPCODE(fdiv): {
             float lhs = load_operand_f(1);
             float rhs = load_operand_f(0);
             pop_operand();
@@ -2746,10 +6702,10 @@ execute_bytecode(Class* clz,
             auto result = lhs / rhs;
             push_operand_f(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::fmul: {
+        JVM_OPCODE(fmul): {
             float lhs = load_operand_f(0);
             float rhs = load_operand_f(1);
             pop_operand();
@@ -2757,11 +6713,11 @@ execute_bytecode(Class* clz,
             auto result = lhs * rhs;
             push_operand_f(result);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::fcmpg:
-        case Bytecode::fcmpl: {
+        JVM_OPCODE(fcmpg):
+        JVM_OPCODE(fcmpl): {
             auto rhs = load_operand_f(0);
             auto lhs = load_operand_f(1);
 
@@ -2782,18 +6738,14 @@ execute_bytecode(Class* clz,
                 }
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dcmpg:
-        case Bytecode::dcmpl: {
+        JVM_OPCODE(dcmpg):
+        JVM_OPCODE(dcmpl): {
             auto rhs = load_wide_operand_d(0);
             auto lhs = load_wide_operand_d(2);
-
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            pop_operand();
+            pop_operands(4);
 
             if (lhs > rhs) {
                 push_operand_i(1);
@@ -2809,106 +6761,85 @@ execute_bytecode(Class* clz,
                 }
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::d2f: {
+        JVM_OPCODE(d2f): {
             double d = load_wide_operand_d(0);
             pop_operand();
             pop_operand();
             push_operand_f(d);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::d2i: {
+        JVM_OPCODE(d2i): {
             double d = load_wide_operand_d(0);
             pop_operand();
             pop_operand();
             push_operand_i(d);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::d2l: {
-            double d = load_wide_operand_d(0);
-            pop_operand();
-            pop_operand();
-            push_wide_operand_l(d);
+        JVM_OPCODE(d2l): {
+            store_wide_operand_l(0, load_wide_operand_d(0));
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dadd: {
+        JVM_OPCODE(dadd): {
             auto rhs = load_wide_operand_d(0);
-            pop_operand();
-            pop_operand();
+            pop_operands(2);
             auto lhs = load_wide_operand_d(0);
-            pop_operand();
-            pop_operand();
-            push_wide_operand_d(lhs + rhs);
+            store_wide_operand_d(0, lhs + rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dsub: {
+        JVM_OPCODE(dsub): {
             auto rhs = load_wide_operand_d(0);
-            pop_operand();
-            pop_operand();
+            pop_operands(2);
             auto lhs = load_wide_operand_d(0);
-            pop_operand();
-            pop_operand();
-            push_wide_operand_d(lhs - rhs);
+            store_wide_operand_d(0, lhs - rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dmul: {
+        JVM_OPCODE(dmul): {
             auto rhs = load_wide_operand_d(0);
-            pop_operand();
-            pop_operand();
+            pop_operands(2);
             auto lhs = load_wide_operand_d(0);
-            pop_operand();
-            pop_operand();
-            push_wide_operand_d(lhs * rhs);
+            store_wide_operand_d(0, lhs * rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::ddiv: {
+        JVM_OPCODE(ddiv): {
             auto rhs = load_wide_operand_d(0);
-            pop_operand();
-            pop_operand();
+            pop_operands(2);
             auto lhs = load_wide_operand_d(0);
-            pop_operand();
-            pop_operand();
-            push_wide_operand_d(lhs / rhs);
+            store_wide_operand_d(0, lhs / rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::drem: {
+        JVM_OPCODE(drem): {
             auto rhs = load_wide_operand_d(0);
-            pop_operand();
-            pop_operand();
+            pop_operands(2);
             auto lhs = load_wide_operand_d(0);
-            pop_operand();
-            pop_operand();
-            push_wide_operand_d(fmod(lhs, rhs));
+            store_wide_operand_d(0, fmod(lhs, rhs));
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dneg: {
-            auto value = load_wide_operand_d(0);
-            pop_operand();
-            pop_operand();
-            push_wide_operand_d(-value);
+        JVM_OPCODE(dneg): {
+            store_wide_operand_d(0, -load_wide_operand_d(0));
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::daload: {
+        JVM_OPCODE(daload): {
             auto array = (Array*)load_operand(1);
             s32 index = load_operand_i(0);
             pop_operand();
@@ -2926,10 +6857,10 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dastore: {
+        JVM_OPCODE(dastore): {
             auto value = load_wide_operand_d(0);
             auto index = load_operand_i(2);
             auto array = (Array*)load_operand(3);
@@ -2949,107 +6880,107 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dload: {
+        JVM_OPCODE(dload): {
             double val;
             load_wide_local(bytecode[pc + 1], &val);
             push_wide_operand_d(val);
             pc += 2;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dload_0: {
+        JVM_OPCODE(dload_0): {
             double val;
             load_wide_local(0, &val);
             push_wide_operand_d(val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dload_1: {
+        JVM_OPCODE(dload_1): {
             double val;
             load_wide_local(1, &val);
             push_wide_operand_d(val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dload_2: {
+        JVM_OPCODE(dload_2): {
             double val;
             load_wide_local(2, &val);
             push_wide_operand_d(val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dload_3: {
+        JVM_OPCODE(dload_3): {
             double val;
             load_wide_local(3, &val);
             push_wide_operand_d(val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dconst_0: {
+        JVM_OPCODE(dconst_0): {
             push_wide_operand_d(0.0);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dconst_1: {
+        JVM_OPCODE(dconst_1): {
             push_wide_operand_d(1.0);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dstore: {
+        JVM_OPCODE(dstore): {
             auto val = load_wide_operand_d(0);
             pop_operand();
             pop_operand();
             store_wide_local(bytecode[pc + 1], &val);
             pc += 2;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dstore_0: {
+        JVM_OPCODE(dstore_0): {
             auto val = load_wide_operand_d(0);
             pop_operand();
             pop_operand();
             store_wide_local(0, &val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dstore_1: {
+        JVM_OPCODE(dstore_1): {
             auto val = load_wide_operand_d(0);
             pop_operand();
             pop_operand();
             store_wide_local(1, &val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dstore_2: {
+        JVM_OPCODE(dstore_2): {
             auto val = load_wide_operand_d(0);
             pop_operand();
             pop_operand();
             store_wide_local(2, &val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::dstore_3: {
+        JVM_OPCODE(dstore_3): {
             auto val = load_wide_operand_d(0);
             pop_operand();
             pop_operand();
             store_wide_local(3, &val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::laload: {
+        JVM_OPCODE(laload): {
             auto array = (Array*)load_operand(1);
             s32 index = load_operand_i(0);
             pop_operand();
@@ -3067,10 +6998,10 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lastore: {
+        JVM_OPCODE(lastore): {
             auto value = load_wide_operand_l(0);
             auto index = load_operand_i(2);
             auto array = (Array*)load_operand(3);
@@ -3090,10 +7021,10 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::saload: {
+        JVM_OPCODE(saload): {
             auto array = (Array*)load_operand(1);
             s32 index = load_operand_i(0);
 
@@ -3116,10 +7047,10 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::sastore: {
+        JVM_OPCODE(sastore): {
             auto array = (Array*)load_operand(2);
             s16 value = load_operand_i(0);
             s32 index = load_operand_i(1);
@@ -3142,149 +7073,149 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::sipush: {
-            s16 val = ((network_s16*)(bytecode + pc + 1))->get();
+        JVM_OPCODE(sipush): {
+            s16 val = Operands::s16_at(bytecode + pc + 1);
             push_operand_i(val);
             pc += 3;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::astore:
+        JVM_OPCODE(astore):
             store_local(
                 bytecode[pc + 1], load_operand(0), OperandTypeCategory::object);
             pop_operand();
             pc += 2;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::astore_0:
+        JVM_OPCODE(astore_0):
             store_local(0, load_operand(0), OperandTypeCategory::object);
             pop_operand();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::astore_1:
+        JVM_OPCODE(astore_1):
             store_local(1, load_operand(0), OperandTypeCategory::object);
             pop_operand();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::astore_2:
+        JVM_OPCODE(astore_2):
             store_local(2, load_operand(0), OperandTypeCategory::object);
             pop_operand();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::astore_3:
+        JVM_OPCODE(astore_3):
             store_local(3, load_operand(0), OperandTypeCategory::object);
             pop_operand();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::fstore:
-        case Bytecode::istore:
+        JVM_OPCODE(fstore):
+        JVM_OPCODE(istore):
             store_local(bytecode[pc + 1],
                         load_operand(0),
                         OperandTypeCategory::primitive);
             pop_operand();
             pc += 2;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::fstore_0:
-        case Bytecode::istore_0:
+        JVM_OPCODE(fstore_0):
+        JVM_OPCODE(istore_0):
             store_local(0, load_operand(0), OperandTypeCategory::primitive);
             pop_operand();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::fstore_1:
-        case Bytecode::istore_1:
+        JVM_OPCODE(fstore_1):
+        JVM_OPCODE(istore_1):
             store_local(1, load_operand(0), OperandTypeCategory::primitive);
             pop_operand();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::fstore_2:
-        case Bytecode::istore_2:
+        JVM_OPCODE(fstore_2):
+        JVM_OPCODE(istore_2):
             store_local(2, load_operand(0), OperandTypeCategory::primitive);
             pop_operand();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::fstore_3:
-        case Bytecode::istore_3:
+        JVM_OPCODE(fstore_3):
+        JVM_OPCODE(istore_3):
             store_local(3, load_operand(0), OperandTypeCategory::primitive);
             pop_operand();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::aload:
+        JVM_OPCODE(aload):
             push_operand_a(*(Object*)load_local(bytecode[pc + 1]));
             pc += 2;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::aload_0:
+        JVM_OPCODE(aload_0):
             push_operand_a(*(Object*)load_local(0));
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::aload_1:
+        JVM_OPCODE(aload_1):
             push_operand_a(*(Object*)load_local(1));
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::aload_2:
+        JVM_OPCODE(aload_2):
             push_operand_a(*(Object*)load_local(2));
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::aload_3:
+        JVM_OPCODE(aload_3):
             push_operand_a(*(Object*)load_local(3));
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::fload:
-        case Bytecode::iload:
+        JVM_OPCODE(fload):
+        JVM_OPCODE(iload):
             push_operand_p(load_local(bytecode[pc + 1]));
             pc += 2;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::fload_0:
-        case Bytecode::iload_0:
+        JVM_OPCODE(fload_0):
+        JVM_OPCODE(iload_0):
             push_operand_p(load_local(0));
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::fload_1:
-        case Bytecode::iload_1:
+        JVM_OPCODE(fload_1):
+        JVM_OPCODE(iload_1):
             push_operand_p(load_local(1));
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::fload_2:
-        case Bytecode::iload_2:
+        JVM_OPCODE(fload_2):
+        JVM_OPCODE(iload_2):
             push_operand_p(load_local(2));
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::fload_3:
-        case Bytecode::iload_3:
+        JVM_OPCODE(fload_3):
+        JVM_OPCODE(iload_3):
             push_operand_p(load_local(3));
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::iinc:
+        JVM_OPCODE(iinc):
             store_local(bytecode[pc + 1],
                         (void*)(intptr_t)(
                             (int)(intptr_t)(load_local(bytecode[pc + 1])) +
                             (s8)bytecode[pc + 2]),
                         OperandTypeCategory::primitive);
             pc += 3;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::castore: {
+        JVM_OPCODE(castore): {
             auto array = (Array*)load_operand(2);
             u8 value = load_operand_i(0);
             s32 index = load_operand_i(1);
@@ -3303,10 +7234,10 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::bastore: {
+        JVM_OPCODE(bastore): {
             auto array = (Array*)load_operand(2);
             s8 value = load_operand_i(0);
             s32 index = load_operand_i(1);
@@ -3325,10 +7256,10 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::caload: {
+        JVM_OPCODE(caload): {
             auto array = (Array*)load_operand(1);
             s32 index = load_operand_i(0);
 
@@ -3346,10 +7277,10 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::baload: {
+        JVM_OPCODE(baload): {
             auto array = (Array*)load_operand(1);
             s32 index = load_operand_i(0);
 
@@ -3367,11 +7298,11 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::fastore:
-        case Bytecode::iastore: {
+        JVM_OPCODE(fastore):
+        JVM_OPCODE(iastore): {
             auto array = (Array*)load_operand(2);
             s32 value = load_operand_i(0);
             s32 index = load_operand_i(1);
@@ -3394,11 +7325,11 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::faload:
-        case Bytecode::iaload: {
+        JVM_OPCODE(faload):
+        JVM_OPCODE(iaload): {
             auto array = (Array*)load_operand(1);
             s32 index = load_operand_i(0);
 
@@ -3421,142 +7352,136 @@ execute_bytecode(Class* clz,
                 JVM_ARRAY_INDEX_EXCEPTION(index);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lconst_0: {
+        JVM_OPCODE(lconst_0): {
             s64 value = 0;
             push_wide_operand_l(value);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lconst_1: {
+        JVM_OPCODE(lconst_1): {
             s64 value = 1;
             push_wide_operand_l(value);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::l2d: {
-            double arg = load_wide_operand_l(0);
-            pop_operand();
-            pop_operand();
-            push_wide_operand_d(arg);
+        JVM_OPCODE(l2d): {
+            store_wide_operand_d(0, load_wide_operand_l(0));
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::l2f: {
+        JVM_OPCODE(l2f): {
             float arg = load_wide_operand_l(0);
             pop_operand();
             pop_operand();
             push_operand_f(arg);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::l2i: {
+        JVM_OPCODE(l2i): {
             s32 arg = load_wide_operand_l(0);
             pop_operand();
             pop_operand();
             push_operand_i(arg);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lstore: {
+        JVM_OPCODE(lstore): {
             auto val = load_wide_operand_l(0);
             pop_operand();
             pop_operand();
             store_wide_local(bytecode[pc + 1], &val);
             pc += 2;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lstore_0: {
+        JVM_OPCODE(lstore_0): {
             auto val = load_wide_operand_l(0);
             pop_operand();
             pop_operand();
             store_wide_local(0, &val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lstore_1: {
+        JVM_OPCODE(lstore_1): {
             auto val = load_wide_operand_l(0);
             pop_operand();
             pop_operand();
             store_wide_local(1, &val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lstore_2: {
+        JVM_OPCODE(lstore_2): {
             auto val = load_wide_operand_l(0);
             pop_operand();
             pop_operand();
             store_wide_local(2, &val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lstore_3: {
+        JVM_OPCODE(lstore_3): {
             auto val = load_wide_operand_l(0);
             pop_operand();
             pop_operand();
             store_wide_local(3, &val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lload: {
+        JVM_OPCODE(lload): {
             s64 val;
             load_wide_local(bytecode[pc + 1], &val);
             push_wide_operand_l(val);
             pc += 2;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lload_0: {
+        JVM_OPCODE(lload_0): {
             s64 val;
             load_wide_local(0, &val);
             push_wide_operand_l(val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lload_1: {
+        JVM_OPCODE(lload_1): {
             s64 val;
             load_wide_local(1, &val);
             push_wide_operand_l(val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lload_2: {
+        JVM_OPCODE(lload_2): {
             s64 val;
             load_wide_local(2, &val);
             push_wide_operand_l(val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lload_3: {
+        JVM_OPCODE(lload_3): {
             s64 val;
             load_wide_local(3, &val);
             push_wide_operand_l(val);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lcmp: {
+        JVM_OPCODE(lcmp): {
             auto lhs = load_wide_operand_l(2);
             auto rhs = load_wide_operand_l(0);
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            pop_operand();
+            pop_operands(4);
             if (lhs == rhs) {
                 push_operand_i(0);
             } else if (lhs > rhs) {
@@ -3565,274 +7490,415 @@ execute_bytecode(Class* clz,
                 push_operand_i(-1);
             }
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lsub: {
-            auto lhs = load_wide_operand_l(2);
+        JVM_OPCODE(lsub): {
             auto rhs = load_wide_operand_l(0);
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            push_wide_operand_l(lhs - rhs);
+            pop_operands(2);
+            store_wide_operand_l(0, load_wide_operand_l(0) - rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::ldiv: {
-            auto lhs = load_wide_operand_l(2);
+        JVM_OPCODE(ldiv): {
             auto rhs = load_wide_operand_l(0);
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            pop_operand();
+            pop_operands(2);
 
             if (rhs == 0) {
+                pop_operands(2);
                 JVM_THROW_EXN("java/lang/ArithmeticException",
                               "division by zero");
             }
 
-            push_wide_operand_l(lhs / rhs);
+            auto lhs = load_wide_operand_l(0);
+
+            // NOTE: Long.MIN_VALUE / -1 overflows, and traps on x86.
+            store_wide_operand_l(0,
+                                 rhs == -1 ? (s64)(0 - (u64)lhs) : lhs / rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::ladd: {
-            auto lhs = load_wide_operand_l(0);
-            auto rhs = load_wide_operand_l(2);
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            push_wide_operand_l(lhs + rhs);
+        JVM_OPCODE(ladd): {
+            auto rhs = load_wide_operand_l(0);
+            pop_operands(2);
+            store_wide_operand_l(0, load_wide_operand_l(0) + rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lmul: {
-            auto lhs = load_wide_operand_l(2);
+        JVM_OPCODE(lmul): {
             auto rhs = load_wide_operand_l(0);
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            push_wide_operand_l(lhs * rhs);
+            pop_operands(2);
+            store_wide_operand_l(0, load_wide_operand_l(0) * rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lneg: {
-            auto value = load_wide_operand_l(0);
-            pop_operand();
-            pop_operand();
-            push_wide_operand_l(-value);
+        JVM_OPCODE(lneg): {
+            store_wide_operand_l(0, -load_wide_operand_l(0));
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::land: {
-            auto lhs = load_wide_operand_l(2);
+        JVM_OPCODE(land): {
             auto rhs = load_wide_operand_l(0);
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            push_wide_operand_l(lhs & rhs);
+            pop_operands(2);
+            store_wide_operand_l(0, load_wide_operand_l(0) & rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lor: {
-            auto lhs = load_wide_operand_l(2);
+        JVM_OPCODE(lor): {
             auto rhs = load_wide_operand_l(0);
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            push_wide_operand_l(lhs | rhs);
+            pop_operands(2);
+            store_wide_operand_l(0, load_wide_operand_l(0) | rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lrem: {
-            auto lhs = load_wide_operand_l(2);
+        JVM_OPCODE(lrem): {
             auto rhs = load_wide_operand_l(0);
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            push_wide_operand_l(lhs % rhs);
+            pop_operands(2);
+
+            if (rhs == 0) {
+                pop_operands(2);
+                JVM_THROW_EXN("java/lang/ArithmeticException",
+                              "division by zero");
+            }
+
+            auto lhs = load_wide_operand_l(0);
+            store_wide_operand_l(0, rhs == -1 ? 0 : lhs % rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lxor: {
-            auto lhs = load_wide_operand_l(2);
+        JVM_OPCODE(lxor): {
             auto rhs = load_wide_operand_l(0);
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            pop_operand();
-            push_wide_operand_l(lhs ^ rhs);
+            pop_operands(2);
+            store_wide_operand_l(0, load_wide_operand_l(0) ^ rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lushr: {
-            auto lhs = load_wide_operand_l(1);
-            auto rhs = load_operand_i(0);
-            pop_operand();
+        JVM_OPCODE(lushr): {
+            auto rhs = load_operand_i(0) & 0x3f;
             pop_operand();
-            pop_operand();
-            push_wide_operand_l(lhs >> rhs);
+            store_wide_operand_l(0, (u64)load_wide_operand_l(0) >> rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lshl: {
-            // FIXME: Potentially non-portable?
-            const auto result = load_wide_operand_l(1)
-                                << (load_operand_i(0) & 0x1f);
-            pop_operand();
-            pop_operand();
+        JVM_OPCODE(lshl): {
+            auto rhs = load_operand_i(0) & 0x3f;
             pop_operand();
-            push_wide_operand_l(result);
+            store_wide_operand_l(0, (u64)load_wide_operand_l(0) << rhs);
             ++pc;
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::lshr: {
-            const auto result = arithmetic_right_shift_64(
-                load_wide_operand_l(1), load_operand_i(0) & 0x1f);
-            pop_operand();
+        JVM_OPCODE(lshr): {
+            auto rhs = load_operand_i(0) & 0x3f;
             pop_operand();
-            pop_operand();
-            push_wide_operand_l(result);
+            store_wide_operand_l(
+                0, arithmetic_right_shift_64(load_wide_operand_l(0), rhs));
             ++pc;
-            break;
-        }
-
-        case Bytecode::__goto:
-            pc += ((network_s16*)(bytecode + pc + 1))->get();
-            break;
-
-        case Bytecode::__goto_w:
-            pc += ((network_s32*)(bytecode + pc + 1))->get();
-            break;
-
-        case Bytecode::vreturn:
-        case Bytecode::lreturn:
-        case Bytecode::ireturn:
-        case Bytecode::areturn:
-        case Bytecode::freturn:
-        case Bytecode::dreturn:
+            JVM_DISPATCH();
+        }
+
+        JVM_OPCODE(__goto):
+            pc = Operands::branch(bytecode, pc);
+            JVM_DISPATCH();
+
+        JVM_OPCODE(__goto_w):
+            pc = Operands::branch_w(bytecode, pc);
+            JVM_DISPATCH();
+
+        JVM_OPCODE(vreturn):
+        JVM_OPCODE(lreturn):
+        JVM_OPCODE(ireturn):
+        JVM_OPCODE(areturn):
+        JVM_OPCODE(freturn):
+        JVM_OPCODE(dreturn):
+#if JVM_NONRECURSIVE_CALLS
+            if (frames.size() > entry_depth) {
+                // The return value, if any, is already where the caller
+                // expects it, on top of the operand stack.
+                pop_frame();
+                resume();
+                pc += invoke_length(bytecode[pc]);
+                JVM_DISPATCH();
+            }
+#endif
             return nullptr;
 
-        case Bytecode::invokedynamic: {
+        JVM_OPCODE(invokedynamic): {
             auto info =
                 (const ClassFile::ConstantInvokeDynamic*)clz->constants_->load(
-                    ((network_u16*)(bytecode + pc + 1))->get());
+                    Operands::u16_at(bytecode + pc + 1));
 
             auto exn =
                 invokedynamic(clz, info->bootstrap_method_attr_index_.get());
 
             if (exn) {
-                if (not handle_exception(clz, exn, pc, exception_table)) {
-                    return exn;
-                }
+                push_operand_a(*exn);
+                goto THROW;
             } else {
                 pc += 5;
             }
-            break;
+            JVM_DISPATCH();
         }
 
-        case Bytecode::invokestatic: {
-            auto exn = dispatch_method(
-                clz, ((network_u16*)(bytecode + pc + 1))->get(), true, false);
-            if (exn) {
-                if (not handle_exception(clz, exn, pc, exception_table)) {
-                    return exn;
-                }
-            } else {
-                pc += 3;
+        JVM_OPCODE(invokestatic): {
+#if JVM_RESOLVED_METHODS
+            const u16 index = Operands::u16_at(bytecode + pc + 1);
+
+            if (auto exn = resolve_direct(clz, index, false, call)) {
+                push_operand_a(*exn);
+                goto THROW;
             }
-            break;
+
+            if (quick) {
+                quicken_direct_call(clz, quick, pc, index);
+            }
+#else
+            if (auto exn = resolve_method(clz,
+                                          Operands::u16_at(bytecode + pc + 1),
+                                          true,
+                                          false,
+                                          call)) {
+                push_operand_a(*exn);
+                goto THROW;
+            }
+#endif
+            goto INVOKE;
         }
 
-        case Bytecode::invokevirtual: {
-            auto exn = dispatch_method(
-                clz, ((network_u16*)(bytecode + pc + 1))->get(), false, false);
-            if (exn) {
-                if (not handle_exception(clz, exn, pc, exception_table)) {
-                    return exn;
-                }
-            } else {
-                pc += 3;
+        JVM_OPCODE(invokevirtual): {
+#if JVM_INLINE_CACHES
+            if (quick and
+                quicken_invoke(
+                    clz, quick, pc, Operands::u16_at(bytecode + pc + 1))) {
+                JVM_REDISPATCH();
             }
-            break;
+#endif
+#if JVM_VTABLES
+            if (auto exn = resolve_virtual(
+                    clz, Operands::u16_at(bytecode + pc + 1), call)) {
+                push_operand_a(*exn);
+                goto THROW;
+            }
+#else
+            if (auto exn = resolve_method(clz,
+                                          Operands::u16_at(bytecode + pc + 1),
+                                          false,
+                                          false,
+                                          call)) {
+                push_operand_a(*exn);
+                goto THROW;
+            }
+#endif
+            goto INVOKE;
         }
 
-        case Bytecode::invokeinterface: {
-            auto exn = dispatch_method(
-                clz, ((network_u16*)(bytecode + pc + 1))->get(), false, false);
-            if (exn) {
-                if (not handle_exception(clz, exn, pc, exception_table)) {
-                    return exn;
-                }
-            } else {
-                pc += 5;
+        JVM_OPCODE(invokeinterface): {
+#if JVM_INLINE_CACHES
+            if (quick and
+                quicken_invoke(
+                    clz, quick, pc, Operands::u16_at(bytecode + pc + 1))) {
+                JVM_REDISPATCH();
             }
-            break;
+#endif
+#if JVM_ITABLES
+            if (auto exn = resolve_interface(
+                    clz, Operands::u16_at(bytecode + pc + 1), call)) {
+                push_operand_a(*exn);
+                goto THROW;
+            }
+#else
+            if (auto exn = resolve_method(clz,
+                                          Operands::u16_at(bytecode + pc + 1),
+                                          false,
+                                          false,
+                                          call)) {
+                push_operand_a(*exn);
+                goto THROW;
+            }
+#endif
+            goto INVOKE;
         }
 
-        case Bytecode::invokespecial: {
-            auto exn =
-                invoke_special(clz, ((network_u16*)(bytecode + pc + 1))->get());
-            if (exn) {
-                if (not handle_exception(clz, exn, pc, exception_table)) {
-                    return exn;
+        JVM_OPCODE(invokespecial): {
+#if JVM_RESOLVED_METHODS
+            const u16 index = Operands::u16_at(bytecode + pc + 1);
+
+            if (auto exn = resolve_direct(clz, index, true, call)) {
+                push_operand_a(*exn);
+                goto THROW;
+            }
+
+            if (quick) {
+                quicken_direct_call(clz, quick, pc, index);
+            }
+#else
+            if (auto exn = resolve_method(clz,
+                                          Operands::u16_at(bytecode + pc + 1),
+                                          true,
+                                          true,
+                                          call)) {
+                push_operand_a(*exn);
+                goto THROW;
+            }
+#endif
+            goto INVOKE;
+        }
+
+        JVM_OPCODE(invokestatic_quick):
+        JVM_OPCODE(invokespecial_quick): {
+#if JVM_RESOLVED_METHODS
+            if (auto exn = bound_invocation(
+                    quick->slots_[read_quick_operand(bytecode, pc)].method_,
+                    bytecode[pc] == Bytecode::invokespecial_quick,
+                    call)) {
+                push_operand_a(*exn);
+                goto THROW;
+            }
+            goto INVOKE;
+#else
+            invalid_bytecode_instruction(bytecode[pc], pc);
+#endif
+        }
+
+        JVM_OPCODE(invokevirtual_quick):
+        JVM_OPCODE(invokeinterface_quick): {
+#if JVM_INLINE_CACHES
+            auto& cache =
+                quick->inline_caches_[read_quick_operand(bytecode, pc)];
+
+            if (auto exn = resolve_cached(
+                    clz,
+                    cache,
+                    bytecode[pc] == Bytecode::invokeinterface_quick,
+                    call)) {
+                push_operand_a(*exn);
+                goto THROW;
+            }
+            goto INVOKE;
+#else
+            invalid_bytecode_instruction(bytecode[pc], pc);
+#endif
+        }
+
+        INVOKE: {
+#if JVM_NONRECURSIVE_CALLS
+            auto code =
+                call.code_ ? call.code_ : code_attribute(call.clz_, call.method_);
+
+            if (code) {
+                // Save our own state in the caller's frame, then push a frame
+                // for the callee and carry on with the callee's bytecode. A
+                // return instruction (or an exception that the callee does not
+                // handle) switches back to the caller. See resume().
+                auto& caller = frames.back();
+                caller.bytecode_ = bytecode;
+                caller.exception_table_ = exception_table;
+                caller.quick_ = quick;
+                caller.call_pc_ = pc;
+                caller.pc_ = &caller.call_pc_;
+
+                auto callee = enter_method(call.clz_,
+                                           call.method_,
+                                           code,
+                                           call.argc_,
+                                           call.type_signature_,
+                                           call.quick_);
+
+                if (callee.bytecode_ == nullptr) {
+                    frames.back().pc_ = &pc;
+                    auto exn = stack_overflow(call.argc_);
+                    push_operand_a(*exn);
+                    goto THROW;
                 }
-            } else {
-                pc += 3;
+
+#if JVM_PREDECODE_BYTECODE
+                const bool same_encoding =
+                    (callee.quick_ not_eq nullptr) == Operands::predecoded;
+#else
+                const bool same_encoding = true;
+#endif
+
+                if (same_encoding) {
+                    clz = call.clz_;
+                    bytecode = callee.bytecode_;
+                    exception_table = callee.exception_table_;
+                    quick = callee.quick_;
+                    operand_base = frames.back().operand_base_;
+                    pc = 0;
+                    frames.back().pc_ = &pc;
+                    JVM_DISPATCH();
+                }
+
+                // The callee's operands are encoded differently, it needs an
+                // execute_bytecode() of its own.
+                auto exn = run_method(call.clz_, callee);
+                pop_frame();
+                frames.back().pc_ = &pc;
+
+                if (exn) {
+                    push_operand_a(*exn);
+                    goto THROW;
+                }
+                pc += invoke_length(bytecode[pc]);
+                JVM_DISPATCH();
             }
-            break;
+#endif
+
+            if (auto exn = invoke_method(call)) {
+                push_operand_a(*exn);
+                goto THROW;
+            }
+            pc += invoke_length(bytecode[pc]);
+            JVM_DISPATCH();
         }
 
         // NOTE: jsr, jsr_w, and ret are untested. I need to find a java
         // compiler that actually generates them.
-        case Bytecode::jsr: {
+        JVM_OPCODE(jsr): {
             push_operand_a(*(Object*)make_return_address(pc + 3));
-            pc += ((network_s16*)(bytecode + pc + 1))->get();
-            break;
+            pc = Operands::branch(bytecode, pc);
+            JVM_DISPATCH();
         }
 
-        case Bytecode::jsr_w: {
+        JVM_OPCODE(jsr_w): {
             push_operand_a(*(Object*)make_return_address(pc + 5));
-            pc += ((network_s32*)(bytecode + pc + 1))->get();
-            break;
+            pc = Operands::branch_w(bytecode, pc);
+            JVM_DISPATCH();
         }
 
-        case Bytecode::ret: {
+        JVM_OPCODE(ret): {
             auto rt = (ReturnAddress*)load_local(bytecode[pc + 1]);
             pc = rt->pc_;
-            break;
+            JVM_DISPATCH();
         }
 
         // NOTE: We intend our JVM implementation for embedded systems, where we
         // do not care about multithreaded execution. monitorenter/exit
         // essentially do nothing.
-        case Bytecode::monitorenter:
+        JVM_OPCODE(monitorenter):
             pop_operand();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
-        case Bytecode::monitorexit:
+        JVM_OPCODE(monitorexit):
             pop_operand();
             ++pc;
-            break;
+            JVM_DISPATCH();
 
         default:
+#if JVM_THREADED_DISPATCH
+        op_invalid:
+#endif
             invalid_bytecode_instruction(bytecode[pc], pc);
         }
     }
@@ -3840,6 +7906,12 @@ execute_bytecode(Class* clz,
 
 
 
+#if JVM_THREADED_DISPATCH
+#pragma GCC diagnostic pop
+#endif
+
+
+
 #ifndef PROJECT_ROOT
 #define PROJECT_ROOT ""
 #endif
@@ -3857,7 +7929,7 @@ static void invoke_static_block(Class* clz)
 
     if (auto mtd = clz->load_method(name, signature)) {
         ArgumentInfo argc;
-        auto exn = invoke_method(clz, nullptr, mtd, argc, signature);
+        auto exn = invoke_method(clz, mtd, argc, signature);
         if (exn) {
             // TODO: what to do! I'm not really sure where we should propagate
             // an exception from a static block...
@@ -3901,20 +7973,25 @@ static void stacktrace()
     // java.lang.RuntimeException.<init>
     // test.Test.main
     //
-    int skip_frames = 1; // By default, skip this call to stacktrace()
-    for (int i = callstack.size() - 2; i > -1; --i) {
-        if (is_derived_from(callstack[i].first, throwable_clz)) {
-            ++skip_frames;
-        } else {
-            break;
+    // NOTE: Host frames (see HostFrame) don't belong in a stack trace either.
+    int start = frames.size() - 2; // By default, skip this call to stacktrace()
+    while (start > -1 and
+           (not frames[start].method_ or
+            is_derived_from(frames[start].clz_, throwable_clz))) {
+        --start;
+    }
+
+    int count = 0;
+    for (int i = start; i > -1; --i) {
+        if (frames[i].method_) {
+            ++count;
         }
     }
 
     auto clz =
         load_class_by_name(Slice::from_c_str("java/lang/StackTraceElement"));
 
-    push_operand_a(
-        *(Object*)Array::create(callstack.size() - skip_frames, clz));
+    push_operand_a(*(Object*)Array::create(count, clz));
 
     if (load_operand(0) == nullptr) {
         unhandled_error("oom");
@@ -3922,14 +7999,18 @@ static void stacktrace()
 
     int j = 0;
 
-    for (int i = callstack.size() - (1 + skip_frames); i > -1; --i) {
+    for (int i = start; i > -1; --i) {
+
+        auto& frame = frames[i];
 
-        auto& frame = callstack[i];
+        if (not frame.method_) {
+            continue;
+        }
 
         push_operand_a(*(Object*)make_instance_impl(clz));
         dup(0); // copy instance on stack
 
-        auto cname = classtable::name(frame.first);
+        auto cname = classtable::name(frame.clz_);
         StringBuffer<80> fmt_;
         fmt_ += cname;
 
@@ -3939,8 +8020,8 @@ static void stacktrace()
             }
         }
 
-        auto mtdname = frame.first->constants_->load_string(
-            frame.second->name_index_.get());
+        auto mtdname = frame.clz_->constants_->load_string(
+            frame.method_->name_index_.get());
 
         push_operand_a(
             *(Object*)make_string(Slice(fmt_.c_str(), fmt_.length())));
@@ -3953,8 +8034,7 @@ static void stacktrace()
             ArgumentInfo argc;
             argc.argument_count_ = 3;
             argc.operand_count_ = 3;
-            auto exn = invoke_method(
-                clz, (Object*)load_operand(2), mtd, argc, ctor_typeinfo);
+            auto exn = invoke_method(clz, mtd, argc, ctor_typeinfo);
             if (exn) {
                 unhandled_error("exn from StackTraceElement ctor");
             }
@@ -3972,7 +8052,7 @@ static void stacktrace()
 
 #else
 
-    push_operand(nullptr);
+    push_operand_p(nullptr);
 
 #endif
 }
@@ -3981,7 +8061,7 @@ static void stacktrace()
 
 static void bootstrap()
 {
-    bind_jar((const char*)lang_jar_data);
+    bind_jar((const char*)lang_jar_data, lang_jar_size);
 
     if (auto obj_class = import(Slice::from_c_str("java/lang/Object"))) {
         obj_class->super_ = nullptr;
@@ -3990,13 +8070,20 @@ static void bootstrap()
         reference_array_class.super_ = obj_class;
         return_address_class.super_ = obj_class;
 
-        jni::bind_native_method(obj_class,
-                                Slice::from_c_str("clone"),
-                                Slice::from_c_str("TODO_:)"),
-                                [] {
-                                    auto self = (Object*)load_local(0);
-                                    push_operand_a(*clone(self));
-                                });
+#if JVM_VTABLES
+        for (auto clz : {&primitive_array_class,
+                         &reference_array_class,
+                         &return_address_class}) {
+            clz->vtable_ = obj_class->vtable_;
+            clz->vtable_size_ = obj_class->vtable_size_;
+            clz->flags_ |= Class::Flag::has_vtable;
+        }
+#endif
+
+        jni::bind_native_function(obj_class,
+                                  Slice::from_c_str("clone"),
+                                  Slice::from_c_str("()Ljava/lang/Object;"),
+                                  clone);
 
         // Needs to be deferred until we've completed the above steps.
         invoke_static_block(obj_class);
@@ -4012,38 +8099,39 @@ static void bootstrap()
 
     if (auto runtime_class = import(Slice::from_c_str("java/lang/Runtime"))) {
 
-        jni::bind_native_method(runtime_class,
-                                Slice::from_c_str("exit"),
-                                Slice::from_c_str("TODO_:)"),
-                                [] { exit((intptr_t)load_local(1)); });
+        jni::bind_native_function(
+            runtime_class,
+            Slice::from_c_str("exit"),
+            Slice::from_c_str("(I)V"),
+            +[](Object*, s32 code) { exit(code); });
 
 
-        jni::bind_native_method(runtime_class,
-                                Slice::from_c_str("gc"),
-                                Slice::from_c_str("TODO_:)"),
-                                [] { java::jvm::gc::collect(); });
+        jni::bind_native_function(runtime_class,
+                                  Slice::from_c_str("gc"),
+                                  Slice::from_c_str("()V"),
+                                  +[](Object*) { java::jvm::gc::collect(); });
 
-        jni::bind_native_method(
+        jni::bind_native_function(
             runtime_class,
             Slice::from_c_str("totalMemory"),
-            Slice::from_c_str("TODO_:)"),
-            [] { push_wide_operand_l(jvm::heap::total()); });
+            Slice::from_c_str("()J"),
+            +[](Object*) -> s64 { return jvm::heap::total(); });
 
-        jni::bind_native_method(runtime_class,
-                                Slice::from_c_str("freeMemory"),
-                                Slice::from_c_str("TODO_:)"),
-                                [] {
-                                    push_wide_operand_l(jvm::heap::total() -
-                                                        jvm::heap::used());
-                                });
+        jni::bind_native_function(runtime_class,
+                                  Slice::from_c_str("freeMemory"),
+                                  Slice::from_c_str("()J"),
+                                  +[](Object*) -> s64 {
+                                      return jvm::heap::total() -
+                                             jvm::heap::used();
+                                  });
 
 
-#if JVM_USE_CALLSTACK
-        jni::bind_native_method(runtime_class,
-                                Slice::from_c_str("stackTrace"),
-                                Slice::from_c_str("TODO_:)"),
-                                stacktrace);
-#endif
+        // Walks the call stack, so needs a frame of its own.
+        jni::bind_native_method(
+            runtime_class,
+            Slice::from_c_str("stackTrace"),
+            Slice::from_c_str("()[Ljava/lang/StackTraceElement;"),
+            stacktrace);
     }
 
     if (import(Slice::from_c_str("java/lang/Throwable"))) {
@@ -4089,8 +8177,8 @@ static int start(Class* entry_point)
         argc.argument_count_ = 1;
         argc.operand_count_ = 1;
 
-        auto exn = java::jvm::invoke_method(
-            entry_point, nullptr, entry, argc, type_signature);
+        auto exn =
+            java::jvm::invoke_method(entry_point, entry, argc, type_signature);
 
         if (exn) {
             auto cname = classtable::name(exn->class_);
@@ -4121,16 +8209,92 @@ static int start(Class* entry_point)
 
 int start_from_jar(const char* jar_file_bytes, Slice classpath)
 {
+    const Slice jar{jar_file_bytes, 0};
+    return start_from_jars(&jar, 1, classpath);
+}
+
+
+
+int start_from_jars(const Slice* jars, int jar_count, Slice classpath)
+{
+    bootstrap();
+
+    // The vm searches the most recently bound jar first.
+    for (int i = jar_count - 1; i >= 0; --i) {
+        bind_jar(jars[i].ptr_, jars[i].length_);
+    }
+
+    if (auto clz = java::jvm::import(classpath)) {
+        return start(clz);
+    } else {
+        return 1;
+    }
+}
+
+
+
+#if JVM_SNAPSHOT
+// The app's jars, in order, then the prelinked image. Lang.jar sits in the
+// program, so needs no region of its own.
+static int
+snapshot_regions(snapshot::Region* regions, const Slice* jars, int jar_count)
+{
+    int count = 0;
+
+    for (int i = 0; i < jar_count; ++i) {
+        regions[count++] = {jars[i],
+                            jar::directory_crc32(jars[i].ptr_, jars[i].length_)};
+    }
+
+#if JVM_PRELINKED_IMAGE
+    if (prelinked_image.ptr_) {
+        regions[count++] = {prelinked_image,
+                            image::table_crc32(prelinked_image.ptr_)};
+    }
+#endif
+
+    return count;
+}
+
+
+
+int start_from_snapshot(Slice snapshot,
+                        const Slice* jars,
+                        int jar_count,
+                        Slice classpath,
+                        snapshot::Writer write,
+                        void* arg)
+{
+    if (jar_count + 1 > snapshot::max_regions) {
+        return start_from_jars(jars, jar_count, classpath);
+    }
+
+    snapshot::Region regions[snapshot::max_regions];
+    const auto region_count = snapshot_regions(regions, jars, jar_count);
+
+    if (snapshot.length_ and
+        snapshot::restore(snapshot, regions, region_count)) {
+        // NOTE: static initializers ran before we took the snapshot, and do not
+        // run again. Their side effects outside of the vm, if any, are lost.
+        return start(load_class_by_name(classpath));
+    }
+
     bootstrap();
 
-    bind_jar(jar_file_bytes);
+    for (int i = jar_count - 1; i >= 0; --i) {
+        bind_jar(jars[i].ptr_, jars[i].length_);
+    }
 
     if (auto clz = java::jvm::import(classpath)) {
+        if (write) {
+            snapshot::save(regions, region_count, write, arg);
+        }
         return start(clz);
     } else {
         return 1;
     }
 }
+#endif
 
 
 
@@ -4139,6 +8303,9 @@ int start_from_classfile(const char* class_file_bytes, Slice classpath)
     bootstrap();
 
     if (auto clz = parse_classfile(classpath, class_file_bytes)) {
+#if JVM_GC_REFERENCE_MAPS
+        reserve_reference_map_scratch(clz);
+#endif
         invoke_static_block(clz);
         return start(clz);
     } else {
@@ -4148,8 +8315,180 @@ int start_from_classfile(const char* class_file_bytes, Slice classpath)
 
 
 
+#if JVM_VTABLES
+void print_class_stats(void (*print_str_callback)(const char*))
+{
+    print_str_callback("vtables (class: slots, bytes of class memory)\n");
+
+    classtable::visit(
+        [](Slice name, Class* clz, void* arg) {
+            char buffer[120];
+            snprintf(buffer,
+                     sizeof buffer,
+                     "%.*s: %d, %zu\n",
+                     (int)name.length_,
+                     name.ptr_,
+                     clz->vtable_size_,
+                     clz->vtable_memory());
+
+            ((void (*)(const char*))arg)(buffer);
+        },
+        (void*)print_str_callback);
+}
+#else
+void print_class_stats(void (*)(const char*))
+{
+}
+#endif
+
+
+
+#if JVM_INLINE_CACHE_STATS
+void print_inline_cache_stats(void (*print_str_callback)(const char*))
+{
+    print_str_callback(
+        "inline caches (caller: method, receiver classes, hits, misses)\n");
+
+    classtable::visit(
+        [](Slice name, Class* clz, void* arg) {
+            clz->visit_quickened_code([&](Class::OptionQuickenedCode* quick) {
+                for (int i = 0; i < quick->inline_cache_count_; ++i) {
+                    auto& cache = quick->inline_caches_[i];
+
+                    auto ref = (const ClassFile::ConstantRef*)
+                                   clz->constants_->load(cache.constant_index_);
+                    auto nt = (const ClassFile::ConstantNameAndType*)
+                                  clz->constants_->load(
+                                      ref->name_and_type_index_.get());
+                    auto method =
+                        clz->constants_->load_string(nt->name_index_.get());
+
+                    char receivers[16];
+                    if (cache.receivers_ == InlineCache::megamorphic) {
+                        snprintf(receivers, sizeof receivers, "megamorphic");
+                    } else if (cache.receivers_ ==
+                               InlineCache::devirtualized) {
+                        snprintf(receivers, sizeof receivers, "devirtualized");
+                    } else {
+                        snprintf(receivers,
+                                 sizeof receivers,
+                                 "%d",
+                                 cache.receivers_);
+                    }
+
+                    char buffer[160];
+                    snprintf(buffer,
+                             sizeof buffer,
+                             "%.*s: %.*s, %s, %u, %u\n",
+                             (int)name.length_,
+                             name.ptr_,
+                             (int)method.length_,
+                             method.ptr_,
+                             receivers,
+                             (unsigned)cache.hits_,
+                             (unsigned)cache.misses_);
+
+                    ((void (*)(const char*))arg)(buffer);
+                }
+            });
+        },
+        (void*)print_str_callback);
+}
+#else
+void print_inline_cache_stats(void (*)(const char*))
+{
+}
+#endif
+
+
+
 } // namespace jvm
 
 
 
+namespace jni {
+
+
+
+s32 load_operand_i(int offset)
+{
+    return jvm::load_operand_i(offset);
+}
+
+
+
+float load_operand_f(int offset)
+{
+    return jvm::load_operand_f(offset);
+}
+
+
+
+s64 load_wide_operand_l(int offset)
+{
+    return jvm::load_wide_operand_l(offset);
+}
+
+
+
+double load_wide_operand_d(int offset)
+{
+    return jvm::load_wide_operand_d(offset);
+}
+
+
+
+Object* load_operand_a(int offset)
+{
+    return (Object*)jvm::load_operand(offset);
+}
+
+
+
+void push_operand_i(s32 value)
+{
+    jvm::push_operand_i(value);
+}
+
+
+
+void push_operand_f(float value)
+{
+    jvm::push_operand_f(value);
+}
+
+
+
+void push_wide_operand_l(s64 value)
+{
+    jvm::push_wide_operand_l(value);
+}
+
+
+
+void push_wide_operand_d(double value)
+{
+    jvm::push_wide_operand_d(value);
+}
+
+
+
+void push_operand_a(Object* value)
+{
+    jvm::push_operand_a(*value);
+}
+
+
+
+void pop_operands(int count)
+{
+    jvm::pop_operands(count);
+}
+
+
+
+} // namespace jni
+
+
+
 } // namespace java
@@ -5,6 +5,7 @@
 #include "defines.hpp"
 #include "java.hpp"
 #include "slice.hpp"
+#include "snapshot.hpp"
 
 
 
@@ -22,19 +23,14 @@ enum class OperandTypeCategory {
 
 
 using OperandStack = Buffer<void*, JVM_OPERAND_STACK_SIZE>;
-using OperandTypes = Buffer<OperandTypeCategory, JVM_OPERAND_STACK_SIZE>;
 
 
 OperandStack& operand_stack();
-OperandTypes& operand_types();
 
 
-using Locals = Buffer<void*, JVM_STACK_LOCALS_SIZE>;
-using LocalTypes = Buffer<OperandTypeCategory, JVM_STACK_LOCALS_SIZE>;
-
-
-Locals& locals();
-LocalTypes& local_types();
+// Calls the visitor for each operand stack slot and local variable that holds
+// a reference, i.e. the gc's roots, aside from static variables.
+void visit_stack_roots(void (*visitor)(Object**));
 
 
 
@@ -43,6 +39,41 @@ int start_from_jar(const char* jar_file_bytes, Slice classpath);
 
 
 
+// Like start_from_jar(), but loads classes from any of several jars, searched
+// in order. Each Slice holds a jar's bytes, which the vm runs classes straight
+// out of, and which therefore need to stay put, but may be read-only. A jar's
+// length may be zero, if not known.
+int start_from_jars(const Slice* jars, int jar_count, Slice classpath);
+
+
+
+#if JVM_PRELINKED_IMAGE
+// Loads classes with the help of a prelinked image, see image.hpp, written by
+// tools/prelink.cpp for the jars that the vm runs. Like a jar, the image needs
+// to stay put, but may be read-only. Call before starting the vm. Returns false,
+// and runs without the image, if the image is truncated or corrupt, see
+// image::check().
+bool bind_image(const char* image_bytes, size_t image_size);
+#endif
+
+
+
+#if JVM_SNAPSHOT
+// Like start_from_jars(), but restores the vm from a snapshot, if the snapshot
+// matches this build of the vm, the jars, and the prelinked image, if any, see
+// snapshot.hpp. Otherwise, starts the vm the usual way, and, if given a
+// writer, passes it a new snapshot, just before calling main(). The snapshot
+// may be empty. Jars need known sizes.
+int start_from_snapshot(Slice snapshot,
+                        const Slice* jars,
+                        int jar_count,
+                        Slice classpath,
+                        snapshot::Writer write,
+                        void* arg);
+#endif
+
+
+
 void register_class(Slice name, Class* clz);
 
 
@@ -52,5 +83,24 @@ Class* load_class_by_name(Slice class_name);
 
 
 
+// Per-class metadata costs, e.g. vtables.
+void print_class_stats(void (*print_str_callback)(const char*));
+
+
+
+#if JVM_DEVIRTUALIZE
+// Called when a class overrides a method, so that call sites bound to the
+// method by class hierarchy analysis go back to checking the receiver.
+void invalidate_devirtualized_calls(const ClassFile::MethodInfo* method);
+#endif
+
+
+
+// Per-call-site inline cache hits and misses. Prints nothing, unless built with
+// JVM_INLINE_CACHE_STATS.
+void print_inline_cache_stats(void (*print_str_callback)(const char*));
+
+
+
 } // namespace jvm
 } // namespace java
@@ -0,0 +1,403 @@
+// Offline tool: counts the opcode pairs and triples that occur in the methods
+// of one or more jars. I used it to pick the superinstructions in vm.cpp (see
+// fuse_superinstructions()), and it's worth re-running over Lang.jar plus an
+// application's jar when the set needs revisiting. Build with
+// ./build-tools.sh, then e.g.:
+//
+// ./opcode-stats Lang.jar unittest/Test.jar
+//
+// The counts are static (occurrences in the bytecode, not executions), and a
+// sequence is only counted when control actually falls through from each
+// instruction to the next, i.e. goto/return/athrow/switch may only appear at
+// the end of a sequence. Like the vm itself, we only support uncompressed
+// jars.
+
+
+#include "../src/classfile.hpp"
+#include "../src/endian.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+
+
+namespace java {
+
+
+
+void unhandled_error(const char* description)
+{
+    std::cerr << description << std::endl;
+    exit(1);
+}
+
+
+
+void uncaught_exception(Slice, Slice)
+{
+    exit(1);
+}
+
+
+
+} // namespace java
+
+
+
+using namespace java;
+
+
+
+// clang-format off
+static const char* const opcode_names[256] = {
+    "nop", "aconst_null", "iconst_m1", "iconst_0", "iconst_1", "iconst_2",
+    "iconst_3", "iconst_4", "iconst_5", "lconst_0", "lconst_1", "fconst_0",
+    "fconst_1", "fconst_2", "dconst_0", "dconst_1", "bipush", "sipush", "ldc",
+    "ldc_w", "ldc2_w", "iload", "lload", "fload", "dload", "aload", "iload_0",
+    "iload_1", "iload_2", "iload_3", "lload_0", "lload_1", "lload_2",
+    "lload_3", "fload_0", "fload_1", "fload_2", "fload_3", "dload_0",
+    "dload_1", "dload_2", "dload_3", "aload_0", "aload_1", "aload_2",
+    "aload_3", "iaload", "laload", "faload", "daload", "aaload", "baload",
+    "caload", "saload", "istore", "lstore", "fstore", "dstore", "astore",
+    "istore_0", "istore_1", "istore_2", "istore_3", "lstore_0", "lstore_1",
+    "lstore_2", "lstore_3", "fstore_0", "fstore_1", "fstore_2", "fstore_3",
+    "dstore_0", "dstore_1", "dstore_2", "dstore_3", "astore_0", "astore_1",
+    "astore_2", "astore_3", "iastore", "lastore", "fastore", "dastore",
+    "aastore", "bastore", "castore", "sastore", "pop", "pop2", "dup",
+    "dup_x1", "dup_x2", "dup2", "dup2_x1", "dup2_x2", "swap", "iadd", "ladd",
+    "fadd", "dadd", "isub", "lsub", "fsub", "dsub", "imul", "lmul", "fmul",
+    "dmul", "idiv", "ldiv", "fdiv", "ddiv", "irem", "lrem", "frem", "drem",
+    "ineg", "lneg", "fneg", "dneg", "ishl", "lshl", "ishr", "lshr", "iushr",
+    "lushr", "iand", "land", "ior", "lor", "ixor", "lxor", "iinc", "i2l",
+    "i2f", "i2d", "l2i", "l2f", "l2d", "f2i", "f2l", "f2d", "d2i", "d2l",
+    "d2f", "i2b", "i2c", "i2s", "lcmp", "fcmpl", "fcmpg", "dcmpl", "dcmpg",
+    "ifeq", "ifne", "iflt", "ifge", "ifgt", "ifle", "if_icmpeq", "if_icmpne",
+    "if_icmplt", "if_icmpge", "if_icmpgt", "if_icmple", "if_acmpeq",
+    "if_acmpne", "goto", "jsr", "ret", "tableswitch", "lookupswitch",
+    "ireturn", "lreturn", "freturn", "dreturn", "areturn", "return",
+    "getstatic", "putstatic", "getfield", "putfield", "invokevirtual",
+    "invokespecial", "invokestatic", "invokeinterface", "invokedynamic",
+    "new", "newarray", "anewarray", "arraylength", "athrow", "checkcast",
+    "instanceof", "monitorenter", "monitorexit", "wide", "multianewarray",
+    "ifnull", "ifnonnull", "goto_w", "jsr_w",
+};
+// clang-format on
+
+
+
+static const char* opcode_name(u8 opcode)
+{
+    if (auto name = opcode_names[opcode]) {
+        return name;
+    }
+    return "<invalid>";
+}
+
+
+
+// Same as instruction_length() in vm.cpp, minus the private opcodes.
+static u32 instruction_length(const u8* code, u32 pc)
+{
+    auto aligned = [pc] {
+        u32 i = pc + 1;
+        if (i % 4 not_eq 0) {
+            i += 4 - i % 4;
+        }
+        return i;
+    };
+
+    switch (code[pc]) {
+    case 0xaa: { // tableswitch
+        const u32 i = aligned();
+        const auto low = ((network_s32*)(code + i + 4))->get();
+        const auto high = ((network_s32*)(code + i + 8))->get();
+        return (i - pc) + 12 + 4 * (high - low + 1);
+    }
+
+    case 0xab: { // lookupswitch
+        const u32 i = aligned();
+        const auto npairs = ((network_s32*)(code + i + 4))->get();
+        return (i - pc) + 8 + 8 * npairs;
+    }
+
+    case 0xc4: // wide
+        return code[pc + 1] == 0x84 ? 6 : 4;
+
+    case 0x10: // bipush
+    case 0x12: // ldc
+    case 0xbc: // newarray
+    case 0xa9: // ret
+        return 2;
+
+    case 0x11: // sipush
+    case 0x13: // ldc_w
+    case 0x14: // ldc2_w
+    case 0x84: // iinc
+        return 3;
+
+    case 0xc5: // multianewarray
+        return 4;
+
+    case 0xb9: // invokeinterface
+    case 0xba: // invokedynamic
+    case 0xc8: // goto_w
+    case 0xc9: // jsr_w
+        return 5;
+    }
+
+    if (code[pc] >= 0x15 and code[pc] <= 0x19) { // xload
+        return 2;
+    }
+    if (code[pc] >= 0x36 and code[pc] <= 0x3a) { // xstore
+        return 2;
+    }
+    if (code[pc] >= 0x99 and code[pc] <= 0xa8) { // if*, goto, jsr
+        return 3;
+    }
+    if (code[pc] >= 0xb2 and code[pc] <= 0xb8) { // fields, invokes
+        return 3;
+    }
+    if (code[pc] == 0xbb or code[pc] == 0xbd or code[pc] == 0xc0 or
+        code[pc] == 0xc1 or code[pc] == 0xc6 or code[pc] == 0xc7) {
+        return 3;
+    }
+
+    return 1;
+}
+
+
+
+// Whether execution may continue with the next instruction.
+static bool falls_through(u8 opcode)
+{
+    switch (opcode) {
+    case 0xa7: // goto
+    case 0xc8: // goto_w
+    case 0xa8: // jsr
+    case 0xc9: // jsr_w
+    case 0xa9: // ret
+    case 0xaa: // tableswitch
+    case 0xab: // lookupswitch
+    case 0xbf: // athrow
+        return false;
+    }
+    return not(opcode >= 0xac and opcode <= 0xb1); // xreturn
+}
+
+
+
+struct Stats {
+    u32 methods_ = 0;
+    u32 instructions_ = 0;
+    std::map<std::vector<u8>, u32> sequences_[2];
+};
+
+
+
+static void count_code(Stats& stats, const u8* code, u32 code_length)
+{
+    ++stats.methods_;
+
+    std::vector<u8> window;
+
+    for (u32 pc = 0; pc < code_length; pc += instruction_length(code, pc)) {
+        ++stats.instructions_;
+
+        window.push_back(code[pc]);
+        if (window.size() > 3) {
+            window.erase(window.begin());
+        }
+
+        if (window.size() >= 2) {
+            ++stats.sequences_[0][{window.end() - 2, window.end()}];
+        }
+        if (window.size() == 3) {
+            ++stats.sequences_[1][window];
+        }
+
+        if (not falls_through(code[pc])) {
+            window.clear();
+        }
+    }
+}
+
+
+
+static void count_class(Stats& stats, const char* classfile)
+{
+    auto str = classfile;
+
+    auto h1 = (const ClassFile::HeaderSection1*)str;
+    if (h1->magic_.get() not_eq 0xcafebabe) {
+        return;
+    }
+    str += sizeof(ClassFile::HeaderSection1);
+
+    std::vector<Slice> utf8(h1->constant_count_.get());
+
+    for (int i = 0; i < h1->constant_count_.get() - 1; ++i) {
+        auto hdr = (const ClassFile::ConstantHeader*)str;
+
+        if (hdr->tag_ == ClassFile::t_utf8) {
+            auto c = (const ClassFile::ConstantUtf8*)hdr;
+            utf8[i + 1] = {str + sizeof(ClassFile::ConstantUtf8),
+                           c->length_.get()};
+        }
+
+        str += ClassFile::constant_size(hdr);
+
+        if (hdr->tag_ == ClassFile::t_double or
+            hdr->tag_ == ClassFile::t_long) {
+            ++i;
+        }
+    }
+
+    auto h2 = (const ClassFile::HeaderSection2*)str;
+    str += sizeof(ClassFile::HeaderSection2);
+    str += h2->interfaces_count_.get() * sizeof(u16);
+
+    auto skip_attributes = [&](int count) {
+        for (int i = 0; i < count; ++i) {
+            auto attr = (const ClassFile::AttributeInfo*)str;
+            str += sizeof(ClassFile::AttributeInfo) +
+                   attr->attribute_length_.get();
+        }
+    };
+
+    auto h3 = (const ClassFile::HeaderSection3*)str;
+    str += sizeof(ClassFile::HeaderSection3);
+
+    for (int i = 0; i < h3->fields_count_.get(); ++i) {
+        auto field = (const ClassFile::FieldInfo*)str;
+        str += sizeof(ClassFile::FieldInfo);
+        skip_attributes(field->attributes_count_.get());
+    }
+
+    auto h4 = (const ClassFile::HeaderSection4*)str;
+    str += sizeof(ClassFile::HeaderSection4);
+
+    for (int i = 0; i < h4->methods_count_.get(); ++i) {
+        auto method = (const ClassFile::MethodInfo*)str;
+        str += sizeof(ClassFile::MethodInfo);
+
+        for (int j = 0; j < method->attributes_count_.get(); ++j) {
+            auto attr = (const ClassFile::AttributeInfo*)str;
+            const auto name_index = attr->attribute_name_index_.get();
+
+            if (name_index < utf8.size() and
+                utf8[name_index] == Slice::from_c_str("Code")) {
+                auto code = (const ClassFile::AttributeCode*)attr;
+                count_code(stats,
+                           (const u8*)str + sizeof(ClassFile::AttributeCode),
+                           code->code_length_.get());
+            }
+
+            str += sizeof(ClassFile::AttributeInfo) +
+                   attr->attribute_length_.get();
+        }
+    }
+}
+
+
+
+// Walk the local file headers, like jar::load_file_data() does.
+static bool count_jar(Stats& stats, const std::string& data)
+{
+    const char* str = data.c_str();
+    const char* end = str + data.size();
+
+    while (str + 30 <= end) {
+        if (((host_u32*)str)->get() not_eq 0x04034b50) {
+            break; // Central directory
+        }
+
+        const auto flags = ((host_u16*)(str + 6))->get();
+        const auto method = ((host_u16*)(str + 8))->get();
+        const auto size = ((host_u32*)(str + 18))->get();
+        const auto name_length = ((host_u16*)(str + 26))->get();
+        const auto extra_length = ((host_u16*)(str + 28))->get();
+
+        if (method not_eq 0 or (flags & (1 << 3))) {
+            std::cerr << "compressed jar, see fixup-jar.sh" << std::endl;
+            return false;
+        }
+
+        const std::string name(str + 30, name_length);
+        str += 30 + name_length + extra_length;
+
+        if (name.size() > 6 and name.substr(name.size() - 6) == ".class") {
+            count_class(stats, str);
+        }
+
+        str += size;
+    }
+
+    return true;
+}
+
+
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        puts("usage: opcode-stats [-n <count>] <jar>...");
+        return 1;
+    }
+
+    Stats stats;
+    size_t top = 40;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "-n" and i + 1 < argc) {
+            top = atoi(argv[++i]);
+            continue;
+        }
+
+        std::ifstream t(argv[i], std::ios::binary);
+        if (not t) {
+            std::cerr << "failed to open " << argv[i] << std::endl;
+            return 1;
+        }
+        std::string str((std::istreambuf_iterator<char>(t)),
+                        std::istreambuf_iterator<char>());
+
+        if (not count_jar(stats, str)) {
+            return 1;
+        }
+    }
+
+    printf("%u methods, %u instructions\n",
+           stats.methods_,
+           stats.instructions_);
+
+    const char* titles[] = {"pairs", "triples"};
+
+    for (int n = 0; n < 2; ++n) {
+        using Entry = std::pair<std::vector<u8>, u32>;
+
+        std::vector<Entry> sorted(stats.sequences_[n].begin(),
+                                  stats.sequences_[n].end());
+
+        std::sort(sorted.begin(),
+                  sorted.end(),
+                  [](const Entry& lhs, const Entry& rhs) {
+                      return lhs.second > rhs.second;
+                  });
+
+        printf("\n%s:\n", titles[n]);
+
+        for (size_t i = 0; i < std::min(top, sorted.size()); ++i) {
+            printf("%8u %5.2f%%  ",
+                   sorted[i].second,
+                   100.0 * sorted[i].second / stats.instructions_);
+            for (auto op : sorted[i].first) {
+                printf(" %s", opcode_name(op));
+            }
+            printf("\n");
+        }
+    }
+}
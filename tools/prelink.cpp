@@ -0,0 +1,305 @@
+// Offline tool: writes a prelinked image for one or more jars, see
+// src/image.hpp. For each class, the image records where each constant sits in
+// the constant pool, where the sections after the constant pool begin, and how
+// many field, method and interface method references the class makes, so that
+// the vm need not walk the classfile to find out when loading the class. Build
+// with ./build-tools.sh, then e.g.:
+//
+// ./prelink app.img unittest/Test.jar src/Lang.jar
+// ./eb-java unittest/Test.jar Main -image app.img
+//
+// Pass the jars in the order that the vm searches them: the program's jar, any
+// -cp jars, then Lang.jar, which the vm binds first, and so searches last.
+// Include Lang.jar, or the vm loads the java.lang classes the usual way. Each
+// record matches one exact classfile, by the crc32 that the jar stores, so a
+// stale image just stops helping, for the classes that changed. Like the vm
+// itself, we only support uncompressed jars.
+
+
+#include "../src/classfile.hpp"
+#include "../src/crc32.hpp"
+#include "../src/endian.hpp"
+#include "../src/image.hpp"
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+
+
+namespace java {
+
+
+
+void unhandled_error(const char* description)
+{
+    std::cerr << description << std::endl;
+    exit(1);
+}
+
+
+
+void uncaught_exception(Slice, Slice)
+{
+    exit(1);
+}
+
+
+
+} // namespace java
+
+
+
+using namespace java;
+
+
+
+struct Record {
+    std::string name_;
+    std::vector<char> data_; // image::ClassRecord, name and offsets
+};
+
+
+
+template <typename T> static void append(std::vector<char>& out, T value)
+{
+    HostInteger<T> encoded;
+    encoded.set(value);
+    out.insert(out.end(), (char*)&encoded, (char*)&encoded + sizeof encoded);
+}
+
+
+
+// Returns false for classfiles that the image cannot describe, e.g. ones whose
+// constant pool runs past the reach of a u16 offset.
+static bool
+make_record(Record& record, const char* classfile, u32 size, u32 crc)
+{
+    auto h1 = (const ClassFile::HeaderSection1*)classfile;
+
+    if (size < sizeof(ClassFile::HeaderSection1) or
+        h1->magic_.get() not_eq 0xcafebabe) {
+        return false;
+    }
+
+    const int count = h1->constant_count_.get() - 1;
+
+    std::vector<u16> offsets(count > 0 ? count : 0);
+    u16 field_refs = 0;
+    u16 method_refs = 0;
+    u16 interface_method_refs = 0;
+
+    const char* str = classfile + sizeof(ClassFile::HeaderSection1);
+
+    for (int i = 0; i < count; ++i) {
+        if (str - classfile > 0xffff) {
+            return false;
+        }
+
+        auto c = (const ClassFile::ConstantHeader*)str;
+        offsets[i] = str - classfile;
+
+        switch (c->tag_) {
+        case ClassFile::t_field_ref:
+            ++field_refs;
+            break;
+
+        case ClassFile::t_method_ref:
+            ++method_refs;
+            break;
+
+        case ClassFile::t_interface_method_ref:
+            ++interface_method_refs;
+            break;
+
+        case ClassFile::t_double:
+        case ClassFile::t_long:
+            ++i; // The next slot is unusable, and stays zero.
+            break;
+
+        default:
+            break;
+        }
+
+        str += ClassFile::constant_size(c);
+    }
+
+    const u32 interfaces_offset = str - classfile;
+
+    auto h2 = (const ClassFile::HeaderSection2*)str;
+    str += sizeof(ClassFile::HeaderSection2);
+    str += sizeof(u16) * h2->interfaces_count_.get();
+
+    const u32 fields_offset = str - classfile;
+
+    auto skip_members = [&str](int member_count) {
+        for (int i = 0; i < member_count; ++i) {
+            // FieldInfo and MethodInfo share a layout.
+            auto member = (const ClassFile::FieldInfo*)str;
+            str += sizeof(ClassFile::FieldInfo);
+
+            for (int j = 0; j < member->attributes_count_.get(); ++j) {
+                auto attr = (const ClassFile::AttributeInfo*)str;
+                str += sizeof(ClassFile::AttributeInfo) +
+                       attr->attribute_length_.get();
+            }
+        }
+    };
+
+    auto h3 = (const ClassFile::HeaderSection3*)str;
+    str += sizeof(ClassFile::HeaderSection3);
+    skip_members(h3->fields_count_.get());
+
+    auto h4 = (const ClassFile::HeaderSection4*)str;
+    str += sizeof(ClassFile::HeaderSection4);
+    skip_members(h4->methods_count_.get());
+
+    const u32 attributes_offset = str - classfile;
+
+    if (attributes_offset + sizeof(ClassFile::HeaderSection5) > size) {
+        return false;
+    }
+
+    auto& out = record.data_;
+
+    append<u32>(out, size);
+    append<u32>(out, crc);
+    append<u32>(out, interfaces_offset);
+    append<u32>(out, fields_offset);
+    append<u32>(out, attributes_offset);
+    append<u16>(out, field_refs);
+    append<u16>(out, method_refs);
+    append<u16>(out, interface_method_refs);
+    append<u16>(out, h1->constant_count_.get());
+    append<u16>(out, record.name_.size());
+
+    out.insert(out.end(), record.name_.begin(), record.name_.end());
+
+    for (auto offset : offsets) {
+        append<u16>(out, offset);
+    }
+
+    return true;
+}
+
+
+
+// Walk the local file headers, like jar::load_file_data() does.
+static bool prelink_jar(std::vector<Record>& records,
+                        std::set<std::string>& seen,
+                        const std::string& data)
+{
+    const char* str = data.c_str();
+    const char* end = str + data.size();
+
+    while (str + 30 <= end) {
+        if (((host_u32*)str)->get() not_eq 0x04034b50) {
+            break; // Central directory
+        }
+
+        const auto flags = ((host_u16*)(str + 6))->get();
+        const auto method = ((host_u16*)(str + 8))->get();
+        const auto crc = ((host_u32*)(str + 14))->get();
+        const auto size = ((host_u32*)(str + 18))->get();
+        const auto name_length = ((host_u16*)(str + 26))->get();
+        const auto extra_length = ((host_u16*)(str + 28))->get();
+
+        if (method not_eq 0 or (flags & (1 << 3))) {
+            std::cerr << "compressed jar, see fixup-jar.sh" << std::endl;
+            return false;
+        }
+
+        const std::string name(str + 30, name_length);
+        str += 30 + name_length + extra_length;
+
+        if (name.size() > 6 and name.substr(name.size() - 6) == ".class") {
+            Record record;
+            record.name_ = name.substr(0, name.size() - 6);
+
+            // The vm only ever loads the first copy of a class that it finds,
+            // so we keep the record of the first copy, see above.
+            if (seen.insert(record.name_).second and
+                make_record(record, str, size, crc)) {
+                records.push_back(std::move(record));
+            }
+        }
+
+        str += size;
+    }
+
+    return true;
+}
+
+
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        puts("usage: prelink <image> <jar>...");
+        return 1;
+    }
+
+    std::vector<Record> records;
+    std::set<std::string> seen;
+
+    for (int i = 2; i < argc; ++i) {
+        std::ifstream t(argv[i], std::ios::binary);
+        if (not t) {
+            std::cerr << "failed to open " << argv[i] << std::endl;
+            return 1;
+        }
+        std::string str((std::istreambuf_iterator<char>(t)),
+                        std::istreambuf_iterator<char>());
+
+        if (not prelink_jar(records, seen, str)) {
+            return 1;
+        }
+    }
+
+    // At most two thirds full, like the vm's jar indexes.
+    const size_t capacity = records.size() + records.size() / 2 + 1;
+
+    if (capacity > 0xffff) {
+        std::cerr << "too many classes" << std::endl;
+        return 1;
+    }
+
+    std::vector<u32> slots(capacity, 0);
+
+    u32 offset = sizeof(image::Header) + sizeof(host_u32) * capacity;
+
+    for (auto& record : records) {
+        auto slot = crc32(record.name_.c_str(), record.name_.size()) % capacity;
+        while (slots[slot]) {
+            slot = (slot + 1) % capacity;
+        }
+        slots[slot] = offset;
+        offset += record.data_.size();
+    }
+
+    std::vector<char> out;
+
+    append<u32>(out, image::magic);
+    append<u16>(out, image::version);
+    append<u16>(out, capacity);
+
+    for (auto slot : slots) {
+        append<u32>(out, slot);
+    }
+
+    for (auto& record : records) {
+        out.insert(out.end(), record.data_.begin(), record.data_.end());
+    }
+
+    std::ofstream image(argv[1], std::ios::binary);
+    image.write(out.data(), out.size());
+
+    if (not image) {
+        std::cerr << "failed to write " << argv[1] << std::endl;
+        return 1;
+    }
+
+    printf("%zu classes, %zu bytes\n", records.size(), out.size());
+}
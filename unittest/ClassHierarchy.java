@@ -0,0 +1,112 @@
+package test;
+
+
+
+class ChaBase {
+
+    int value()
+    {
+        return 1;
+    }
+
+
+    int twice()
+    {
+        return value() * 2;
+    }
+}
+
+
+class ChaMid extends ChaBase {
+}
+
+
+class ChaSub extends ChaBase {
+
+    int value()
+    {
+        return 10;
+    }
+}
+
+
+class ChaLeaf extends ChaMid {
+
+    int value()
+    {
+        return 100;
+    }
+}
+
+
+// While no loaded class overrides ChaBase.value(), the vm may bind calls to it
+// outright. Loading an override must unbind them.
+class ClassHierarchy {
+
+
+    static void check(boolean condition)
+    {
+        if (!condition) {
+            Runtime.getRuntime().exit(1);
+        }
+    }
+
+
+    static int call(ChaBase base)
+    {
+        return base.value();
+    }
+
+
+    static int callMid(ChaMid mid)
+    {
+        return mid.value();
+    }
+
+
+    // The overriding classes load when these first run, not before.
+    static ChaBase makeSub()
+    {
+        return new ChaSub();
+    }
+
+
+    static ChaMid makeLeaf()
+    {
+        return new ChaLeaf();
+    }
+
+
+    public static void main(String[] args)
+    {
+        ChaBase base = new ChaBase();
+        ChaMid mid = new ChaMid();
+
+        for (int i = 0; i < 100; ++i) {
+            check(call(base) == 1);
+            check(call(mid) == 1);
+            check(callMid(mid) == 1);
+            check(base.twice() == 2);
+        }
+
+        ChaBase sub = makeSub();
+
+        for (int i = 0; i < 100; ++i) {
+            check(call(sub) == 10);
+            check(call(base) == 1);
+            check(sub.twice() == 20);
+            check(base.twice() == 2);
+            check(callMid(mid) == 1);
+        }
+
+        ChaMid leaf = makeLeaf();
+
+        for (int i = 0; i < 100; ++i) {
+            check(callMid(leaf) == 100);
+            check(callMid(mid) == 1);
+            check(call(leaf) == 100);
+            check(call(sub) == 10);
+            check(leaf.twice() == 200);
+        }
+    }
+}
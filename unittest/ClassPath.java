@@ -0,0 +1,39 @@
+package test;
+
+
+
+// runtests.sh also runs this test with ClassPathLib in a jar of its own,
+// passed with -cp.
+class ClassPathLib {
+
+    static int counter = 7;
+
+
+    int next()
+    {
+        return ++counter;
+    }
+}
+
+
+
+class ClassPath {
+
+
+    static void check(boolean condition)
+    {
+        if (!condition) {
+            Runtime.getRuntime().exit(1);
+        }
+    }
+
+
+    public static void main(String[] args)
+    {
+        ClassPathLib lib = new ClassPathLib();
+
+        check(lib.next() == 8);
+        check(lib.next() == 9);
+        check(ClassPathLib.counter == 9);
+    }
+}
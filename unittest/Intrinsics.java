@@ -0,0 +1,333 @@
+package test;
+
+
+
+class IntrinsicsFields {
+
+    // Field initializers run after Object.<init>, which the vm replaces with an
+    // intrinsic that does nothing.
+    int x = 5;
+    long y = 1L << 40;
+    String z = "z";
+}
+
+
+// Compares the vm's intrinsics (see src/intrinsics.cpp) with copies of the
+// Lang.jar methods that they replace.
+class Intrinsics {
+
+
+    static void check(boolean condition)
+    {
+        if (!condition) {
+            Runtime.getRuntime().exit(1);
+        }
+    }
+
+
+    static final char[] digits = {
+        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9'
+    };
+
+
+    static final char[] DigitTens = new char[100];
+    static final char[] DigitOnes = new char[100];
+
+
+    static
+    {
+        for (int i = 0; i < 100; ++i) {
+            DigitTens[i] = digits[i / 10];
+            DigitOnes[i] = digits[i % 10];
+        }
+    }
+
+
+    // From java.lang.IntegerStringConverter.
+    static int stringSize(int x)
+    {
+        final int[] sizeTable = {
+            9, 99, 999, 9999, 99999, 999999, 9999999,
+            99999999, 999999999, 0x7fffffff
+        };
+
+        for (int i = 0; ; i++) {
+            if (x <= sizeTable[i]) {
+                return i + 1;
+            }
+        }
+    }
+
+
+    // From java.lang.IntegerStringConverter.
+    static int stringSize(long x)
+    {
+        long p = 10;
+        for (int i = 1; i < 19; i++) {
+            if (x < p) {
+                return i;
+            }
+            p = 10 * p;
+        }
+        return 19;
+    }
+
+
+    // From java.lang.IntegerStringConverter.
+    static void getChars(int i, int index, char[] buf)
+    {
+        int q, r;
+        int charPos = index;
+        char sign = 0;
+
+        if (i < 0) {
+            sign = '-';
+            i = -i;
+        }
+
+        while (i >= 65536) {
+            q = i / 100;
+            r = i - ((q << 6) + (q << 5) + (q << 2));
+            i = q;
+            buf[--charPos] = DigitOnes[r];
+            buf[--charPos] = DigitTens[r];
+        }
+
+        for (;;) {
+            q = (i * 52429) >>> (16+3);
+            r = i - ((q << 3) + (q << 1));
+            buf[--charPos] = digits [r];
+            i = q;
+            if (i == 0) break;
+        }
+
+        if (sign != 0) {
+            buf [--charPos] = sign;
+        }
+    }
+
+
+    // From java.lang.IntegerStringConverter.
+    static void getChars(long i, int index, char[] buf)
+    {
+        long q;
+        int r;
+        int charPos = index;
+        char sign = 0;
+
+        if (i < 0) {
+            sign = '-';
+            i = -i;
+        }
+
+        while (i > 0x7fffffff) {
+            q = i / 100;
+            r = (int)(i - ((q << 6) + (q << 5) + (q << 2)));
+            i = q;
+            buf[--charPos] = DigitOnes[r];
+            buf[--charPos] = DigitTens[r];
+        }
+
+        int q2;
+        int i2 = (int)i;
+        while (i2 >= 65536) {
+            q2 = i2 / 100;
+            r = i2 - ((q2 << 6) + (q2 << 5) + (q2 << 2));
+            i2 = q2;
+            buf[--charPos] = DigitOnes[r];
+            buf[--charPos] = DigitTens[r];
+        }
+
+        for (;;) {
+            q2 = (i2 * 52429) >>> (16+3);
+            r = i2 - ((q2 << 3) + (q2 << 1));
+            buf[--charPos] = digits[r];
+            i2 = q2;
+            if (i2 == 0) break;
+        }
+
+        if (sign != 0) {
+            buf[--charPos] = sign;
+        }
+    }
+
+
+    // From java.lang.String, on the strings' contents.
+    static boolean equals(String self, Object other)
+    {
+        if (self == other) {
+            return true;
+        }
+
+        if (other instanceof String) {
+            char v1[] = self.toCharArray();
+            char v2[] = ((String)other).toCharArray();
+            int n = v1.length;
+
+            if (n == v2.length) {
+                int i = 0;
+
+                while (n-- != 0) {
+                    if (v1[i] != v2[i])
+                        return false;
+                    i++;
+                }
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+    static boolean same(String str, char[] expected)
+    {
+        char[] chars = str.toCharArray();
+
+        if (chars.length != expected.length) {
+            return false;
+        }
+
+        for (int i = 0; i < chars.length; ++i) {
+            if (chars[i] != expected[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    static void checkString(String str)
+    {
+        char[] chars = str.toCharArray();
+
+        check(str.length() == chars.length);
+
+        for (int i = 0; i < chars.length; ++i) {
+            check(str.charAt(i) == chars[i]);
+        }
+
+        boolean thrown = false;
+        try {
+            str.charAt(chars.length);
+        } catch (StringIndexOutOfBoundsException exn) {
+            thrown = true;
+        }
+        check(thrown);
+
+        thrown = false;
+        try {
+            str.charAt(-1);
+        } catch (StringIndexOutOfBoundsException exn) {
+            thrown = true;
+        }
+        check(thrown);
+    }
+
+
+    static void checkInt(int i)
+    {
+        int size = (i < 0) ? stringSize(-i) + 1 : stringSize(i);
+        char[] buf = new char[size];
+        getChars(i, size, buf);
+
+        String str = Integer.toString(i);
+        check(same(str, buf));
+        checkString(str);
+    }
+
+
+    static void checkLong(long i)
+    {
+        int size = (i < 0) ? stringSize(-i) + 1 : stringSize(i);
+        char[] buf = new char[size];
+        getChars(i, size, buf);
+
+        String str = Long.toString(i);
+        check(same(str, buf));
+        checkString(str);
+    }
+
+
+    public static void main(String[] args)
+    {
+        IntrinsicsFields fields = new IntrinsicsFields();
+        check(fields.x == 5 && fields.y == 1L << 40 && fields.z.equals("z"));
+
+        // Every digit count, and the values around each step of the
+        // conversion (NOTE: Lang.jar does not handle MIN_VALUE).
+        int p = 1;
+        for (int n = 1; n <= 10; ++n) {
+            checkInt(p);
+            checkInt(p - 1);
+            checkInt(-p);
+            checkInt(1 - p);
+            if (n < 10) {
+                checkInt(p * 10 - 1);
+                p *= 10;
+            }
+        }
+        checkInt(65535);
+        checkInt(65536);
+        checkInt(-65536);
+        checkInt(0x7fffffff);
+        checkInt(-0x7fffffff);
+
+        long q = 1;
+        for (int n = 1; n <= 19; ++n) {
+            checkLong(q);
+            checkLong(q - 1);
+            checkLong(-q);
+            if (n < 19) {
+                checkLong(q * 10 - 1);
+                q *= 10;
+            }
+        }
+        checkLong(0x7fffffffL);
+        checkLong(0x80000000L);
+        checkLong(0x7fffffffffffffffL);
+        checkLong(-0x7fffffffffffffffL);
+
+        int seed = 12345;
+        for (int i = 0; i < 500; ++i) {
+            seed = seed * 1103515245 + 12345;
+            if (seed != 0x80000000) {
+                checkInt(seed);
+                checkInt(seed >> (i % 31));
+            }
+            checkLong(((long)seed << 21) + i);
+        }
+
+        String[] strings = {
+            "", "a", "ab", "abc", "abd", "abcd", "hello, world!", "hello, world?"
+        };
+
+        for (int i = 0; i < strings.length; ++i) {
+            checkString(strings[i]);
+
+            for (int j = 0; j < strings.length; ++j) {
+                check(strings[i].equals(strings[j]) ==
+                      equals(strings[i], strings[j]));
+            }
+
+            String copy = new String(strings[i].toCharArray());
+            check(copy != strings[i]);
+            check(copy.equals(strings[i]) && equals(copy, strings[i]));
+
+            check(!strings[i].equals(null) && !equals(strings[i], null));
+
+            Object notString = new IntrinsicsFields();
+            check(!strings[i].equals(notString));
+        }
+
+        // Appends grow the builder's array over and over again.
+        StringBuilder builder = new StringBuilder();
+        char[] expected = new char[1000];
+        for (int i = 0; i < expected.length; ++i) {
+            expected[i] = (char)('a' + i % 26);
+            check(builder.append(expected[i]) == builder);
+        }
+        check(same(builder.toString(), expected));
+    }
+}
@@ -0,0 +1,197 @@
+package test;
+
+
+
+interface ItableShape {
+
+    int area();
+
+    default int sides()
+    {
+        return 0;
+    }
+}
+
+
+interface ItableNamed {
+
+    String name();
+}
+
+
+interface ItablePolygon extends ItableShape {
+
+    int perimeter();
+
+    default int sides()
+    {
+        return 3;
+    }
+}
+
+
+interface ItableScaled {
+
+    default int scale()
+    {
+        return 2;
+    }
+}
+
+
+// Implements interface methods on behalf of its subclasses, without
+// implementing the interfaces itself.
+class ItableBase {
+
+    public int area()
+    {
+        return 10;
+    }
+
+
+    public String name()
+    {
+        return "base";
+    }
+}
+
+
+class ItableTriangle extends ItableBase
+    implements ItablePolygon, ItableNamed, ItableScaled {
+
+    public int perimeter()
+    {
+        return 12;
+    }
+}
+
+
+class ItableSquare extends ItableBase implements ItablePolygon, ItableScaled {
+
+    public int area()
+    {
+        return 16;
+    }
+
+
+    public int perimeter()
+    {
+        return 16;
+    }
+
+
+    public int sides()
+    {
+        return 4;
+    }
+
+
+    public int scale()
+    {
+        return 3;
+    }
+}
+
+
+// Implements nothing of its own.
+class ItableUnitSquare extends ItableSquare {
+}
+
+
+class ItableCircle implements ItableShape, ItableNamed {
+
+    public int area()
+    {
+        return 28;
+    }
+
+
+    public String name()
+    {
+        return "circle";
+    }
+}
+
+
+class Itables {
+
+
+    static int area(ItableShape shape)
+    {
+        return shape.area();
+    }
+
+
+    static int sides(ItableShape shape)
+    {
+        return shape.sides();
+    }
+
+
+    static int perimeter(ItablePolygon polygon)
+    {
+        return polygon.perimeter();
+    }
+
+
+    static int scale(ItableScaled scaled)
+    {
+        return scaled.scale();
+    }
+
+
+    static String name(ItableNamed named)
+    {
+        return named.name();
+    }
+
+
+    static void check(boolean condition)
+    {
+        if (!condition) {
+            Runtime.getRuntime().exit(1);
+        }
+    }
+
+
+    public static void main(String[] args)
+    {
+        ItableShape[] shapes = {
+            new ItableTriangle(),
+            new ItableSquare(),
+            new ItableCircle(),
+            new ItableUnitSquare()
+        };
+
+        int[] areas = {10, 16, 28, 16};
+        int[] sides = {3, 4, 0, 4};
+
+        // Repeat, so that each call site sees every receiver class more than
+        // once.
+        for (int round = 0; round < 50; ++round) {
+            for (int i = 0; i < shapes.length; ++i) {
+                check(area(shapes[i]) == areas[i]);
+                check(sides(shapes[i]) == sides[i]);
+            }
+
+            check(perimeter((ItablePolygon)shapes[0]) == 12);
+            check(perimeter((ItablePolygon)shapes[1]) == 16);
+            check(perimeter((ItablePolygon)shapes[3]) == 16);
+
+            check(scale((ItableScaled)shapes[0]) == 2);
+            check(scale((ItableScaled)shapes[1]) == 3);
+            check(scale((ItableScaled)shapes[3]) == 3);
+
+            check(name((ItableNamed)shapes[0]).equals("base"));
+            check(name((ItableNamed)shapes[2]).equals("circle"));
+        }
+
+        Object obj = new ItableTriangle();
+        check(obj instanceof ItableShape);
+        check(obj instanceof ItablePolygon);
+        check(obj instanceof ItableNamed);
+        check(obj instanceof ItableScaled);
+        check(!(new ItableCircle() instanceof ItableScaled));
+        check(!(new ItableBase() instanceof ItableNamed));
+    }
+}
@@ -0,0 +1,47 @@
+package test;
+
+
+
+// The paths of these two classes, test/JarIndexClass_hhhhhhhhhhhh.class and
+// test/JarIndexClass_kmommmoilkih.class, have the same crc32 (0x59037c54),
+// so they share a hash in the jar's index, see src/jar.cpp.
+class JarIndexClass_hhhhhhhhhhhh {
+
+    static int value()
+    {
+        return 1;
+    }
+}
+
+
+
+class JarIndexClass_kmommmoilkih {
+
+    static int value()
+    {
+        return 2;
+    }
+}
+
+
+
+// runtests.sh also puts files that are not classfiles into the jar, which the
+// index leaves out.
+class JarIndex {
+
+
+    static void check(boolean condition)
+    {
+        if (!condition) {
+            Runtime.getRuntime().exit(1);
+        }
+    }
+
+
+    public static void main(String[] args)
+    {
+        check(JarIndexClass_kmommmoilkih.value() == 2);
+        check(JarIndexClass_hhhhhhhhhhhh.value() == 1);
+        check(JarIndexClass_kmommmoilkih.value() == 2);
+    }
+}
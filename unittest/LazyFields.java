@@ -0,0 +1,92 @@
+package test;
+
+
+
+// Only other classes touch these fields, so the class's own constant pool
+// holds no fieldrefs to them. Its instances must have room for them anyway.
+class LazyFieldsData {
+    int a;
+    long b;
+    Object c;
+    String d;
+    LazyFieldsData next;
+}
+
+
+
+class LazyFieldsBase {
+    int base = 3;
+}
+
+
+
+class LazyFieldsSub extends LazyFieldsBase {
+    long sub;
+}
+
+
+
+// The vm binds each fieldref when a getfield or putfield first executes it.
+class LazyFields {
+
+
+    static void check(boolean condition)
+    {
+        if (!condition) {
+            Runtime.getRuntime().exit(1);
+        }
+    }
+
+
+    static LazyFieldsData make(int i, LazyFieldsData next)
+    {
+        LazyFieldsData data = new LazyFieldsData();
+        data.a = i;
+        data.b = (long)i << 33;
+        data.c = new int[i + 1];
+        data.d = Integer.toString(i);
+        data.next = next;
+        return data;
+    }
+
+
+    public static void main(String[] args)
+    {
+        LazyFieldsData list = null;
+
+        for (int i = 0; i < 64; ++i) {
+            list = make(i, list);
+
+            // Garbage, so that the gc moves the list around.
+            Object[] garbage = new Object[16];
+            for (int j = 0; j < garbage.length; ++j) {
+                garbage[j] = new LazyFieldsData();
+            }
+        }
+
+        Runtime.getRuntime().gc();
+
+        int i = 63;
+        for (LazyFieldsData data = list; data != null; data = data.next) {
+            check(data.a == i);
+            check(data.b == (long)i << 33);
+            check(((int[])data.c).length == i + 1);
+            check(data.d.equals(Integer.toString(i)));
+            --i;
+        }
+        check(i == -1);
+
+        LazyFieldsSub sub = new LazyFieldsSub();
+
+        for (int j = 0; j < 10; ++j) {
+            // Fields of the superclass, through the subclass. The fieldrefs
+            // in the branch bind late, on the last round.
+            check(sub.base == 3 + j);
+            if (j == 9) {
+                sub.sub = -1L;
+                check(sub.sub == -1L && sub.base == 12);
+            }
+            ++sub.base;
+        }
+    }
+}
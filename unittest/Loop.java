@@ -0,0 +1,115 @@
+package test;
+
+
+
+// Tight loops, mostly useful as a microbenchmark for the interpreter's
+// dispatch overhead, e.g.: time ../eb-java Test.jar test/Loop
+class Loop {
+
+
+    int count;
+
+
+    int step(int s, int i)
+    {
+        return s + (i & 7);
+    }
+
+
+    static int intLoop(int n)
+    {
+        int s = 0;
+        for (int i = 0; i < n; ++i) {
+            s = (s + i * 3) ^ (s >> 1);
+        }
+        return s;
+    }
+
+
+    static long longLoop(int n)
+    {
+        long l = 0;
+        for (int i = 0; i < n; ++i) {
+            l = (l + i) * 3;
+        }
+        return l;
+    }
+
+
+    static int arrayLoop(int[] a, int n)
+    {
+        for (int i = 0; i < n; ++i) {
+            a[i & 255] += i;
+        }
+
+        int total = 0;
+        for (int i = 0; i < a.length; ++i) {
+            total += a[i];
+        }
+        return total;
+    }
+
+
+    static int fieldLoop(Loop loop, int n)
+    {
+        for (int i = 0; i < n; ++i) {
+            loop.count += i & 7;
+        }
+        return loop.count;
+    }
+
+
+    static int callLoop(Loop loop, int n)
+    {
+        int s = 0;
+        for (int i = 0; i < n; ++i) {
+            s = loop.step(s, i);
+        }
+        return s;
+    }
+
+
+    // Allocates, so it runs the gc too.
+    static int stringLoop(int n)
+    {
+        int total = 0;
+        for (int i = 0; i < n; ++i) {
+            StringBuilder builder = new StringBuilder();
+            builder.append("item ").append(i).append(',').append((long)i * i);
+            total += builder.toString().length();
+        }
+        return total;
+    }
+
+
+    public static void main(String args[])
+    {
+        if (intLoop(1000000) != 39324526) {
+            Runtime.getRuntime().exit(1);
+        }
+
+        if (longLoop(1000000) != 5761800953780656224L) {
+            Runtime.getRuntime().exit(1);
+        }
+
+        int[] a = new int[256];
+        if (arrayLoop(a, 1000000) != 1783293664 || a[17] != 1953441395) {
+            Runtime.getRuntime().exit(1);
+        }
+
+        Loop loop = new Loop();
+        if (fieldLoop(loop, 1000000) != 3500000) {
+            Runtime.getRuntime().exit(1);
+        }
+
+        if (callLoop(loop, 1000000) != 3500000) {
+            Runtime.getRuntime().exit(1);
+        }
+
+        if (stringLoop(100000) != 2042641) {
+            Runtime.getRuntime().exit(1);
+        }
+    }
+
+
+}
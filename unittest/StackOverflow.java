@@ -0,0 +1,78 @@
+package test;
+
+
+
+class StackOverflow {
+
+
+    static int depth = 0;
+
+
+    // Twenty locals per frame, so the recursion runs out of local slots long
+    // before it runs out of frames. The locals must survive the calls above.
+    static int deep(int n)
+    {
+        ++depth;
+
+        int a = n + 1, b = n + 2, c = n + 3, d = n + 4, e = n + 5;
+        int f = n + 6, g = n + 7, h = n + 8, i = n + 9, j = n + 10;
+        int k = n + 11, l = n + 12, m = n + 13, o = n + 14, p = n + 15;
+        int q = n + 16, r = n + 17, s = n + 18, t = n + 19;
+
+        deep(n + 1);
+
+        if (a != n + 1 || b != n + 2 || c != n + 3 || d != n + 4 ||
+            e != n + 5 || f != n + 6 || g != n + 7 || h != n + 8 ||
+            i != n + 9 || j != n + 10 || k != n + 11 || l != n + 12 ||
+            m != n + 13 || o != n + 14 || p != n + 15 || q != n + 16 ||
+            r != n + 17 || s != n + 18 || t != n + 19) {
+            Runtime.getRuntime().exit(1);
+        }
+
+        return a + t;
+    }
+
+
+    static int sum(int n)
+    {
+        if (n == 0) {
+            return 0;
+        }
+        return n + sum(n - 1);
+    }
+
+
+    public static void main(String[] args)
+    {
+        int before = 12345;
+
+        long wide = 1L << 40;
+
+        // Overflow more than once, to check that unwinding releases the
+        // frames.
+        for (int round = 0; round < 3; ++round) {
+            depth = 0;
+            boolean caught = false;
+
+            try {
+                deep(0);
+            } catch (StackOverflowError err) {
+                caught = true;
+            }
+
+            if (!caught || depth < 40) {
+                Runtime.getRuntime().exit(1);
+            }
+        }
+
+        if (before != 12345 || wide != 1L << 40) {
+            Runtime.getRuntime().exit(1);
+        }
+
+        // Methods with few locals may still recurse a couple hundred calls
+        // deep.
+        if (sum(240) != 240 * 241 / 2) {
+            Runtime.getRuntime().exit(1);
+        }
+    }
+}
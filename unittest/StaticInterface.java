@@ -0,0 +1,44 @@
+package test;
+
+
+
+interface StaticInterfaceBase {
+
+    // Not a compile time constant, so uses of it read the field.
+    int[] VALUES = {1, 2, 3};
+}
+
+
+interface StaticInterfaceSub extends StaticInterfaceBase {
+}
+
+
+class StaticInterfaceDerived extends StaticInterface {
+}
+
+
+// javac refers to a static field of an interface, used unqualified in a class
+// that implements the interface, through the class. So the vm has to look for
+// the field in the class's superinterfaces.
+public class StaticInterface implements StaticInterfaceSub {
+
+
+    static int sum(int[] values)
+    {
+        return values[0] + values[1] + values[2];
+    }
+
+
+    public static void main(String[] args)
+    {
+        for (int i = 0; i < 3; ++i) {
+            if (sum(VALUES) != 6) {
+                Runtime.getRuntime().exit(1);
+            }
+
+            if (StaticInterfaceDerived.VALUES != StaticInterfaceBase.VALUES) {
+                Runtime.getRuntime().exit(1);
+            }
+        }
+    }
+}
@@ -0,0 +1,153 @@
+package test;
+
+
+
+interface TypeCheckRoot {
+}
+
+
+interface TypeCheckLeaf extends TypeCheckRoot {
+}
+
+
+interface TypeCheckOther {
+}
+
+
+class TypeCheckA {
+}
+
+
+class TypeCheckB extends TypeCheckA {
+}
+
+
+class TypeCheckC extends TypeCheckB implements TypeCheckLeaf {
+}
+
+
+class TypeCheckD extends TypeCheckC {
+}
+
+
+class TypeCheckE extends TypeCheckD {
+}
+
+
+class TypeCheckF extends TypeCheckE implements TypeCheckOther {
+}
+
+
+class TypeCheckG extends TypeCheckF {
+}
+
+
+class TypeChecks {
+
+
+    static void check(boolean condition)
+    {
+        if (!condition) {
+            Runtime.getRuntime().exit(1);
+        }
+    }
+
+
+    static boolean castFails(Object obj)
+    {
+        try {
+            TypeCheckE e = (TypeCheckE)obj;
+            return false;
+        } catch (ClassCastException exn) {
+            return true;
+        }
+    }
+
+
+    static boolean arrayCastFails(Object obj)
+    {
+        try {
+            String[] strings = (String[])obj;
+            return false;
+        } catch (ClassCastException exn) {
+            return true;
+        }
+    }
+
+
+    public static void main(String[] args)
+    {
+        Object[] objects = {
+            new TypeCheckA(),
+            new TypeCheckB(),
+            new TypeCheckC(),
+            new TypeCheckD(),
+            new TypeCheckE(),
+            new TypeCheckF(),
+            new TypeCheckG()
+        };
+
+        // Repeat, so that each check sees the same class more than once.
+        for (int round = 0; round < 20; ++round) {
+            for (int i = 0; i < objects.length; ++i) {
+                Object obj = objects[i];
+
+                check(obj instanceof TypeCheckA);
+                check((obj instanceof TypeCheckB) == (i >= 1));
+                check((obj instanceof TypeCheckD) == (i >= 3));
+                check((obj instanceof TypeCheckE) == (i >= 4));
+                check((obj instanceof TypeCheckG) == (i >= 6));
+
+                // Interfaces, implemented directly, through a superclass, or
+                // through a superinterface.
+                check((obj instanceof TypeCheckLeaf) == (i >= 2));
+                check((obj instanceof TypeCheckRoot) == (i >= 2));
+                check((obj instanceof TypeCheckOther) == (i >= 5));
+
+                check(castFails(obj) == (i < 4));
+            }
+
+            TypeCheckRoot root = (TypeCheckRoot)objects[6];
+            TypeCheckOther other = (TypeCheckOther)root;
+            check(other == objects[6]);
+        }
+
+        Object nothing = null;
+        check(!(nothing instanceof Object));
+        check(!castFails(nothing));
+
+        Object ints = new int[4];
+        check(ints instanceof Object);
+        check(ints instanceof int[]);
+        check(!(ints instanceof long[]));
+        check(!(ints instanceof Object[]));
+        check(arrayCastFails(ints));
+
+        Object strings = new String[3];
+        check(strings instanceof Object);
+        check(strings instanceof String[]);
+        check(strings instanceof Object[]);
+        check(strings instanceof CharSequence[]);
+        check(!(strings instanceof Integer[]));
+        check(!(strings instanceof int[]));
+        check(!arrayCastFails(strings));
+
+        Object plain = new Object[3];
+        check(plain instanceof Object[]);
+        check(!(plain instanceof String[]));
+        check(arrayCastFails(plain));
+
+        Object deep = new TypeCheckG[2];
+        check(deep instanceof TypeCheckA[]);
+        check(deep instanceof TypeCheckRoot[]);
+        check(deep instanceof TypeCheckOther[]);
+        check(!(new TypeCheckA[2] instanceof TypeCheckRoot[]));
+
+        Object matrix = new int[2][3];
+        check(matrix instanceof Object);
+        check(matrix instanceof Object[]);
+        check(matrix instanceof int[][]);
+        check(!(matrix instanceof String[]));
+        check(((int[][])matrix)[1].length == 3);
+    }
+}
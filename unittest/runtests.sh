@@ -1,25 +1,67 @@
 
 javac --release 8 *.java
 mv *.class test/
+
+# Files other than classfiles, see JarIndex.java.
+echo "not a classfile" > test/JarIndex.txt
+echo "not a classfile either" > test/JarIndexClass_hhhhhhhhhhhh
+
 jar cf0 Test.jar test
 
 
-for i in *.java; do
-    [ -f "$i" ] || break
+# Prelinked images, see tools/prelink.cpp: one for the jars as they are, and a
+# stale one, of the same classes compiled with more debug info, so that none of
+# its records match a classfile in Test.jar. Build ../prelink with
+# ../build-tools.sh.
+javac --release 8 -g -d stale *.java
+jar cf0 Stale.jar -C stale test
+
+../prelink Test.img Test.jar ../src/Lang.jar
+../prelink Stale.img Stale.jar ../src/Lang.jar
+
+# And a truncated one, which the vm should ignore.
+head -c 64 Test.img > Truncated.img
+
+
+for image in "" Test.img Stale.img Truncated.img; do
+    for i in *.java; do
+        [ -f "$i" ] || break
 
-    echo ================================================================================
-    echo Running test $i...
-    echo ================================================================================
+        echo ================================================================================
+        echo Running test $i${image:+ with -image $image}...
+        echo ================================================================================
 
-    ../eb-java Test.jar test/"${i%%.*}"
+        ../eb-java Test.jar test/"${i%%.*}" ${image:+-image $image}
 
-    exit_status=$?
+        exit_status=$?
 
-    if [ $exit_status -eq 1 ]; then
-        echo unit test $i failed!
-        exit 1
-    fi
+        if [ $exit_status -eq 1 ]; then
+            echo unit test $i failed!
+            exit 1
+        fi
 
-    echo Test success!
-    echo ""
+        echo Test success!
+        echo ""
+    done
 done
+
+
+echo ================================================================================
+echo Running test ClassPath.java with -cp...
+echo ================================================================================
+
+jar cf0 ClassPath.jar test/ClassPath.class
+jar cf0 ClassPathLib.jar test/ClassPathLib.class
+
+if ! ../eb-java ClassPath.jar test/ClassPath -cp ClassPathLib.jar:Test.jar; then
+    echo unit test ClassPath.java with -cp failed!
+    exit 1
+fi
+
+if ../eb-java Test.jar test/ClassPath -classpath ClassPathLib.jar > /dev/null; then
+    echo eb-java accepted an unknown option!
+    exit 1
+fi
+
+echo Test success!
+echo ""